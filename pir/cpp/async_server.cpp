@@ -0,0 +1,131 @@
+//
+// Copyright 2020 the authors listed in CONTRIBUTORS.md
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#include "pir/cpp/async_server.h"
+
+#include <utility>
+
+namespace pir {
+
+AsyncPIRServer::AsyncPIRServer(std::shared_ptr<const PIRServer> server,
+                               size_t num_dispatchers, size_t max_queued)
+    : server_(std::move(server)),
+      capacity_(num_dispatchers + max_queued),
+      dispatchers_(std::make_unique<ThreadPool>(num_dispatchers)) {}
+
+StatusOr<std::unique_ptr<AsyncPIRServer>> AsyncPIRServer::Create(
+    std::shared_ptr<const PIRServer> server, size_t num_dispatchers,
+    size_t max_queued) {
+  if (server == nullptr) {
+    return absl::InvalidArgumentError("server must not be null");
+  }
+  if (num_dispatchers == 0) {
+    return absl::InvalidArgumentError(
+        "number of dispatchers must be positive");
+  }
+  return absl::WrapUnique(
+      new AsyncPIRServer(std::move(server), num_dispatchers, max_queued));
+}
+
+AsyncPIRServer::~AsyncPIRServer() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  // Runs what is left in the queue, which now completes straight away.
+  dispatchers_.reset();
+}
+
+Status AsyncPIRServer::ProcessRequestAsync(
+    Request request, std::shared_ptr<Cancellation> cancellation,
+    Callback done) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stopping_) {
+      return absl::UnavailableError("server is shutting down");
+    }
+    if (metrics_.queued + metrics_.running >= capacity_) {
+      ++metrics_.rejected;
+      return absl::ResourceExhaustedError("request queue is full");
+    }
+    ++metrics_.accepted;
+    ++metrics_.queued;
+  }
+  dispatchers_->Schedule(
+      [this, request = std::move(request),
+       cancellation = std::move(cancellation),
+       done = std::move(done)](size_t) {
+        Run(request, cancellation.get(), done);
+      });
+  return absl::OkStatus();
+}
+
+std::future<StatusOr<Response>> AsyncPIRServer::ProcessRequestAsync(
+    Request request, std::shared_ptr<Cancellation> cancellation) {
+  auto promise = std::make_shared<std::promise<StatusOr<Response>>>();
+  auto future = promise->get_future();
+  const auto status = ProcessRequestAsync(
+      std::move(request), std::move(cancellation),
+      [promise](StatusOr<Response> response) {
+        promise->set_value(std::move(response));
+      });
+  if (!status.ok()) promise->set_value(status);
+  return future;
+}
+
+AsyncServerMetrics AsyncPIRServer::Metrics() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return metrics_;
+}
+
+void AsyncPIRServer::Run(const Request& request,
+                         const Cancellation* cancellation,
+                         const Callback& done) {
+  bool stopping;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    --metrics_.queued;
+    ++metrics_.running;
+    stopping = stopping_;
+  }
+
+  StatusOr<Response> response =
+      absl::UnavailableError("server is shutting down");
+  if (!stopping) {
+    // Requests that were stopped while they waited are never started.
+    const auto status =
+        cancellation == nullptr ? absl::OkStatus() : cancellation->status();
+    if (status.ok()) {
+      response = server_->ProcessRequest(request, cancellation);
+    } else {
+      response = status;
+    }
+  }
+  const auto code = response.status().code();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++metrics_.completed;
+    if (code == absl::StatusCode::kCancelled ||
+        code == absl::StatusCode::kDeadlineExceeded) {
+      ++metrics_.stopped;
+    }
+  }
+  done(std::move(response));
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  --metrics_.running;
+}
+
+}  // namespace pir
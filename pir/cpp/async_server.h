@@ -0,0 +1,138 @@
+//
+// Copyright 2020 the authors listed in CONTRIBUTORS.md
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef PIR_ASYNC_SERVER_H_
+#define PIR_ASYNC_SERVER_H_
+
+#include <cstddef>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+
+#include "absl/status/statusor.h"
+#include "pir/cpp/cancellation.h"
+#include "pir/cpp/server.h"
+#include "pir/cpp/thread_pool.h"
+#include "pir/proto/payload.pb.h"
+
+namespace pir {
+
+using absl::Status;
+using absl::StatusOr;
+
+/**
+ * Counters describing the behaviour of an AsyncPIRServer.
+ */
+struct AsyncServerMetrics {
+  // Requests accepted, and those turned away because the queue was full.
+  std::size_t accepted = 0;
+  std::size_t rejected = 0;
+  // Requests that have completed, counted before their callback is called,
+  // and those among them that were stopped by cancellation or their deadline.
+  std::size_t completed = 0;
+  std::size_t stopped = 0;
+  // Requests currently waiting for a dispatcher, and holding one, until their
+  // callback returns.
+  std::size_t queued = 0;
+  std::size_t running = 0;
+};
+
+/**
+ * Processes the requests of a PIRServer asynchronously, on a fixed number of
+ * dispatcher threads fed by a bounded queue. When every dispatcher is busy
+ * and the queue is full, new requests are rejected straight away instead of
+ * waiting, so that an overloaded server sheds load rather than piling up
+ * threads. Requests can be cancelled and given deadlines, which are checked
+ * before a request leaves the queue and while it is processed.
+ */
+class AsyncPIRServer {
+ public:
+  using Callback = std::function<void(StatusOr<Response>)>;
+
+  /**
+   * Creates an asynchronous front end for a server.
+   * @param[in] server Server the requests are processed by. Each dispatcher
+   *    calls its ProcessRequest, which splits the queries of a request
+   *    between the server's own threads.
+   * @param[in] num_dispatchers Number of requests processed at the same time.
+   * @param[in] max_queued Number of requests that may wait for a dispatcher.
+   * @returns InvalidArgument if there is no server or no dispatcher
+   */
+  static StatusOr<std::unique_ptr<AsyncPIRServer>> Create(
+      std::shared_ptr<const PIRServer> server, std::size_t num_dispatchers = 1,
+      std::size_t max_queued = 0);
+
+  /**
+   * Waits for the requests being processed. Requests still queued complete
+   * with Unavailable, without being processed.
+   */
+  ~AsyncPIRServer();
+
+  AsyncPIRServer(const AsyncPIRServer&) = delete;
+  AsyncPIRServer& operator=(const AsyncPIRServer&) = delete;
+
+  /**
+   * Queues a request, calling done with its response on a dispatcher thread
+   * once it has been processed. The request's place in the queue is only
+   * released once done returns.
+   * @param[in] request The PIR Payload
+   * @param[in] cancellation If not nullptr, deadline and cancellation flag of
+   *    the request. A request stopped before a dispatcher picks it up
+   *    completes without being processed.
+   * @param[in] done Called exactly once with the response, or the error of
+   *    the request, if the request is accepted. Must not throw.
+   * @returns ResourceExhausted if the queue is full, or Unavailable if the
+   *    server is shutting down, in which case done is never called
+   */
+  Status ProcessRequestAsync(Request request,
+                             std::shared_ptr<Cancellation> cancellation,
+                             Callback done);
+
+  /**
+   * As above, returning the response through a future. A request that isn't
+   * accepted gets a future that is already ready with the error.
+   */
+  std::future<StatusOr<Response>> ProcessRequestAsync(
+      Request request, std::shared_ptr<Cancellation> cancellation = nullptr);
+
+  /**
+   * Returns a snapshot of the counters.
+   */
+  AsyncServerMetrics Metrics() const;
+
+ private:
+  AsyncPIRServer(std::shared_ptr<const PIRServer> server,
+                 std::size_t num_dispatchers, std::size_t max_queued);
+
+  void Run(const Request& request, const Cancellation* cancellation,
+           const Callback& done);
+
+  const std::shared_ptr<const PIRServer> server_;
+  // Requests queued or running at most.
+  const std::size_t capacity_;
+
+  mutable std::mutex mutex_;
+  AsyncServerMetrics metrics_;
+  bool stopping_ = false;
+
+  // Last, so that the dispatchers stop before the rest is destroyed.
+  std::unique_ptr<ThreadPool> dispatchers_;
+};
+
+}  // namespace pir
+
+#endif  // PIR_ASYNC_SERVER_H_
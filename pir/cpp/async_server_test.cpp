@@ -0,0 +1,133 @@
+//
+// Copyright 2020 the authors listed in CONTRIBUTORS.md
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "pir/cpp/async_server.h"
+
+#include <chrono>
+#include <future>
+#include <memory>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "pir/cpp/client.h"
+#include "pir/cpp/status_asserts.h"
+#include "pir/cpp/test_base.h"
+
+namespace pir {
+namespace {
+
+using std::size_t;
+using std::vector;
+using ::testing::Eq;
+using ::testing::NotNull;
+
+class AsyncPIRServerTest : public ::testing::Test, public PIRTestingBase {
+ protected:
+  void SetUp() {
+    SetUpParams(100, 64, 2);
+    GenerateDB();
+    ASSIGN_OR_FAIL(client_, PIRClient::Create(pir_params_));
+    ASSIGN_OR_FAIL(server_, PIRServer::Create(pir_db_, pir_params_));
+  }
+
+  std::unique_ptr<PIRClient> client_;
+  std::shared_ptr<PIRServer> server_;
+};
+
+TEST_F(AsyncPIRServerTest, ProcessesRequests) {
+  ASSIGN_OR_FAIL(auto async_server, AsyncPIRServer::Create(server_, 2, 4));
+  const vector<vector<size_t>> indices = {{3}, {42, 7}, {99}};
+  vector<std::future<StatusOr<Response>>> futures;
+  for (const auto& request_indices : indices) {
+    ASSIGN_OR_FAIL(auto request, client_->CreateRequest(request_indices));
+    futures.push_back(async_server->ProcessRequestAsync(std::move(request)));
+  }
+  for (size_t r = 0; r < indices.size(); ++r) {
+    ASSIGN_OR_FAIL(auto response, futures[r].get());
+    ASSIGN_OR_FAIL(auto results,
+                   client_->ProcessResponse(indices[r], response));
+    ASSERT_THAT(results.size(), Eq(indices[r].size()));
+    for (size_t i = 0; i < results.size(); ++i) {
+      EXPECT_THAT(results[i], Eq(string_db_[indices[r][i]]));
+    }
+  }
+  const auto metrics = async_server->Metrics();
+  EXPECT_THAT(metrics.accepted, Eq(3));
+  EXPECT_THAT(metrics.completed, Eq(3));
+}
+
+TEST_F(AsyncPIRServerTest, CancelledRequestIsNotProcessed) {
+  ASSIGN_OR_FAIL(auto async_server, AsyncPIRServer::Create(server_));
+  ASSIGN_OR_FAIL(auto request, client_->CreateRequest({5}));
+  auto cancellation = std::make_shared<Cancellation>();
+  cancellation->Cancel();
+  auto response = async_server->ProcessRequestAsync(request, cancellation);
+  EXPECT_THAT(response.get().status().code(),
+              Eq(absl::StatusCode::kCancelled));
+  EXPECT_THAT(async_server->Metrics().stopped, Eq(1));
+}
+
+TEST_F(AsyncPIRServerTest, DeadlineExceeded) {
+  ASSIGN_OR_FAIL(auto async_server, AsyncPIRServer::Create(server_));
+  ASSIGN_OR_FAIL(auto request, client_->CreateRequest({5}));
+  auto cancellation = std::make_shared<Cancellation>(
+      Cancellation::Clock::now() - std::chrono::seconds(1));
+  auto response = async_server->ProcessRequestAsync(request, cancellation);
+  EXPECT_THAT(response.get().status().code(),
+              Eq(absl::StatusCode::kDeadlineExceeded));
+}
+
+TEST_F(AsyncPIRServerTest, RejectsRequestsWhenFull) {
+  ASSIGN_OR_FAIL(auto async_server, AsyncPIRServer::Create(server_, 1, 1));
+  ASSIGN_OR_FAIL(auto request, client_->CreateRequest({5}));
+
+  // The first request holds the dispatcher until its callback returns, and
+  // the second one fills the queue.
+  std::promise<void> release;
+  auto released = release.get_future().share();
+  std::promise<StatusOr<Response>> first;
+  ASSERT_OK(async_server->ProcessRequestAsync(
+      request, nullptr, [&](StatusOr<Response> response) {
+        released.wait();
+        first.set_value(std::move(response));
+      }));
+  auto second = async_server->ProcessRequestAsync(request);
+  auto third = async_server->ProcessRequestAsync(request);
+  EXPECT_THAT(third.get().status().code(),
+              Eq(absl::StatusCode::kResourceExhausted));
+  EXPECT_THAT(async_server->Metrics().rejected, Eq(1));
+
+  release.set_value();
+  EXPECT_OK(first.get_future().get().status());
+  EXPECT_OK(second.get().status());
+}
+
+TEST_F(AsyncPIRServerTest, ProcessRequestStopsWhenCancelled) {
+  ASSIGN_OR_FAIL(auto request, client_->CreateRequest({5}));
+  Cancellation cancellation;
+  cancellation.Cancel();
+  EXPECT_THAT(server_->ProcessRequest(request, &cancellation).status().code(),
+              Eq(absl::StatusCode::kCancelled));
+}
+
+TEST(AsyncPIRServerCreateTest, InvalidArguments) {
+  EXPECT_THAT(AsyncPIRServer::Create(nullptr).status().code(),
+              Eq(absl::StatusCode::kInvalidArgument));
+}
+
+}  // namespace
+}  // namespace pir
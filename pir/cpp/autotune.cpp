@@ -0,0 +1,328 @@
+//
+// Copyright 2020 the authors listed in CONTRIBUTORS.md
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#include "pir/cpp/autotune.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <string>
+
+#include "pir/cpp/context.h"
+#include "pir/cpp/ct_reencoder.h"
+#include "pir/cpp/serialization.h"
+#include "pir/cpp/status_asserts.h"
+#include "pir/cpp/utils.h"
+
+namespace pir {
+
+using absl::InternalError;
+using absl::InvalidArgumentError;
+using seal::Ciphertext;
+using seal::Plaintext;
+using std::size_t;
+using std::string;
+using std::vector;
+
+namespace {
+
+/**
+ * Average time of a call to fn, after a first call that warms up the memory
+ * pools.
+ */
+template <typename Fn>
+double seconds_per_call(size_t repetitions, Fn fn) {
+  fn();
+  const auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < repetitions; ++i) fn();
+  const std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return elapsed.count() / repetitions;
+}
+
+/**
+ * Calls fn with every set of d dimensions tried for num_pt plaintexts. The
+ * top d-1 dimensions go from 2 up to their size in an equal split, since
+ * every cost but the query size grows with them, and the bottom one is as
+ * large as it needs to be to cover the database.
+ */
+template <typename Fn>
+void for_each_dimensions(size_t num_pt, size_t d, Fn fn) {
+  vector<uint32_t> dims(d, 2);
+  if (d == 1) {
+    dims[0] = num_pt;
+    fn(dims);
+    return;
+  }
+  const uint32_t limit = std::ceil(std::pow(num_pt, 1.0 / d));
+  if (limit < 2) return;
+  while (true) {
+    size_t top = 1;
+    for (size_t i = 0; i + 1 < d; ++i) top *= dims[i];
+    const size_t bottom = (num_pt + top - 1) / top;
+    if (bottom >= 2) {
+      dims[d - 1] = bottom;
+      fn(dims);
+    }
+    size_t i = 0;
+    while (i + 1 < d && dims[i] == limit) dims[i++] = 2;
+    if (i + 1 == d) return;
+    ++dims[i];
+  }
+}
+
+}  // namespace
+
+StatusOr<CostModel> CalibrateCostModel(const EncryptionParameters& enc_params,
+                                       size_t repetitions) {
+  if (repetitions == 0) {
+    return InvalidArgumentError("number of repetitions must be positive");
+  }
+  // A context for a database of one item, for the level replies are switched
+  // to.
+  ASSIGN_OR_RETURN(auto params, CreatePIRParameters(1, 0, 1, enc_params));
+  params->set_modulus_switch_replies(true);
+  ASSIGN_OR_RETURN(auto context, PIRContext::Create(params));
+  auto sealctx = context->SEALContext();
+  const auto& reply_parms_id = context->ReplyParmsId();
+  ASSIGN_OR_RETURN(auto reencoder, CiphertextReencoder::Create(sealctx));
+  ASSIGN_OR_RETURN(auto switched_reencoder,
+                   CiphertextReencoder::Create(sealctx, reply_parms_id));
+
+  CostModel model;
+  const size_t poly_modulus_degree = enc_params.poly_modulus_degree();
+  model.poly_modulus_degree = poly_modulus_degree;
+  model.expansion_ratio = reencoder->ExpansionRatio();
+  model.switched_expansion_ratio = switched_reencoder->ExpansionRatio();
+  try {
+    seal::KeyGenerator keygen(sealctx);
+    seal::Encryptor encryptor(sealctx, keygen.public_key(),
+                              keygen.secret_key());
+    seal::Decryptor decryptor(sealctx, keygen.secret_key());
+    seal::Evaluator evaluator(sealctx);
+    const uint32_t galois_elt = poly_modulus_degree + 1;
+    auto gal_keys = keygen.galois_keys_local({galois_elt});
+    auto relin_keys = keygen.relin_keys_local();
+
+    // Coefficients below the plaintext modulus, like those of the database
+    // and of decomposed ciphertexts.
+    const uint64_t plain_modulus = enc_params.plain_modulus().value();
+    Plaintext pt(poly_modulus_degree);
+    std::mt19937_64 prng(0);
+    for (size_t i = 0; i < poly_modulus_degree; ++i) {
+      pt[i] = prng() % plain_modulus;
+    }
+    Plaintext one("1");
+    Ciphertext ct;
+    encryptor.encrypt(one, ct);
+    model.fresh_noise_budget = decryptor.invariant_noise_budget(ct);
+
+    string serialized;
+    RETURN_IF_ERROR(SEALSerialize<>(encryptor.encrypt_symmetric(one),
+                                    &serialized));
+    model.query_ciphertext_bytes = serialized.size();
+    RETURN_IF_ERROR(SEALSerialize<>(ct, &serialized));
+    model.reply_ciphertext_bytes = serialized.size();
+
+    Ciphertext result;
+    model.expansion_seconds = seconds_per_call(repetitions, [&] {
+      evaluator.apply_galois(ct, galois_elt, gal_keys, result);
+      evaluator.add_inplace(result, ct);
+    });
+    model.expansion_noise_bits =
+        model.fresh_noise_budget - decryptor.invariant_noise_budget(result);
+
+    model.multiply_seconds = seconds_per_call(repetitions, [&] {
+      evaluator.multiply(ct, ct, result);
+      evaluator.relinearize_inplace(result, relin_keys);
+    });
+    model.multiply_noise_bits =
+        model.fresh_noise_budget - decryptor.invariant_noise_budget(result);
+
+    evaluator.multiply_plain(ct, pt, result);
+    model.multiply_plain_noise_bits =
+        model.fresh_noise_budget - decryptor.invariant_noise_budget(result);
+    // The database multiplies in NTT form.
+    Plaintext pt_ntt;
+    evaluator.transform_to_ntt(pt, sealctx->first_parms_id(), pt_ntt);
+    Ciphertext ct_ntt;
+    evaluator.transform_to_ntt(ct, ct_ntt);
+    model.multiply_plain_seconds = seconds_per_call(repetitions, [&] {
+      evaluator.multiply_plain(ct_ntt, pt_ntt, result);
+    });
+
+    Ciphertext switched;
+    evaluator.mod_switch_to(ct, reply_parms_id, switched);
+    model.modulus_switch_noise_bits =
+        std::max(0, model.fresh_noise_budget -
+                        decryptor.invariant_noise_budget(switched));
+    RETURN_IF_ERROR(SEALSerialize<>(switched, &serialized));
+    model.switched_reply_ciphertext_bytes = serialized.size();
+
+    vector<Plaintext> pts;
+    model.reencode_seconds = seconds_per_call(
+        repetitions, [&] { reencoder->EncodeNTT(ct, pts); });
+    model.switched_reencode_seconds = seconds_per_call(
+        repetitions, [&] { switched_reencoder->EncodeNTT(switched, pts); });
+  } catch (const std::exception& e) {
+    return InternalError(e.what());
+  }
+  return model;
+}
+
+CostEstimate EstimateCost(const PIRParameters& params, const CostModel& model,
+                          const TuningObjective& objective) {
+  CostEstimate estimate;
+  const size_t num_dims = params.dimensions_size();
+  if (num_dims == 0 || model.poly_modulus_degree == 0) return estimate;
+  const bool switched = params.modulus_switch_replies();
+  const size_t num_pt = params.num_pt();
+
+  // Expansion of the selection vectors of all dimensions, packed together in
+  // the query.
+  size_t dim_sum = 0;
+  for (const auto d : params.dimensions()) dim_sum += d;
+  const size_t query_cts =
+      (dim_sum + model.poly_modulus_degree - 1) / model.poly_modulus_degree;
+  estimate.query_bytes = query_cts * model.query_ciphertext_bytes;
+  estimate.server_seconds += dim_sum * model.expansion_seconds;
+  const int selection_budget =
+      model.fresh_noise_budget -
+      model.expansion_noise_bits *
+          ceil_log2(std::min(dim_sum, model.poly_modulus_degree));
+
+  // Rows of dimension i the server goes through, which stop at the end of
+  // the database rather than at the product of the dimensions.
+  vector<size_t> rows(num_dims);
+  size_t row_size = 1;
+  for (size_t i = num_dims; i-- > 0;) {
+    rows[i] = (num_pt + row_size - 1) / row_size;
+    row_size *= params.dimensions(i);
+  }
+
+  // The bottom dimension is multiplied with the database plaintexts.
+  estimate.server_seconds += rows[num_dims - 1] * model.multiply_plain_seconds;
+  const int bottom_budget =
+      selection_budget - model.multiply_plain_noise_bits -
+      static_cast<int>(ceil_log2(params.dimensions(num_dims - 1)));
+  const int switch_bits = switched ? model.modulus_switch_noise_bits : 0;
+
+  size_t reply_cts = 1;
+  if (params.use_ciphertext_multiplication()) {
+    // Each higher dimension multiplies the sums of the lower ones by its
+    // selection vector, using up noise budget of the same ciphertext.
+    int budget = bottom_budget;
+    for (size_t i = 0; i + 1 < num_dims; ++i) {
+      estimate.server_seconds += rows[i] * model.multiply_seconds;
+      budget -= model.multiply_noise_bits +
+                static_cast<int>(ceil_log2(params.dimensions(i)));
+    }
+    estimate.noise_budget = budget - switch_bits;
+  } else {
+    // Each higher dimension decomposes the ciphertexts of the lower ones into
+    // plaintexts, multiplied with fresh selection vectors, so every level
+    // has its own noise and only the worst one counts.
+    const size_t ratio =
+        2 * (switched ? model.switched_expansion_ratio : model.expansion_ratio);
+    const double reencode_seconds =
+        switched ? model.switched_reencode_seconds : model.reencode_seconds;
+    int budget = bottom_budget;
+    for (size_t i = num_dims - 1; i-- > 0;) {
+      estimate.server_seconds += rows[i] * reply_cts * reencode_seconds;
+      reply_cts *= ratio;
+      estimate.server_seconds +=
+          rows[i] * reply_cts * model.multiply_plain_seconds;
+      budget = std::min(
+          budget, selection_budget - model.multiply_plain_noise_bits -
+                      static_cast<int>(ceil_log2(params.dimensions(i))));
+    }
+    estimate.noise_budget = budget - switch_bits;
+  }
+  estimate.reply_bytes =
+      reply_cts * (switched ? model.switched_reply_ciphertext_bytes
+                            : model.reply_ciphertext_bytes);
+
+  estimate.objective =
+      objective.seconds_weight * estimate.server_seconds +
+      objective.bytes_weight * (estimate.query_bytes + estimate.reply_bytes);
+  return estimate;
+}
+
+vector<EncryptionParameters> DefaultTuningCandidates() {
+  vector<EncryptionParameters> candidates;
+  for (const uint32_t bits : {16, 20, 24}) {
+    candidates.push_back(GenerateEncryptionParams(4096, bits));
+  }
+  for (const uint32_t bits : {20, 30, 42}) {
+    candidates.push_back(GenerateEncryptionParams(8192, bits));
+  }
+  return candidates;
+}
+
+StatusOr<std::shared_ptr<PIRParameters>> AutotunePIRParameters(
+    size_t dbsize, size_t bytes_per_item, const TuningObjective& objective,
+    const vector<EncryptionParameters>& candidates) {
+  vector<std::pair<EncryptionParameters, CostModel>> calibrated;
+  for (const auto& enc_params : candidates) {
+    ASSIGN_OR_RETURN(auto model, CalibrateCostModel(enc_params));
+    calibrated.emplace_back(enc_params, model);
+  }
+  return AutotunePIRParameters(dbsize, bytes_per_item, objective, calibrated);
+}
+
+StatusOr<std::shared_ptr<PIRParameters>> AutotunePIRParameters(
+    size_t dbsize, size_t bytes_per_item, const TuningObjective& objective,
+    const vector<std::pair<EncryptionParameters, CostModel>>& candidates) {
+  std::shared_ptr<PIRParameters> best;
+  double best_objective = std::numeric_limits<double>::infinity();
+  for (const auto& candidate : candidates) {
+    ASSIGN_OR_RETURN(auto params, CreatePIRParameters(dbsize, bytes_per_item,
+                                                      1, candidate.first));
+    auto try_dimensions = [&](const vector<uint32_t>& dims) {
+      params->clear_dimensions();
+      for (const auto dim : dims) params->add_dimensions(dim);
+      // Ciphertext multiplication only changes anything with several
+      // dimensions.
+      for (const bool ct_mult : {false, true}) {
+        if (ct_mult && dims.size() == 1) continue;
+        params->set_use_ciphertext_multiplication(ct_mult);
+        for (const bool switched : {false, true}) {
+          params->set_modulus_switch_replies(switched);
+          const auto estimate =
+              EstimateCost(*params, candidate.second, objective);
+          if (estimate.noise_budget < objective.min_noise_budget ||
+              estimate.objective >= best_objective) {
+            continue;
+          }
+          best_objective = estimate.objective;
+          best = std::make_shared<PIRParameters>(*params);
+        }
+      }
+    };
+    const size_t max_dimensions = std::max<size_t>(objective.max_dimensions, 1);
+    for (size_t d = 1; d <= max_dimensions; ++d) {
+      for_each_dimensions(params->num_pt(), d, try_dimensions);
+    }
+  }
+  if (best == nullptr) {
+    return InvalidArgumentError(
+        "No candidate parameters keep the required noise budget");
+  }
+  return best;
+}
+
+}  // namespace pir
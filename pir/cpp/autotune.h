@@ -0,0 +1,163 @@
+//
+// Copyright 2020 the authors listed in CONTRIBUTORS.md
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef PIR_AUTOTUNE_H_
+#define PIR_AUTOTUNE_H_
+
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "absl/status/statusor.h"
+#include "pir/cpp/parameters.h"
+#include "pir/proto/payload.pb.h"
+#include "seal/seal.h"
+
+namespace pir {
+
+using absl::StatusOr;
+
+/**
+ * Costs of the homomorphic operations a server runs for one query under
+ * given encryption parameters, measured by CalibrateCostModel.
+ */
+struct CostModel {
+  std::size_t poly_modulus_degree = 0;
+
+  // Seconds taken by one step of query expansion, an automorphism and an
+  // addition, which is done about once per item of the selection vector.
+  double expansion_seconds = 0;
+  // Seconds taken by a plaintext multiplication, in NTT form.
+  double multiply_plain_seconds = 0;
+  // Seconds taken by a ciphertext multiplication and relinearization.
+  double multiply_seconds = 0;
+  // Seconds taken to decompose a ciphertext into plaintexts, at the first
+  // level and at the level replies are modulus switched to.
+  double reencode_seconds = 0;
+  double switched_reencode_seconds = 0;
+
+  // Serialized sizes of a query ciphertext, which is seeded, and of a reply
+  // ciphertext before and after modulus switching.
+  std::size_t query_ciphertext_bytes = 0;
+  std::size_t reply_ciphertext_bytes = 0;
+  std::size_t switched_reply_ciphertext_bytes = 0;
+
+  // Noise budget of a fresh ciphertext, and bits of it used up by each level
+  // of query expansion, a plaintext multiplication, a ciphertext
+  // multiplication and modulus switching.
+  int fresh_noise_budget = 0;
+  int expansion_noise_bits = 0;
+  int multiply_plain_noise_bits = 0;
+  int multiply_noise_bits = 0;
+  int modulus_switch_noise_bits = 0;
+
+  // Plaintexts each polynomial of a ciphertext decomposes into, before and
+  // after modulus switching.
+  std::size_t expansion_ratio = 0;
+  std::size_t switched_expansion_ratio = 0;
+};
+
+/**
+ * What the autotuner minimizes, and the noise budget it must keep.
+ */
+struct TuningObjective {
+  // Weight of the server's computation time, per second.
+  double seconds_weight = 1.0;
+  // Weight of the query and reply sizes, per byte. The default values a
+  // byte like the time it takes to send it at 100MB/s.
+  double bytes_weight = 1e-8;
+  // Bits of noise budget replies must have left, as a margin for the
+  // approximations of the model.
+  int min_noise_budget = 4;
+  // Largest number of dimensions tried.
+  std::size_t max_dimensions = 3;
+};
+
+/**
+ * Cost of one query under given parameters, as predicted by a cost model.
+ */
+struct CostEstimate {
+  double server_seconds = 0;
+  std::size_t query_bytes = 0;
+  std::size_t reply_bytes = 0;
+  // Smallest noise budget left in the ciphertexts the client decrypts.
+  int noise_budget = 0;
+  // Weighted sum of the time and the sizes.
+  double objective = 0;
+};
+
+/**
+ * Measures the costs of the operations of a query under encryption
+ * parameters, each averaged over some repetitions.
+ * @param[in] enc_params SEAL Encryption Parameters to measure.
+ * @param[in] repetitions Number of times each operation is timed.
+ * @returns InvalidArgument if the parameters are invalid or repetitions is
+ *    zero, or InternalError if SEAL fails
+ */
+StatusOr<CostModel> CalibrateCostModel(const EncryptionParameters& enc_params,
+                                       std::size_t repetitions = 8);
+
+/**
+ * Predicts the cost of one query. Only the number of plaintexts, the
+ * dimensions and the multiplication and modulus switching settings of the
+ * parameters are used, and the model must be calibrated for their
+ * encryption parameters.
+ */
+CostEstimate EstimateCost(const PIRParameters& params, const CostModel& model,
+                          const TuningObjective& objective);
+
+/**
+ * Encryption parameters the autotuner tries by default: polynomial degrees
+ * of 4096 and 8192, each with a few sizes of plaintext modulus.
+ */
+std::vector<EncryptionParameters> DefaultTuningCandidates();
+
+/**
+ * Chooses the parameters of a database that minimize the objective, among
+ * the candidate encryption parameters, numbers of dimensions up to
+ * objective.max_dimensions, dimension sizes, with and without ciphertext
+ * multiplication and modulus switching of replies. The dimensions needn't
+ * be equal: the bottom one, whose selection vector is multiplied with the
+ * database plaintexts, is usually larger than the others.
+ * @param[in] dbsize The number of individual items in the database.
+ * @param[in] bytes_per_item Size in bytes of each item in the database.
+ * @param[in] objective What to minimize and noise budget to keep.
+ * @param[in] candidates Encryption parameters to try, each measured with
+ *    CalibrateCostModel.
+ * @returns InvalidArgument if no candidate keeps the noise budget, or the
+ *    errors of CalibrateCostModel and CreatePIRParameters
+ */
+StatusOr<std::shared_ptr<PIRParameters>> AutotunePIRParameters(
+    std::size_t dbsize, std::size_t bytes_per_item,
+    const TuningObjective& objective = TuningObjective(),
+    const std::vector<EncryptionParameters>& candidates =
+        DefaultTuningCandidates());
+
+/**
+ * As above, with cost models each already calibrated for the encryption
+ * parameters they are paired with, so that they can be measured once and
+ * reused for many databases.
+ */
+StatusOr<std::shared_ptr<PIRParameters>> AutotunePIRParameters(
+    std::size_t dbsize, std::size_t bytes_per_item,
+    const TuningObjective& objective,
+    const std::vector<std::pair<EncryptionParameters, CostModel>>&
+        candidates);
+
+}  // namespace pir
+
+#endif  // PIR_AUTOTUNE_H_
@@ -0,0 +1,163 @@
+//
+// Copyright 2020 the authors listed in CONTRIBUTORS.md
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "pir/cpp/autotune.h"
+
+#include <utility>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "pir/cpp/status_asserts.h"
+
+namespace pir {
+namespace {
+
+using std::size_t;
+using std::vector;
+using ::testing::DoubleNear;
+using ::testing::Eq;
+using ::testing::Ge;
+using ::testing::Le;
+
+// Costs made up so that the estimates can be worked out by hand.
+CostModel MakeModel() {
+  CostModel model;
+  model.poly_modulus_degree = 4096;
+  model.expansion_seconds = 1e-4;
+  model.multiply_plain_seconds = 1e-4;
+  model.multiply_seconds = 1e-3;
+  model.reencode_seconds = 1e-4;
+  model.switched_reencode_seconds = 1e-4;
+  model.query_ciphertext_bytes = 60000;
+  model.reply_ciphertext_bytes = 120000;
+  model.switched_reply_ciphertext_bytes = 40000;
+  model.fresh_noise_budget = 60;
+  model.expansion_noise_bits = 1;
+  model.multiply_plain_noise_bits = 20;
+  model.multiply_noise_bits = 25;
+  model.modulus_switch_noise_bits = 5;
+  model.expansion_ratio = 3;
+  model.switched_expansion_ratio = 1;
+  return model;
+}
+
+PIRParameters MakeParams(size_t num_pt, const vector<uint32_t>& dims) {
+  PIRParameters params;
+  params.set_num_pt(num_pt);
+  for (const auto d : dims) params.add_dimensions(d);
+  return params;
+}
+
+TEST(AutotuneTest, EstimateCostDecomposition) {
+  const auto estimate =
+      EstimateCost(MakeParams(100, {10, 10}), MakeModel(), TuningObjective());
+  EXPECT_THAT(estimate.query_bytes, Eq(60000));
+  // Each of the 2 polynomials of the bottom reply decomposes into 3
+  // plaintexts.
+  EXPECT_THAT(estimate.reply_bytes, Eq(6 * 120000));
+  // 20 expansion steps, 100 products with the database, then 10 rows each
+  // reencoding a ciphertext and multiplying its 6 plaintexts.
+  EXPECT_THAT(estimate.server_seconds, DoubleNear(0.019, 1e-9));
+  // 5 levels of expansion, a plaintext product and a sum over 10 rows.
+  EXPECT_THAT(estimate.noise_budget, Eq(60 - 5 - 20 - 4));
+  EXPECT_THAT(estimate.objective,
+              DoubleNear(0.019 + 1e-8 * (60000 + 6 * 120000), 1e-9));
+}
+
+TEST(AutotuneTest, EstimateCostCiphertextMultiplication) {
+  auto params = MakeParams(100, {10, 10});
+  params.set_use_ciphertext_multiplication(true);
+  params.set_modulus_switch_replies(true);
+  const auto estimate = EstimateCost(params, MakeModel(), TuningObjective());
+  EXPECT_THAT(estimate.reply_bytes, Eq(40000));
+  EXPECT_THAT(estimate.server_seconds, DoubleNear(0.022, 1e-9));
+  EXPECT_THAT(estimate.noise_budget, Eq(60 - 5 - 20 - 4 - 25 - 4 - 5));
+}
+
+TEST(AutotuneTest, EstimateCostSkipsRowsPastTheEnd) {
+  // Only 5 of the 10 rows of the top dimension hold plaintexts.
+  const auto estimate =
+      EstimateCost(MakeParams(41, {10, 10}), MakeModel(), TuningObjective());
+  EXPECT_THAT(estimate.server_seconds,
+              DoubleNear(20e-4 + 41e-4 + 5e-4 + 30e-4, 1e-9));
+}
+
+TEST(AutotuneTest, ChoosesDimensionsCoveringTheDatabase) {
+  const auto enc_params = GenerateEncryptionParams(4096, 20);
+  ASSIGN_OR_FAIL(auto equal_params,
+                 CreatePIRParameters(1 << 16, 256, 2, enc_params));
+  ASSIGN_OR_FAIL(auto params,
+                 AutotunePIRParameters(1 << 16, 256, TuningObjective(),
+                                       {{enc_params, MakeModel()}}));
+  EXPECT_THAT(params->num_pt(), Eq(equal_params->num_pt()));
+  size_t product = 1;
+  for (const auto d : params->dimensions()) product *= d;
+  EXPECT_THAT(product, Ge(params->num_pt()));
+
+  const auto estimate = EstimateCost(*params, MakeModel(), TuningObjective());
+  EXPECT_THAT(estimate.noise_budget, Ge(TuningObjective().min_noise_budget));
+  EXPECT_THAT(estimate.objective,
+              Le(EstimateCost(*equal_params, MakeModel(), TuningObjective())
+                     .objective));
+}
+
+TEST(AutotuneTest, PrefersOneDimensionWhenExpansionIsFree) {
+  // Any higher dimension adds work, and the query fits in a ciphertext.
+  auto model = MakeModel();
+  model.expansion_seconds = 0;
+  TuningObjective objective;
+  objective.bytes_weight = 0;
+  ASSIGN_OR_FAIL(auto params,
+                 AutotunePIRParameters(1 << 16, 256, objective,
+                                       {{GenerateEncryptionParams(4096, 20),
+                                         model}}));
+  EXPECT_THAT(params->dimensions_size(), Eq(1));
+}
+
+TEST(AutotuneTest, PrefersALargeBottomDimension) {
+  // The selection vector of a single dimension would need several query
+  // ciphertexts and take long to expand, while every row of a top dimension
+  // adds work, so the top dimension ends up smaller than the bottom one.
+  auto model = MakeModel();
+  model.fresh_noise_budget = 100;
+  TuningObjective objective;
+  objective.max_dimensions = 2;
+  const auto enc_params = GenerateEncryptionParams(4096, 20);
+  ASSIGN_OR_FAIL(auto equal_params,
+                 CreatePIRParameters(400000, 256, 2, enc_params));
+  ASSIGN_OR_FAIL(auto params, AutotunePIRParameters(400000, 256, objective,
+                                                    {{enc_params, model}}));
+  ASSERT_THAT(params->dimensions_size(), Eq(2));
+  EXPECT_THAT(params->dimensions(0), Le(params->dimensions(1) / 4));
+  EXPECT_THAT(
+      EstimateCost(*params, model, objective).objective,
+      Le(EstimateCost(*equal_params, model, objective).objective));
+}
+
+TEST(AutotuneTest, NoCandidateKeepsTheNoiseBudget) {
+  TuningObjective objective;
+  objective.min_noise_budget = 1000;
+  EXPECT_THAT(AutotunePIRParameters(1000, 256, objective,
+                                    {{GenerateEncryptionParams(4096, 20),
+                                      MakeModel()}})
+                  .status()
+                  .code(),
+              Eq(absl::StatusCode::kInvalidArgument));
+}
+
+}  // namespace
+}  // namespace pir
@@ -0,0 +1,151 @@
+//
+// Copyright 2020 the authors listed in CONTRIBUTORS.md
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#include "pir/cpp/backend.h"
+
+#include <functional>
+#include <stdexcept>
+#include <utility>
+
+#include "absl/memory/memory.h"
+#include "pir/cpp/dot_product.h"
+#include "seal/util/polyarithsmallmod.h"
+
+namespace pir {
+
+namespace {
+
+// The reference backend, everything done by SEAL.
+class SEALBackend : public Backend {
+ public:
+  explicit SEALBackend(std::shared_ptr<seal::SEALContext> context)
+      : Backend(std::move(context)) {}
+
+  const char* name() const override { return "seal"; }
+};
+
+// Multiplies the bottom dimension with the lazy-reduction kernel.
+class CPUBackend : public Backend {
+ public:
+  explicit CPUBackend(std::shared_ptr<seal::SEALContext> context)
+      : Backend(context), dot_product_(make_dot_product(*context)) {}
+
+  const char* name() const override { return "cpu"; }
+  bool has_dot_product() const override { return true; }
+  void dot_product(
+      const std::vector<const std::uint64_t*>& plain,
+      const std::vector<std::vector<const std::uint64_t*>>& operands,
+      const std::vector<std::uint64_t*>& results,
+      bool accumulate) const override {
+    dot_product_.compute(plain, operands, results, accumulate);
+  }
+
+ private:
+  static DotProduct make_dot_product(const seal::SEALContext& context) {
+    const auto& parms = context.first_context_data()->parms();
+    std::vector<std::uint64_t> moduli;
+    for (const auto& modulus : parms.coeff_modulus()) {
+      moduli.push_back(modulus.value());
+    }
+    return DotProduct(moduli, parms.poly_modulus_degree());
+  }
+
+  const DotProduct dot_product_;
+};
+
+using BackendFactory = std::function<std::unique_ptr<Backend>(
+    std::shared_ptr<seal::SEALContext>)>;
+
+// Backends built in, the reference first and the default last. Backends that
+// depend on optional libraries go between them, each under its build flag.
+const std::vector<std::pair<std::string, BackendFactory>>& Backends() {
+  static const auto* const backends =
+      new std::vector<std::pair<std::string, BackendFactory>>{
+          {"seal",
+           [](std::shared_ptr<seal::SEALContext> context) {
+             return absl::make_unique<SEALBackend>(std::move(context));
+           }},
+          {"cpu",
+           [](std::shared_ptr<seal::SEALContext> context) {
+             return absl::make_unique<CPUBackend>(std::move(context));
+           }},
+      };
+  return *backends;
+}
+
+}  // namespace
+
+void Backend::dot_product(
+    const std::vector<const std::uint64_t*>&,
+    const std::vector<std::vector<const std::uint64_t*>>&,
+    const std::vector<std::uint64_t*>&, bool) const {
+  throw std::logic_error(std::string("Backend ") + name() +
+                         " has no dot product");
+}
+
+void Backend::apply_galois_inplace(seal::Evaluator& evaluator,
+                                   seal::Ciphertext& ct,
+                                   const std::uint32_t galois_elt,
+                                   const seal::GaloisKeys& gal_keys,
+                                   seal::MemoryPoolHandle pool) const {
+  evaluator.apply_galois_inplace(ct, galois_elt, gal_keys, std::move(pool));
+}
+
+void Backend::multiply_inverse_power_of_x(
+    const seal::Ciphertext& encrypted, const std::uint32_t k,
+    seal::Ciphertext& destination) const {
+  // This has to get the actual params from the SEALContext. Using just the
+  // params from PIR doesn't work.
+  const auto& params = context_->first_context_data()->parms();
+  const auto poly_modulus_degree = params.poly_modulus_degree();
+  const auto coeff_mod_count = params.coeff_modulus().size();
+
+  const std::uint32_t index =
+      ((poly_modulus_degree << 1) - k) % (poly_modulus_degree << 1);
+
+  // Every coefficient is overwritten below, so the destination only needs the
+  // right shape. Resizing reuses its allocation if it has one.
+  destination.resize(context_, encrypted.parms_id(), encrypted.size());
+  destination.is_ntt_form() = encrypted.is_ntt_form();
+
+  // Loop over polynomials in ciphertext
+  for (std::size_t i = 0; i < encrypted.size(); i++) {
+    // loop over each coefficient in polynomial
+    for (std::size_t j = 0; j < coeff_mod_count; j++) {
+      seal::util::negacyclic_shift_poly_coeffmod(
+          encrypted.data(i) + (j * poly_modulus_degree), poly_modulus_degree,
+          index, params.coeff_modulus()[j],
+          destination.data(i) + (j * poly_modulus_degree));
+    }
+  }
+}
+
+std::vector<std::string> BackendNames() {
+  std::vector<std::string> names;
+  for (const auto& backend : Backends()) names.push_back(backend.first);
+  return names;
+}
+
+StatusOr<std::unique_ptr<Backend>> CreateBackend(
+    const std::string& name, std::shared_ptr<seal::SEALContext> context) {
+  const auto& backends = Backends();
+  if (name.empty()) return backends.back().second(std::move(context));
+  for (const auto& backend : backends) {
+    if (backend.first == name) return backend.second(std::move(context));
+  }
+  return absl::InvalidArgumentError("Unknown backend " + name);
+}
+
+}  // namespace pir
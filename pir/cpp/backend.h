@@ -0,0 +1,115 @@
+//
+// Copyright 2020 the authors listed in CONTRIBUTORS.md
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef PIR_BACKEND_H_
+#define PIR_BACKEND_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/status/statusor.h"
+#include "seal/seal.h"
+
+namespace pir {
+
+using absl::StatusOr;
+
+/**
+ * Implementation of the arithmetic that dominates the cost of a query: the
+ * products of the bottom dimension of the selection vector with the database
+ * plaintexts, and the automorphisms and shifts of oblivious expansion.
+ *
+ * The "seal" backend does all of it with the SEAL evaluator, and is the
+ * reference the others must agree with. The "cpu" backend, the default,
+ * multiplies the bottom dimension with the lazy-reduction kernel of
+ * DotProduct, on AVX-512 IFMA when the CPU supports it. Backends needing
+ * libraries or hardware that may be missing are added to the table in
+ * backend.cpp under their own build flag, and then chosen by name at
+ * runtime like the others.
+ *
+ * A backend is bound to the encryption parameters of a database, and is used
+ * by every thread multiplying or expanding queries at once.
+ */
+class Backend {
+ public:
+  virtual ~Backend() = default;
+
+  /**
+   * Name the backend is created with.
+   */
+  virtual const char* name() const = 0;
+
+  /**
+   * Whether the backend implements dot_product. Without it, the bottom
+   * dimension is multiplied with Evaluator::multiply_plain and added up.
+   */
+  virtual bool has_dot_product() const { return false; }
+
+  /**
+   * Computes results[j] = sum_i operands[j][i] * plain[i] for polynomials in
+   * NTT form at the first parameters, with the contract of
+   * DotProduct::compute. Throws std::logic_error unless has_dot_product.
+   */
+  virtual void dot_product(
+      const std::vector<const std::uint64_t*>& plain,
+      const std::vector<std::vector<const std::uint64_t*>>& operands,
+      const std::vector<std::uint64_t*>& results, bool accumulate) const;
+
+  /**
+   * Applies the automorphism x -> x^galois_elt to ct, as
+   * Evaluator::apply_galois_inplace.
+   * @param[in] evaluator Evaluator of the calling thread.
+   */
+  virtual void apply_galois_inplace(seal::Evaluator& evaluator,
+                                    seal::Ciphertext& ct,
+                                    std::uint32_t galois_elt,
+                                    const seal::GaloisKeys& gal_keys,
+                                    seal::MemoryPoolHandle pool) const;
+
+  /**
+   * Sets destination to encrypted times x^-k, a negacyclic shift of each of
+   * its polynomials. encrypted must be at the first parameters.
+   */
+  virtual void multiply_inverse_power_of_x(
+      const seal::Ciphertext& encrypted, std::uint32_t k,
+      seal::Ciphertext& destination) const;
+
+ protected:
+  explicit Backend(std::shared_ptr<seal::SEALContext> context)
+      : context_(std::move(context)) {}
+
+  const std::shared_ptr<seal::SEALContext> context_;
+};
+
+/**
+ * Names of the backends built in, the reference "seal" backend first.
+ */
+std::vector<std::string> BackendNames();
+
+/**
+ * Creates the backend of the given name.
+ * @param[in] name Name of the backend, or empty for the default one.
+ * @param[in] context SEAL context of the database it is used for.
+ * @returns InvalidArgument if no backend of that name is built in
+ */
+StatusOr<std::unique_ptr<Backend>> CreateBackend(
+    const std::string& name, std::shared_ptr<seal::SEALContext> context);
+
+}  // namespace pir
+
+#endif  // PIR_BACKEND_H_
@@ -0,0 +1,162 @@
+//
+// Copyright 2020 the authors listed in CONTRIBUTORS.md
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "pir/cpp/backend.h"
+
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "pir/cpp/parameters.h"
+#include "pir/cpp/status_asserts.h"
+
+namespace pir {
+namespace {
+
+using seal::Ciphertext;
+using seal::Plaintext;
+using std::uint64_t;
+using std::vector;
+using namespace ::testing;
+
+constexpr size_t POLY_MODULUS_DEGREE = 4096;
+
+class BackendTest : public ::testing::Test {
+ protected:
+  void SetUp() {
+    seal_context_ = seal::SEALContext::Create(
+        GenerateEncryptionParams(POLY_MODULUS_DEGREE, 20));
+    evaluator_ = std::make_unique<seal::Evaluator>(seal_context_);
+    keygen_ = std::make_unique<seal::KeyGenerator>(seal_context_);
+    encryptor_ =
+        std::make_unique<seal::Encryptor>(seal_context_, keygen_->public_key());
+  }
+
+  Plaintext random_plaintext() {
+    const auto plain_modulus = seal_context_->first_context_data()
+                                   ->parms()
+                                   .plain_modulus()
+                                   .value();
+    std::uniform_int_distribution<uint64_t> dist(0, plain_modulus - 1);
+    Plaintext pt(POLY_MODULUS_DEGREE);
+    for (size_t c = 0; c < POLY_MODULUS_DEGREE; ++c) pt[c] = dist(prng_);
+    return pt;
+  }
+
+  std::shared_ptr<seal::SEALContext> seal_context_;
+  std::unique_ptr<seal::Evaluator> evaluator_;
+  std::unique_ptr<seal::KeyGenerator> keygen_;
+  std::unique_ptr<seal::Encryptor> encryptor_;
+  std::mt19937_64 prng_{42};
+};
+
+TEST_F(BackendTest, TestNames) {
+  EXPECT_THAT(BackendNames(), ElementsAre("seal", "cpu"));
+  for (const auto& name : BackendNames()) {
+    ASSIGN_OR_FAIL(auto backend, CreateBackend(name, seal_context_));
+    EXPECT_EQ(backend->name(), name);
+  }
+  ASSIGN_OR_FAIL(auto backend, CreateBackend("", seal_context_));
+  EXPECT_EQ(backend->name(), std::string("cpu"));
+  EXPECT_THAT(CreateBackend("nope", seal_context_).status().code(),
+              Eq(absl::StatusCode::kInvalidArgument));
+}
+
+TEST_F(BackendTest, TestSEALHasNoDotProduct) {
+  ASSIGN_OR_FAIL(auto backend, CreateBackend("seal", seal_context_));
+  EXPECT_FALSE(backend->has_dot_product());
+  EXPECT_THROW(backend->dot_product({}, {}, {}, false), std::logic_error);
+}
+
+TEST_F(BackendTest, TestDotProductMatchesEvaluator) {
+  ASSIGN_OR_FAIL(auto backend, CreateBackend("cpu", seal_context_));
+  ASSERT_TRUE(backend->has_dot_product());
+  const auto& parms_id = seal_context_->first_parms_id();
+
+  constexpr size_t num_terms = 5;
+  vector<Plaintext> plain(num_terms);
+  vector<Ciphertext> operands(num_terms);
+  for (size_t i = 0; i < num_terms; ++i) {
+    plain[i] = random_plaintext();
+    evaluator_->transform_to_ntt_inplace(plain[i], parms_id);
+    encryptor_->encrypt(random_plaintext(), operands[i]);
+    evaluator_->transform_to_ntt_inplace(operands[i]);
+  }
+
+  Ciphertext expected;
+  for (size_t i = 0; i < num_terms; ++i) {
+    Ciphertext product;
+    evaluator_->multiply_plain(operands[i], plain[i], product);
+    if (i == 0) {
+      expected = product;
+    } else {
+      evaluator_->add_inplace(expected, product);
+    }
+  }
+
+  Ciphertext result = operands[0];
+  vector<const uint64_t*> plain_ptrs;
+  for (const auto& pt : plain) plain_ptrs.push_back(pt.data());
+  vector<vector<const uint64_t*>> operand_ptrs(result.size());
+  vector<uint64_t*> result_ptrs;
+  for (size_t p = 0; p < result.size(); ++p) {
+    for (const auto& ct : operands) operand_ptrs[p].push_back(ct.data(p));
+    result_ptrs.push_back(result.data(p));
+  }
+  backend->dot_product(plain_ptrs, operand_ptrs, result_ptrs, false);
+
+  const size_t poly_words = result.poly_modulus_degree() *
+                            result.coeff_modulus_size();
+  for (size_t p = 0; p < result.size(); ++p) {
+    EXPECT_THAT(vector<uint64_t>(result.data(p), result.data(p) + poly_words),
+                ElementsAreArray(expected.data(p), poly_words))
+        << "p = " << p;
+  }
+}
+
+TEST_F(BackendTest, TestMultiplyInversePowerOfX) {
+  const auto& coeff_modulus =
+      seal_context_->first_context_data()->parms().coeff_modulus();
+  Ciphertext ct(seal_context_);
+  ct.resize(2);
+  for (size_t m = 0; m < coeff_modulus.size(); ++m) {
+    ct.data(1)[m * POLY_MODULUS_DEGREE + 5] = 99;
+  }
+
+  for (const auto& name : BackendNames()) {
+    ASSIGN_OR_FAIL(auto backend, CreateBackend(name, seal_context_));
+    // x^5 / x^3 = x^2, and x^5 / x^7 = x^-2 = -x^(N - 2).
+    Ciphertext shifted;
+    backend->multiply_inverse_power_of_x(ct, 3, shifted);
+    ASSERT_EQ(shifted.size(), 2);
+    EXPECT_EQ(shifted.data(1)[2], 99) << name;
+    EXPECT_EQ(shifted.data(1)[5], 0) << name;
+    backend->multiply_inverse_power_of_x(ct, 7, shifted);
+    for (size_t m = 0; m < coeff_modulus.size(); ++m) {
+      const auto* limb = shifted.data(1) + m * POLY_MODULUS_DEGREE;
+      EXPECT_EQ(limb[POLY_MODULUS_DEGREE - 2], coeff_modulus[m].value() - 99)
+          << name << ", m = " << m;
+    }
+  }
+}
+
+}  // namespace
+}  // namespace pir
@@ -0,0 +1,78 @@
+//
+// Copyright 2020 the authors listed in CONTRIBUTORS.md
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#include "pir/cpp/batch_client.h"
+
+#include "absl/memory/memory.h"
+#include "pir/cpp/status_asserts.h"
+
+namespace pir {
+
+using absl::InvalidArgumentError;
+using std::size_t;
+using std::vector;
+
+BatchPIRClient::BatchPIRClient(std::shared_ptr<BatchPIRParameters> params,
+                               BucketLayout layout,
+                               std::unique_ptr<PIRClient> client)
+    : params_(std::move(params)),
+      layout_(std::move(layout)),
+      client_(std::move(client)) {}
+
+StatusOr<std::unique_ptr<BatchPIRClient>> BatchPIRClient::Create(
+    std::shared_ptr<BatchPIRParameters> params, size_t num_threads) {
+  ASSIGN_OR_RETURN(auto layout, BucketLayout::Create(*params));
+  // The bucket parameters live as long as the batch parameters holding them.
+  std::shared_ptr<PIRParameters> bucket_params(
+      params, params->mutable_bucket_parameters());
+  ASSIGN_OR_RETURN(auto client,
+                   PIRClient::Create(bucket_params, false,
+                                     seal::Serialization::compr_mode_default,
+                                     num_threads));
+  return absl::WrapUnique(new BatchPIRClient(std::move(params),
+                                             std::move(layout),
+                                             std::move(client)));
+}
+
+StatusOr<Request> BatchPIRClient::CreateRequest(
+    const vector<size_t>& indexes, bool include_keys) const {
+  ASSIGN_OR_RETURN(auto buckets, layout_.Assign(indexes));
+  vector<size_t> positions(layout_.num_buckets(), 0);
+  for (size_t i = 0; i < indexes.size(); ++i) {
+    positions[buckets[i]] = layout_.position(indexes[i], buckets[i]);
+  }
+  return client_->CreateRequest(positions, include_keys);
+}
+
+StatusOr<vector<std::string>> BatchPIRClient::ProcessResponse(
+    const vector<size_t>& indexes, const Response& response) const {
+  if (static_cast<size_t>(response.reply_size()) != layout_.num_buckets()) {
+    return InvalidArgumentError(
+        "Response has " + std::to_string(response.reply_size()) +
+        " replies, expected one per bucket");
+  }
+  ASSIGN_OR_RETURN(auto buckets, layout_.Assign(indexes));
+  // Only the replies of the buckets holding the items are decrypted.
+  Response replies;
+  vector<size_t> positions;
+  positions.reserve(indexes.size());
+  for (size_t i = 0; i < indexes.size(); ++i) {
+    *replies.add_reply() = response.reply(buckets[i]);
+    positions.push_back(layout_.position(indexes[i], buckets[i]));
+  }
+  return client_->ProcessResponse(positions, replies);
+}
+
+}  // namespace pir
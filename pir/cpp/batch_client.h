@@ -0,0 +1,92 @@
+//
+// Copyright 2020 the authors listed in CONTRIBUTORS.md
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef PIR_BATCH_CLIENT_H_
+#define PIR_BATCH_CLIENT_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/status/statusor.h"
+#include "pir/cpp/client.h"
+#include "pir/cpp/cuckoo_hashing.h"
+
+namespace pir {
+
+using absl::StatusOr;
+
+/**
+ * Client of batch PIR, which fetches several items with a single request.
+ * The request holds one query per bucket of the batch parameters. Each item
+ * is fetched from a distinct bucket that holds it, and the other buckets get
+ * a query for an arbitrary item, so the server can't tell which buckets
+ * matter.
+ */
+class BatchPIRClient {
+ public:
+  /**
+   * Creates and returns a new client instance, from existing parameters.
+   * @param[in] params Batch PIR parameters
+   * @param[in] num_threads Number of threads used to decrypt the replies of a
+   *    response. With 1, replies are decrypted on the calling thread.
+   * @returns InvalidArgument if the parameters are invalid
+   **/
+  static StatusOr<std::unique_ptr<BatchPIRClient>> Create(
+      std::shared_ptr<BatchPIRParameters> params, std::size_t num_threads = 1);
+
+  /**
+   * Creates a new request for a batch of items.
+   * @param[in] indexes Indices of the items in the whole database, at most
+   *    one per bucket once repeated indices are removed.
+   * @param[in] include_keys Whether to send the keys with the request, as
+   *    for PIRClient::CreateRequest.
+   * @returns InvalidArgument if an index is invalid or there are too many,
+   *    ResourceExhausted if the items can't be placed in distinct buckets
+   **/
+  StatusOr<Request> CreateRequest(const std::vector<std::size_t>& indexes,
+                                  bool include_keys = true) const;
+
+  /**
+   * Extracts the items from the response to a request.
+   * @param[in] indexes Indices the request was created with, in the same
+   *    order.
+   * @param[in] response The response from the server.
+   * @returns The value of each item, in the order of indexes, or an error
+   **/
+  StatusOr<std::vector<std::string>> ProcessResponse(
+      const std::vector<std::size_t>& indexes, const Response& response) const;
+
+  /**
+   * Identifier sent with every request so that a server can cache the keys.
+   **/
+  const std::string& KeyId() const { return client_->KeyId(); }
+
+  BatchPIRClient() = delete;
+
+ private:
+  BatchPIRClient(std::shared_ptr<BatchPIRParameters> params,
+                 BucketLayout layout, std::unique_ptr<PIRClient> client);
+
+  std::shared_ptr<BatchPIRParameters> params_;
+  const BucketLayout layout_;
+  // Client of the bucket databases, which all share the same parameters.
+  std::unique_ptr<PIRClient> client_;
+};
+
+}  // namespace pir
+
+#endif  // PIR_BATCH_CLIENT_H_
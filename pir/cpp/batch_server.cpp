@@ -0,0 +1,133 @@
+//
+// Copyright 2020 the authors listed in CONTRIBUTORS.md
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#include "pir/cpp/batch_server.h"
+
+#include <string>
+
+#include "absl/memory/memory.h"
+#include "pir/cpp/database.h"
+#include "pir/cpp/status_asserts.h"
+#include "pir/cpp/utils.h"
+
+namespace pir {
+
+using absl::InvalidArgumentError;
+using std::size_t;
+using std::vector;
+
+BatchPIRServer::BatchPIRServer(std::shared_ptr<BatchPIRParameters> params,
+                               std::unique_ptr<PIRContext> context,
+                               vector<std::unique_ptr<PIRServer>> servers,
+                               size_t num_threads)
+    : params_(std::move(params)),
+      context_(std::move(context)),
+      servers_(std::move(servers)) {
+  if (num_threads > 1) {
+    // The calling thread takes part in the work, so it counts as one.
+    thread_pool_ = std::make_unique<ThreadPool>(num_threads - 1);
+    for (size_t i = 0; i < thread_pool_->size(); ++i) {
+      workers_.push_back(context_->CreateWorkerContext());
+    }
+  }
+  workers_.push_back(context_->DefaultWorkerContext());
+}
+
+StatusOr<std::unique_ptr<BatchPIRServer>> BatchPIRServer::Create(
+    const RecordSource& records, std::shared_ptr<BatchPIRParameters> params,
+    size_t num_threads, size_t key_cache_bytes) {
+  if (num_threads == 0) {
+    return InvalidArgumentError("number of threads must be positive");
+  }
+  if (records.size() != params->num_items()) {
+    return InvalidArgumentError(
+        "Database size " + std::to_string(records.size()) +
+        " does not match params value " +
+        std::to_string(params->num_items()));
+  }
+  ASSIGN_OR_RETURN(auto layout, BucketLayout::Create(*params));
+  std::shared_ptr<PIRParameters> bucket_params(
+      params, params->mutable_bucket_parameters());
+  const size_t bytes_per_item = bucket_params->bytes_per_item();
+  ASSIGN_OR_RETURN(auto context, PIRContext::Create(bucket_params));
+
+  vector<std::unique_ptr<PIRServer>> servers(layout.num_buckets());
+  for (size_t b = 0; b < layout.num_buckets(); ++b) {
+    const auto& items = layout.bucket(b);
+    // Buckets smaller than the parameters are padded with empty items.
+    CallbackRecordSource source(
+        bucket_params->num_items(),
+        [&](size_t i, std::string& out) -> Status {
+          if (i >= items.size()) {
+            out.append(bytes_per_item, 0);
+            return absl::OkStatus();
+          }
+          std::string scratch;
+          ASSIGN_OR_RETURN(auto record,
+                           records.Read(items[i], items[i] + 1, scratch));
+          if (record.size() != bytes_per_item) {
+            return InvalidArgumentError(
+                "Record " + std::to_string(items[i]) + " is " +
+                std::to_string(record.size()) + " bytes, expected " +
+                std::to_string(bytes_per_item));
+          }
+          out.append(record.data(), record.size());
+          return absl::OkStatus();
+        });
+    // Requests are parallelized across buckets only, so each bucket is
+    // multiplied on a single thread, without a pool of its own.
+    ASSIGN_OR_RETURN(auto db, PIRDatabase::Create(source, bucket_params, 1));
+    // Only the first server sees the keys, so only it needs a cache.
+    ASSIGN_OR_RETURN(servers[b],
+                     PIRServer::Create(db, bucket_params, 1,
+                                       b == 0 ? key_cache_bytes : 0));
+  }
+  return absl::WrapUnique(new BatchPIRServer(std::move(params),
+                                             std::move(context),
+                                             std::move(servers), num_threads));
+}
+
+StatusOr<Response> BatchPIRServer::ProcessRequest(
+    const Request& request) const {
+  const size_t num_buckets = servers_.size();
+  if (static_cast<size_t>(request.query_size()) != num_buckets) {
+    return InvalidArgumentError(
+        "Request has " + std::to_string(request.query_size()) +
+        " queries, expected one per bucket");
+  }
+  ASSIGN_OR_RETURN(auto keys, servers_[0]->GetKeys(request));
+
+  Response response;
+  vector<Ciphertexts*> replies(num_buckets);
+  for (auto& reply : replies) {
+    reply = response.add_reply();
+  }
+  vector<Status> statuses(num_buckets);
+  const auto process = [&](size_t b, size_t worker) {
+    statuses[b] = servers_[b]->ProcessQuery(request.query(b), *keys,
+                                            replies[b], workers_[worker]);
+  };
+  if (thread_pool_ == nullptr) {
+    for (size_t b = 0; b < num_buckets; ++b) process(b, workers_.size() - 1);
+  } else {
+    thread_pool_->ParallelFor(num_buckets, process);
+  }
+  for (const auto& status : statuses) {
+    RETURN_IF_ERROR(status);
+  }
+  return response;
+}
+
+}  // namespace pir
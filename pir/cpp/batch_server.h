@@ -0,0 +1,93 @@
+//
+// Copyright 2020 the authors listed in CONTRIBUTORS.md
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef PIR_BATCH_SERVER_H_
+#define PIR_BATCH_SERVER_H_
+
+#include <memory>
+#include <vector>
+
+#include "absl/status/statusor.h"
+#include "pir/cpp/context.h"
+#include "pir/cpp/cuckoo_hashing.h"
+#include "pir/cpp/record_source.h"
+#include "pir/cpp/server.h"
+#include "pir/cpp/thread_pool.h"
+
+namespace pir {
+
+using absl::StatusOr;
+
+/**
+ * Server of batch PIR. Holds one database per bucket of the batch
+ * parameters, each with a copy of the items hashed to the bucket, and answers
+ * the query for every bucket of a request.
+ */
+class BatchPIRServer {
+ public:
+  /**
+   * Creates and returns a new server instance, splitting the records into
+   * bucket databases.
+   * @param[in] records Records of the whole database, each bytes_per_item
+   *    bytes long. Only read while the server is created.
+   * @param[in] params Batch PIR parameters
+   * @param[in] num_threads Number of threads used to process the queries of a
+   *    request in parallel, one bucket at a time per thread. With 1, queries
+   *    are processed on the calling thread.
+   * @param[in] key_cache_bytes Size limit of the cache of deserialized client
+   *    keys, as for PIRServer::Create.
+   * @returns InvalidArgument if the records don't match the parameters or
+   *    the database encoding fails
+   **/
+  static StatusOr<std::unique_ptr<BatchPIRServer>> Create(
+      const RecordSource& records, std::shared_ptr<BatchPIRParameters> params,
+      std::size_t num_threads = 1, std::size_t key_cache_bytes = 0);
+
+  /**
+   * Handles a batch request, which must hold one query per bucket. Replies
+   * are in the same order as the queries.
+   * @param[in] request The PIR Payload
+   * @returns InvalidArgument if the number of queries is wrong or the
+   *    deserialization or encrypted operations fail, NotFound if the request
+   *    refers to keys that aren't cached
+   **/
+  StatusOr<Response> ProcessRequest(const Request& request) const;
+
+  BatchPIRServer() = delete;
+
+ private:
+  BatchPIRServer(std::shared_ptr<BatchPIRParameters> params,
+                 std::unique_ptr<PIRContext> context,
+                 std::vector<std::unique_ptr<PIRServer>> servers,
+                 std::size_t num_threads);
+
+  std::shared_ptr<BatchPIRParameters> params_;
+  // Context of the bucket parameters, shared by every bucket server, that
+  // the worker contexts are created from.
+  std::unique_ptr<PIRContext> context_;
+  // One server per bucket. The first one also deserializes and caches the
+  // keys of every request, which the others share.
+  std::vector<std::unique_ptr<PIRServer>> servers_;
+  // Null when queries are processed on the calling thread.
+  std::unique_ptr<ThreadPool> thread_pool_;
+  // One entry per thread pool worker, followed by one for threads outside of
+  // the pool, as in PIRServer. Used for the queries of every bucket.
+  std::vector<WorkerContext> workers_;
+};
+
+}  // namespace pir
+
+#endif  // PIR_BATCH_SERVER_H_
@@ -1,19 +1,30 @@
 #include "benchmark/benchmark.h"
 
+#include <chrono>
 #include <iostream>
+#include <numeric>
+#include <string>
+#include <utility>
+#include <vector>
 
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
+#include "pir/cpp/backend.h"
 #include "pir/cpp/client.h"
+#include "pir/cpp/dot_product.h"
 #include "pir/cpp/server.h"
 #include "pir/cpp/status_asserts.h"
 #include "pir/cpp/test_base.h"
+#include "pir/cpp/tracing.h"
+#include "pir/cpp/utils.h"
 #include "seal/seal.h"
 
 namespace pir {
 
 using namespace ::testing;
 
+// Defaults of the parameters swept by the benchmarks of whole requests, and
+// the parameters of the benchmarks of single operations.
 constexpr bool USE_CIPHERTEXT_MULTIPLICATION = false;
 constexpr uint32_t ITEM_SIZE = 288;
 constexpr uint32_t DIMENSIONS = 2;
@@ -21,20 +32,126 @@ constexpr uint32_t POLY_MOD_DEGREE = 4096;
 constexpr uint32_t PLAIN_MOD_BITS = 24;
 constexpr uint32_t BITS_PER_COEFF = 0;
 constexpr uint32_t QUERIES_PER_REQUEST = 1;
+constexpr uint32_t DB_SIZE = 1 << 12;
 
 using std::cout;
 using std::endl;
 
+// Arguments of the benchmarks of PIRFixture, by their index in the state.
+// Benchmarks with an argument of their own take it after these.
+enum ConfigArg {
+  kItems,
+  kItemSize,
+  kDimensions,
+  kPolyModDegree,
+  kPlainModBits,
+  kCiphertextMultiplication,
+  kQueriesPerRequest,
+  kThreads,
+  kNumConfigArgs,
+};
+
+const vector<string> CONFIG_ARG_NAMES = {"items", "item_size", "dims",
+                                         "poly_degree", "plain_bits",
+                                         "ct_mult", "queries", "threads"};
+
+// Configurations measured: the defaults, and each parameter varied from them
+// in turn, so that a change shows up in the rows of the parameters it
+// affects without sweeping the whole product.
+vector<vector<int64_t>> SweepConfigs() {
+  const vector<int64_t> defaults = {DB_SIZE,
+                                    ITEM_SIZE,
+                                    DIMENSIONS,
+                                    POLY_MOD_DEGREE,
+                                    PLAIN_MOD_BITS,
+                                    USE_CIPHERTEXT_MULTIPLICATION,
+                                    QUERIES_PER_REQUEST,
+                                    1};
+  vector<vector<int64_t>> configs = {defaults};
+  const auto vary = [&](ConfigArg arg, const vector<int64_t>& values,
+                        const vector<std::pair<ConfigArg, int64_t>>& also) {
+    for (const auto value : values) {
+      auto config = defaults;
+      config[arg] = value;
+      for (const auto& a : also) config[a.first] = a.second;
+      configs.push_back(config);
+    }
+  };
+  vary(kItems, {1 << 8, 1 << 10, 1 << 14, 1 << 16}, {});
+  vary(kItemSize, {64, 1024, 4096}, {});
+  vary(kDimensions, {1}, {});
+  // Two levels of decomposition need the noise budget of the larger modulus.
+  vary(kDimensions, {3}, {{kPolyModDegree, 8192}});
+  vary(kPolyModDegree, {8192}, {});
+  vary(kPlainModBits, {16, 20}, {});
+  // A ciphertext product uses up more noise than the decomposition does.
+  vary(kCiphertextMultiplication, {1}, {{kPlainModBits, 20}});
+  vary(kQueriesPerRequest, {4, 16}, {});
+  vary(kThreads, {2, 4, 8}, {});
+  return configs;
+}
+
+// Adds every configuration of the sweep to a benchmark, once for each value
+// of its own argument if it has one.
+void AddSweep(benchmark::internal::Benchmark* b, const string& arg_name = "",
+              const vector<int64_t>& arg_values = {}) {
+  auto names = CONFIG_ARG_NAMES;
+  if (!arg_name.empty()) names.push_back(arg_name);
+  b->ArgNames(names);
+  for (const auto& config : SweepConfigs()) {
+    if (arg_name.empty()) {
+      b->Args(config);
+      continue;
+    }
+    for (const auto value : arg_values) {
+      auto args = config;
+      args.push_back(value);
+      b->Args(args);
+    }
+  }
+}
+
+void ConfigSweep(benchmark::internal::Benchmark* b) { AddSweep(b); }
+
+void PrecomputeSweep(benchmark::internal::Benchmark* b) {
+  AddSweep(b, "precompute", {0, 1});
+}
+
+void CompactSweep(benchmark::internal::Benchmark* b) {
+  AddSweep(b, "compact", {0, 1});
+}
+
+void BatchSweep(benchmark::internal::Benchmark* b) {
+  AddSweep(b, "batch", {1, 4, 16});
+}
+
+// Backends by index in BackendNames.
+void BackendSweep(benchmark::internal::Benchmark* b) {
+  vector<int64_t> backends(BackendNames().size());
+  std::iota(backends.begin(), backends.end(), 0);
+  AddSweep(b, "backend", backends);
+}
+
 class PIRFixture : public benchmark::Fixture, public PIRTestingBase {
  public:
   void SetUpDb(const ::benchmark::State& state) {
-    SetUpParams(state.range(0), ITEM_SIZE, DIMENSIONS, POLY_MOD_DEGREE,
-                PLAIN_MOD_BITS, BITS_PER_COEFF, USE_CIPHERTEXT_MULTIPLICATION);
+    queries_per_request_ = state.range(kQueriesPerRequest);
+    num_threads_ = state.range(kThreads);
+    SetUpParams(state.range(kItems), state.range(kItemSize),
+                state.range(kDimensions), state.range(kPolyModDegree),
+                state.range(kPlainModBits), BITS_PER_COEFF,
+                state.range(kCiphertextMultiplication) != 0);
     GenerateDB();
+    if (num_threads_ > 1) {
+      ASSIGN_OR_FAIL(pir_db_, PIRDatabase::Create(string_db_, pir_params_,
+                                                  num_threads_));
+    }
     SetUpSealTools();
 
-    client_ = *(PIRClient::Create(pir_params_));
-    server_ = *(PIRServer::Create(pir_db_, pir_params_));
+    client_ = *(PIRClient::Create(pir_params_, false,
+                                  seal::Serialization::compr_mode_default,
+                                  num_threads_));
+    server_ = *(PIRServer::Create(pir_db_, pir_params_, num_threads_));
     ASSERT_THAT(client_, NotNull());
     ASSERT_THAT(server_, NotNull());
   }
@@ -42,42 +159,331 @@ class PIRFixture : public benchmark::Fixture, public PIRTestingBase {
   vector<size_t> GenerateRandomIndices() {
     static auto prng =
         seal::UniformRandomGeneratorFactory::DefaultFactory()->create({42});
-    vector<size_t> result(QUERIES_PER_REQUEST, 0);
+    vector<size_t> result(queries_per_request_, 0);
     for (auto& i : result) {
       i = prng->generate() % (db_size_);
     }
     return result;
   }
 
+  // Serialized sizes of a request and its response, per iteration.
+  static void SetSizeCounters(benchmark::State& st, const Request& request,
+                              const Response* response = nullptr) {
+    st.counters["request_bytes"] = request.ByteSizeLong();
+    if (response != nullptr) {
+      st.counters["response_bytes"] = response->ByteSizeLong();
+    }
+  }
+
+  size_t queries_per_request_;
+  size_t num_threads_;
   unique_ptr<PIRClient> client_;
   unique_ptr<PIRServer> server_;
 };
 
+// Isolates the oblivious expansion of a single, full query ciphertext.
+class ExpansionFixture : public benchmark::Fixture, public PIRTestingBase {
+ public:
+  void SetUpExpansion(const ::benchmark::State& state) {
+    num_items_ = state.range(0);
+    SetUpParams(1, ITEM_SIZE, 1, num_items_, PLAIN_MOD_BITS, BITS_PER_COEFF,
+                USE_CIPHERTEXT_MULTIPLICATION);
+    GenerateDB();
+    SetUpSealTools();
+
+    server_ = *(PIRServer::Create(pir_db_, pir_params_));
+    ASSERT_THAT(server_, NotNull());
+    gal_keys_ = keygen_->galois_keys_local(generate_galois_elts(num_items_));
+    encryptor_->encrypt_zero(ct_);
+  }
+
+  size_t num_items_;
+  unique_ptr<PIRServer> server_;
+  GaloisKeys gal_keys_;
+  Ciphertext ct_;
+};
+
+// Bottom dimension inner product of one query against range(0) NTT form
+// plaintexts, with random data at the first parameters of POLY_MOD_DEGREE.
+class DotProductFixture : public benchmark::Fixture {
+ public:
+  void SetUpData(const ::benchmark::State& state) {
+    seal::EncryptionParameters params(seal::scheme_type::BFV);
+    params.set_poly_modulus_degree(POLY_MOD_DEGREE);
+    params.set_coeff_modulus(seal::CoeffModulus::BFVDefault(POLY_MOD_DEGREE));
+    params.set_plain_modulus(
+        seal::PlainModulus::Batching(POLY_MOD_DEGREE, PLAIN_MOD_BITS));
+    seal_context_ = seal::SEALContext::Create(params);
+    evaluator_ = std::make_unique<seal::Evaluator>(seal_context_);
+    const auto context_data = seal_context_->first_context_data();
+    for (const auto& modulus : context_data->parms().coeff_modulus()) {
+      moduli_.push_back(modulus.value());
+    }
+
+    static auto prng =
+        seal::UniformRandomGeneratorFactory::DefaultFactory()->create({42});
+    const auto random_poly = [this](uint64_t* data) {
+      for (size_t m = 0; m < moduli_.size(); ++m) {
+        for (size_t c = 0; c < POLY_MOD_DEGREE; ++c) {
+          *data++ = prng->generate() % moduli_[m];
+        }
+      }
+    };
+    plain_.resize(state.range(0));
+    cts_.resize(state.range(0));
+    for (int64_t i = 0; i < state.range(0); ++i) {
+      plain_[i].resize(moduli_.size() * POLY_MOD_DEGREE);
+      random_poly(plain_[i].data());
+      plain_[i].parms_id() = context_data->parms_id();
+      cts_[i].resize(seal_context_, context_data->parms_id(), 2);
+      random_poly(cts_[i].data(0));
+      random_poly(cts_[i].data(1));
+      cts_[i].is_ntt_form() = true;
+    }
+  }
+
+  shared_ptr<seal::SEALContext> seal_context_;
+  unique_ptr<seal::Evaluator> evaluator_;
+  vector<uint64_t> moduli_;
+  vector<Plaintext> plain_;
+  vector<Ciphertext> cts_;
+};
+
+BENCHMARK_DEFINE_F(DotProductFixture, MultiplyPlainAccumulate)
+(benchmark::State& st) {
+  SetUpData(st);
+  for (auto _ : st) {
+    Ciphertext result;
+    evaluator_->multiply_plain(cts_[0], plain_[0], result);
+    for (size_t i = 1; i < plain_.size(); ++i) {
+      Ciphertext temp;
+      evaluator_->multiply_plain(cts_[i], plain_[i], temp);
+      evaluator_->add_inplace(result, temp);
+    }
+    ::benchmark::DoNotOptimize(result);
+  }
+  st.SetItemsProcessed(st.iterations() * plain_.size());
+}
+
+// range(1) selects the SIMD implementation when the CPU supports it.
+BENCHMARK_DEFINE_F(DotProductFixture, LazyDotProduct)(benchmark::State& st) {
+  SetUpData(st);
+  DotProduct dot_product(moduli_, POLY_MOD_DEGREE, st.range(1) != 0);
+  vector<const uint64_t*> plain;
+  vector<vector<const uint64_t*>> operands(2);
+  for (size_t i = 0; i < plain_.size(); ++i) {
+    plain.push_back(plain_[i].data());
+    operands[0].push_back(cts_[i].data(0));
+    operands[1].push_back(cts_[i].data(1));
+  }
+  for (auto _ : st) {
+    Ciphertext result(seal_context_);
+    result.resize(2);
+    dot_product.compute(plain, operands, {result.data(0), result.data(1)});
+    ::benchmark::DoNotOptimize(result);
+  }
+  st.SetItemsProcessed(st.iterations() * plain_.size());
+  st.SetLabel(dot_product.uses_simd() ? "simd" : "portable");
+}
+
+BENCHMARK_DEFINE_F(ExpansionFixture, ObliviousExpansion)
+(benchmark::State& st) {
+  SetUpExpansion(st);
+  for (auto _ : st) {
+    ASSIGN_OR_FAIL(auto results,
+                   server_->oblivious_expansion(ct_, num_items_, gal_keys_));
+    ::benchmark::DoNotOptimize(results);
+  }
+  st.SetItemsProcessed(st.iterations() * num_items_);
+}
+
+BENCHMARK_DEFINE_F(ExpansionFixture, ObliviousExpansionStreaming)
+(benchmark::State& st) {
+  SetUpExpansion(st);
+  for (auto _ : st) {
+    ASSERT_OK(server_->oblivious_expansion_streaming(
+        ct_, num_items_, gal_keys_, [](size_t, Ciphertext& ct) {
+          ::benchmark::DoNotOptimize(ct);
+          return absl::OkStatus();
+        }));
+  }
+  st.SetItemsProcessed(st.iterations() * num_items_);
+}
+
+// Encoding of the items into a database on as many threads as the server.
 BENCHMARK_DEFINE_F(PIRFixture, SetupDb)(benchmark::State& st) {
+  SetUpDb(st);
   for (auto _ : st) {
-    SetUpDb(st);
+    ASSIGN_OR_FAIL(auto db,
+                   PIRDatabase::Create(string_db_, pir_params_, num_threads_));
+    ::benchmark::DoNotOptimize(db);
   }
+  st.SetItemsProcessed(st.iterations() * db_size_);
 }
 
+// Creation of a request, encrypting queries online when precompute is 0 and
+// from precomputed encryptions of zero, refilled outside of the timing, when
+// it is 1.
 BENCHMARK_DEFINE_F(PIRFixture, ClientCreateRequest)(benchmark::State& st) {
   SetUpDb(st);
+  const bool precompute = st.range(kNumConfigArgs) != 0;
+  const size_t num_ciphertexts =
+      client_->CiphertextsPerQuery() * queries_per_request_;
+  Request request;
   for (auto _ : st) {
+    if (precompute) {
+      st.PauseTiming();
+      ASSERT_OK(client_->Precompute(num_ciphertexts));
+      st.ResumeTiming();
+    }
     auto indices = GenerateRandomIndices();
-    ASSIGN_OR_FAIL(auto request, client_->CreateRequest(indices));
+    ASSIGN_OR_FAIL(request, client_->CreateRequest(indices));
     ::benchmark::DoNotOptimize(request);
   }
+  SetSizeCounters(st, request);
+}
+
+// Deserialization of the keys of a request, which isn't cached.
+BENCHMARK_DEFINE_F(PIRFixture, ServerGetKeys)(benchmark::State& st) {
+  SetUpDb(st);
+  ASSIGN_OR_FAIL(auto request, client_->CreateRequest(GenerateRandomIndices()));
+  for (auto _ : st) {
+    ASSIGN_OR_FAIL(auto keys, server_->GetKeys(request));
+    ::benchmark::DoNotOptimize(keys);
+  }
+  st.counters["key_bytes"] =
+      request.galois_keys().size() + request.relin_keys().size();
 }
 
 BENCHMARK_DEFINE_F(PIRFixture, ServerProcessRequest)(benchmark::State& st) {
   SetUpDb(st);
   auto indices = GenerateRandomIndices();
   ASSIGN_OR_FAIL(auto request, client_->CreateRequest(indices));
+  Response response;
+  for (auto _ : st) {
+    ASSIGN_OR_FAIL(response, server_->ProcessRequest(request));
+    ::benchmark::DoNotOptimize(response);
+  }
+  SetSizeCounters(st, request, &response);
+}
+
+// Breakdown of ServerProcessRequest: the time of each phase and the count of
+// each operation, per request, as measured by a MetricsTracer. Phases run by
+// several threads at once add up the time of every thread.
+BENCHMARK_DEFINE_F(PIRFixture, ServerProcessRequestPhases)
+(benchmark::State& st) {
+  SetUpDb(st);
+  auto tracer = std::make_shared<MetricsTracer>();
+  server_->set_tracer(tracer);
+  auto indices = GenerateRandomIndices();
+  ASSIGN_OR_FAIL(auto request, client_->CreateRequest(indices));
+  Response response;
+  for (auto _ : st) {
+    ASSIGN_OR_FAIL(response, server_->ProcessRequest(request));
+    ::benchmark::DoNotOptimize(response);
+  }
+  for (size_t p = 0; p < kNumPhases; ++p) {
+    const auto phase = static_cast<Phase>(p);
+    st.counters[string(PhaseName(phase)) + "_seconds"] = benchmark::Counter(
+        std::chrono::duration<double>(tracer->phase_time(phase)).count(),
+        benchmark::Counter::kAvgIterations);
+  }
+  for (size_t c = 0; c < kNumCounters; ++c) {
+    const auto counter = static_cast<Counter>(c);
+    st.counters[CounterName(counter)] = benchmark::Counter(
+        tracer->count(counter), benchmark::Counter::kAvgIterations);
+  }
+}
+
+// Processing of a request against a database kept in NTT form when compact
+// is 0 and packed and expanded as it is multiplied when it is 1.
+BENCHMARK_DEFINE_F(PIRFixture, ServerProcessRequestStorage)
+(benchmark::State& st) {
+  SetUpDb(st);
+  pir_params_->set_compact_storage(st.range(kNumConfigArgs) != 0);
+  ASSIGN_OR_FAIL(pir_db_, PIRDatabase::Create(string_db_, pir_params_,
+                                              num_threads_));
+  ASSIGN_OR_FAIL(server_,
+                 PIRServer::Create(pir_db_, pir_params_, num_threads_));
+  auto indices = GenerateRandomIndices();
+  ASSIGN_OR_FAIL(auto request, client_->CreateRequest(indices));
   for (auto _ : st) {
     ASSIGN_OR_FAIL(auto response, server_->ProcessRequest(request));
     ::benchmark::DoNotOptimize(response);
   }
 }
 
+// Processing of a request with each backend built in, the first being the
+// reference SEAL one.
+BENCHMARK_DEFINE_F(PIRFixture, ServerProcessRequestBackend)
+(benchmark::State& st) {
+  SetUpDb(st);
+  const auto backend = BackendNames()[st.range(kNumConfigArgs)];
+  ASSERT_OK(pir_db_->set_backend(backend));
+  auto indices = GenerateRandomIndices();
+  ASSIGN_OR_FAIL(auto request, client_->CreateRequest(indices));
+  for (auto _ : st) {
+    ASSIGN_OR_FAIL(auto response, server_->ProcessRequest(request));
+    ::benchmark::DoNotOptimize(response);
+  }
+  st.SetLabel(backend);
+}
+
+BENCHMARK_DEFINE_F(PIRFixture, ServerProcessBatch)(benchmark::State& st) {
+  SetUpDb(st);
+  vector<Request> requests;
+  for (int64_t i = 0; i < st.range(kNumConfigArgs); ++i) {
+    ASSIGN_OR_FAIL(auto request,
+                   client_->CreateRequest(GenerateRandomIndices()));
+    requests.push_back(std::move(request));
+  }
+  for (auto _ : st) {
+    auto responses = server_->ProcessBatch(requests);
+    ::benchmark::DoNotOptimize(responses);
+  }
+  st.SetItemsProcessed(st.iterations() * requests.size());
+}
+
+// Decryption of the ciphertexts of every reply of a response, as they arrive.
+BENCHMARK_DEFINE_F(PIRFixture, ClientDecrypt)(benchmark::State& st) {
+  SetUpDb(st);
+  auto indices = GenerateRandomIndices();
+  ASSIGN_OR_FAIL(auto request, client_->CreateRequest(indices));
+  ASSIGN_OR_FAIL(auto response, server_->ProcessRequest(request));
+  for (auto _ : st) {
+    for (size_t q = 0; q < indices.size(); ++q) {
+      ASSIGN_OR_FAIL(auto reply, client_->BeginReply(indices[q]));
+      for (const auto& ct : response.reply(q).ct()) {
+        ASSERT_OK(reply->Add(ct));
+      }
+      ::benchmark::DoNotOptimize(reply);
+    }
+  }
+  SetSizeCounters(st, request, &response);
+}
+
+// Decoding of the items from the decrypted plaintexts of a response.
+BENCHMARK_DEFINE_F(PIRFixture, ClientDecode)(benchmark::State& st) {
+  SetUpDb(st);
+  auto indices = GenerateRandomIndices();
+  ASSIGN_OR_FAIL(auto request, client_->CreateRequest(indices));
+  ASSIGN_OR_FAIL(auto response, server_->ProcessRequest(request));
+  vector<unique_ptr<PIRClient::ReplyStream>> replies;
+  for (size_t q = 0; q < indices.size(); ++q) {
+    ASSIGN_OR_FAIL(auto reply, client_->BeginReply(indices[q]));
+    for (const auto& ct : response.reply(q).ct()) {
+      ASSERT_OK(reply->Add(ct));
+    }
+    replies.push_back(std::move(reply));
+  }
+  for (auto _ : st) {
+    for (size_t q = 0; q < replies.size(); ++q) {
+      ASSIGN_OR_FAIL(auto item, replies[q]->Finish());
+      ASSERT_EQ(item, string_db_[indices[q]]) << "q = " << q;
+    }
+  }
+}
+
 BENCHMARK_DEFINE_F(PIRFixture, ClientProcessResponse)(benchmark::State& st) {
   SetUpDb(st);
   auto indices = GenerateRandomIndices();
@@ -91,19 +497,34 @@ BENCHMARK_DEFINE_F(PIRFixture, ClientProcessResponse)(benchmark::State& st) {
       ASSERT_EQ(results[i], string_db_[indices[i]]) << "i = " << i;
     }
   }
+  SetSizeCounters(st, request, &response);
 }
 
-BENCHMARK_REGISTER_F(PIRFixture, SetupDb)
-    ->RangeMultiplier(2)
-    ->Range(1 << 8, 1 << 16);
-BENCHMARK_REGISTER_F(PIRFixture, ClientCreateRequest)
-    ->RangeMultiplier(2)
-    ->Range(1 << 8, 1 << 16);
-BENCHMARK_REGISTER_F(PIRFixture, ServerProcessRequest)
+BENCHMARK_REGISTER_F(PIRFixture, SetupDb)->Apply(ConfigSweep);
+BENCHMARK_REGISTER_F(PIRFixture, ClientCreateRequest)->Apply(PrecomputeSweep);
+BENCHMARK_REGISTER_F(PIRFixture, ServerGetKeys)->Apply(ConfigSweep);
+BENCHMARK_REGISTER_F(PIRFixture, ServerProcessRequest)->Apply(ConfigSweep);
+BENCHMARK_REGISTER_F(PIRFixture, ServerProcessRequestPhases)
+    ->Apply(ConfigSweep);
+BENCHMARK_REGISTER_F(PIRFixture, ServerProcessRequestStorage)
+    ->Apply(CompactSweep);
+BENCHMARK_REGISTER_F(PIRFixture, ServerProcessRequestBackend)
+    ->Apply(BackendSweep);
+BENCHMARK_REGISTER_F(PIRFixture, ServerProcessBatch)->Apply(BatchSweep);
+BENCHMARK_REGISTER_F(PIRFixture, ClientDecrypt)->Apply(ConfigSweep);
+BENCHMARK_REGISTER_F(PIRFixture, ClientDecode)->Apply(ConfigSweep);
+BENCHMARK_REGISTER_F(PIRFixture, ClientProcessResponse)->Apply(ConfigSweep);
+BENCHMARK_REGISTER_F(ExpansionFixture, ObliviousExpansion)
     ->RangeMultiplier(2)
-    ->Range(1 << 8, 1 << 16);
-BENCHMARK_REGISTER_F(PIRFixture, ClientProcessResponse)
+    ->Range(4096, 16384);
+BENCHMARK_REGISTER_F(ExpansionFixture, ObliviousExpansionStreaming)
     ->RangeMultiplier(2)
-    ->Range(1 << 8, 1 << 16);
+    ->Range(4096, 16384);
+BENCHMARK_REGISTER_F(DotProductFixture, MultiplyPlainAccumulate)
+    ->RangeMultiplier(4)
+    ->Range(16, 1024);
+BENCHMARK_REGISTER_F(DotProductFixture, LazyDotProduct)
+    ->RangeMultiplier(4)
+    ->Ranges({{16, 1024}, {0, 1}});
 
 }  // namespace pir
@@ -0,0 +1,30 @@
+//
+// Copyright 2020 the authors listed in CONTRIBUTORS.md
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#include "pir/cpp/cancellation.h"
+
+namespace pir {
+
+absl::Status Cancellation::status() const {
+  if (cancelled_.load(std::memory_order_relaxed)) {
+    return absl::CancelledError("request cancelled");
+  }
+  if (deadline_ && Clock::now() >= *deadline_) {
+    return absl::DeadlineExceededError("request deadline exceeded");
+  }
+  return absl::OkStatus();
+}
+
+}  // namespace pir
@@ -0,0 +1,79 @@
+//
+// Copyright 2020 the authors listed in CONTRIBUTORS.md
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef PIR_CANCELLATION_H_
+#define PIR_CANCELLATION_H_
+
+#include <atomic>
+#include <chrono>
+#include <optional>
+
+#include "absl/status/status.h"
+
+namespace pir {
+
+/**
+ * Deadline and cancellation flag of a request. The server checks it between
+ * the steps of its work, such as the queries of a request and the rows of the
+ * higher dimensions of the database, and gives up on the request once it is
+ * cancelled or past its deadline. Thread safe: Cancel may be called from any
+ * thread while the request is processed.
+ */
+class Cancellation {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  /**
+   * A request without a deadline, only stopped by Cancel.
+   */
+  Cancellation() = default;
+
+  /**
+   * A request that is stopped by Cancel or once the deadline has passed.
+   */
+  explicit Cancellation(Clock::time_point deadline) : deadline_(deadline) {}
+
+  Cancellation(const Cancellation&) = delete;
+  Cancellation& operator=(const Cancellation&) = delete;
+
+  /**
+   * Asks for the work on the request to stop.
+   */
+  void Cancel() { cancelled_.store(true, std::memory_order_relaxed); }
+
+  /**
+   * Returns true if the request was cancelled or is past its deadline.
+   */
+  bool IsStopped() const { return !status().ok(); }
+
+  /**
+   * Returns Cancelled if Cancel was called, DeadlineExceeded if the deadline
+   * has passed, and OK otherwise.
+   */
+  absl::Status status() const;
+
+  const std::optional<Clock::time_point>& deadline() const {
+    return deadline_;
+  }
+
+ private:
+  std::atomic<bool> cancelled_{false};
+  const std::optional<Clock::time_point> deadline_;
+};
+
+}  // namespace pir
+
+#endif  // PIR_CANCELLATION_H_
@@ -15,6 +15,9 @@
 //
 #include "pir/cpp/client.h"
 
+#include <algorithm>
+
+#include "absl/strings/escaping.h"
 #include "pir/cpp/ct_reencoder.h"
 #include "pir/cpp/database.h"
 #include "pir/cpp/status_asserts.h"
@@ -32,26 +35,63 @@ using ::seal::GaloisKeys;
 using ::seal::Plaintext;
 using ::seal::RelinKeys;
 
-PIRClient::PIRClient(std::unique_ptr<PIRContext> context)
-    : context_(std::move(context)) {}
+PIRClient::PIRClient(std::unique_ptr<PIRContext> context,
+                     bool seeded_queries, seal::compr_mode_type compr_mode,
+                     size_t num_threads)
+    : context_(std::move(context)),
+      seeded_queries_(seeded_queries),
+      compr_mode_(compr_mode) {
+  if (num_threads > 1) {
+    // The calling thread takes part in the work, so it counts as one.
+    thread_pool_ = std::make_unique<ThreadPool>(num_threads - 1);
+  }
+}
 
 Status PIRClient::initialize() {
   ASSIGN_OR_RETURN(db_, PIRDatabase::Create(context_->Params()));
+  string_encoder_ = std::make_unique<StringEncoder>(context_->SEALContext());
+  if (context_->Params()->bits_per_coeff() > 0) {
+    string_encoder_->set_bits_per_coeff(context_->Params()->bits_per_coeff());
+  }
+  if (!context_->Params()->use_ciphertext_multiplication()) {
+    // Replies decompose ciphertexts at the level the server switched them to.
+    ASSIGN_OR_RETURN(ct_reencoder_,
+                     CiphertextReencoder::Create(context_->SEALContext(),
+                                                 context_->ReplyParmsId()));
+  }
   try {
     auto sealctx = context_->SEALContext();
     keygen_ = std::make_unique<seal::KeyGenerator>(sealctx);
-    encryptor_ =
-        std::make_shared<seal::Encryptor>(sealctx, keygen_->public_key());
+    // Both keys, so queries can be encrypted either way.
+    encryptor_ = std::make_shared<seal::Encryptor>(
+        sealctx, keygen_->public_key(), keygen_->secret_key());
     decryptor_ =
         std::make_shared<seal::Decryptor>(sealctx, keygen_->secret_key());
-    auto gal_keys = keygen_->galois_keys(generate_galois_elts(
-        context_->EncryptionParams().poly_modulus_degree()));
-    auto relin_keys = keygen_->relin_keys();
+    // Only the elements for the levels the server expands queries to.
+    const auto galois_elts = generate_galois_elts(
+        context_->EncryptionParams().poly_modulus_degree(),
+        context_->DimensionsSum());
+    auto gal_keys = keygen_->galois_keys(galois_elts);
     request_proto_ = std::make_unique<Request>();
+    for (const auto elt : galois_elts) {
+      request_proto_->add_galois_elts(elt);
+    }
+    // Random so that different clients of a server don't share key IDs.
+    string key_id(16, 0);
+    seal::UniformRandomGeneratorFactory::DefaultFactory()->create()->generate(
+        key_id.size(), reinterpret_cast<seal::SEAL_BYTE*>(key_id.data()));
+    request_proto_->set_key_id(absl::BytesToHexString(key_id));
     RETURN_IF_ERROR(
         SEALSerialize<>(gal_keys, request_proto_->mutable_galois_keys()));
-    RETURN_IF_ERROR(
-        SEALSerialize<>(relin_keys, request_proto_->mutable_relin_keys()));
+    // Relinearization keys are only used to multiply selection vectors of
+    // different dimensions together as ciphertexts.
+    const auto& params = context_->Params();
+    if (params->use_ciphertext_multiplication() &&
+        params->dimensions_size() > 1) {
+      auto relin_keys = keygen_->relin_keys();
+      RETURN_IF_ERROR(
+          SEALSerialize<>(relin_keys, request_proto_->mutable_relin_keys()));
+    }
   } catch (const std::exception& ex) {
     return InternalError(ex.what());
   }
@@ -59,13 +99,66 @@ Status PIRClient::initialize() {
 }
 
 StatusOr<std::unique_ptr<PIRClient>> PIRClient::Create(
-    shared_ptr<PIRParameters> params) {
+    shared_ptr<PIRParameters> params, bool seeded_queries,
+    seal::compr_mode_type compr_mode, size_t num_threads) {
+  if (num_threads == 0) {
+    return InvalidArgumentError("number of threads must be positive");
+  }
   ASSIGN_OR_RETURN(auto context, PIRContext::Create(params));
-  auto client = absl::WrapUnique(new PIRClient(std::move(context)));
+  auto client = absl::WrapUnique(new PIRClient(
+      std::move(context), seeded_queries, compr_mode, num_threads));
   RETURN_IF_ERROR(client->initialize());
   return client;
 }
 
+Status PIRClient::Precompute(size_t num_ciphertexts) {
+  if (seeded_queries_) {
+    return absl::FailedPreconditionError(
+        "seeded queries can't be precomputed");
+  }
+  {
+    std::lock_guard<std::mutex> lock(precomputed_mutex_);
+    const size_t room = precomputed_.size() < precompute_capacity_
+                            ? precompute_capacity_ - precomputed_.size()
+                            : 0;
+    num_ciphertexts = std::min(num_ciphertexts, room);
+  }
+  // Encrypted without holding the lock, so requests aren't held up.
+  vector<Ciphertext> cts(num_ciphertexts);
+  try {
+    for (auto& ct : cts) {
+      encryptor_->encrypt_zero(ct);
+    }
+  } catch (const std::exception& e) {
+    return InternalError(e.what());
+  }
+  std::lock_guard<std::mutex> lock(precomputed_mutex_);
+  for (auto& ct : cts) {
+    if (precomputed_.size() >= precompute_capacity_) break;
+    precomputed_.push_back(std::move(ct));
+  }
+  return absl::OkStatus();
+}
+
+void PIRClient::SetPrecomputeCapacity(size_t capacity) {
+  std::lock_guard<std::mutex> lock(precomputed_mutex_);
+  precompute_capacity_ = capacity;
+  if (precomputed_.size() > capacity) {
+    precomputed_.resize(capacity);
+  }
+}
+
+size_t PIRClient::PrecomputedCount() const {
+  std::lock_guard<std::mutex> lock(precomputed_mutex_);
+  return precomputed_.size();
+}
+
+size_t PIRClient::CiphertextsPerQuery() const {
+  return context_->DimensionsSum() /
+             context_->EncryptionParams().poly_modulus_degree() +
+         1;
+}
+
 StatusOr<uint64_t> InvertMod(uint64_t m, const seal::Modulus& mod) {
   if (mod.uint64_count() > 1) {
     return InternalError("Modulus too big to invert");
@@ -78,19 +171,21 @@ StatusOr<uint64_t> InvertMod(uint64_t m, const seal::Modulus& mod) {
 }
 
 StatusOr<Request> PIRClient::CreateRequest(
-    const std::vector<std::size_t>& indexes) const {
-  vector<vector<Ciphertext>> queries(indexes.size());
-  for (size_t i = 0; i < indexes.size(); ++i) {
-    RETURN_IF_ERROR(createQueryFor(indexes[i], queries[i]));
+    const std::vector<std::size_t>& indexes, bool include_keys) const {
+  Request request_proto;
+  if (include_keys) {
+    request_proto = *request_proto_;
+  } else {
+    request_proto.set_key_id(request_proto_->key_id());
+  }
+  for (const auto index : indexes) {
+    RETURN_IF_ERROR(createQueryFor(index, request_proto.add_query()));
   }
-
-  Request request_proto(*request_proto_);
-  RETURN_IF_ERROR(SaveRequest(queries, &request_proto));
   return request_proto;
 }
 
 Status PIRClient::createQueryFor(size_t desired_index,
-                                 vector<Ciphertext>& query) const {
+                                 Ciphertexts* query) const {
   if (desired_index >= context_->Params()->num_items()) {
     return InvalidArgumentError("invalid index " +
                                 std::to_string(desired_index));
@@ -106,9 +201,9 @@ Status PIRClient::createQueryFor(size_t desired_index,
   const size_t dim_sum = context_->DimensionsSum();
 
   size_t offset = 0;
-  query.resize(dim_sum / poly_modulus_degree + 1);
+  const size_t num_ct = CiphertextsPerQuery();
   Plaintext pt(poly_modulus_degree);
-  for (size_t c = 0; c < query.size(); ++c) {
+  for (size_t c = 0; c < num_ct; ++c) {
     pt.set_zero();
 
     while (!indices.empty()) {
@@ -119,7 +214,7 @@ Status PIRClient::createQueryFor(size_t desired_index,
         offset = 0;
         break;
       }
-      uint64_t m = (c < query.size() - 1)
+      uint64_t m = (c < num_ct - 1)
                        ? poly_modulus_degree
                        : next_power_two(dim_sum % poly_modulus_degree);
       ASSIGN_OR_RETURN(pt[indices[0] + offset], InvertMod(m, plain_mod));
@@ -134,7 +229,14 @@ Status PIRClient::createQueryFor(size_t desired_index,
     }
 
     try {
-      encryptor_->encrypt(pt, query[c]);
+      if (seeded_queries_) {
+        RETURN_IF_ERROR(SEALSerialize<>(encryptor_->encrypt_symmetric(pt),
+                                        query->add_ct(), compr_mode_));
+      } else {
+        Ciphertext ct;
+        encrypt(pt, ct);
+        RETURN_IF_ERROR(SEALSerialize<>(ct, query->add_ct(), compr_mode_));
+      }
     } catch (const std::exception& e) {
       return InternalError(e.what());
     }
@@ -143,18 +245,36 @@ Status PIRClient::createQueryFor(size_t desired_index,
   return absl::OkStatus();
 }
 
-StatusOr<std::vector<int64_t>> PIRClient::ProcessResponseInteger(
-    const Response& response_proto) const {
-  vector<int64_t> result;
-  result.reserve(response_proto.reply_size());
-  for (const auto& r : response_proto.reply()) {
-    ASSIGN_OR_RETURN(auto result_pt, ProcessReply(r));
-    try {
-      result.push_back(context_->Encoder()->decode_int64(result_pt));
-    } catch (const std::exception& e) {
-      return InternalError(e.what());
+void PIRClient::encrypt(const Plaintext& pt, Ciphertext& ct) const {
+  bool precomputed = false;
+  {
+    std::lock_guard<std::mutex> lock(precomputed_mutex_);
+    if (!precomputed_.empty()) {
+      ct = std::move(precomputed_.back());
+      precomputed_.pop_back();
+      precomputed = true;
     }
   }
+  if (precomputed) {
+    // An encryption of zero plus pt is an encryption of pt.
+    context_->Evaluator()->add_plain_inplace(ct, pt);
+  } else {
+    encryptor_->encrypt(pt, ct);
+  }
+}
+
+StatusOr<std::vector<int64_t>> PIRClient::ProcessResponseInteger(
+    const Response& response_proto) const {
+  vector<int64_t> result(response_proto.reply_size());
+  RETURN_IF_ERROR(
+      forEachReply(response_proto, [&](size_t i, const Plaintext& pt) {
+        try {
+          result[i] = context_->Encoder()->decode_int64(pt);
+        } catch (const std::exception& e) {
+          return InternalError(e.what());
+        }
+        return absl::OkStatus();
+      }));
   return result;
 }
 
@@ -166,75 +286,170 @@ StatusOr<std::vector<string>> PIRClient::ProcessResponse(
         "Number of indexes must match number of replies");
   }
 
-  StringEncoder encoder(context_->SEALContext());
-  if (context_->Params()->bits_per_coeff() > 0) {
-    encoder.set_bits_per_coeff(context_->Params()->bits_per_coeff());
+  const size_t bytes_per_item = context_->Params()->bytes_per_item();
+  vector<string> result(response_proto.reply_size());
+  RETURN_IF_ERROR(
+      forEachReply(response_proto, [&](size_t i, const Plaintext& pt) {
+        ASSIGN_OR_RETURN(
+            result[i],
+            string_encoder_->decode(pt, bytes_per_item,
+                                    db_->calculate_item_offset(indexes[i])));
+        return absl::OkStatus();
+      }));
+  return result;
+}
+
+PIRClient::ReplyStream::ReplyStream(const PIRClient* client, size_t index,
+                                    size_t num_ciphertexts, size_t num_levels)
+    : client_(client),
+      index_(index),
+      num_ciphertexts_(num_ciphertexts),
+      pending_(num_levels) {}
+
+StatusOr<std::unique_ptr<PIRClient::ReplyStream>> PIRClient::BeginReply(
+    size_t index) const {
+  if (index >= context_->Params()->num_items()) {
+    return InvalidArgumentError("invalid index " + std::to_string(index));
+  }
+  const size_t num_dims = context_->Params()->dimensions_size();
+  if (context_->Params()->use_ciphertext_multiplication()) {
+    return absl::WrapUnique(new ReplyStream(this, index, 1, 1));
+  }
+  const size_t exp_ratio = ct_reencoder_->ExpansionRatio() * 2;
+  return absl::WrapUnique(new ReplyStream(
+      this, index, ipow(exp_ratio, num_dims - 1), num_dims));
+}
+
+Status PIRClient::ReplyStream::Add(const string& ciphertext) {
+  if (added_ == num_ciphertexts_) {
+    return InvalidArgumentError("Reply has only " +
+                                std::to_string(num_ciphertexts_) +
+                                " ciphertexts");
   }
-  vector<string> result;
-  result.reserve(response_proto.reply_size());
+  ASSIGN_OR_RETURN(auto ct, SEALDeserialize<Ciphertext>(
+                                client_->context_->SEALContext(), ciphertext));
+  ++added_;
+  return push(0, ct);
+}
 
-  for (size_t i = 0; i < indexes.size(); ++i) {
-    ASSIGN_OR_RETURN(auto result_pt, ProcessReply(response_proto.reply(i)));
+Status PIRClient::ReplyStream::push(size_t level, const Ciphertext& ct) {
+  Plaintext pt;
+  try {
+    client_->decryptor_->decrypt(ct, pt);
+  } catch (const std::exception& e) {
+    return InternalError(e.what());
+  }
+  if (level + 1 == pending_.size()) {
+    result_ = std::move(pt);
+    return absl::OkStatus();
+  }
 
-    ASSIGN_OR_RETURN(
-        auto v, encoder.decode(result_pt, context_->Params()->bytes_per_item(),
-                               db_->calculate_item_offset(indexes[i])));
-    result.push_back(v);
+  // Consecutive ciphertexts of a level decompose one of the level above.
+  auto& pts = pending_[level];
+  pts.push_back(std::move(pt));
+  if (pts.size() < client_->ct_reencoder_->ExpansionRatio() * 2) {
+    return absl::OkStatus();
   }
-  return result;
+  Ciphertext next;
+  try {
+    client_->ct_reencoder_->Decode(pts.cbegin(), 2, next);
+  } catch (const std::exception& e) {
+    return InternalError(e.what());
+  }
+  pts.clear();
+  return push(level + 1, next);
+}
+
+StatusOr<string> PIRClient::ReplyStream::Finish() const {
+  if (added_ < num_ciphertexts_) {
+    return absl::FailedPreconditionError(
+        "Reply has " + std::to_string(added_) + " of its " +
+        std::to_string(num_ciphertexts_) + " ciphertexts");
+  }
+  return client_->string_encoder_->decode(
+      result_, client_->context_->Params()->bytes_per_item(),
+      client_->db_->calculate_item_offset(index_));
+}
+
+Status PIRClient::forEachReply(
+    const Response& response_proto,
+    const std::function<Status(size_t, const Plaintext&)>& fn) const {
+  const size_t num_replies = response_proto.reply_size();
+  if (thread_pool_ == nullptr || num_replies <= 1) {
+    ReplyScratch scratch;
+    for (size_t i = 0; i < num_replies; ++i) {
+      RETURN_IF_ERROR(ProcessReply(response_proto.reply(i), scratch));
+      RETURN_IF_ERROR(fn(i, scratch.result()));
+    }
+    return absl::OkStatus();
+  }
+
+  // One set of buffers per worker, plus one for the calling thread.
+  vector<ReplyScratch> scratch(thread_pool_->size() + 1);
+  vector<Status> statuses(num_replies);
+  thread_pool_->ParallelFor(num_replies, [&](size_t i, size_t worker) {
+    statuses[i] = ProcessReply(response_proto.reply(i), scratch[worker]);
+    if (statuses[i].ok()) {
+      statuses[i] = fn(i, scratch[worker].result());
+    }
+  });
+  for (const auto& status : statuses) {
+    RETURN_IF_ERROR(status);
+  }
+  return absl::OkStatus();
 }
 
-StatusOr<Plaintext> PIRClient::ProcessReply(
-    const Ciphertexts& reply_proto) const {
+Status PIRClient::ProcessReply(const Ciphertexts& reply_proto,
+                               ReplyScratch& scratch) const {
   if (context_->Params()->use_ciphertext_multiplication()) {
-    return ProcessReplyCiphertextMult(reply_proto);
+    return ProcessReplyCiphertextMult(reply_proto, scratch);
   } else {
-    return ProcessReplyCiphertextDecomp(reply_proto);
+    return ProcessReplyCiphertextDecomp(reply_proto, scratch);
   }
 }
 
-StatusOr<Plaintext> PIRClient::ProcessReplyCiphertextMult(
-    const Ciphertexts& reply_proto) const {
-  ASSIGN_OR_RETURN(auto reply_cts,
+Status PIRClient::ProcessReplyCiphertextMult(const Ciphertexts& reply_proto,
+                                             ReplyScratch& scratch) const {
+  ASSIGN_OR_RETURN(scratch.cts,
                    LoadCiphertexts(context_->SEALContext(), reply_proto));
-  if (reply_cts.size() != 1) {
+  if (scratch.cts.size() != 1) {
     return InvalidArgumentError(
         "Number of ciphertexts in reply must be 1 when using CT "
         "multiplication");
   }
 
-  const auto poly_modulus_degree =
-      context_->EncryptionParams().poly_modulus_degree();
-  seal::Plaintext pt(poly_modulus_degree, 0);
-
+  scratch.pts.resize(1);
   try {
-    decryptor_->decrypt(reply_cts[0], pt);
+    decryptor_->decrypt(scratch.cts[0], scratch.pts[0]);
   } catch (const std::exception& e) {
     return InternalError(e.what());
   }
 
-  return pt;
+  return absl::OkStatus();
 }
 
-StatusOr<Plaintext> PIRClient::ProcessReplyCiphertextDecomp(
-    const Ciphertexts& reply_proto) const {
-  ASSIGN_OR_RETURN(auto ct_reencoder,
-                   CiphertextReencoder::Create(context_->SEALContext()));
+Status PIRClient::ProcessReplyCiphertextDecomp(const Ciphertexts& reply_proto,
+                                               ReplyScratch& scratch) const {
   // TODO: this should use the original CT size
-  const size_t exp_ratio = ct_reencoder->ExpansionRatio() * 2;
+  const size_t exp_ratio = ct_reencoder_->ExpansionRatio() * 2;
   const size_t num_dims = context_->Params()->dimensions_size();
   const size_t num_ct_per_reply = ipow(exp_ratio, num_dims - 1);
 
-  ASSIGN_OR_RETURN(auto reply_cts,
+  auto& reply_cts = scratch.cts;
+  auto& reply_pts = scratch.pts;
+  ASSIGN_OR_RETURN(reply_cts,
                    LoadCiphertexts(context_->SEALContext(), reply_proto));
   if (reply_cts.size() != num_ct_per_reply) {
     return InvalidArgumentError(
         "Number of ciphertexts in reply does not match expected");
   }
-  vector<Plaintext> reply_pts;
 
+  // Plaintexts kept from earlier replies are decrypted over in place, and
+  // each dimension decodes its ciphertexts into those of the one before.
   for (size_t d = 0; d < num_dims; ++d) {
-    reply_pts.resize(reply_cts.size());
+    if (reply_pts.size() < reply_cts.size()) {
+      reply_pts.resize(reply_cts.size());
+    }
     try {
       for (size_t i = 0; i < reply_cts.size(); ++i) {
         decryptor_->decrypt(reply_cts[i], reply_pts[i]);
@@ -243,14 +458,15 @@ StatusOr<Plaintext> PIRClient::ProcessReplyCiphertextDecomp(
       return InternalError(e.what());
     }
 
-    if (reply_pts.size() <= 1) break;
+    if (reply_cts.size() <= 1) break;
 
     reply_cts.resize(reply_cts.size() / exp_ratio);
     for (size_t i = 0; i < reply_cts.size(); ++i) {
-      reply_cts[i] = ct_reencoder->Decode(reply_pts.begin() + i * exp_ratio, 2);
+      ct_reencoder_->Decode(reply_pts.begin() + i * exp_ratio, 2,
+                            reply_cts[i]);
     }
   }
 
-  return reply_pts[0];
+  return absl::OkStatus();
 }
 }  // namespace pir
@@ -17,12 +17,18 @@
 #ifndef PIR_CLIENT_H_
 #define PIR_CLIENT_H_
 
+#include <functional>
+#include <mutex>
 #include <string>
+#include <vector>
 
 #include "absl/status/statusor.h"
 #include "pir/cpp/context.h"
+#include "pir/cpp/ct_reencoder.h"
 #include "pir/cpp/database.h"
 #include "pir/cpp/serialization.h"
+#include "pir/cpp/string_encoder.h"
+#include "pir/cpp/thread_pool.h"
 
 namespace pir {
 
@@ -35,10 +41,22 @@ class PIRClient {
   /**
    * Creates and returns a new client instance, from existing parameters
    * @param[in] params PIR parameters
-   * @returns InvalidArgument if the parameters cannot be loaded
+   * @param[in] seeded_queries If true, queries are encrypted with the secret
+   *    key, and the second polynomial of each query ciphertext is sent as the
+   *    seed it was generated from rather than in full, which about halves the
+   *    size of requests. Servers regenerate it when loading the request.
+   * @param[in] compr_mode Compression applied to serialized query
+   *    ciphertexts.
+   * @param[in] num_threads Number of threads replies of a response are
+   *    decrypted and decoded on, including the calling thread.
+   * @returns InvalidArgument if the parameters cannot be loaded or the number
+   *    of threads is zero
    **/
   static StatusOr<std::unique_ptr<PIRClient>> Create(
-      shared_ptr<PIRParameters> params);
+      shared_ptr<PIRParameters> params, bool seeded_queries = false,
+      seal::compr_mode_type compr_mode =
+          seal::Serialization::compr_mode_default,
+      std::size_t num_threads = 1);
   /**
    * Creates a new request to query the database for the given index. Note that
    * if more than one dimension is specified in context, then the request
@@ -47,10 +65,46 @@ class PIRClient {
    * request ciphertexts, and then split them into vectors by the dimensions
    * given in context.
    * @param[in] desiredIndex Expected database value from an index
+   * @param[in] include_keys If false, the request carries only the client's
+   *    key ID, for servers that cached the keys from an earlier request.
    * @returns InvalidArgument if the index is invalid or if the encryption fails
    **/
-  StatusOr<Request> CreateRequest(
-      const std::vector<std::size_t>& /*indexes*/) const;
+  StatusOr<Request> CreateRequest(const std::vector<std::size_t>& /*indexes*/,
+                                  bool include_keys = true) const;
+
+  /**
+   * Moves the public key encryption of queries offline: adds fresh
+   * encryptions of zero to a pool that CreateRequest draws from, so that
+   * encrypting a query ciphertext online only takes adding its selection
+   * plaintext. Each precomputed ciphertext is used once. May be called from a
+   * background thread while requests are created, to refill the pool.
+   * @param[in] num_ciphertexts Number of ciphertexts to add; the pool never
+   *    holds more than its capacity. Each query takes CiphertextsPerQuery().
+   * @returns FailedPrecondition if the client encrypts seeded queries, which
+   *    are encrypted with the secret key and can't be precomputed
+   **/
+  Status Precompute(std::size_t num_ciphertexts);
+
+  /**
+   * Sets the maximum number of precomputed ciphertexts the pool holds.
+   * Ciphertexts above a lowered capacity are dropped.
+   **/
+  void SetPrecomputeCapacity(std::size_t capacity);
+
+  /**
+   * Number of precomputed ciphertexts left in the pool.
+   **/
+  std::size_t PrecomputedCount() const;
+
+  /**
+   * Number of ciphertexts in each query of a request.
+   **/
+  std::size_t CiphertextsPerQuery() const;
+
+  /**
+   * Identifier sent with every request so that a server can cache the keys.
+   **/
+  const std::string& KeyId() const { return request_proto_->key_id(); }
 
   /**
    * Extracts database value from server response message. Needs the indices
@@ -63,6 +117,64 @@ class PIRClient {
   StatusOr<std::vector<std::string>> ProcessResponse(
       const std::vector<std::size_t>& indexes, const Response& response) const;
 
+  /**
+   * Reply to one query, fed one ciphertext at a time as it arrives from
+   * PIRServer::ProcessRequestStreaming, and decrypted as it goes rather than
+   * once the whole response is in.
+   */
+  class ReplyStream {
+   public:
+    ReplyStream(const ReplyStream&) = delete;
+    ReplyStream& operator=(const ReplyStream&) = delete;
+
+    /**
+     * Decrypts the next ciphertext of the reply right away, and each
+     * ciphertext of a higher dimension as soon as all of the ciphertexts it
+     * was decomposed into have been added, so that only a few plaintexts per
+     * dimension are ever held.
+     * @param[in] ciphertext Serialized ciphertext, in the order the server
+     *    wrote them.
+     * @returns InvalidArgument if the reply already has all its ciphertexts
+     *    or the ciphertext can't be loaded, InternalError if decryption fails
+     */
+    Status Add(const std::string& ciphertext);
+
+    /**
+     * Number of ciphertexts the reply is made of.
+     */
+    std::size_t num_ciphertexts() const { return num_ciphertexts_; }
+
+    /**
+     * Returns the value of the item, once every ciphertext has been added.
+     * @returns FailedPrecondition if ciphertexts are missing
+     */
+    StatusOr<std::string> Finish() const;
+
+   private:
+    friend class PIRClient;
+    ReplyStream(const PIRClient* client, std::size_t index,
+                std::size_t num_ciphertexts, std::size_t num_levels);
+
+    // Decrypts a ciphertext of the given level of decomposition, the sole
+    // ciphertext of the last level being the item itself.
+    Status push(std::size_t level, const seal::Ciphertext& ct);
+
+    const PIRClient* const client_;
+    const std::size_t index_;
+    const std::size_t num_ciphertexts_;
+    std::size_t added_ = 0;
+    // Plaintexts of each level not yet decoded into a ciphertext of the next.
+    std::vector<std::vector<seal::Plaintext>> pending_;
+    seal::Plaintext result_;
+  };
+
+  /**
+   * Starts processing the reply to the query for an index incrementally.
+   * @param[in] index Index the query was created for.
+   * @returns InvalidArgument if the index is invalid
+   */
+  StatusOr<std::unique_ptr<ReplyStream>> BeginReply(std::size_t index) const;
+
   /**
    * Extracts server response as an integer encoded in the plaintext.
    * Should only be used for testing.
@@ -75,23 +187,60 @@ class PIRClient {
   PIRClient() = delete;
 
  private:
-  PIRClient(std::unique_ptr<PIRContext>);
+  PIRClient(std::unique_ptr<PIRContext>, bool seeded_queries,
+            seal::compr_mode_type compr_mode, std::size_t num_threads);
   Status initialize();
-  Status createQueryFor(size_t desired_index, vector<Ciphertext>& query) const;
+  // Encrypts the selection vector of an index and serializes it to query.
+  Status createQueryFor(size_t desired_index, Ciphertexts* query) const;
+  // Encrypts pt to ct, from a precomputed encryption of zero if there is one.
+  void encrypt(const seal::Plaintext& pt, seal::Ciphertext& ct) const;
 
   std::unique_ptr<PIRContext> context_;
   std::shared_ptr<PIRDatabase> db_;
+  const bool seeded_queries_;
+  const seal::compr_mode_type compr_mode_;
 
   std::unique_ptr<seal::KeyGenerator> keygen_;
   std::shared_ptr<seal::Encryptor> encryptor_;
   std::shared_ptr<seal::Decryptor> decryptor_;
   std::unique_ptr<Request> request_proto_;
 
-  StatusOr<seal::Plaintext> ProcessReply(const Ciphertexts& reply_proto) const;
-  StatusOr<seal::Plaintext> ProcessReplyCiphertextMult(
-      const Ciphertexts& reply_proto) const;
-  StatusOr<seal::Plaintext> ProcessReplyCiphertextDecomp(
-      const Ciphertexts& reply_proto) const;
+  // Precomputed encryptions of zero, taken by requests created concurrently.
+  mutable std::mutex precomputed_mutex_;
+  mutable std::vector<seal::Ciphertext> precomputed_;
+  std::size_t precompute_capacity_ = 64;
+
+  // Buffers one thread decrypts replies into, reused from reply to reply and
+  // across the dimensions of each reply.
+  struct ReplyScratch {
+    std::vector<seal::Ciphertext> cts;
+    std::vector<seal::Plaintext> pts;
+
+    // Plaintext of the last reply processed.
+    const seal::Plaintext& result() const { return pts[0]; }
+  };
+
+  // Processes every reply of a response, in parallel when the client has a
+  // thread pool, calling fn with the index and plaintext of each.
+  Status forEachReply(
+      const Response& response_proto,
+      const std::function<Status(size_t, const seal::Plaintext&)>& fn) const;
+
+  // Decrypts a reply, leaving its plaintext in scratch.result().
+  Status ProcessReply(const Ciphertexts& reply_proto,
+                      ReplyScratch& scratch) const;
+  Status ProcessReplyCiphertextMult(const Ciphertexts& reply_proto,
+                                    ReplyScratch& scratch) const;
+  Status ProcessReplyCiphertextDecomp(const Ciphertexts& reply_proto,
+                                      ReplyScratch& scratch) const;
+
+  // Helpers for decoding replies, created once.
+  std::unique_ptr<StringEncoder> string_encoder_;
+  // Null when using ciphertext multiplication.
+  std::unique_ptr<CiphertextReencoder> ct_reencoder_;
+
+  // Null when replies are processed on the calling thread.
+  std::unique_ptr<ThreadPool> thread_pool_;
 };
 
 }  // namespace pir
@@ -43,13 +43,16 @@ class PIRClientTest : public ::testing::Test {
   void SetUp() { SetUpDB(100); }
 
   void SetUpDB(size_t dbsize, size_t dimensions = 1, size_t elem_size = 0,
-               bool use_ciphertext_multiplication = false) {
+               bool use_ciphertext_multiplication = false,
+               size_t num_threads = 1) {
     db_size_ = dbsize;
     encryption_params_ = GenerateEncryptionParams(POLY_MODULUS_DEGREE, 16);
     pir_params_ =
         *(CreatePIRParameters(dbsize, elem_size, dimensions, encryption_params_,
                               use_ciphertext_multiplication));
-    client_ = *(PIRClient::Create(pir_params_));
+    client_ = *(PIRClient::Create(pir_params_, false,
+                                  seal::Serialization::compr_mode_default,
+                                  num_threads));
 
     ASSERT_TRUE(client_ != nullptr);
   }
@@ -87,6 +90,120 @@ TEST_F(PIRClientTest, TestCreateRequest) {
   }
 }
 
+TEST_F(PIRClientTest, TestCreateRequestWithoutKeys) {
+  ASSIGN_OR_FAIL(auto with_keys, client_->CreateRequest({5}));
+  ASSIGN_OR_FAIL(auto without_keys, client_->CreateRequest({5}, false));
+  ASSERT_EQ(without_keys.query_size(), 1);
+  EXPECT_THAT(client_->KeyId(), Not(IsEmpty()));
+  EXPECT_THAT(with_keys.key_id(), Eq(client_->KeyId()));
+  EXPECT_THAT(without_keys.key_id(), Eq(client_->KeyId()));
+  EXPECT_THAT(without_keys.galois_keys(), IsEmpty());
+  EXPECT_THAT(without_keys.relin_keys(), IsEmpty());
+}
+
+TEST_F(PIRClientTest, TestCreateRequestSeeded) {
+  const size_t desired_index = 5;
+  ASSIGN_OR_FAIL(auto full, client_->CreateRequest({desired_index}, false));
+  ASSIGN_OR_FAIL(auto uncompressed_client,
+                 PIRClient::Create(pir_params_, false,
+                                   seal::compr_mode_type::none));
+  ASSIGN_OR_FAIL(auto uncompressed,
+                 uncompressed_client->CreateRequest({desired_index}, false));
+  ASSIGN_OR_FAIL(client_, PIRClient::Create(pir_params_, true));
+  ASSIGN_OR_FAIL(auto seeded, client_->CreateRequest({desired_index}, false));
+
+  ASSERT_EQ(seeded.query_size(), 1);
+  ASSERT_EQ(seeded.query(0).ct_size(), 1);
+  // The second polynomial is replaced by its seed.
+  EXPECT_LT(seeded.query(0).ct(0).size(), full.query(0).ct(0).size() * 0.6);
+  if (seal::Serialization::IsSupportedComprMode(
+          seal::compr_mode_type::deflate)) {
+    EXPECT_LT(full.query(0).ct(0).size(),
+              uncompressed.query(0).ct(0).size());
+  }
+
+  // Loading the ciphertexts regenerates the second polynomial.
+  ASSIGN_OR_FAIL(auto req,
+                 LoadCiphertexts(Context()->SEALContext(), seeded.query(0)));
+  ASSERT_EQ(req.size(), 1);
+  EXPECT_EQ(req[0].size(), 2);
+  Plaintext pt;
+  Decryptor()->decrypt(req[0], pt);
+  const auto plain_mod = encryption_params_.plain_modulus().value();
+  EXPECT_EQ((pt[desired_index] * next_power_two(db_size_)) % plain_mod, 1);
+  for (size_t i = 0; i < pt.coeff_count(); ++i) {
+    if (i != desired_index) {
+      EXPECT_EQ(pt[i], 0) << "i = " << i;
+    }
+  }
+}
+
+TEST_F(PIRClientTest, TestCreateRequestPrecomputed) {
+  client_->SetPrecomputeCapacity(3);
+  ASSERT_OK(client_->Precompute(2));
+  EXPECT_EQ(client_->PrecomputedCount(), 2);
+  ASSERT_OK(client_->Precompute(10));
+  EXPECT_EQ(client_->PrecomputedCount(), 3);
+
+  const vector<size_t> indices = {5, 17, 42, 99};
+  ASSIGN_OR_FAIL(auto request_proto, client_->CreateRequest(indices));
+  // Three queries are encrypted from the pool and the last one online.
+  EXPECT_EQ(client_->PrecomputedCount(), 0);
+  ASSERT_EQ(request_proto.query_size(), indices.size());
+
+  const auto plain_mod = encryption_params_.plain_modulus().value();
+  for (size_t q = 0; q < indices.size(); ++q) {
+    ASSIGN_OR_FAIL(auto query, LoadCiphertexts(Context()->SEALContext(),
+                                               request_proto.query(q)));
+    ASSERT_EQ(query.size(), 1);
+    Plaintext pt;
+    Decryptor()->decrypt(query[0], pt);
+    EXPECT_EQ((pt[indices[q]] * next_power_two(db_size_)) % plain_mod, 1);
+    for (size_t i = 0; i < pt.coeff_count(); ++i) {
+      if (i != indices[q]) {
+        EXPECT_EQ(pt[i], 0) << "i = " << i;
+      }
+    }
+  }
+
+  ASSERT_OK(client_->Precompute(3));
+  client_->SetPrecomputeCapacity(1);
+  EXPECT_EQ(client_->PrecomputedCount(), 1);
+}
+
+TEST_F(PIRClientTest, TestPrecomputeSeeded) {
+  ASSIGN_OR_FAIL(client_, PIRClient::Create(pir_params_, true));
+  EXPECT_THAT(client_->Precompute(1).code(),
+              Eq(absl::StatusCode::kFailedPrecondition));
+}
+
+TEST_F(PIRClientTest, TestCreateRequestMinimalKeys) {
+  // 100 items make for 7 expansion levels, rather than log2(4096) = 12.
+  ASSIGN_OR_FAIL(auto request_proto, client_->CreateRequest({5}));
+  EXPECT_THAT(request_proto.galois_elts(),
+              ElementsAre(4097, 2049, 1025, 513, 257, 129, 65));
+  EXPECT_THAT(request_proto.relin_keys(), IsEmpty());
+
+  ASSIGN_OR_FAIL(auto galois_keys,
+                 SEALDeserialize<GaloisKeys>(Context()->SEALContext(),
+                                             request_proto.galois_keys()));
+  for (const auto elt : request_proto.galois_elts()) {
+    EXPECT_TRUE(galois_keys.has_key(elt)) << "elt = " << elt;
+  }
+  EXPECT_FALSE(galois_keys.has_key(33));
+}
+
+TEST_F(PIRClientTest, TestCreateRequestRelinKeysCTMultiply) {
+  SetUpDB(84, 2, 0, true);
+  ASSIGN_OR_FAIL(auto request_proto, client_->CreateRequest({42}));
+  EXPECT_THAT(request_proto.relin_keys(), Not(IsEmpty()));
+
+  // A single dimension has nothing to multiply.
+  SetUpDB(84, 1, 0, true);
+  ASSIGN_OR_FAIL(request_proto, client_->CreateRequest({42}));
+  EXPECT_THAT(request_proto.relin_keys(), IsEmpty());
+}
+
 TEST_F(PIRClientTest, TestCreateRequestD2) {
   SetUpDB(84, 2);
   const size_t desired_index = 42;
@@ -105,7 +222,7 @@ TEST_F(PIRClientTest, TestCreateRequestD2) {
   Plaintext pt;
   ASSERT_EQ(request.size(), 1);
   EXPECT_THAT(request_proto.galois_keys(), Not(IsEmpty()));
-  EXPECT_THAT(request_proto.relin_keys(), Not(IsEmpty()));
+  EXPECT_THAT(request_proto.relin_keys(), IsEmpty());
 
   Decryptor()->decrypt(request[0], pt);
 
@@ -143,7 +260,7 @@ TEST_F(PIRClientTest, TestCreateRequestD3) {
   Plaintext pt;
   ASSERT_EQ(request.size(), 1);
   EXPECT_THAT(request_proto.galois_keys(), Not(IsEmpty()));
-  EXPECT_THAT(request_proto.relin_keys(), Not(IsEmpty()));
+  EXPECT_THAT(request_proto.relin_keys(), IsEmpty());
   Decryptor()->decrypt(request[0], pt);
 
   const size_t expected_row = 2;
@@ -181,7 +298,7 @@ TEST_F(PIRClientTest, TestCreateRequestMultiDimMultiCT1) {
                                                request_proto.query(0)));
   ASSERT_EQ(request.size(), 3);
   EXPECT_THAT(request_proto.galois_keys(), Not(IsEmpty()));
-  EXPECT_THAT(request_proto.relin_keys(), Not(IsEmpty()));
+  EXPECT_THAT(request_proto.relin_keys(), IsEmpty());
 
   const size_t expected_row = 2760;
   const size_t expected_col = 2959;
@@ -231,7 +348,7 @@ TEST_F(PIRClientTest, TestCreateRequestMultiDimMultiCT2) {
                                                request_proto.query(0)));
   ASSERT_EQ(request.size(), 3);
   EXPECT_THAT(request_proto.galois_keys(), Not(IsEmpty()));
-  EXPECT_THAT(request_proto.relin_keys(), Not(IsEmpty()));
+  EXPECT_THAT(request_proto.relin_keys(), IsEmpty());
 
   const size_t expected_row = 2760;
   const size_t expected_col = 3959;
@@ -352,7 +469,8 @@ class ProcessResponseTest
       public testing::WithParamInterface<tuple<
           size_t, size_t, size_t, size_t, vector<size_t>, vector<size_t>>> {
  protected:
-  void SetUpForCTMultiply(bool use_ciphertext_multiplication) {
+  void SetUpForCTMultiply(bool use_ciphertext_multiplication,
+                          size_t num_threads = 1) {
     const auto dbsize = get<0>(GetParam());
     d_ = get<1>(GetParam());
     elem_size_ = get<2>(GetParam());
@@ -361,7 +479,8 @@ class ProcessResponseTest
     result_offsets_ = get<5>(GetParam());
     ASSERT_EQ(desired_indices_.size(), result_offsets_.size());
 
-    SetUpDB(dbsize, d_, elem_size_, use_ciphertext_multiplication);
+    SetUpDB(dbsize, d_, elem_size_, use_ciphertext_multiplication,
+            num_threads);
 
     prng_ = seal::UniformRandomGeneratorFactory::DefaultFactory()->create({99});
 
@@ -453,6 +572,55 @@ TEST_P(ProcessResponseTest, TestProcessResponseCTMultiply) {
   }
 }
 
+TEST_P(ProcessResponseTest, TestProcessResponseThreaded) {
+  for (const bool use_ciphertext_multiplication : {false, true}) {
+    SetUpForCTMultiply(use_ciphertext_multiplication, 3);
+    // Enough replies for every thread to process several, reusing its
+    // buffers.
+    vector<size_t> indices;
+    vector<size_t> offsets;
+    for (size_t r = 0; r < 4; ++r) {
+      indices.insert(indices.end(), desired_indices_.begin(),
+                     desired_indices_.end());
+      offsets.insert(offsets.end(), result_offsets_.begin(),
+                     result_offsets_.end());
+    }
+    vector<string> values(indices.size(), string(pt_size_, 0));
+    for (size_t i = 0; i < values.size(); ++i) {
+      prng_->generate(values[i].size(),
+                      reinterpret_cast<seal::SEAL_BYTE*>(values[i].data()));
+    }
+
+    StringEncoder encoder(Context()->SEALContext());
+    Response response;
+    for (auto& value : values) {
+      Plaintext pt;
+      encoder.encode(value, pt);
+      Ciphertext ct;
+      Encryptor()->encrypt(pt, ct);
+      if (use_ciphertext_multiplication) {
+        SaveCiphertexts({ct}, response.add_reply());
+      } else {
+        SaveCiphertexts(DecompCT(ct), response.add_reply());
+      }
+    }
+
+    ASSIGN_OR_FAIL(auto result, client_->ProcessResponse(indices, response));
+    ASSERT_EQ(result.size(), values.size());
+    for (size_t i = 0; i < result.size(); ++i) {
+      EXPECT_EQ(result[i], values[i].substr(offsets[i], elem_size_))
+          << "i = " << i << ", ct mult = " << use_ciphertext_multiplication;
+    }
+  }
+}
+
+TEST_F(PIRClientTest, TestCreateZeroThreads) {
+  auto client_or = PIRClient::Create(
+      pir_params_, false, seal::Serialization::compr_mode_default, 0);
+  ASSERT_THAT(client_or.status().code(),
+              Eq(absl::StatusCode::kInvalidArgument));
+}
+
 TEST_P(ProcessResponseTest, TestProcessResponseInteger) {
   SetUpForCTMultiply(false);
   vector<int64_t> values(desired_indices_.size());
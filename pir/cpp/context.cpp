@@ -15,8 +15,11 @@
 //
 #include "pir/cpp/context.h"
 
+#include <algorithm>
+
 #include "pir/cpp/serialization.h"
 #include "pir/cpp/status_asserts.h"
+#include "pir/cpp/utils.h"
 #include "seal/seal.h"
 
 namespace pir {
@@ -26,27 +29,114 @@ using absl::InvalidArgumentError;
 using absl::StatusOr;
 using seal::EncryptionParameters;
 
-PIRContext::PIRContext(shared_ptr<PIRParameters> params,
-                       const EncryptionParameters& enc_params,
-                       shared_ptr<seal::SEALContext> context)
-    : parameters_(params), encryption_params_(enc_params), context_(context) {
-  encoder_ = std::make_shared<seal::IntegerEncoder>(this->context_);
-  evaluator_ = std::make_shared<seal::Evaluator>(context_);
+// Bits of modulus kept above the plaintext modulus and the noise of modulus
+// switching when choosing the level replies are switched to.
+constexpr int kModulusSwitchMarginBits = 8;
+
+SEALContextRegistry& SEALContextRegistry::Global() {
+  static auto* const registry = new SEALContextRegistry();
+  return *registry;
 }
 
-StatusOr<std::unique_ptr<PIRContext>> PIRContext::Create(
-    shared_ptr<PIRParameters> params) {
-  ASSIGN_OR_RETURN(auto enc_params, SEALDeserialize<EncryptionParameters>(
-                                        params->encryption_parameters()));
+StatusOr<shared_ptr<const SharedSEALContext>> SEALContextRegistry::Get(
+    const std::string& serialized_params) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = contexts_.find(serialized_params);
+  if (it != contexts_.end()) {
+    if (auto shared = it->second.lock()) return shared;
+  }
 
+  ASSIGN_OR_RETURN(auto enc_params,
+                   SEALDeserialize<EncryptionParameters>(serialized_params));
+  auto shared = std::make_shared<SharedSEALContext>();
   try {
-    auto context = seal::SEALContext::Create(enc_params);
-    return absl::WrapUnique(new PIRContext(params, enc_params, context));
+    shared->encryption_params = enc_params;
+    shared->context = seal::SEALContext::Create(enc_params);
+    shared->encoder = std::make_shared<seal::IntegerEncoder>(shared->context);
+    shared->evaluator = std::make_shared<seal::Evaluator>(shared->context);
   } catch (const std::exception& e) {
     return InvalidArgumentError(e.what());
   }
 
-  return InternalError("this should never happen");
+  // Rounding to a smaller modulus adds noise of about sqrt(N) times the
+  // plaintext modulus, plus a margin for the noise the reply already has.
+  const int min_bit_count =
+      enc_params.plain_modulus().bit_count() +
+      (ceil_log2(enc_params.poly_modulus_degree()) + 1) / 2 +
+      kModulusSwitchMarginBits;
+  auto context_data = shared->context->first_context_data();
+  shared->last_usable_parms_id = context_data->parms_id();
+  while ((context_data = context_data->next_context_data()) != nullptr &&
+         context_data->total_coeff_modulus_bit_count() >= min_bit_count) {
+    shared->last_usable_parms_id = context_data->parms_id();
+  }
+
+  // Entries of contexts no one holds anymore are dropped as new ones come.
+  for (auto entry = contexts_.begin(); entry != contexts_.end();) {
+    entry = entry->second.expired() ? contexts_.erase(entry) : ++entry;
+  }
+  contexts_[serialized_params] = shared;
+  return shared;
+}
+
+size_t SEALContextRegistry::size() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  size_t count = 0;
+  for (const auto& entry : contexts_) {
+    if (!entry.second.expired()) ++count;
+  }
+  return count;
+}
+
+PIRContext::PIRContext(shared_ptr<PIRParameters> params,
+                       shared_ptr<const SharedSEALContext> shared)
+    : parameters_(params),
+      shared_(std::move(shared)),
+      context_(shared_->context),
+      evaluator_(shared_->evaluator),
+      encoder_(shared_->encoder) {}
+
+WorkerContext PIRContext::DefaultWorkerContext() {
+  return {evaluator_, seal::MemoryManager::GetPool()};
+}
+
+WorkerContext PIRContext::CreateWorkerContext() {
+  return {std::make_shared<seal::Evaluator>(context_),
+          seal::MemoryPoolHandle::New()};
+}
+
+std::pair<size_t, size_t> PIRContext::ShardRows() {
+  const size_t rows = Params()->dimensions_size() > 0 ? Params()->dimensions(0)
+                                                      : 0;
+  const size_t num_shards = std::max<size_t>(Params()->num_shards(), 1);
+  const size_t shard = Params()->shard_index();
+  return {shard * rows / num_shards, (shard + 1) * rows / num_shards};
+}
+
+std::pair<size_t, size_t> PIRContext::ShardPlaintexts() {
+  size_t row_size = 1;
+  for (int i = 1; i < Params()->dimensions_size(); ++i) {
+    row_size *= Params()->dimensions(i);
+  }
+  const auto rows = ShardRows();
+  const size_t num_pt = Params()->num_pt();
+  return {std::min<size_t>(rows.first * row_size, num_pt),
+          std::min<size_t>(rows.second * row_size, num_pt)};
+}
+
+StatusOr<std::unique_ptr<PIRContext>> PIRContext::Create(
+    shared_ptr<PIRParameters> params, SEALContextRegistry& registry) {
+  const size_t num_shards = std::max<size_t>(params->num_shards(), 1);
+  if (params->shard_index() >= num_shards ||
+      (num_shards > 1 && (params->dimensions_size() == 0 ||
+                          num_shards > params->dimensions(0)))) {
+    return InvalidArgumentError("Invalid shard " +
+                                std::to_string(params->shard_index()) +
+                                " of " + std::to_string(num_shards));
+  }
+  ASSIGN_OR_RETURN(auto shared,
+                   registry.Get(params->encryption_parameters()));
+  return absl::WrapUnique(new PIRContext(params, std::move(shared)));
 }
 
 }  // namespace pir
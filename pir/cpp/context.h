@@ -17,6 +17,12 @@
 #ifndef PIR_CONTEXT_H_
 #define PIR_CONTEXT_H_
 
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
 #include "absl/status/statusor.h"
 #include "pir/cpp/parameters.h"
 #include "seal/seal.h"
@@ -32,19 +38,98 @@ using ::std::vector;
 
 using seal::EncryptionParameters;
 
+/**
+ * Evaluator and memory pool used by a single thread of execution. Giving each
+ * worker thread its own keeps concurrent homomorphic operations from
+ * contending on the shared evaluator and the global memory pool.
+ */
+struct WorkerContext {
+  std::shared_ptr<seal::Evaluator> evaluator;
+  seal::MemoryPoolHandle pool;
+};
+
+/**
+ * SEAL objects that only depend on the encryption parameters, built once and
+ * shared by every PIRContext with the same parameters. None of them change
+ * once built: the evaluator and the encoder are safe to use from several
+ * threads, each with its own memory pool.
+ */
+struct SharedSEALContext {
+  EncryptionParameters encryption_params;
+  shared_ptr<seal::SEALContext> context;
+  shared_ptr<seal::Evaluator> evaluator;
+  shared_ptr<seal::IntegerEncoder> encoder;
+  // Last level of the modulus chain replies can be switched to.
+  seal::parms_id_type last_usable_parms_id;
+};
+
+/**
+ * Hands out the SEAL contexts of encryption parameters, keyed by their
+ * serialized bytes, so that clients, servers and databases with the same
+ * parameters share one context and its NTT tables instead of each building
+ * its own. Contexts are only held while in use: once the last PIRContext
+ * using one is gone, the next request for it builds it again. Thread safe.
+ */
+class SEALContextRegistry {
+ public:
+  /**
+   * The registry used by PIRContext::Create by default.
+   */
+  static SEALContextRegistry& Global();
+
+  SEALContextRegistry() = default;
+  SEALContextRegistry(const SEALContextRegistry&) = delete;
+  SEALContextRegistry& operator=(const SEALContextRegistry&) = delete;
+
+  /**
+   * Returns the context of the serialized encryption parameters, building it
+   * if no one holds it. Concurrent calls for the same parameters build it
+   * once.
+   * @param[in] serialized_params Encryption parameters serialized with
+   *    SEALSerialize, as in PIRParameters.
+   * @returns InvalidArgument if the parameters can't be deserialized or are
+   *    not valid
+   */
+  StatusOr<shared_ptr<const SharedSEALContext>> Get(
+      const std::string& serialized_params);
+
+  /**
+   * Number of contexts currently in use.
+   */
+  std::size_t size() const;
+
+ private:
+  mutable std::mutex mutex_;
+  std::unordered_map<std::string, std::weak_ptr<const SharedSEALContext>>
+      contexts_;
+};
+
 class PIRContext {
  public:
   /**
-   * Creates a new context
+   * Creates a new context, sharing the SEAL objects of its encryption
+   * parameters with the other contexts of the registry.
    * @param[in] params PIR parameters
+   * @param[in] registry Registry to get the SEAL context from.
    * @returns InvalidArgument if the SEAL parameter deserialization fails
    **/
   static StatusOr<std::unique_ptr<PIRContext>> Create(
-      shared_ptr<PIRParameters> /*params*/);
+      shared_ptr<PIRParameters> /*params*/,
+      SEALContextRegistry& registry = SEALContextRegistry::Global());
   /**
    * Returns an Evaluator instance.
    **/
   std::shared_ptr<seal::Evaluator>& Evaluator() { return evaluator_; }
+  /**
+   * Returns a worker context that uses the shared Evaluator and the default
+   * memory pool.
+   **/
+  WorkerContext DefaultWorkerContext();
+  /**
+   * Creates a worker context with a new Evaluator and its own memory pool,
+   * meant to be used by a single thread.
+   **/
+  WorkerContext CreateWorkerContext();
   /**
    * Returns the SEAL context.
    **/
@@ -60,10 +145,34 @@ class PIRContext {
     return std::accumulate(Params()->dimensions().begin(),
                            Params()->dimensions().end(), 0);
   }
+  /**
+   * Returns the parameters of reply ciphertexts, and of the ciphertexts passed
+   * between dimensions when using decomposition: the last usable level of the
+   * modulus chain when replies are modulus switched, and the first otherwise.
+   * A level is usable when its modulus leaves room above the plaintext
+   * modulus for the noise that switching to it adds.
+   **/
+  const seal::parms_id_type& ReplyParmsId() {
+    return Params()->modulus_switch_replies() ? shared_->last_usable_parms_id
+                                              : context_->first_parms_id();
+  }
+  /**
+   * Returns the rows [first, second) of the first dimension held by the shard
+   * the parameters describe, which are all of them for a database that isn't
+   * sharded.
+   **/
+  std::pair<size_t, size_t> ShardRows();
+  /**
+   * Returns the plaintexts [first, second) held by the shard the parameters
+   * describe, in the order of the whole database.
+   **/
+  std::pair<size_t, size_t> ShardPlaintexts();
   /**
    * Returns the encryption parameters used to create SEAL context.
    **/
-  const EncryptionParameters& EncryptionParams() { return encryption_params_; }
+  const EncryptionParameters& EncryptionParams() {
+    return shared_->encryption_params;
+  }
 
   /**
    * Returns the encoder
@@ -72,11 +181,11 @@ class PIRContext {
 
  private:
   PIRContext(shared_ptr<PIRParameters> /*params*/,
-             const EncryptionParameters& /*enc_params*/,
-             shared_ptr<seal::SEALContext> /*seal_context*/);
+             shared_ptr<const SharedSEALContext> /*shared*/);
 
   shared_ptr<PIRParameters> parameters_;
-  EncryptionParameters encryption_params_;
+  // Keeps the entry of the registry alive for as long as the context is.
+  const shared_ptr<const SharedSEALContext> shared_;
   shared_ptr<seal::SEALContext> context_;
   shared_ptr<seal::Evaluator> evaluator_;
   shared_ptr<seal::IntegerEncoder> encoder_;
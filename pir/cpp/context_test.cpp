@@ -0,0 +1,115 @@
+//
+// Copyright 2020 the authors listed in CONTRIBUTORS.md
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "pir/cpp/context.h"
+
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "pir/cpp/parameters.h"
+#include "pir/cpp/status_asserts.h"
+
+namespace pir {
+namespace {
+
+using std::shared_ptr;
+using std::unique_ptr;
+using std::vector;
+using ::testing::Eq;
+using ::testing::Ne;
+using ::testing::NotNull;
+
+TEST(SEALContextRegistryTest, SharesContextsOfTheSameParameters) {
+  SEALContextRegistry registry;
+  ASSIGN_OR_FAIL(auto params, CreatePIRParameters(100, 256, 1));
+  // Other PIR parameters with the same encryption parameters.
+  ASSIGN_OR_FAIL(auto other_params, CreatePIRParameters(1000, 64, 2));
+  ASSIGN_OR_FAIL(auto context, PIRContext::Create(params, registry));
+  ASSIGN_OR_FAIL(auto other, PIRContext::Create(other_params, registry));
+
+  EXPECT_THAT(context->SEALContext(), Eq(other->SEALContext()));
+  EXPECT_THAT(context->Evaluator(), Eq(other->Evaluator()));
+  EXPECT_THAT(context->Encoder(), Eq(other->Encoder()));
+  EXPECT_THAT(context->ReplyParmsId(), Eq(other->ReplyParmsId()));
+  EXPECT_THAT(context->DimensionsSum(), Ne(other->DimensionsSum()));
+  EXPECT_THAT(registry.size(), Eq(1));
+
+  // Each worker still gets an evaluator of its own.
+  EXPECT_THAT(context->CreateWorkerContext().evaluator,
+              Ne(context->Evaluator()));
+}
+
+TEST(SEALContextRegistryTest, SeparatesDifferentParameters) {
+  SEALContextRegistry registry;
+  ASSIGN_OR_FAIL(auto params,
+                 CreatePIRParameters(100, 256, 1,
+                                     GenerateEncryptionParams(4096, 20)));
+  ASSIGN_OR_FAIL(auto other_params,
+                 CreatePIRParameters(100, 256, 1,
+                                     GenerateEncryptionParams(8192, 20)));
+  ASSIGN_OR_FAIL(auto context, PIRContext::Create(params, registry));
+  ASSIGN_OR_FAIL(auto other, PIRContext::Create(other_params, registry));
+
+  EXPECT_THAT(context->SEALContext(), Ne(other->SEALContext()));
+  EXPECT_THAT(other->EncryptionParams().poly_modulus_degree(), Eq(8192));
+  EXPECT_THAT(registry.size(), Eq(2));
+}
+
+TEST(SEALContextRegistryTest, ReleasesUnusedContexts) {
+  SEALContextRegistry registry;
+  ASSIGN_OR_FAIL(auto params, CreatePIRParameters(100, 256, 1));
+  ASSIGN_OR_FAIL(auto context, PIRContext::Create(params, registry));
+  std::weak_ptr<seal::SEALContext> seal_context = context->SEALContext();
+  context.reset();
+  EXPECT_THAT(registry.size(), Eq(0));
+  EXPECT_TRUE(seal_context.expired());
+
+  ASSIGN_OR_FAIL(context, PIRContext::Create(params, registry));
+  EXPECT_THAT(context->SEALContext(), NotNull());
+  EXPECT_THAT(registry.size(), Eq(1));
+}
+
+TEST(SEALContextRegistryTest, ConcurrentCreation) {
+  SEALContextRegistry registry;
+  ASSIGN_OR_FAIL(auto params, CreatePIRParameters(100, 256, 1));
+  vector<unique_ptr<PIRContext>> contexts(4);
+  vector<std::thread> threads;
+  for (auto& context : contexts) {
+    threads.emplace_back([&] {
+      auto context_or = PIRContext::Create(params, registry);
+      if (context_or.ok()) context = *std::move(context_or);
+    });
+  }
+  for (auto& thread : threads) thread.join();
+
+  for (const auto& context : contexts) {
+    ASSERT_THAT(context, NotNull());
+    EXPECT_THAT(context->SEALContext(), Eq(contexts[0]->SEALContext()));
+  }
+}
+
+TEST(SEALContextRegistryTest, InvalidParameters) {
+  SEALContextRegistry registry;
+  EXPECT_THAT(registry.Get("not encryption parameters").status().code(),
+              Eq(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(registry.size(), Eq(0));
+}
+
+}  // namespace
+}  // namespace pir
@@ -20,8 +20,14 @@
 
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
+#include "pir/cpp/batch_client.h"
+#include "pir/cpp/batch_server.h"
 #include "pir/cpp/client.h"
+#include "pir/cpp/keyword_client.h"
+#include "pir/cpp/keyword_server.h"
+#include "pir/cpp/record_source.h"
 #include "pir/cpp/server.h"
+#include "pir/cpp/shard_combiner.h"
 #include "pir/cpp/status_asserts.h"
 #include "pir/cpp/test_base.h"
 #include "pir/cpp/utils.h"
@@ -92,6 +98,49 @@ TEST_P(PIRCorrectnessTest, TestCorrectness) {
   }
 }
 
+TEST_P(PIRCorrectnessTest, TestCorrectnessSeededQueries) {
+  ASSIGN_OR_FAIL(client_, PIRClient::Create(pir_params_, true));
+  const auto desired_indices = get<7>(GetParam());
+  ASSIGN_OR_FAIL(auto request, client_->CreateRequest(desired_indices));
+  ASSIGN_OR_FAIL(auto response, server_->ProcessRequest(request));
+  ASSIGN_OR_FAIL(auto results,
+                 client_->ProcessResponse(desired_indices, response));
+
+  ASSERT_EQ(results.size(), desired_indices.size());
+  for (size_t i = 0; i < results.size(); ++i) {
+    ASSERT_EQ(results[i], string_db_[desired_indices[i]]) << "i = " << i;
+  }
+}
+
+TEST_P(PIRCorrectnessTest, TestCorrectnessModulusSwitchedReplies) {
+  const auto desired_indices = get<7>(GetParam());
+  ASSIGN_OR_FAIL(auto request, client_->CreateRequest(desired_indices));
+  ASSIGN_OR_FAIL(auto full_response, server_->ProcessRequest(request));
+
+  pir_params_->set_modulus_switch_replies(true);
+  ASSIGN_OR_FAIL(client_, PIRClient::Create(pir_params_));
+  ASSIGN_OR_FAIL(server_, PIRServer::Create(pir_db_, pir_params_));
+  ASSIGN_OR_FAIL(request, client_->CreateRequest(desired_indices));
+  ASSIGN_OR_FAIL(auto response, server_->ProcessRequest(request));
+  ASSIGN_OR_FAIL(auto results,
+                 client_->ProcessResponse(desired_indices, response));
+
+  ASSERT_EQ(results.size(), desired_indices.size());
+  for (size_t i = 0; i < results.size(); ++i) {
+    ASSERT_EQ(results[i], string_db_[desired_indices[i]]) << "i = " << i;
+  }
+
+  auto context = server_->Context();
+  ASSIGN_OR_FAIL(auto reply_cts,
+                 LoadCiphertexts(context->SEALContext(), response.reply(0)));
+  for (const auto& ct : reply_cts) {
+    EXPECT_EQ(ct.parms_id(), context->ReplyParmsId());
+  }
+  if (context->ReplyParmsId() != context->SEALContext()->first_parms_id()) {
+    EXPECT_LT(response.ByteSizeLong(), full_response.ByteSizeLong());
+  }
+}
+
 INSTANTIATE_TEST_SUITE_P(
     CorrectnessTest, PIRCorrectnessTest,
     testing::Values(
@@ -107,10 +156,211 @@ INSTANTIATE_TEST_SUITE_P(
         make_tuple(false, 4096, 24, 0, 0, 10, 1, vector<size_t>({0})),
         make_tuple(false, 4096, 24, 0, 10, 9, 2, vector<size_t>({1, 5})),
         make_tuple(false, 4096, 24, 0, 6, 500, 2, vector<size_t>({9, 125})),
+        make_tuple(false, 4096, 16, 0, 10, 9, 2, vector<size_t>({1, 5})),
+        make_tuple(false, 4096, 16, 0, 6, 500, 2, vector<size_t>({9, 125})),
         make_tuple(false, 4096, 24, 64, 10, 1200, 1,
                    vector<size_t>({0, 80, 81, 123, 777, 1199})),
         make_tuple(false, 4096, 24, 289, 10, 1200, 1,
                    vector<size_t>({0, 47, 777, 1199}))));
 
+class PIRBatchCorrectnessTest
+    : public ::testing::TestWithParam<tuple<bool, uint32_t, size_t>> {};
+
+TEST_P(PIRBatchCorrectnessTest, TestCorrectness) {
+  const auto use_ciphertext_multiplication = get<0>(GetParam());
+  const auto dimensions = get<1>(GetParam());
+  const auto num_threads = get<2>(GetParam());
+  constexpr size_t kDBSize = 1000;
+  constexpr size_t kElemSize = 16;
+  const auto db = generate_test_db(kDBSize, kElemSize);
+  ASSIGN_OR_FAIL(auto params,
+                 CreateBatchPIRParameters(
+                     kDBSize, kElemSize, 8, dimensions,
+                     GenerateEncryptionParams(POLY_MODULUS_DEGREE, 16),
+                     use_ciphertext_multiplication));
+  ASSIGN_OR_FAIL(auto client, BatchPIRClient::Create(params, num_threads));
+  ASSIGN_OR_FAIL(auto server, BatchPIRServer::Create(VectorRecordSource(db),
+                                                     params, num_threads));
+
+  const vector<size_t> desired_indices = {3, 999, 17, 500, 17, 0, 421, 77, 3};
+  ASSIGN_OR_FAIL(auto request, client->CreateRequest(desired_indices));
+  ASSERT_EQ(request.query_size(), params->num_buckets());
+  ASSIGN_OR_FAIL(auto response, server->ProcessRequest(request));
+  ASSIGN_OR_FAIL(auto results,
+                 client->ProcessResponse(desired_indices, response));
+
+  ASSERT_EQ(results.size(), desired_indices.size());
+  for (size_t i = 0; i < results.size(); ++i) {
+    ASSERT_EQ(results[i], db[desired_indices[i]]) << "i = " << i;
+  }
+}
+
+TEST(PIRBatchTest, TestTooManyItems) {
+  ASSIGN_OR_FAIL(auto params, CreateBatchPIRParameters(100, 8, 2));
+  ASSIGN_OR_FAIL(auto client, BatchPIRClient::Create(params));
+  EXPECT_EQ(client->CreateRequest({1, 2, 3, 4}).status().code(),
+            absl::StatusCode::kInvalidArgument);
+}
+
+INSTANTIATE_TEST_SUITE_P(BatchCorrectnessTest, PIRBatchCorrectnessTest,
+                         testing::Values(make_tuple(false, 1, 1),
+                                         make_tuple(false, 2, 3),
+                                         make_tuple(true, 2, 1),
+                                         make_tuple(true, 2, 3)));
+
+class PIRKeywordCorrectnessTest
+    : public ::testing::TestWithParam<tuple<bool, uint32_t>> {};
+
+TEST_P(PIRKeywordCorrectnessTest, TestCorrectness) {
+  const auto use_ciphertext_multiplication = get<0>(GetParam());
+  const auto dimensions = get<1>(GetParam());
+  constexpr size_t kValueSize = 12;
+  const auto values = generate_test_db(500, kValueSize);
+  vector<string> keys;
+  vector<std::pair<string, string>> records;
+  for (size_t i = 0; i < values.size(); ++i) {
+    keys.push_back("key-" + std::to_string(i * 104729));
+    records.emplace_back(keys.back(), values[i]);
+  }
+  ASSIGN_OR_FAIL(auto params,
+                 CreateKeywordPIRParameters(
+                     keys, kValueSize, dimensions,
+                     GenerateEncryptionParams(POLY_MODULUS_DEGREE, 16),
+                     use_ciphertext_multiplication));
+  ASSIGN_OR_FAIL(auto client, KeywordPIRClient::Create(params));
+  ASSIGN_OR_FAIL(auto server, KeywordPIRServer::Create(records, params));
+
+  const vector<string> lookups = {keys[0], "missing", keys[499], keys[42]};
+  ASSIGN_OR_FAIL(auto request, client->CreateRequest(lookups));
+  ASSIGN_OR_FAIL(auto response, server->ProcessRequest(request));
+  ASSIGN_OR_FAIL(auto results, client->ProcessResponse(lookups, response));
+
+  ASSERT_EQ(results.size(), lookups.size());
+  EXPECT_THAT(results[0], Optional(Eq(values[0])));
+  EXPECT_EQ(results[1], std::nullopt);
+  EXPECT_THAT(results[2], Optional(Eq(values[499])));
+  EXPECT_THAT(results[3], Optional(Eq(values[42])));
+}
+
+INSTANTIATE_TEST_SUITE_P(KeywordCorrectnessTest, PIRKeywordCorrectnessTest,
+                         testing::Values(make_tuple(false, 1),
+                                         make_tuple(false, 2),
+                                         make_tuple(true, 2)));
+
+class PIRShardedCorrectnessTest
+    : public ::testing::TestWithParam<
+          tuple<bool, uint32_t, uint32_t, bool, vector<size_t>>>,
+      public PIRTestingBase {};
+
+TEST_P(PIRShardedCorrectnessTest, TestCorrectness) {
+  const auto use_ciphertext_multiplication = get<0>(GetParam());
+  const auto d = get<1>(GetParam());
+  const auto num_shards = get<2>(GetParam());
+  const auto modulus_switch_replies = get<3>(GetParam());
+  const auto desired_indices = get<4>(GetParam());
+  constexpr size_t kDBSize = 1200;
+  constexpr size_t kElemSize = 64;
+  string_db_ = generate_test_db(kDBSize, kElemSize);
+  ASSIGN_OR_FAIL(pir_params_,
+                 CreatePIRParameters(
+                     kDBSize, kElemSize, d,
+                     GenerateEncryptionParams(POLY_MODULUS_DEGREE, 16),
+                     use_ciphertext_multiplication, 0, num_shards));
+  pir_params_->set_modulus_switch_replies(modulus_switch_replies);
+
+  ASSIGN_OR_FAIL(auto client, PIRClient::Create(pir_params_));
+  ASSIGN_OR_FAIL(auto request, client->CreateRequest(desired_indices));
+
+  // Every shard is given the whole database and only encodes its rows.
+  vector<Response> partials;
+  for (size_t s = 0; s < num_shards; ++s) {
+    ASSIGN_OR_FAIL(auto shard_params, ShardParameters(*pir_params_, s));
+    ASSIGN_OR_FAIL(auto db, PIRDatabase::Create(string_db_, shard_params));
+    ASSIGN_OR_FAIL(auto server, PIRServer::Create(db, shard_params));
+    ASSIGN_OR_FAIL(auto partial, server->ProcessRequest(request));
+    partials.push_back(std::move(partial));
+  }
+  ASSIGN_OR_FAIL(auto combiner, ShardCombiner::Create(pir_params_));
+  EXPECT_EQ(combiner->Combine(absl::MakeConstSpan(partials).subspan(1))
+                .status()
+                .code(),
+            absl::StatusCode::kInvalidArgument);
+  ASSIGN_OR_FAIL(auto response, combiner->Combine(partials));
+  ASSIGN_OR_FAIL(auto results,
+                 client->ProcessResponse(desired_indices, response));
+
+  ASSERT_EQ(results.size(), desired_indices.size());
+  for (size_t i = 0; i < results.size(); ++i) {
+    ASSERT_EQ(results[i], string_db_[desired_indices[i]]) << "i = " << i;
+  }
+}
+
+INSTANTIATE_TEST_SUITE_P(
+    ShardedCorrectnessTest, PIRShardedCorrectnessTest,
+    testing::Values(
+        make_tuple(false, 1, 2, false, vector<size_t>({0, 600, 1199})),
+        make_tuple(false, 1, 5, true, vector<size_t>({0, 81, 777, 1199})),
+        make_tuple(false, 2, 3, false, vector<size_t>({0, 81, 777, 1199})),
+        make_tuple(false, 2, 3, true, vector<size_t>({5, 500, 1100})),
+        make_tuple(true, 2, 2, false, vector<size_t>({0, 81, 777, 1199}))));
+
+class PIRStreamingCorrectnessTest
+    : public ::testing::TestWithParam<tuple<bool, uint32_t, bool>>,
+      public PIRTestingBase {};
+
+TEST_P(PIRStreamingCorrectnessTest, TestCorrectness) {
+  const auto use_ciphertext_multiplication = get<0>(GetParam());
+  const auto d = get<1>(GetParam());
+  const auto modulus_switch_replies = get<2>(GetParam());
+  const vector<size_t> desired_indices = {0, 81, 777, 1199};
+  SetUpParams(1200, 64, d, POLY_MODULUS_DEGREE, 16, 0,
+              use_ciphertext_multiplication);
+  pir_params_->set_modulus_switch_replies(modulus_switch_replies);
+  GenerateDB();
+
+  ASSIGN_OR_FAIL(auto client, PIRClient::Create(pir_params_));
+  ASSIGN_OR_FAIL(auto server, PIRServer::Create(pir_db_, pir_params_));
+  ASSIGN_OR_FAIL(auto request, client->CreateRequest(desired_indices));
+
+  vector<unique_ptr<PIRClient::ReplyStream>> streams;
+  for (const auto index : desired_indices) {
+    ASSIGN_OR_FAIL(auto stream, client->BeginReply(index));
+    streams.push_back(std::move(stream));
+  }
+  size_t num_ciphertexts = 0;
+  ASSERT_OK(server->ProcessRequestStreaming(
+      request, [&](size_t query, size_t count, string ct) {
+        EXPECT_EQ(count, streams[query]->num_ciphertexts());
+        ++num_ciphertexts;
+        return streams[query]->Add(ct);
+      }));
+  EXPECT_EQ(num_ciphertexts,
+            desired_indices.size() * streams[0]->num_ciphertexts());
+
+  for (size_t i = 0; i < desired_indices.size(); ++i) {
+    ASSIGN_OR_FAIL(auto result, streams[i]->Finish());
+    ASSERT_EQ(result, string_db_[desired_indices[i]]) << "i = " << i;
+  }
+}
+
+TEST_P(PIRStreamingCorrectnessTest, TestIncompleteReply) {
+  SetUpParams(1200, 64, get<1>(GetParam()), POLY_MODULUS_DEGREE, 16, 0,
+              get<0>(GetParam()));
+  GenerateDB();
+  ASSIGN_OR_FAIL(auto client, PIRClient::Create(pir_params_));
+  ASSIGN_OR_FAIL(auto stream, client->BeginReply(5));
+  EXPECT_EQ(stream->Finish().status().code(),
+            absl::StatusCode::kFailedPrecondition);
+  EXPECT_EQ(client->BeginReply(1200).status().code(),
+            absl::StatusCode::kInvalidArgument);
+}
+
+INSTANTIATE_TEST_SUITE_P(StreamingCorrectnessTest, PIRStreamingCorrectnessTest,
+                         testing::Values(make_tuple(false, 1, false),
+                                         make_tuple(false, 2, false),
+                                         make_tuple(false, 2, true),
+                                         make_tuple(false, 1, true),
+                                         make_tuple(true, 2, false)));
+
 //}  // namespace
 }  // namespace pir
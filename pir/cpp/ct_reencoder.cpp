@@ -15,100 +15,305 @@
 //
 #include "pir/cpp/ct_reencoder.h"
 
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
 #include "pir/cpp/serialization.h"
 #include "pir/cpp/status_asserts.h"
 #include "seal/seal.h"
+#include "seal/util/ntt.h"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define PIR_CT_REENCODER_AVX2 1
+#include <immintrin.h>
+#endif
 
 namespace pir {
 
+namespace {
+
+// Writes digit[c] = (coeffs[c] >> shift) & mask.
+void split_portable(const uint64_t* coeffs, size_t count, uint32_t shift,
+                    uint64_t mask, uint64_t* digits) {
+  for (size_t c = 0; c < count; ++c) {
+    digits[c] = (coeffs[c] >> shift) & mask;
+  }
+}
+
+// Writes dest[c] = digits[c] + increment for the digits at or above
+// threshold, and digits[c] for the others. dest may be digits.
+void lift_portable(const uint64_t* digits, size_t count, uint64_t threshold,
+                   uint64_t increment, uint64_t* dest) {
+  for (size_t c = 0; c < count; ++c) {
+    dest[c] = digits[c] + (digits[c] >= threshold ? increment : 0);
+  }
+}
+
+// Adds digits[c] << shift to coeffs[c].
+void combine_portable(const uint64_t* digits, size_t count, uint32_t shift,
+                      uint64_t* coeffs) {
+  for (size_t c = 0; c < count; ++c) {
+    coeffs[c] += digits[c] << shift;
+  }
+}
+
+#ifdef PIR_CT_REENCODER_AVX2
+
+__attribute__((target("avx2"))) void split_avx2(const uint64_t* coeffs,
+                                                size_t count, uint32_t shift,
+                                                uint64_t mask,
+                                                uint64_t* digits) {
+  const __m128i shift_v = _mm_cvtsi32_si128(shift);
+  const __m256i mask_v = _mm256_set1_epi64x(mask);
+  size_t c = 0;
+  for (; c + 4 <= count; c += 4) {
+    const __m256i x =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(coeffs + c));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(digits + c),
+                        _mm256_and_si256(_mm256_srl_epi64(x, shift_v), mask_v));
+  }
+  split_portable(coeffs + c, count - c, shift, mask, digits + c);
+}
+
+// Digits are below the plaintext modulus, so below 2^63, and compare the
+// same as signed integers.
+__attribute__((target("avx2"))) void lift_avx2(const uint64_t* digits,
+                                               size_t count, uint64_t threshold,
+                                               uint64_t increment,
+                                               uint64_t* dest) {
+  const __m256i below_v = _mm256_set1_epi64x(threshold - 1);
+  const __m256i increment_v = _mm256_set1_epi64x(increment);
+  size_t c = 0;
+  for (; c + 4 <= count; c += 4) {
+    const __m256i x =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(digits + c));
+    const __m256i lifted = _mm256_and_si256(_mm256_cmpgt_epi64(x, below_v),
+                                            increment_v);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dest + c),
+                        _mm256_add_epi64(x, lifted));
+  }
+  lift_portable(digits + c, count - c, threshold, increment, dest + c);
+}
+
+__attribute__((target("avx2"))) void combine_avx2(const uint64_t* digits,
+                                                  size_t count, uint32_t shift,
+                                                  uint64_t* coeffs) {
+  const __m128i shift_v = _mm_cvtsi32_si128(shift);
+  size_t c = 0;
+  for (; c + 4 <= count; c += 4) {
+    const __m256i x =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(digits + c));
+    auto* y = reinterpret_cast<__m256i*>(coeffs + c);
+    const __m256i sum =
+        _mm256_add_epi64(_mm256_loadu_si256(y), _mm256_sll_epi64(x, shift_v));
+    _mm256_storeu_si256(y, sum);
+  }
+  combine_portable(digits + c, count - c, shift, coeffs + c);
+}
+
+#endif  // PIR_CT_REENCODER_AVX2
+
+void split(bool use_avx2, const uint64_t* coeffs, size_t count, uint32_t shift,
+           uint64_t mask, uint64_t* digits) {
+#ifdef PIR_CT_REENCODER_AVX2
+  if (use_avx2) return split_avx2(coeffs, count, shift, mask, digits);
+#endif
+  split_portable(coeffs, count, shift, mask, digits);
+}
+
+void lift(bool use_avx2, const uint64_t* digits, size_t count,
+          uint64_t threshold, uint64_t increment, uint64_t* dest) {
+#ifdef PIR_CT_REENCODER_AVX2
+  if (use_avx2) return lift_avx2(digits, count, threshold, increment, dest);
+#endif
+  lift_portable(digits, count, threshold, increment, dest);
+}
+
+void combine(bool use_avx2, const uint64_t* digits, size_t count,
+             uint32_t shift, uint64_t* coeffs) {
+#ifdef PIR_CT_REENCODER_AVX2
+  if (use_avx2) return combine_avx2(digits, count, shift, coeffs);
+#endif
+  combine_portable(digits, count, shift, coeffs);
+}
+
+// Makes pt a plaintext of coeff_count coefficients in coefficient form,
+// keeping its memory when it already has enough.
+void reset(Plaintext& pt, size_t coeff_count) {
+  pt.parms_id() = seal::parms_id_zero;
+  pt.resize(coeff_count);
+}
+
+}  // namespace
+
+CiphertextReencoder::CiphertextReencoder(
+    shared_ptr<SEALContext> context,
+    shared_ptr<const SEALContext::ContextData> context_data, bool allow_simd)
+    : context_(context),
+      context_data_(std::move(context_data)),
+      first_context_data_(context->first_context_data()) {
+  const auto& params = context_data_->parms();
+  coeff_count_ = params.poly_modulus_degree();
+  plain_modulus_ = params.plain_modulus().value();
+  pt_bits_per_coeff_ = log2(plain_modulus_);
+  expansion_ratio_ = 0;
+  for (const auto& modulus : params.coeff_modulus()) {
+    const double coeff_bit_size = log2(modulus.value());
+    digits_per_modulus_.push_back(ceil(coeff_bit_size / pt_bits_per_coeff_));
+    expansion_ratio_ += digits_per_modulus_.back();
+  }
+#ifdef PIR_CT_REENCODER_AVX2
+  use_avx2_ = allow_simd && __builtin_cpu_supports("avx2");
+#endif
+}
+
+StatusOr<std::unique_ptr<CiphertextReencoder>> CiphertextReencoder::Create(
+    shared_ptr<SEALContext> context, bool allow_simd) {
+  return Create(context, context->first_parms_id(), allow_simd);
+}
+
 StatusOr<std::unique_ptr<CiphertextReencoder>> CiphertextReencoder::Create(
-    shared_ptr<SEALContext> context) {
-  return absl::WrapUnique(new CiphertextReencoder(context));
+    shared_ptr<SEALContext> context, const seal::parms_id_type& parms_id,
+    bool allow_simd) {
+  auto context_data = context->get_context_data(parms_id);
+  // The key level has no ciphertexts to decompose.
+  if (context_data == nullptr || parms_id == context->key_parms_id()) {
+    return absl::InvalidArgumentError(
+        "parms_id is not a ciphertext level of the context");
+  }
+  return absl::WrapUnique(
+      new CiphertextReencoder(context, std::move(context_data), allow_simd));
 }
 
-uint32_t CiphertextReencoder::ExpansionRatio() const {
-  uint32_t expansion_ratio = 0;
-  const auto params = context_->first_context_data()->parms();
-  uint32_t pt_bits_per_coeff = log2(params.plain_modulus().value());
-  for (size_t i = 0; i < params.coeff_modulus().size(); ++i) {
-    double coeff_bit_size = log2(params.coeff_modulus()[i].value());
-    expansion_ratio += ceil(coeff_bit_size / pt_bits_per_coeff);
+void CiphertextReencoder::check_parms_id(const Ciphertext& ct) const {
+  if (ct.parms_id() != parms_id()) {
+    throw std::invalid_argument("ct is not at the parameters of the reencoder");
   }
-  return expansion_ratio;
 }
 
-vector<Plaintext> CiphertextReencoder::Encode(const Ciphertext& ct) {
-  const auto params = context_->first_context_data()->parms();
-  const uint32_t pt_bits_per_coeff = log2(params.plain_modulus().value());
-  const auto coeff_count = params.poly_modulus_degree();
-  const auto coeff_mod_count = params.coeff_modulus().size();
-  const uint64_t pt_bitmask = (1 << pt_bits_per_coeff) - 1;
+vector<Plaintext> CiphertextReencoder::Encode(const Ciphertext& ct) const {
+  vector<Plaintext> result;
+  Encode(ct, result);
+  return result;
+}
 
-  vector<Plaintext> result(ExpansionRatio() * ct.size());
-  auto pt_iter = result.begin();
+void CiphertextReencoder::Encode(const Ciphertext& ct,
+                                 vector<Plaintext>& destination) const {
+  check_parms_id(ct);
+  const uint64_t pt_bitmask = (uint64_t(1) << pt_bits_per_coeff_) - 1;
+  destination.resize(ExpansionRatio() * ct.size());
+  auto pt_iter = destination.begin();
   for (size_t poly_index = 0; poly_index < ct.size(); ++poly_index) {
-    for (size_t coeff_mod_index = 0; coeff_mod_index < coeff_mod_count;
-         ++coeff_mod_index) {
-      const double coeff_bit_size =
-          log2(params.coeff_modulus()[coeff_mod_index].value());
-      const size_t local_expansion_ratio =
-          ceil(coeff_bit_size / pt_bits_per_coeff);
-      size_t shift = 0;
-      for (size_t i = 0; i < local_expansion_ratio; ++i) {
-        pt_iter->resize(coeff_count);
-        for (size_t c = 0; c < coeff_count; ++c) {
-          (*pt_iter)[c] =
-              (ct.data(poly_index)[coeff_mod_index * coeff_count + c] >>
-               shift) &
-              pt_bitmask;
-        }
+    for (size_t coeff_mod_index = 0;
+         coeff_mod_index < digits_per_modulus_.size(); ++coeff_mod_index) {
+      const uint64_t* coeffs =
+          ct.data(poly_index) + coeff_mod_index * coeff_count_;
+      uint32_t shift = 0;
+      for (size_t i = 0; i < digits_per_modulus_[coeff_mod_index]; ++i) {
+        reset(*pt_iter, coeff_count_);
+        split(use_avx2_, coeffs, coeff_count_, shift, pt_bitmask,
+              pt_iter->data());
         ++pt_iter;
-        shift += pt_bits_per_coeff;
+        shift += pt_bits_per_coeff_;
       }
     }
   }
+}
+
+vector<Plaintext> CiphertextReencoder::EncodeNTT(
+    const Ciphertext& ct, seal::MemoryPoolHandle pool) const {
+  vector<Plaintext> result;
+  EncodeNTT(ct, result, pool);
   return result;
 }
 
-Ciphertext CiphertextReencoder::Decode(const vector<Plaintext>& pts) {
+void CiphertextReencoder::EncodeNTT(const Ciphertext& ct,
+                                    vector<Plaintext>& destination,
+                                    seal::MemoryPoolHandle pool,
+                                    Tracer* const tracer) const {
+  if (ct.is_ntt_form()) {
+    throw std::invalid_argument("ct cannot be in NTT form");
+  }
+  check_parms_id(ct);
+  ScopedPhase phase(tracer, Phase::kReencode);
+  // The digits of the limbs of ct are lifted to every limb of the first
+  // parameters, which may have more of them.
+  const auto ct_mod_count = digits_per_modulus_.size();
+  const auto& coeff_modulus = first_context_data_->parms().coeff_modulus();
+  const auto coeff_mod_count = coeff_modulus.size();
+  const uint64_t pt_bitmask = (uint64_t(1) << pt_bits_per_coeff_) - 1;
+  // Digits in the upper half of the plaintext modulus are lifted as negative
+  // values, as Evaluator::transform_to_ntt_inplace does.
+  const uint64_t plain_upper_half_threshold = (plain_modulus_ + 1) >> 1;
+  const auto* ntt_tables = first_context_data_->small_ntt_tables();
+
+  const size_t num_pts = ExpansionRatio() * ct.size();
+  TraceCount(tracer, Counter::kNTT, num_pts);
+  if (destination.size() > num_pts) destination.resize(num_pts);
+  while (destination.size() < num_pts) destination.emplace_back(pool);
+  auto pt_iter = destination.begin();
+  for (size_t poly_index = 0; poly_index < ct.size(); ++poly_index) {
+    for (size_t coeff_mod_index = 0; coeff_mod_index < ct_mod_count;
+         ++coeff_mod_index) {
+      const uint64_t* coeffs =
+          ct.data(poly_index) + coeff_mod_index * coeff_count_;
+      uint32_t shift = 0;
+      for (size_t i = 0; i < digits_per_modulus_[coeff_mod_index]; ++i) {
+        auto& pt = *pt_iter++;
+        reset(pt, coeff_count_ * coeff_mod_count);
+        uint64_t* digits = pt.data();
+        split(use_avx2_, coeffs, coeff_count_, shift, pt_bitmask, digits);
+        // Highest modulus first, so the digits at the start of the plaintext
+        // are only overwritten once all the other moduli have been lifted.
+        for (size_t m = coeff_mod_count; m-- > 0;) {
+          uint64_t* dest = pt.data() + m * coeff_count_;
+          lift(use_avx2_, digits, coeff_count_, plain_upper_half_threshold,
+               coeff_modulus[m].value() - plain_modulus_, dest);
+          seal::util::ntt_negacyclic_harvey(dest, ntt_tables[m]);
+        }
+        pt.parms_id() = first_context_data_->parms_id();
+        shift += pt_bits_per_coeff_;
+      }
+    }
+  }
+}
+
+Ciphertext CiphertextReencoder::Decode(const vector<Plaintext>& pts) const {
   return Decode(pts.begin(), pts.size() / ExpansionRatio());
 }
 
 Ciphertext CiphertextReencoder::Decode(
-    vector<Plaintext>::const_iterator pt_iter, const size_t ct_poly_count) {
-  const auto params = context_->first_context_data()->parms();
-  const uint32_t pt_bits_per_coeff = log2(params.plain_modulus().value());
-  const auto coeff_count = params.poly_modulus_degree();
-  const auto coeff_mod_count = params.coeff_modulus().size();
-  // size_t pt_count = 0;
-  // TODO: should check here if numbers match
-
+    vector<Plaintext>::const_iterator pt_iter,
+    const size_t ct_poly_count) const {
   Ciphertext ct(context_);
-  ct.resize(ct_poly_count);
+  Decode(pt_iter, ct_poly_count, ct);
+  return ct;
+}
+
+void CiphertextReencoder::Decode(vector<Plaintext>::const_iterator pt_iter,
+                                 const size_t ct_poly_count,
+                                 Ciphertext& destination) const {
+  // TODO: should check here if numbers match
+  destination.resize(context_, context_data_->parms_id(), ct_poly_count);
+  destination.is_ntt_form() = false;
   for (size_t poly_index = 0; poly_index < ct_poly_count; ++poly_index) {
-    for (size_t coeff_mod_index = 0; coeff_mod_index < coeff_mod_count;
-         ++coeff_mod_index) {
-      const double coeff_bit_size =
-          log2(params.coeff_modulus()[coeff_mod_index].value());
-      const size_t local_expansion_ratio =
-          ceil(coeff_bit_size / pt_bits_per_coeff);
-      size_t shift = 0;
-      for (size_t i = 0; i < local_expansion_ratio; ++i) {
-        for (size_t c = 0; c < pt_iter->coeff_count(); ++c) {
-          if (shift == 0) {
-            ct.data(poly_index)[coeff_mod_index * coeff_count + c] =
-                (*pt_iter)[c];
-          } else {
-            ct.data(poly_index)[coeff_mod_index * coeff_count + c] +=
-                ((*pt_iter)[c] << shift);
-          }
-        }
+    for (size_t coeff_mod_index = 0;
+         coeff_mod_index < digits_per_modulus_.size(); ++coeff_mod_index) {
+      uint64_t* coeffs =
+          destination.data(poly_index) + coeff_mod_index * coeff_count_;
+      // Decrypted digits may have fewer coefficients than the polynomial;
+      // the missing ones are zero.
+      std::fill_n(coeffs, coeff_count_, 0);
+      uint32_t shift = 0;
+      for (size_t i = 0; i < digits_per_modulus_[coeff_mod_index]; ++i) {
+        combine(use_avx2_, pt_iter->data(),
+                std::min(pt_iter->coeff_count(), coeff_count_), shift, coeffs);
         ++pt_iter;
-        shift += pt_bits_per_coeff;
+        shift += pt_bits_per_coeff_;
       }
     }
   }
-  return ct;
 }
 
 }  // namespace pir
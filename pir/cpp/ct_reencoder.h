@@ -17,7 +17,12 @@
 #ifndef PIR_CT_REENCODER_H_
 #define PIR_CT_REENCODER_H_
 
+#include <cstdint>
+#include <memory>
+#include <vector>
+
 #include "absl/status/statusor.h"
+#include "pir/cpp/tracing.h"
 #include "seal/seal.h"
 
 namespace pir {
@@ -30,34 +35,149 @@ using seal::SEALContext;
 using ::std::shared_ptr;
 using ::std::vector;
 
+/**
+ * Decomposes ciphertexts into plaintexts, splitting the coefficient of each
+ * RNS limb into digits of as many bits as fit below the plaintext modulus, and
+ * recomposes them. The ciphertexts are at one level of the modulus chain,
+ * fixed when the reencoder is created along with the number of digits of each
+ * limb, so lower levels decompose into fewer plaintexts. On CPUs with AVX2,
+ * four coefficients are split and recombined at a time.
+ */
 class CiphertextReencoder {
  public:
+  /**
+   * Creates a reencoder for the first parameters of a context.
+   * @param[in] context SEAL context of the ciphertexts.
+   * @param[in] allow_simd If false, always use the portable implementation.
+   */
+  static StatusOr<std::unique_ptr<CiphertextReencoder>> Create(
+      shared_ptr<SEALContext> context, bool allow_simd = true);
+
+  /**
+   * Creates a reencoder for ciphertexts at the given parameters of a context.
+   * @param[in] context SEAL context of the ciphertexts.
+   * @param[in] parms_id Parameters of the ciphertexts to decompose and of
+   *    those recomposed.
+   * @param[in] allow_simd If false, always use the portable implementation.
+   * @returns InvalidArgument if parms_id isn't in the modulus chain of
+   *    context
+   */
   static StatusOr<std::unique_ptr<CiphertextReencoder>> Create(
-      shared_ptr<SEALContext> /*params*/);
+      shared_ptr<SEALContext> context, const seal::parms_id_type& parms_id,
+      bool allow_simd = true);
 
-  uint32_t ExpansionRatio() const;
+  /**
+   * Parameters of the ciphertexts the reencoder decomposes and recomposes.
+   */
+  const seal::parms_id_type& parms_id() const {
+    return context_data_->parms_id();
+  }
+
+  /**
+   * Returns true if the reencoder runs the AVX2 implementation.
+   */
+  bool uses_simd() const { return use_avx2_; }
+
+  /**
+   * Number of plaintexts each polynomial of a ciphertext is decomposed into.
+   */
+  uint32_t ExpansionRatio() const { return expansion_ratio_; }
 
   /**
    * Reencode a ciphertext as a set of plaintexts.
-   * @param[in] ct Ciphertext to reencode.
+   * @param[in] ct Ciphertext to reencode, at parms_id().
    * @returns Vector of plaintexts created by decomposing CT.
    */
-  vector<Plaintext> Encode(const Ciphertext& ct);
+  vector<Plaintext> Encode(const Ciphertext& ct) const;
+
+  /**
+   * Reencode a ciphertext as a set of plaintexts, written to the plaintexts of
+   * destination so that their memory is reused from one call to the next.
+   * @param[in] ct Ciphertext to reencode, at parms_id().
+   * @param[out] destination Resized to ExpansionRatio() * ct.size()
+   *    plaintexts created by decomposing CT.
+   */
+  void Encode(const Ciphertext& ct, vector<Plaintext>& destination) const;
+
+  /**
+   * Reencode a ciphertext as a set of plaintexts in NTT form, ready to be
+   * multiplied with ciphertexts in NTT form at the first parameters of the
+   * context, whatever the parameters of ct. Gives the same plaintexts as
+   * transforming the result of Encode with Evaluator::transform_to_ntt_inplace
+   * at the first parms_id, but writes the digits straight into full size
+   * plaintexts and uses the NTT tables looked up when the reencoder was
+   * created.
+   * @param[in] ct Ciphertext to reencode, at parms_id(). Must not be in NTT
+   *    form, since the decomposition works on the coefficients.
+   * @param[in] pool Memory pool used to allocate the plaintexts.
+   * @returns Vector of NTT form plaintexts created by decomposing CT.
+   */
+  vector<Plaintext> EncodeNTT(
+      const Ciphertext& ct,
+      seal::MemoryPoolHandle pool = seal::MemoryManager::GetPool()) const;
+
+  /**
+   * As EncodeNTT above, writing to the plaintexts of destination so that
+   * their memory is reused from one call to the next.
+   * @param[in] ct Ciphertext to reencode, at parms_id(). Must not be in NTT
+   *    form.
+   * @param[out] destination Resized to ExpansionRatio() * ct.size() NTT form
+   *    plaintexts created by decomposing CT.
+   * @param[in] pool Memory pool used to allocate plaintexts destination
+   *    doesn't have yet.
+   * @param[in] tracer If not nullptr, receives the time of the reencoding
+   *    and the number of NTT transforms of plaintexts.
+   */
+  void EncodeNTT(
+      const Ciphertext& ct, vector<Plaintext>& destination,
+      seal::MemoryPoolHandle pool = seal::MemoryManager::GetPool(),
+      Tracer* const tracer = nullptr) const;
 
   /**
    * Recompose a ciphertext from a set of plaintexts.
    * @param[in] pts Vector of plaintexts to decode.
    * @returns Ciphertext recomposed from plaintexts.
    */
-  Ciphertext Decode(const vector<Plaintext>& pts);
+  Ciphertext Decode(const vector<Plaintext>& pts) const;
 
   Ciphertext Decode(vector<Plaintext>::const_iterator pt_iter,
-                    const size_t ct_poly_count);
+                    const size_t ct_poly_count) const;
+
+  /**
+   * Recompose a ciphertext from a set of plaintexts into destination, reusing
+   * its memory.
+   * @param[in] pt_iter First of the ExpansionRatio() * ct_poly_count
+   *    plaintexts to decode.
+   * @param[in] ct_poly_count Number of polynomials of the ciphertext.
+   * @param[out] destination Ciphertext recomposed from plaintexts, at
+   *    parms_id().
+   */
+  void Decode(vector<Plaintext>::const_iterator pt_iter,
+              const size_t ct_poly_count, Ciphertext& destination) const;
 
  private:
-  CiphertextReencoder(shared_ptr<SEALContext> context) : context_(context) {}
+  CiphertextReencoder(
+      shared_ptr<SEALContext> context,
+      shared_ptr<const SEALContext::ContextData> context_data,
+      bool allow_simd);
+
+  // Throws invalid_argument if ct isn't at parms_id().
+  void check_parms_id(const Ciphertext& ct) const;
 
   shared_ptr<SEALContext> context_;
+  // Parameters of the ciphertexts.
+  shared_ptr<const SEALContext::ContextData> context_data_;
+  // Parameters NTT form plaintexts are encoded for.
+  shared_ptr<const SEALContext::ContextData> first_context_data_;
+
+  // Split of the coefficients, from the parameters of the ciphertexts.
+  std::size_t coeff_count_;
+  uint64_t plain_modulus_;
+  uint32_t pt_bits_per_coeff_;
+  // Number of digits of each coefficient modulus.
+  vector<std::size_t> digits_per_modulus_;
+  uint32_t expansion_ratio_;
+  bool use_avx2_ = false;
 };
 
 }  // namespace pir
@@ -17,6 +17,7 @@
 #include "pir/cpp/ct_reencoder.h"
 
 #include <memory>
+#include <stdexcept>
 
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
@@ -94,6 +95,176 @@ TEST_F(CiphertextReencoderTest, TestEncodeDecode) {
   EXPECT_EQ(result, value);
 }
 
+TEST_F(CiphertextReencoderTest, TestEncodeNTT) {
+  string value = GenerateSampleString();
+  Plaintext pt;
+  encoder_->encode(value, pt);
+  Ciphertext ct;
+  encryptor_->encrypt(pt, ct);
+
+  Evaluator eval(seal_context_);
+  auto expected = ct_reencoder_->Encode(ct);
+  for (auto& expected_pt : expected) {
+    eval.transform_to_ntt_inplace(expected_pt,
+                                  seal_context_->first_parms_id());
+  }
+  auto pt_decomp = ct_reencoder_->EncodeNTT(ct);
+  ASSERT_EQ(pt_decomp.size(), expected.size());
+  for (size_t i = 0; i < pt_decomp.size(); ++i) {
+    EXPECT_TRUE(pt_decomp[i].is_ntt_form()) << "i = " << i;
+    EXPECT_EQ(pt_decomp[i].parms_id(), expected[i].parms_id()) << "i = " << i;
+    EXPECT_EQ(pt_decomp[i], expected[i]) << "i = " << i;
+  }
+}
+
+TEST_F(CiphertextReencoderTest, TestEncodeNTTRejectsNTTForm) {
+  Plaintext pt(1);
+  pt[0] = 1;
+  Ciphertext ct;
+  encryptor_->encrypt(pt, ct);
+  Evaluator eval(seal_context_);
+  eval.transform_to_ntt_inplace(ct);
+  EXPECT_THROW(ct_reencoder_->EncodeNTT(ct), std::invalid_argument);
+}
+
+TEST_F(CiphertextReencoderTest, TestIntoBuffers) {
+  vector<Ciphertext> cts(2);
+  for (auto& ct : cts) {
+    Plaintext pt;
+    encoder_->encode(GenerateSampleString(), pt);
+    encryptor_->encrypt(pt, ct);
+  }
+
+  // Buffers holding the plaintexts of another ciphertext, in the other form,
+  // and a ciphertext in NTT form give the same results as fresh ones.
+  vector<Plaintext> pts;
+  vector<Plaintext> ntt_pts;
+  ct_reencoder_->EncodeNTT(cts[1], pts);
+  ct_reencoder_->Encode(cts[1], ntt_pts);
+  Ciphertext result_ct;
+  Evaluator eval(seal_context_);
+  eval.transform_to_ntt(cts[1], result_ct);
+  const size_t words = cts[0].poly_modulus_degree() *
+                       cts[0].coeff_modulus_size();
+  for (const auto& ct : cts) {
+    ct_reencoder_->Encode(ct, pts);
+    EXPECT_EQ(pts, ct_reencoder_->Encode(ct));
+    ct_reencoder_->EncodeNTT(ct, ntt_pts);
+    EXPECT_EQ(ntt_pts, ct_reencoder_->EncodeNTT(ct));
+
+    ct_reencoder_->Decode(pts.begin(), ct.size(), result_ct);
+    EXPECT_FALSE(result_ct.is_ntt_form());
+    ASSERT_EQ(result_ct.size(), ct.size());
+    for (size_t p = 0; p < ct.size(); ++p) {
+      const auto* data = result_ct.data(p);
+      EXPECT_THAT(vector<uint64_t>(data, data + words),
+                  ElementsAreArray(ct.data(p), words));
+    }
+  }
+}
+
+TEST_F(CiphertextReencoderTest, TestSimdMatchesPortable) {
+  ASSIGN_OR_FAIL(auto portable,
+                 CiphertextReencoder::Create(seal_context_, false));
+  EXPECT_FALSE(portable->uses_simd());
+  EXPECT_EQ(portable->ExpansionRatio(), ct_reencoder_->ExpansionRatio());
+
+  Plaintext pt;
+  encoder_->encode(GenerateSampleString(), pt);
+  Ciphertext ct;
+  encryptor_->encrypt(pt, ct);
+  const auto pts = ct_reencoder_->Encode(ct);
+  EXPECT_EQ(pts, portable->Encode(ct));
+  EXPECT_EQ(ct_reencoder_->EncodeNTT(ct), portable->EncodeNTT(ct));
+
+  // Decrypted digits, whose leading coefficients may be missing.
+  vector<Plaintext> decrypted(pts.size());
+  for (size_t i = 0; i < pts.size(); ++i) {
+    Ciphertext digit_ct;
+    encryptor_->encrypt(pts[i], digit_ct);
+    decryptor_->decrypt(digit_ct, decrypted[i]);
+  }
+  const auto expected = portable->Decode(decrypted);
+  const auto result = ct_reencoder_->Decode(decrypted);
+  const size_t words = ct.poly_modulus_degree() * ct.coeff_modulus_size();
+  for (size_t p = 0; p < ct.size(); ++p) {
+    EXPECT_THAT(vector<uint64_t>(result.data(p), result.data(p) + words),
+                ElementsAreArray(expected.data(p), words));
+  }
+}
+
+TEST_F(CiphertextReencoderTest, TestCreateAtLevel) {
+  ASSIGN_OR_FAIL(auto first,
+                 CiphertextReencoder::Create(seal_context_,
+                                             seal_context_->first_parms_id()));
+  EXPECT_EQ(first->parms_id(), ct_reencoder_->parms_id());
+  EXPECT_EQ(first->ExpansionRatio(), ct_reencoder_->ExpansionRatio());
+
+  ASSIGN_OR_FAIL(auto last,
+                 CiphertextReencoder::Create(seal_context_,
+                                             seal_context_->last_parms_id()));
+  EXPECT_EQ(last->parms_id(), seal_context_->last_parms_id());
+  EXPECT_LT(last->ExpansionRatio(), ct_reencoder_->ExpansionRatio());
+
+  EXPECT_THAT(CiphertextReencoder::Create(seal_context_,
+                                          seal_context_->key_parms_id())
+                  .status()
+                  .code(),
+              Eq(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(CiphertextReencoder::Create(seal_context_, seal::parms_id_zero)
+                  .status()
+                  .code(),
+              Eq(absl::StatusCode::kInvalidArgument));
+}
+
+TEST_F(CiphertextReencoderTest, TestLastLevel) {
+  ASSIGN_OR_FAIL(auto last,
+                 CiphertextReencoder::Create(seal_context_,
+                                             seal_context_->last_parms_id()));
+  string value = GenerateSampleString();
+  Plaintext pt;
+  encoder_->encode(value, pt);
+  Ciphertext ct;
+  encryptor_->encrypt(pt, ct);
+  EXPECT_THROW(last->Encode(ct), std::invalid_argument);
+
+  Evaluator eval(seal_context_);
+  eval.mod_switch_to_inplace(ct, seal_context_->last_parms_id());
+  const auto pt_decomp = last->Encode(ct);
+  ASSERT_EQ(pt_decomp.size(), ct.size() * last->ExpansionRatio());
+  const auto result_ct = last->Decode(pt_decomp);
+  EXPECT_EQ(result_ct.parms_id(), seal_context_->last_parms_id());
+  Plaintext result_pt;
+  decryptor_->decrypt(result_ct, result_pt);
+  EXPECT_EQ(result_pt, pt);
+
+  // Digits of a ciphertext at the last level are encoded for multiplication
+  // at the first.
+  auto expected = pt_decomp;
+  for (auto& expected_pt : expected) {
+    eval.transform_to_ntt_inplace(expected_pt,
+                                  seal_context_->first_parms_id());
+  }
+  EXPECT_EQ(last->EncodeNTT(ct), expected);
+
+  Plaintext one_pt(1);
+  one_pt[0] = 1;
+  Ciphertext one_ct;
+  encryptor_->encrypt(one_pt, one_ct);
+  eval.transform_to_ntt_inplace(one_ct);
+  vector<Plaintext> pts;
+  for (const auto& digit : last->EncodeNTT(ct)) {
+    Ciphertext digit_ct;
+    eval.multiply_plain(one_ct, digit, digit_ct);
+    eval.transform_from_ntt_inplace(digit_ct);
+    pts.emplace_back();
+    decryptor_->decrypt(digit_ct, pts.back());
+  }
+  decryptor_->decrypt(last->Decode(pts), result_pt);
+  ASSIGN_OR_FAIL(auto result, encoder_->decode(result_pt));
+  EXPECT_EQ(result, value);
+}
+
 TEST_F(CiphertextReencoderTest, TestRecursion) {
   string value = GenerateSampleString();
   Plaintext pt;
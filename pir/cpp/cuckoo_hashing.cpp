@@ -0,0 +1,186 @@
+//
+// Copyright 2020 the authors listed in CONTRIBUTORS.md
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#include "pir/cpp/cuckoo_hashing.h"
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <unordered_map>
+
+#include "pir/cpp/status_asserts.h"
+
+namespace pir {
+
+using absl::InvalidArgumentError;
+using std::size_t;
+using std::vector;
+
+namespace {
+
+// Number of items evicted while placing one item before giving up.
+constexpr size_t kMaxEvictions = 500;
+
+// Finalizer of SplitMix64, which spreads consecutive inputs over all bits.
+uint64_t mix(uint64_t x) {
+  x ^= x >> 30;
+  x *= 0xbf58476d1ce4e5b9ULL;
+  x ^= x >> 27;
+  x *= 0x94d049bb133111ebULL;
+  x ^= x >> 31;
+  return x;
+}
+
+}  // namespace
+
+BucketLayout::BucketLayout(size_t num_items, size_t num_buckets,
+                           size_t num_hashes, uint64_t seed)
+    : num_items_(num_items),
+      num_hashes_(num_hashes),
+      seed_(seed),
+      buckets_(num_buckets) {
+  // Items are added in increasing order, so every bucket ends up sorted.
+  vector<size_t> candidates(num_hashes_);
+  for (size_t item = 0; item < num_items_; ++item) {
+    for (size_t h = 0; h < num_hashes_; ++h) {
+      candidates[h] = candidate(item, h);
+    }
+    for (size_t h = 0; h < num_hashes_; ++h) {
+      // An item two hash functions map to the same bucket is stored once.
+      if (std::find(candidates.begin(), candidates.begin() + h,
+                    candidates[h]) == candidates.begin() + h) {
+        buckets_[candidates[h]].push_back(item);
+      }
+    }
+  }
+}
+
+StatusOr<BucketLayout> BucketLayout::Create(const BatchPIRParameters& params) {
+  if (params.num_buckets() == 0) {
+    return InvalidArgumentError("number of buckets must be positive");
+  }
+  if (params.num_hashes() == 0) {
+    return InvalidArgumentError("number of hashes must be positive");
+  }
+  return BucketLayout(params.num_items(), params.num_buckets(),
+                      params.num_hashes(), params.hash_seed());
+}
+
+size_t BucketLayout::max_bucket_size() const {
+  size_t result = 0;
+  for (const auto& bucket : buckets_) {
+    result = std::max(result, bucket.size());
+  }
+  return result;
+}
+
+size_t BucketLayout::candidate(size_t item, size_t hash) const {
+  return mix(seed_ ^ mix(item * num_hashes_ + hash)) % buckets_.size();
+}
+
+size_t BucketLayout::position(size_t item, size_t b) const {
+  const auto& items = buckets_[b];
+  return std::lower_bound(items.begin(), items.end(), item) - items.begin();
+}
+
+StatusOr<vector<size_t>> BucketLayout::Assign(
+    const vector<size_t>& items) const {
+  // Distinct items, in the order they first appear.
+  std::unordered_map<size_t, size_t> slots;
+  vector<size_t> distinct;
+  for (const auto item : items) {
+    if (item >= num_items_) {
+      return InvalidArgumentError("invalid index " + std::to_string(item));
+    }
+    if (slots.emplace(item, distinct.size()).second) {
+      distinct.push_back(item);
+    }
+  }
+  if (distinct.size() > buckets_.size()) {
+    return InvalidArgumentError(
+        "more distinct items than the " + std::to_string(buckets_.size()) +
+        " buckets");
+  }
+
+  // Index in distinct of the item placed in each bucket.
+  constexpr size_t kEmpty = static_cast<size_t>(-1);
+  vector<size_t> occupant(buckets_.size(), kEmpty);
+  vector<size_t> assigned(distinct.size());
+  // Seeded the same way every time, so the same items get the same buckets.
+  std::mt19937_64 prng(seed_);
+  for (size_t d = 0; d < distinct.size(); ++d) {
+    size_t current = d;
+    size_t evicted_from = kEmpty;
+    size_t evictions = 0;
+    while (current != kEmpty) {
+      size_t b = kEmpty;
+      for (size_t h = 0; h < num_hashes_ && b == kEmpty; ++h) {
+        const size_t c = candidate(distinct[current], h);
+        if (occupant[c] == kEmpty) b = c;
+      }
+      if (b == kEmpty) {
+        if (evictions++ == kMaxEvictions) {
+          return absl::ResourceExhaustedError(
+              "could not place the items in distinct buckets");
+        }
+        // Evict from a random candidate, moving on to the next one rather
+        // than straight back to the bucket the item was just evicted from.
+        const size_t h = prng() % num_hashes_;
+        b = candidate(distinct[current], h);
+        if (b == evicted_from) {
+          b = candidate(distinct[current], (h + 1) % num_hashes_);
+        }
+      }
+      std::swap(occupant[b], current);
+      assigned[occupant[b]] = b;
+      evicted_from = b;
+    }
+  }
+
+  vector<size_t> result;
+  result.reserve(items.size());
+  for (const auto item : items) {
+    result.push_back(assigned[slots[item]]);
+  }
+  return result;
+}
+
+StatusOr<std::shared_ptr<BatchPIRParameters>> CreateBatchPIRParameters(
+    size_t dbsize, size_t bytes_per_item, size_t batch_size,
+    size_t dimensions, EncryptionParameters enc_params,
+    bool use_ciphertext_multiplication, size_t bits_per_coeff,
+    size_t num_hashes) {
+  if (batch_size == 0) {
+    return InvalidArgumentError("batch size must be positive");
+  }
+  auto params = std::make_shared<BatchPIRParameters>();
+  params->set_num_items(dbsize);
+  // Cuckoo hashing with 3 hash functions places k items in 1.5k buckets with
+  // high probability.
+  params->set_num_buckets((3 * batch_size + 1) / 2);
+  params->set_num_hashes(num_hashes);
+  params->set_hash_seed(DEFAULT_HASH_SEED);
+
+  ASSIGN_OR_RETURN(auto layout, BucketLayout::Create(*params));
+  ASSIGN_OR_RETURN(
+      auto bucket_params,
+      CreatePIRParameters(std::max<size_t>(layout.max_bucket_size(), 1),
+                          bytes_per_item, dimensions, enc_params,
+                          use_ciphertext_multiplication, bits_per_coeff));
+  *params->mutable_bucket_parameters() = *bucket_params;
+  return params;
+}
+
+}  // namespace pir
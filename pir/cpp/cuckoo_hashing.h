@@ -0,0 +1,130 @@
+//
+// Copyright 2020 the authors listed in CONTRIBUTORS.md
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef PIR_CUCKOO_HASHING_H_
+#define PIR_CUCKOO_HASHING_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "absl/status/statusor.h"
+#include "pir/cpp/parameters.h"
+#include "pir/proto/payload.pb.h"
+
+namespace pir {
+
+using absl::StatusOr;
+
+// Number of hash functions, and so copies of each item, used by default.
+constexpr uint32_t DEFAULT_NUM_HASHES = 3;
+
+// Seed of the hash functions. The layout doesn't need to be secret, only the
+// same on both sides, so a fixed seed keeps it the same from run to run.
+constexpr uint64_t DEFAULT_HASH_SEED = 0x5eed;
+
+/**
+ * Layout of the buckets of batch PIR. Each item is stored in every bucket one
+ * of the hash functions maps it to, so that a client can fetch it from any of
+ * them without asking the server where it is. The client and the server both
+ * derive the layout from the batch parameters alone.
+ */
+class BucketLayout {
+ public:
+  /**
+   * Works out which items each bucket holds.
+   * @param[in] params Batch parameters. Only the number of items, buckets and
+   *    hashes and the seed are used.
+   * @returns InvalidArgument if there are no buckets or no hash functions
+   */
+  static StatusOr<BucketLayout> Create(const BatchPIRParameters& params);
+
+  std::size_t num_buckets() const { return buckets_.size(); }
+
+  /**
+   * Items of a bucket in increasing order. The position of an item in the
+   * database of the bucket is its index in this list.
+   */
+  const std::vector<uint32_t>& bucket(std::size_t b) const {
+    return buckets_[b];
+  }
+
+  /**
+   * Number of items in the largest bucket.
+   */
+  std::size_t max_bucket_size() const;
+
+  /**
+   * Bucket the given hash function maps an item to.
+   */
+  std::size_t candidate(std::size_t item, std::size_t hash) const;
+
+  /**
+   * Position of an item in the database of a bucket, which must be one of the
+   * item's candidates.
+   */
+  std::size_t position(std::size_t item, std::size_t b) const;
+
+  /**
+   * Cuckoo hashes items into distinct buckets, each one of the item's
+   * candidates. Repeated items share a bucket. The assignment only depends on
+   * the items and their order, so it can be worked out again when the
+   * response comes back.
+   * @param[in] items Indices of the items in the whole database.
+   * @returns The bucket of each item, InvalidArgument if an index is out of
+   *    range or there are more distinct items than buckets, or
+   *    ResourceExhausted if the items couldn't be placed
+   */
+  StatusOr<std::vector<std::size_t>> Assign(
+      const std::vector<std::size_t>& items) const;
+
+ private:
+  BucketLayout(std::size_t num_items, std::size_t num_buckets,
+               std::size_t num_hashes, uint64_t seed);
+
+  const std::size_t num_items_;
+  const std::size_t num_hashes_;
+  const uint64_t seed_;
+  std::vector<std::vector<uint32_t>> buckets_;
+};
+
+/**
+ * Helper function to create the parameters of batch PIR.
+ * @param[in] dbsize The number of individual items in the database.
+ * @param[in] bytes_per_item Size in bytes of each item in the database.
+ * @param[in] batch_size Number of items fetched by each request.
+ * @param[in] dimensions Number of dimensions of the bucket databases.
+ * @param[in] enc_params SEAL Encryption Parameters to be used.
+ * @param[in] use_ciphertext_multiplication Multiply selection vectors as
+ *    ciphertexts rather than decomposing them.
+ * @param[in] bits_per_coeff If non-zero, number of bits to encode per
+ *    plaintext coefficient in the bucket databases.
+ * @param[in] num_hashes Number of buckets each item is stored in.
+ * @returns InvalidArgument if batch_size or num_hashes is zero, or if the
+ *    parameters of the buckets can't be created
+ */
+StatusOr<std::shared_ptr<BatchPIRParameters>> CreateBatchPIRParameters(
+    std::size_t dbsize, std::size_t bytes_per_item, std::size_t batch_size,
+    std::size_t dimensions = 1,
+    EncryptionParameters enc_params = GenerateEncryptionParams(),
+    bool use_ciphertext_multiplication = false,
+    std::size_t bits_per_coeff = 0,
+    std::size_t num_hashes = DEFAULT_NUM_HASHES);
+
+}  // namespace pir
+
+#endif  // PIR_CUCKOO_HASHING_H_
@@ -0,0 +1,140 @@
+//
+// Copyright 2020 the authors listed in CONTRIBUTORS.md
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "pir/cpp/cuckoo_hashing.h"
+
+#include <algorithm>
+#include <set>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "pir/cpp/status_asserts.h"
+
+namespace pir {
+namespace {
+
+using std::size_t;
+using std::vector;
+using ::testing::Contains;
+using ::testing::Each;
+using ::testing::Eq;
+using ::testing::Ge;
+
+BatchPIRParameters MakeParams(size_t num_items, size_t num_buckets,
+                              size_t num_hashes = DEFAULT_NUM_HASHES) {
+  BatchPIRParameters params;
+  params.set_num_items(num_items);
+  params.set_num_buckets(num_buckets);
+  params.set_num_hashes(num_hashes);
+  params.set_hash_seed(1234);
+  return params;
+}
+
+TEST(BucketLayoutTest, ItemsAreInTheirCandidateBuckets) {
+  ASSIGN_OR_FAIL(auto layout, BucketLayout::Create(MakeParams(1000, 12)));
+  ASSERT_THAT(layout.num_buckets(), Eq(12));
+
+  size_t total = 0;
+  for (size_t b = 0; b < layout.num_buckets(); ++b) {
+    const auto& items = layout.bucket(b);
+    EXPECT_TRUE(std::is_sorted(items.begin(), items.end()));
+    EXPECT_THAT(layout.max_bucket_size(), Ge(items.size()));
+    total += items.size();
+  }
+  // Candidates that collide keep a single copy of the item.
+  EXPECT_THAT(total, Ge(1000));
+
+  for (size_t item = 0; item < 1000; ++item) {
+    for (size_t h = 0; h < DEFAULT_NUM_HASHES; ++h) {
+      const auto b = layout.candidate(item, h);
+      ASSERT_THAT(layout.bucket(b), Contains(item));
+      EXPECT_THAT(layout.bucket(b)[layout.position(item, b)], Eq(item));
+    }
+  }
+}
+
+TEST(BucketLayoutTest, SameParamsSameLayout) {
+  ASSIGN_OR_FAIL(auto a, BucketLayout::Create(MakeParams(100, 6)));
+  ASSIGN_OR_FAIL(auto b, BucketLayout::Create(MakeParams(100, 6)));
+  for (size_t i = 0; i < 6; ++i) {
+    EXPECT_THAT(a.bucket(i), Eq(b.bucket(i)));
+  }
+}
+
+TEST(BucketLayoutTest, CreateInvalid) {
+  EXPECT_THAT(BucketLayout::Create(MakeParams(100, 0)).status().code(),
+              Eq(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(BucketLayout::Create(MakeParams(100, 6, 0)).status().code(),
+              Eq(absl::StatusCode::kInvalidArgument));
+}
+
+TEST(BucketLayoutTest, AssignDistinctCandidates) {
+  ASSIGN_OR_FAIL(auto layout, BucketLayout::Create(MakeParams(10000, 96)));
+  vector<size_t> items;
+  for (size_t i = 0; i < 64; ++i) {
+    items.push_back(i * 151 % 10000);
+  }
+  ASSIGN_OR_FAIL(auto buckets, layout.Assign(items));
+  ASSERT_THAT(buckets.size(), Eq(items.size()));
+  EXPECT_THAT(std::set<size_t>(buckets.begin(), buckets.end()).size(),
+              Eq(items.size()));
+  for (size_t i = 0; i < items.size(); ++i) {
+    EXPECT_THAT(layout.bucket(buckets[i]), Contains(items[i]));
+  }
+
+  ASSIGN_OR_FAIL(auto again, layout.Assign(items));
+  EXPECT_THAT(again, Eq(buckets));
+}
+
+TEST(BucketLayoutTest, AssignRepeatedItems) {
+  ASSIGN_OR_FAIL(auto layout, BucketLayout::Create(MakeParams(100, 3)));
+  ASSIGN_OR_FAIL(auto buckets, layout.Assign({7, 7, 7, 7}));
+  ASSERT_THAT(buckets.size(), Eq(4));
+  EXPECT_THAT(buckets, Each(Eq(buckets[0])));
+}
+
+TEST(BucketLayoutTest, AssignInvalid) {
+  ASSIGN_OR_FAIL(auto layout, BucketLayout::Create(MakeParams(100, 3)));
+  EXPECT_THAT(layout.Assign({1, 100}).status().code(),
+              Eq(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(layout.Assign({1, 2, 3, 4}).status().code(),
+              Eq(absl::StatusCode::kInvalidArgument));
+}
+
+TEST(CreateBatchPIRParametersTest, BucketsHoldLargestBucket) {
+  ASSIGN_OR_FAIL(auto params, CreateBatchPIRParameters(1000, 16, 8));
+  EXPECT_THAT(params->num_items(), Eq(1000));
+  EXPECT_THAT(params->num_buckets(), Eq(12));
+  EXPECT_THAT(params->num_hashes(), Eq(DEFAULT_NUM_HASHES));
+  ASSIGN_OR_FAIL(auto layout, BucketLayout::Create(*params));
+  EXPECT_THAT(params->bucket_parameters().num_items(),
+              Eq(layout.max_bucket_size()));
+  EXPECT_THAT(params->bucket_parameters().bytes_per_item(), Eq(16));
+}
+
+TEST(CreateBatchPIRParametersTest, Invalid) {
+  EXPECT_THAT(CreateBatchPIRParameters(1000, 16, 0).status().code(),
+              Eq(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(CreateBatchPIRParameters(1000, 16, 8, 1,
+                                       GenerateEncryptionParams(), false, 0, 0)
+                  .status()
+                  .code(),
+              Eq(absl::StatusCode::kInvalidArgument));
+}
+
+}  // namespace
+}  // namespace pir
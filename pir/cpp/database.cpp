@@ -15,21 +15,26 @@
 //
 #include "pir/cpp/database.h"
 
-#include <iostream>
+#include <algorithm>
+#include <map>
 #include <memory>
 
+#include "absl/memory/memory.h"
+#include "absl/types/span.h"
+#include "pir/cpp/backend.h"
 #include "pir/cpp/ct_reencoder.h"
 #include "pir/cpp/status_asserts.h"
 #include "pir/cpp/string_encoder.h"
 #include "pir/cpp/utils.h"
 #include "seal/seal.h"
+#include "seal/util/ntt.h"
 
 namespace pir {
 
+using absl::FailedPreconditionError;
 using absl::InternalError;
 using absl::InvalidArgumentError;
 using absl::StatusOr;
-using google::protobuf::RepeatedField;
 using seal::Ciphertext;
 using seal::Evaluator;
 using seal::Plaintext;
@@ -37,26 +42,110 @@ using std::unique_ptr;
 using std::vector;
 
 StatusOr<shared_ptr<PIRDatabase>> PIRDatabase::Create(
-    shared_ptr<PIRParameters> params) {
+    shared_ptr<PIRParameters> params, size_t num_threads) {
+  if (num_threads == 0) {
+    return InvalidArgumentError("Number of threads must be at least 1");
+  }
   ASSIGN_OR_RETURN(auto context, PIRContext::Create(params));
-  return std::make_shared<PIRDatabase>(std::move(context));
+  return std::make_shared<PIRDatabase>(std::move(context), num_threads);
 }
 StatusOr<shared_ptr<PIRDatabase>> PIRDatabase::Create(
-    const vector<std::int64_t>& rawdb, shared_ptr<PIRParameters> params) {
-  ASSIGN_OR_RETURN(auto context, PIRContext::Create(params));
-  auto pir_db = std::make_shared<PIRDatabase>(std::move(context));
+    const vector<std::int64_t>& rawdb, shared_ptr<PIRParameters> params,
+    size_t num_threads) {
+  ASSIGN_OR_RETURN(auto pir_db, Create(params, num_threads));
   RETURN_IF_ERROR(pir_db->populate(rawdb));
   return std::move(pir_db);
 }
 
 StatusOr<shared_ptr<PIRDatabase>> PIRDatabase::Create(
-    const vector<string>& rawdb, shared_ptr<PIRParameters> params) {
-  ASSIGN_OR_RETURN(auto context, PIRContext::Create(params));
-  auto pir_db = std::make_shared<PIRDatabase>(std::move(context));
+    const vector<string>& rawdb, shared_ptr<PIRParameters> params,
+    size_t num_threads) {
+  ASSIGN_OR_RETURN(auto pir_db, Create(params, num_threads));
   RETURN_IF_ERROR(pir_db->populate(rawdb));
   return std::move(pir_db);
 }
 
+StatusOr<shared_ptr<PIRDatabase>> PIRDatabase::Create(
+    const RecordSource& source, shared_ptr<PIRParameters> params,
+    size_t num_threads) {
+  ASSIGN_OR_RETURN(auto pir_db, Create(params, num_threads));
+  RETURN_IF_ERROR(pir_db->populate(source));
+  return std::move(pir_db);
+}
+
+PIRDatabase::PIRDatabase(std::unique_ptr<PIRContext> context,
+                         size_t num_threads)
+    : db_(std::make_shared<MemoryPlaintextStore>()),
+      context_(std::move(context)) {
+  // The default backend is always built in.
+  backend_ = *CreateBackend("", context_->SEALContext());
+  if (num_threads > 1) {
+    thread_pool_ = std::make_unique<ThreadPool>(num_threads - 1);
+    for (size_t i = 0; i < thread_pool_->size(); ++i) {
+      workers_.push_back(context_->CreateWorkerContext());
+    }
+  }
+}
+
+PIRDatabase::~PIRDatabase() = default;
+
+Status PIRDatabase::set_backend(const std::string& name) {
+  ASSIGN_OR_RETURN(auto backend, CreateBackend(name, context_->SEALContext()));
+  std::atomic_store(&backend_,
+                    std::shared_ptr<const Backend>(std::move(backend)));
+  return absl::OkStatus();
+}
+
+StatusOr<shared_ptr<PIRDatabase>> PIRDatabase::Open(
+    const std::string& path, size_t num_threads, SnapshotAccess access) {
+  unique_ptr<PlaintextStore> store;
+  auto params_ptr = std::make_shared<PIRParameters>();
+  if (access == SnapshotAccess::kStreamed) {
+    ASSIGN_OR_RETURN(auto streamed, StreamedPlaintextStore::Open(path));
+    *params_ptr = streamed->params();
+    store = std::move(streamed);
+  } else {
+    ASSIGN_OR_RETURN(auto mapped, MappedPlaintextStore::Open(path));
+    *params_ptr = mapped->params();
+    store = std::move(mapped);
+  }
+  ASSIGN_OR_RETURN(auto pir_db, Create(std::move(params_ptr), num_threads));
+  const auto& params = *pir_db->context_->Params();
+  const auto shard = pir_db->context_->ShardPlaintexts();
+  if (store->size() != shard.second - shard.first) {
+    return InvalidArgumentError(
+        path + ": snapshot size " + std::to_string(store->size()) +
+        " does not match its parameters");
+  }
+  // The parms_id is a hash of the encryption parameters, so this also checks
+  // that the plaintexts were transformed with the same ones.
+  const auto& expected_parms_id =
+      params.use_ciphertext_multiplication()
+          ? seal::parms_id_zero
+          : pir_db->context_->SEALContext()->first_parms_id();
+  if (store->size() > 0 && store->parms_id(0) != expected_parms_id) {
+    return InvalidArgumentError(
+        path + ": snapshot plaintexts do not match its parameters");
+  }
+  pir_db->db_ = std::move(store);
+  // Save only writes databases of strings, so snapshots can be updated.
+  pir_db->holds_strings_ = true;
+  return std::move(pir_db);
+}
+
+Status PIRDatabase::Save(const std::string& path) const {
+  std::shared_ptr<const PlaintextStore> store;
+  {
+    std::lock_guard<std::mutex> lock(update_mutex_);
+    if (!holds_strings_) {
+      return FailedPreconditionError(
+          "Only a database populated with strings can be saved");
+    }
+    store = std::atomic_load(&db_);
+  }
+  return MappedPlaintextStore::Write(path, *context_->Params(), *store);
+}
+
 Status PIRDatabase::populate(const vector<std::int64_t>& rawdb) {
   if (rawdb.size() != context_->Params()->num_items()) {
     return InvalidArgumentError(
@@ -65,91 +154,352 @@ Status PIRDatabase::populate(const vector<std::int64_t>& rawdb) {
         std::to_string(context_->Params()->num_items()));
   }
 
-  auto evaluator = std::make_unique<seal::Evaluator>(context_->SEALContext());
-  db_.resize(rawdb.size());
-  for (size_t idx = 0; idx < rawdb.size(); ++idx) {
-    try {
-      context_->Encoder()->encode(rawdb[idx], db_[idx]);
-      if (!context_->Params()->use_ciphertext_multiplication()) {
-        evaluator->transform_to_ntt_inplace(
-            db_[idx], context_->SEALContext()->first_parms_id());
+  // Coefficients of negative values are just below the plain modulus.
+  const uint64_t max_coeff =
+      context_->EncryptionParams().plain_modulus().value() - 1;
+  int bits = 0;
+  while (bits < 64 && (max_coeff >> bits) != 0) ++bits;
+  const auto make_encoder = [&]() -> PlaintextEncoder {
+    auto encoder =
+        std::make_shared<seal::IntegerEncoder>(context_->SEALContext());
+    return [&rawdb, encoder](size_t i, Plaintext& pt) -> Status {
+      try {
+        encoder->encode(rawdb[i], pt);
+      } catch (std::exception& e) {
+        return InvalidArgumentError(e.what());
       }
-    } catch (std::exception& e) {
-      return InvalidArgumentError(e.what());
-    }
-  }
-  return absl::OkStatus();
+      return absl::OkStatus();
+    };
+  };
+  return populate_plaintexts(rawdb.size(), bits, /*holds_strings=*/false,
+                             make_encoder);
 }
 
 Status PIRDatabase::populate(const vector<string>& rawdb) {
-  if (rawdb.size() != context_->Params()->num_items()) {
+  return populate(VectorRecordSource(rawdb));
+}
+
+Status PIRDatabase::populate(const RecordSource& source) {
+  if (source.size() != context_->Params()->num_items()) {
     return InvalidArgumentError(
-        "Database size " + std::to_string(rawdb.size()) +
+        "Database size " + std::to_string(source.size()) +
         " does not match params value " +
         std::to_string(context_->Params()->num_items()));
   }
 
-  const auto items_per_pt = context_->Params()->items_per_plaintext();
-  db_.resize(context_->Params()->num_pt());
-  auto encoder = std::make_unique<StringEncoder>(context_->SEALContext());
-  auto evaluator = std::make_unique<seal::Evaluator>(context_->SEALContext());
+  const size_t items_per_pt = context_->Params()->items_per_plaintext();
+  StringEncoder encoder(context_->SEALContext());
   if (context_->Params()->bits_per_coeff() > 0) {
-    encoder->set_bits_per_coeff(context_->Params()->bits_per_coeff());
-  }
-  auto raw_it = rawdb.begin();
-  for (size_t i = 0; i < db_.size(); ++i) {
-    auto end_it = std::min(raw_it + items_per_pt, rawdb.end());
-    RETURN_IF_ERROR(encoder->encode(raw_it, end_it, db_[i]));
-    if (!context_->Params()->use_ciphertext_multiplication()) {
-      evaluator->transform_to_ntt_inplace(
-          db_[i], context_->SEALContext()->first_parms_id());
+    encoder.set_bits_per_coeff(context_->Params()->bits_per_coeff());
+  }
+  return populate_plaintexts(
+      context_->Params()->num_pt(), encoder.bits_per_coeff(),
+      /*holds_strings=*/true, [&]() -> PlaintextEncoder {
+        // Each thread encodes with its own copy, and reads the records of a
+        // plaintext into its own buffer when the source copies them.
+        auto scratch = std::make_shared<string>();
+        return [&source, items_per_pt, encoder, scratch](
+                   size_t i, Plaintext& pt) -> Status {
+          const size_t first = std::min(i * items_per_pt, source.size());
+          const size_t last = std::min(first + items_per_pt, source.size());
+          ASSIGN_OR_RETURN(auto records, source.Read(first, last, *scratch));
+          return encoder.encode(records, pt);
+        };
+      });
+}
+
+Status PIRDatabase::populate_plaintexts(
+    size_t n, int bits, bool holds_strings,
+    const std::function<PlaintextEncoder()>& make_encoder) {
+  const auto& params = *context_->Params();
+  const bool ntt = !params.use_ciphertext_multiplication();
+  // A shard only encodes its own plaintexts, stored from index 0.
+  const auto shard = context_->ShardPlaintexts();
+  const size_t first = std::min(shard.first, n);
+  n = std::min(shard.second, n) - first;
+  std::shared_ptr<PackedPlaintextStore> packed;
+  vector<Plaintext> db;
+  if (params.compact_storage()) {
+    packed = std::make_shared<PackedPlaintextStore>(context_->SEALContext(),
+                                                    n, bits, ntt);
+  } else {
+    db.resize(n);
+  }
+  RETURN_IF_ERROR(parallel_populate(
+      n, [&](size_t begin, size_t end, const WorkerContext& w) -> Status {
+        const auto encode = make_encoder();
+        Plaintext pt;
+        for (size_t i = begin; i < end; ++i) {
+          auto& dest = packed != nullptr ? pt : db[i];
+          RETURN_IF_ERROR(encode(first + i, dest));
+          if (packed != nullptr) {
+            RETURN_IF_ERROR(packed->set(i, dest));
+          } else if (ntt) {
+            w.evaluator->transform_to_ntt_inplace(
+                dest, context_->SEALContext()->first_parms_id(), w.pool);
+          }
+        }
+        return absl::OkStatus();
+      }));
+
+  std::shared_ptr<const PlaintextStore> store = packed;
+  if (packed == nullptr) {
+    store = std::make_shared<MemoryPlaintextStore>(std::move(db));
+  }
+  std::lock_guard<std::mutex> lock(update_mutex_);
+  std::atomic_store(&db_, std::move(store));
+  holds_strings_ = holds_strings;
+  return absl::OkStatus();
+}
+
+namespace {
+
+// Returns plaintext i of store in coefficient form. transform_to_ntt lifts
+// every coefficient from the plaintext modulus to each RNS limb, so a
+// plaintext in NTT form is recovered exactly from its first limb.
+Plaintext coefficient_form(const PlaintextStore& store, size_t i,
+                           const seal::SEALContext::ContextData& context_data,
+                           Plaintext& scratch) {
+  if (!store.is_ntt_form(i)) {
+    return store.plaintext(i, scratch);
+  }
+  const auto& parms = context_data.parms();
+  const size_t coeff_count = parms.poly_modulus_degree();
+  const uint64_t plain_modulus = parms.plain_modulus().value();
+  const uint64_t coeff_modulus = parms.coeff_modulus()[0].value();
+  Plaintext pt(coeff_count);
+  std::copy_n(store.plaintext(i, scratch).data(), coeff_count, pt.data());
+  seal::util::inverse_ntt_negacyclic_harvey(
+      pt.data(), context_data.small_ntt_tables()[0]);
+  for (size_t c = 0; c < coeff_count; ++c) {
+    // Coefficients in the upper half of the plaintext modulus were lifted by
+    // coeff_modulus - plain_modulus, which puts them above plain_modulus.
+    if (pt[c] >= plain_modulus) {
+      pt[c] -= coeff_modulus - plain_modulus;
     }
-    raw_it += items_per_pt;
   }
+  return pt;
+}
+
+}  // namespace
+
+Status PIRDatabase::Update(size_t index, const string& value) {
+  return ApplyUpdates({{index, value}});
+}
+
+Status PIRDatabase::ApplyUpdates(
+    const vector<std::pair<size_t, string>>& updates) {
+  const auto& params = *context_->Params();
+  const size_t items_per_pt = params.items_per_plaintext();
+  const size_t bytes_per_item = params.bytes_per_item();
+  const auto shard = context_->ShardPlaintexts();
+  // Updated values of each affected plaintext, by position in the plaintext.
+  std::map<size_t, std::map<size_t, const string*>> grouped;
+  for (const auto& update : updates) {
+    if (update.first >= params.num_items()) {
+      return InvalidArgumentError("Item index " + std::to_string(update.first) +
+                                  " is out of range");
+    }
+    if (update.first / items_per_pt < shard.first ||
+        update.first / items_per_pt >= shard.second) {
+      return InvalidArgumentError("Item index " + std::to_string(update.first) +
+                                  " is held by another shard");
+    }
+    if (update.second.size() != bytes_per_item) {
+      return InvalidArgumentError(
+          "Item " + std::to_string(update.first) + " size " +
+          std::to_string(update.second.size()) +
+          " does not match bytes per item " + std::to_string(bytes_per_item));
+    }
+    grouped[update.first / items_per_pt][update.first % items_per_pt] =
+        &update.second;
+  }
+  const vector<std::pair<size_t, std::map<size_t, const string*>>> groups(
+      grouped.begin(), grouped.end());
+
+  std::lock_guard<std::mutex> lock(update_mutex_);
+  if (!holds_strings_) {
+    return FailedPreconditionError(
+        "Only a database populated with strings can be updated");
+  }
+  const auto store = std::atomic_load(&db_);
+
+  const bool ntt = !params.use_ciphertext_multiplication();
+  const auto context_data = context_->SEALContext()->first_context_data();
+  vector<PatchedPlaintextStore::Patch> patches(groups.size());
+  RETURN_IF_ERROR(parallel_populate(
+      groups.size(),
+      [&](size_t begin, size_t end, const WorkerContext& w) -> Status {
+        StringEncoder encoder(context_->SEALContext());
+        if (params.bits_per_coeff() > 0) {
+          encoder.set_bits_per_coeff(params.bits_per_coeff());
+        }
+        Plaintext scratch;
+        for (size_t g = begin; g < end; ++g) {
+          const size_t pt_index = groups[g].first;
+          const auto& values = groups[g].second;
+          const size_t first = pt_index * items_per_pt;
+          const size_t count =
+              std::min<size_t>(items_per_pt, params.num_items() - first);
+
+          const auto old_pt = coefficient_form(*store, pt_index - shard.first,
+                                               *context_data, scratch);
+          vector<string> items(count);
+          for (size_t j = 0; j < count; ++j) {
+            const auto value = values.find(j);
+            if (value != values.end()) {
+              items[j] = *value->second;
+              continue;
+            }
+            ASSIGN_OR_RETURN(items[j], encoder.decode(old_pt, bytes_per_item,
+                                                      j * bytes_per_item));
+          }
+
+          auto pt = std::make_shared<Plaintext>();
+          RETURN_IF_ERROR(encoder.encode(items.begin(), items.end(), *pt));
+          if (ntt) {
+            w.evaluator->transform_to_ntt_inplace(
+                *pt, context_->SEALContext()->first_parms_id(), w.pool);
+          }
+          patches[g] = {pt_index - shard.first, std::move(pt)};
+        }
+        return absl::OkStatus();
+      }));
+  std::atomic_store(&db_, PatchedPlaintextStore::Create(store, patches));
   return absl::OkStatus();
 }
 
+Status PIRDatabase::parallel_populate(
+    size_t n,
+    const std::function<Status(size_t, size_t, const WorkerContext&)>& fn) {
+  const size_t num_chunks = std::max<size_t>(
+      1, std::min(n, thread_pool_ == nullptr ? 1 : thread_pool_->size() + 1));
+  vector<Status> statuses(num_chunks);
+  try {
+    parallel_for(num_chunks, context_->DefaultWorkerContext(),
+                 [&](size_t c, const WorkerContext& w) {
+                   statuses[c] = fn(c * n / num_chunks,
+                                    (c + 1) * n / num_chunks, w);
+                 });
+  } catch (std::exception& e) {
+    return InternalError(e.what());
+  }
+  for (const auto& status : statuses) {
+    RETURN_IF_ERROR(status);
+  }
+  return absl::OkStatus();
+}
+
+// Rows of the bottom dimension multiplied together when the database
+// plaintexts are expanded on the fly, about a megabyte of plaintexts at the
+// usual parameters.
+constexpr size_t kExpandedTileRows = 16;
+
 /**
  * Helper class to make the recursive multiplication operation on the
  * multi-dimensional representation of the database easier. Encapsulates all of
- * the variables needed to do the multiplication, and keeps track of the
- * database iterator to separate it from the database itself.
+ * the variables needed to do the multiplication. Database offsets are computed
+ * from the dimensions rather than tracked with a shared iterator, so
+ * multipliers for disjoint rows of the top dimension can run concurrently.
+ *
+ * A multiplier handles a batch of selection vectors at once: each database
+ * plaintext is multiplied against the selection ciphertexts of every query in
+ * the batch while it is in cache, so the database is scanned once per batch
+ * instead of once per query.
  */
 class DatabaseMultiplier {
  public:
+  // Results of a multiplication, one vector of ciphertexts per query.
+  using Results = vector<vector<Ciphertext>>;
+
   /**
    * Create a multiplier for the given scenario.
    * @param[in] database Database against which to multiply.
-   * @param[in] selection_vector multi-dimensional selection vector
-   * @param[in] evaluator Evaluator to use for homomorphic operations.
-   * @param[in] relin_keys If not nullptr, relinearization will be done after
-   *    every homomorphic multiplication.
-   * @param[in] decryptor If not nullptr, outputs to cout the noise budget
-   *    remaining after every homomorphic operation.
+   * @param[in] first_plaintext Index in the whole database of the first
+   *    plaintext of database, which only holds the rows of one shard when the
+   *    database is sharded. Offsets below are in the whole database.
+   * @param[in] selection_vectors multi-dimensional selection vector of each
+   *    query. Must already be in NTT form when ct_reencoder is given.
+   * @param[in] worker Evaluator and memory pool to use for homomorphic
+   *    operations.
+   * @param[in] ct_reencoder If not nullptr, ciphertexts coming up from lower
+   *    dimensions are decomposed into plaintexts instead of multiplied.
+   * @param[in] backend Backend whose dot product, if it has one, is used for
+   *    the bottom dimension when the database and selection vectors are in
+   *    NTT form.
+   * @param[in] relin_keys Empty, or the relinearization keys of each query.
+   *    Where not nullptr, relinearization will be done after every homomorphic
+   *    multiplication for that query.
+   * @param[in] tracer If not nullptr, receives the counts of homomorphic
+   *    operations, and every intermediate ciphertext if it observes them.
+   * @param[in] cancellation If not nullptr, the multiplication stops early,
+   *    with a meaningless result, once it is stopped.
    */
-  DatabaseMultiplier(const vector<Plaintext>& database,
-                     vector<Ciphertext>& selection_vector,
-                     shared_ptr<Evaluator> evaluator,
-                     unique_ptr<CiphertextReencoder> ct_reencoder,
+  DatabaseMultiplier(const PlaintextStore& database, size_t first_plaintext,
+                     const vector<vector<Ciphertext>*>& selection_vectors,
+                     const WorkerContext& worker,
+                     const CiphertextReencoder* const ct_reencoder,
+                     const Backend& backend,
                      std::shared_ptr<seal::SEALContext> seal_context,
-                     const seal::RelinKeys* const relin_keys,
-                     seal::Decryptor* const decryptor)
+                     const vector<const seal::RelinKeys*>& relin_keys,
+                     Tracer* const tracer,
+                     const Cancellation* const cancellation = nullptr)
       : database_(database),
-        selection_vector_(selection_vector),
-        evaluator_(evaluator),
-        ct_reencoder_(std::move(ct_reencoder)),
+        first_plaintext_(first_plaintext),
+        end_plaintext_(first_plaintext + database.size()),
+        selection_vectors_(selection_vectors),
+        evaluator_(worker.evaluator),
+        pool_(worker.pool),
+        ct_reencoder_(ct_reencoder),
+        backend_(backend),
         seal_context_(seal_context),
         exp_ratio_(ct_reencoder_ == nullptr ? 1
                                             : ct_reencoder_->ExpansionRatio()),
         relin_keys_(relin_keys),
-        decryptor_(decryptor) {}
+        tracer_(tracer),
+        observes_(tracer != nullptr && tracer->ObservesCiphertexts()),
+        cancellation_(cancellation) {}
+
+  /**
+   * Do the multiplication using the given dimension sizes, restricted to the
+   * rows [begin, end) of the first dimension. The result is a partial sum that
+   * may still be in NTT form: partial sums of disjoint row ranges are combined
+   * with add_partial before being transformed back.
+   * @param[in] dimensions Dimension sizes of the database.
+   * @param[in] begin First row of the first dimension to include.
+   * @param[in] end One past the last row of the first dimension to include.
+   * @returns Partial results, empty if none of the rows are in the database.
+   */
+  Results multiply_rows(absl::Span<const uint32_t> dimensions, size_t begin,
+                        size_t end) {
+    size_t row_size = 1;
+    for (const auto d : dimensions.subspan(1)) row_size *= d;
+    // The rows are read in order, in a single scan of the plaintexts they
+    // cover that is shared by every query of the batch.
+    const size_t scan_begin =
+        std::min(std::max(begin * row_size, first_plaintext_), end_plaintext_);
+    const size_t scan_end =
+        std::max(std::min(end * row_size, end_plaintext_), scan_begin);
+    scan_ = database_.scan(scan_begin - first_plaintext_,
+                           scan_end - first_plaintext_);
+    return multiply(dimensions, 0, 0, 0, begin, end);
+  }
 
   /**
-   * Do the multiplication using the given dimension sizes.
+   * Adds the partial results in other to result. Either may be empty.
    */
-  vector<Ciphertext> multiply(const RepeatedField<uint32_t>& dimensions) {
-    database_it_ = database_.begin();
-    return multiply(dimensions, selection_vector_.begin(), 0);
+  static void add_partial(Evaluator& evaluator, Results& result,
+                          Results& other) {
+    if (other.empty()) return;
+    if (result.empty()) {
+      result = std::move(other);
+      return;
+    }
+    for (size_t q = 0; q < result.size(); ++q) {
+      for (size_t j = 0; j < result[q].size(); ++j) {
+        evaluator.add_inplace(result[q][j], other[q][j]);
+      }
+    }
   }
 
  private:
@@ -158,142 +508,491 @@ class DatabaseMultiplier {
    * Calls itself to move down dimensions until you get to the bottom dimension.
    * Bottom dimension just does a dot product with the DB, and returns the
    * result. Upper levels then take those results, and dot product again with
-   * the selection vector, until you get back to the top. NB: Database iterator
-   * is kept at the class level so that we move through the database one element
-   * at a time.
+   * the selection vector, until you get back to the top.
    *
-   * @param[in] dimensions List of remaining demainsion sizes.
-   * @param[in] selection_vector_it Iterator into the start of the selection
-   *  vector for the current depth.
+   * @param[in] dimensions List of remaining dimension sizes.
+   * @param[in] selection_offset Index in the selection vectors of the start of
+   *    the current dimension.
+   * @param[in] database_offset Index in the database of the first plaintext
+   *    covered by this call.
    * @param[in] depth Current depth.
+   * @param[in] begin First row of the current dimension to include.
+   * @param[in] end One past the last row of the current dimension to include.
    */
-  vector<Ciphertext> multiply(const RepeatedField<uint32_t>& dimensions,
-                              vector<Ciphertext>::iterator selection_vector_it,
-                              size_t depth) {
+  Results multiply(absl::Span<const uint32_t> dimensions,
+                   size_t selection_offset, size_t database_offset,
+                   size_t depth, size_t begin, size_t end) {
     const size_t this_dimension = dimensions[0];
-    auto remaining_dimensions =
-        RepeatedField<uint32_t>(dimensions.begin() + 1, dimensions.end());
+    const auto remaining_dimensions = dimensions.subspan(1);
+    size_t row_size = 1;
+    for (const auto d : remaining_dimensions) row_size *= d;
+    const size_t num_queries = selection_vectors_.size();
 
-    string depth_string(depth, ' ');
+    Results result;
+    if (remaining_dimensions.empty() &&
+        multiply_base(selection_offset, database_offset, begin, end, result)) {
+      return result;
+    }
 
-    vector<Ciphertext> result;
     bool first_pass = true;
-    for (size_t i = 0; i < this_dimension; ++i) {
+    for (size_t i = begin; i < end; ++i) {
+      const size_t row_offset = database_offset + i * row_size;
       // make sure we don't go past end of DB
-      if (database_it_ == database_.end()) break;
-      vector<Ciphertext> temp_ct;
+      if (row_offset >= end_plaintext_) break;
+      // Rows of higher dimensions each recurse into a whole lower dimension,
+      // so checking before them bounds the work left once a request stops.
+      if (!remaining_dimensions.empty() && cancellation_ != nullptr &&
+          cancellation_->IsStopped()) {
+        break;
+      }
+      Results temp_ct(num_queries);
       if (remaining_dimensions.empty()) {
-        // base case: have to multiply against DB
-        temp_ct.resize(1);
-        if (ct_reencoder_ != nullptr &&
-            !(selection_vector_it + i)->is_ntt_form()) {
-          evaluator_->transform_to_ntt_inplace(*(selection_vector_it + i));
+        // base case: have to multiply against DB. Every query in the batch
+        // uses the plaintext before moving on to the next one.
+        const auto& pt =
+            scan_->plaintext(row_offset - first_plaintext_, scratch_);
+        for (size_t q = 0; q < num_queries; ++q) {
+          temp_ct[q].emplace_back(pool_);
+          evaluator_->multiply_plain(selection(q, selection_offset + i), pt,
+                                     temp_ct[q][0], pool_);
+          observe(depth, "base", temp_ct[q][0], i);
         }
-        evaluator_->multiply_plain(*(selection_vector_it + i),
-                                   *(database_it_++), temp_ct[0]);
-        print_noise(depth, "base", temp_ct[0], i);
+        TraceCount(tracer_, Counter::kMultiplyPlain, num_queries);
 
       } else {
         auto lower_result =
-            multiply(remaining_dimensions, selection_vector_it + this_dimension,
-                     depth + 1);
-        print_noise(depth, "recurse", lower_result[0], i);
-
-        if (ct_reencoder_ == nullptr) {
-          temp_ct.resize(1);
-          evaluator_->multiply(lower_result[0], *(selection_vector_it + i),
-                               temp_ct[0]);
-          print_noise(depth, "mult", temp_ct[0], i);
-
-          if (relin_keys_ != nullptr) {
-            evaluator_->relinearize_inplace(temp_ct[0], *relin_keys_);
-            print_noise(depth, "relin", temp_ct[0], i);
-          }
-
-        } else {
-          // TODO: check that all CT are size 2
-          temp_ct.resize(lower_result.size() * exp_ratio_ * 2);
-          auto temp_ct_it = temp_ct.begin();
-          for (const auto& ct : lower_result) {
-            auto pt_decomp = ct_reencoder_->Encode(ct);
-            size_t k = 0;
-            for (auto pt : pt_decomp) {
-              if (!(selection_vector_it + i)->is_ntt_form()) {
-                evaluator_->transform_to_ntt_inplace(
-                    *(selection_vector_it + i));
-              }
-              if (!pt.is_ntt_form()) {
-                evaluator_->transform_to_ntt_inplace(
-                    pt, seal_context_->first_parms_id());
-              }
-              evaluator_->multiply_plain(*(selection_vector_it + i), pt,
-                                         *temp_ct_it);
-              print_noise(depth, "mult", *temp_ct_it, k++);
-              ++temp_ct_it;
-            }
-          }
+            multiply(remaining_dimensions, selection_offset + this_dimension,
+                     row_offset, depth + 1, 0, remaining_dimensions[0]);
+        // A lower dimension stopped before its first row has no results,
+        // and the caller returns the status of the cancellation instead.
+        if (lower_result.empty()) break;
+        for (size_t q = 0; q < num_queries; ++q) {
+          finalize(lower_result[q]);
+          observe(depth, "recurse", lower_result[q][0], i);
+          multiply_lower(lower_result[q], selection(q, selection_offset + i),
+                         relin_keys(q), depth, i, temp_ct[q]);
         }
       }
 
       if (first_pass) {
-        result = temp_ct;
+        result = std::move(temp_ct);
         first_pass = false;
-        print_noise(depth, "first_pass", result[0], i);
+        for (const auto& r : result) observe(depth, "first_pass", r[0], i);
       } else {
-        for (size_t j = 0; j < result.size(); ++j) {
-          evaluator_->add_inplace(result[j], temp_ct[j]);
-          print_noise(depth, "result", result[j], i);
+        for (size_t q = 0; q < num_queries; ++q) {
+          for (size_t j = 0; j < result[q].size(); ++j) {
+            evaluator_->add_inplace(result[q][j], temp_ct[q][j]);
+            observe(depth, "result", result[q][j], i);
+          }
+        }
+      }
+    }
+    return result;
+  }
+
+  /**
+   * Base case of multiply for the rows [begin, end) of the bottom dimension,
+   * done with the lazy-reduction kernel in a single pass over the plaintexts
+   * and without temporary ciphertexts. Plaintexts of stores that expand them
+   * are expanded and multiplied a tile of rows at a time, so that only a
+   * tile of them is ever held in their full size.
+   * @returns false, leaving result untouched, if the kernel can't be used for
+   *    these rows: no kernel in the backend, a tracer observing ciphertexts,
+   *    or operands that
+   *    are not all in NTT form at the parameters of the database.
+   */
+  bool multiply_base(size_t selection_offset, size_t database_offset,
+                     size_t begin, size_t end, Results& result) {
+    if (!backend_.has_dot_product() || observes_) return false;
+    if (database_offset + begin >= end_plaintext_) return true;
+    end = std::min(end, end_plaintext_ - database_offset);
+    // Index in the store of the plaintext of row 0. For a shard this may wrap
+    // around, but adding the row of any plaintext the shard holds is exact.
+    const size_t store_offset = database_offset - first_plaintext_;
+
+    const auto& parms_id = database_.parms_id(store_offset + begin);
+    const auto& first = selection(0, selection_offset + begin);
+    const size_t coeff_count =
+        first.poly_modulus_degree() * first.coeff_modulus_size();
+    for (size_t i = begin; i < end; ++i) {
+      const auto pt = store_offset + i;
+      if (!database_.is_ntt_form(pt) || database_.parms_id(pt) != parms_id ||
+          database_.coeff_count(pt) != coeff_count) {
+        return false;
+      }
+    }
+
+    // One product per polynomial of every query's result.
+    vector<vector<const uint64_t*>> operands;
+    for (size_t q = 0; q < selection_vectors_.size(); ++q) {
+      const auto poly_count = selection(q, selection_offset + begin).size();
+      for (size_t p = 0; p < poly_count; ++p) {
+        operands.emplace_back();
+        operands.back().reserve(end - begin);
+        for (size_t i = begin; i < end; ++i) {
+          const auto& ct = selection(q, selection_offset + i);
+          if (!ct.is_ntt_form() || ct.parms_id() != parms_id ||
+              ct.size() != poly_count) {
+            return false;
+          }
+          operands.back().push_back(ct.data(p));
         }
       }
     }
 
+    result.resize(selection_vectors_.size());
+    vector<uint64_t*> outputs;
+    outputs.reserve(operands.size());
+    for (size_t q = 0; q < result.size(); ++q) {
+      const auto poly_count = selection(q, selection_offset + begin).size();
+      result[q].emplace_back(seal_context_, parms_id, poly_count, pool_);
+      auto& ct = result[q][0];
+      ct.resize(poly_count);
+      ct.is_ntt_form() = true;
+      for (size_t p = 0; p < poly_count; ++p) outputs.push_back(ct.data(p));
+    }
+
+    const bool expands = database_.expands();
+    const size_t tile_rows = expands ? kExpandedTileRows : end - begin;
+    if (expands) tile_.resize(tile_rows * coeff_count);
+    vector<const uint64_t*> plain;
+    vector<vector<const uint64_t*>> tile_operands(operands.size());
+    for (size_t tile = begin; tile < end; tile += tile_rows) {
+      const size_t tile_end = std::min(end, tile + tile_rows);
+      plain.clear();
+      for (size_t i = tile; i < tile_end; ++i) {
+        plain.push_back(scan_->data(
+            store_offset + i,
+            expands ? &tile_[(i - tile) * coeff_count] : nullptr));
+      }
+      for (size_t j = 0; j < operands.size(); ++j) {
+        tile_operands[j].assign(operands[j].begin() + (tile - begin),
+                                operands[j].begin() + (tile_end - begin));
+      }
+      backend_.dot_product(plain, tile_operands, outputs, tile != begin);
+    }
+    TraceCount(tracer_, Counter::kMultiplyPlain,
+               (end - begin) * selection_vectors_.size());
+    return true;
+  }
+
+  /**
+   * Multiplies the result of a lower dimension for one query with its
+   * selection ciphertext for the current row.
+   */
+  void multiply_lower(const vector<Ciphertext>& lower_result,
+                      const Ciphertext& selection,
+                      const seal::RelinKeys* const relin_keys, size_t depth,
+                      size_t i, vector<Ciphertext>& temp_ct) {
+    if (ct_reencoder_ == nullptr) {
+      temp_ct.emplace_back(pool_);
+      evaluator_->multiply(lower_result[0], selection, temp_ct[0], pool_);
+      TraceCount(tracer_, Counter::kMultiply);
+      observe(depth, "mult", temp_ct[0], i);
+
+      if (relin_keys != nullptr) {
+        evaluator_->relinearize_inplace(temp_ct[0], *relin_keys, pool_);
+        observe(depth, "relin", temp_ct[0], i);
+      }
+      return;
+    }
+
+    // TODO: check that all CT are size 2
+    temp_ct.resize(lower_result.size() * exp_ratio_ * 2);
+    auto temp_ct_it = temp_ct.begin();
+    for (const auto& ct : lower_result) {
+      // The lower result was only taken out of NTT form because the
+      // decomposition needs its coefficients; the digits go straight back.
+      size_t k = 0;
+      ct_reencoder_->EncodeNTT(ct, digits_, pool_, tracer_);
+      for (const auto& pt : digits_) {
+        evaluator_->multiply_plain(selection, pt, *temp_ct_it, pool_);
+        observe(depth, "mult", *temp_ct_it, k++);
+        ++temp_ct_it;
+      }
+      TraceCount(tracer_, Counter::kMultiplyPlain, digits_.size());
+    }
+  }
+
+  /**
+   * Transforms a result out of NTT form so it can be passed up a dimension,
+   * switching it to the parameters of the reencoder when they are lower.
+   */
+  void finalize(vector<Ciphertext>& result) {
     for (auto& ct : result) {
       if (ct.is_ntt_form()) {
         evaluator_->transform_from_ntt_inplace(ct);
+        TraceCount(tracer_, Counter::kNTT);
+      }
+      if (ct_reencoder_ != nullptr &&
+          ct.parms_id() != ct_reencoder_->parms_id()) {
+        evaluator_->mod_switch_to_inplace(ct, ct_reencoder_->parms_id(),
+                                          pool_);
       }
     }
+  }
 
-    print_noise(depth, "final", result[0]);
-    return result;
+  const Ciphertext& selection(size_t query, size_t index) const {
+    return (*selection_vectors_[query])[index];
   }
 
-  void print_noise(size_t depth, const string& desc, const Ciphertext& ct,
-                   std::optional<size_t> i_opt = {}) {
-    if (decryptor_ != nullptr) {
-      std::cout << string(depth, ' ');
-      if (i_opt) {
-        std::cout << "i = " << (*i_opt) << " ";
-      }
-      std::cout << desc << " noise budget "
-                << decryptor_->invariant_noise_budget(ct) << std::endl;
-    }
+  const seal::RelinKeys* relin_keys(size_t query) const {
+    return relin_keys_.empty() ? nullptr : relin_keys_[query];
   }
 
-  const vector<Plaintext>& database_;
-  vector<Ciphertext>& selection_vector_;
+  void observe(size_t depth, const string& desc, const Ciphertext& ct,
+               size_t i) {
+    if (observes_) tracer_->ObserveCiphertext(depth, desc, i, ct);
+  }
+
+  const PlaintextStore& database_;
+  const size_t first_plaintext_;
+  const size_t end_plaintext_;
+  // Scan of the plaintexts of the rows being multiplied.
+  unique_ptr<PlaintextStore::Scan> scan_;
+  // Holds the current plaintext when the store has to copy it.
+  Plaintext scratch_;
+  // Plaintexts of the current tile of rows, when the store expands them.
+  vector<uint64_t> tile_;
+  // Decomposition of the current lower result, reused from row to row.
+  vector<Plaintext> digits_;
+  const vector<vector<Ciphertext>*>& selection_vectors_;
   shared_ptr<Evaluator> evaluator_;
-  unique_ptr<CiphertextReencoder> ct_reencoder_;
+  seal::MemoryPoolHandle pool_;
+  const CiphertextReencoder* const ct_reencoder_;
+  const Backend& backend_;
   std::shared_ptr<seal::SEALContext> seal_context_;
   const size_t exp_ratio_;
 
   // If not null, relinearization keys are applied after each HE op
-  const seal::RelinKeys* const relin_keys_;
+  const vector<const seal::RelinKeys*>& relin_keys_;
 
-  // If not null, used to get invariant noise budget after each HE op
-  seal::Decryptor* const decryptor_;
+  // If not null, receives operation counts, and each intermediate ciphertext
+  // when observes_ is set.
+  Tracer* const tracer_;
+  const bool observes_;
 
-  // Current location as we move through the database.
-  // Needs to be kept here, as lower levels of recursion move forward.
-  vector<Plaintext>::const_iterator database_it_;
+  // If not null, checked before each row of the dimensions above the bottom
+  const Cancellation* const cancellation_;
 };
 
+void PIRDatabase::parallel_for(
+    size_t n, const WorkerContext& caller,
+    const std::function<void(size_t, const WorkerContext&)>& fn) const {
+  if (thread_pool_ == nullptr) {
+    for (size_t i = 0; i < n; ++i) fn(i, caller);
+    return;
+  }
+  thread_pool_->ParallelFor(n, [&](size_t i, size_t worker) {
+    fn(i, worker < workers_.size() ? workers_[worker] : caller);
+  });
+}
+
 StatusOr<vector<Ciphertext>> PIRDatabase::multiply(
     vector<Ciphertext>& selection_vector,
-    const seal::RelinKeys* const relin_keys,
-    seal::Decryptor* const decryptor) const {
+    const seal::RelinKeys* const relin_keys, Tracer* const tracer,
+    const WorkerContext* const worker,
+    const Cancellation* const cancellation) const {
+  vector<const seal::RelinKeys*> batch_relin_keys;
+  if (relin_keys != nullptr) batch_relin_keys.push_back(relin_keys);
+  ASSIGN_OR_RETURN(auto results, multiply_batch({&selection_vector},
+                                                batch_relin_keys, tracer,
+                                                worker, cancellation));
+  return std::move(results[0]);
+}
+
+StatusOr<vector<vector<Ciphertext>>> PIRDatabase::multiply_batch(
+    const vector<vector<Ciphertext>*>& selection_vectors,
+    const vector<const seal::RelinKeys*>& relin_keys,
+    Tracer* const tracer, const WorkerContext* const worker,
+    const Cancellation* const cancellation) const {
+  ScopedPhase phase(tracer, Phase::kMultiply);
   auto& dimensions = context_->Params()->dimensions();
   const size_t dim_sum = context_->DimensionsSum();
 
+  for (const auto* selection_vector : selection_vectors) {
+    if (selection_vector->size() != dim_sum) {
+      return InvalidArgumentError(
+          "Selection vector size does not match dimensions");
+    }
+  }
+  if (!relin_keys.empty() && relin_keys.size() != selection_vectors.size()) {
+    return InvalidArgumentError(
+        "Relinearization keys do not match selection vectors");
+  }
+  if (selection_vectors.empty()) {
+    return vector<vector<Ciphertext>>();
+  }
+
+  unique_ptr<CiphertextReencoder> ct_reencoder = nullptr;
+  if (!context_->Params()->use_ciphertext_multiplication()) {
+    ASSIGN_OR_RETURN(ct_reencoder,
+                     CiphertextReencoder::Create(context_->SEALContext(),
+                                                 context_->ReplyParmsId()));
+  }
+
+  // Updates swap in a new store rather than changing this one.
+  const auto store = std::atomic_load(&db_);
+  const auto backend = this->backend();
+  const auto caller = (worker != nullptr) ? *worker
+                                          : context_->DefaultWorkerContext();
+  // Split the rows of the first dimension held by this shard into one chunk
+  // per thread. Intermediate ciphertexts are only observed in order when they
+  // come from a single thread.
+  const auto shard_rows = context_->ShardRows();
+  const auto shard_plaintexts = context_->ShardPlaintexts();
+  const size_t num_rows = shard_rows.second - shard_rows.first;
+  const size_t num_chunks =
+      (thread_pool_ == nullptr ||
+       (tracer != nullptr && tracer->ObservesCiphertexts()))
+          ? 1
+          : std::max<size_t>(
+                1, std::min<size_t>(num_rows, thread_pool_->size() + 1));
+  try {
+    if (ct_reencoder != nullptr) {
+      // Every selection ciphertext is multiplied with NTT plaintexts. Doing
+      // the conversion up front keeps the selection vectors read only while
+      // the chunks share them.
+      parallel_for(selection_vectors.size() * dim_sum, caller,
+                   [&](size_t i, const WorkerContext& w) {
+                     auto& ct = (*selection_vectors[i / dim_sum])[i % dim_sum];
+                     if (!ct.is_ntt_form()) {
+                       w.evaluator->transform_to_ntt_inplace(ct);
+                       TraceCount(tracer, Counter::kNTT);
+                     }
+                   });
+    }
+
+    vector<DatabaseMultiplier::Results> partials(num_chunks);
+    parallel_for(num_chunks, caller, [&](size_t c, const WorkerContext& w) {
+      DatabaseMultiplier dbm(*store, shard_plaintexts.first, selection_vectors,
+                             w, ct_reencoder.get(), *backend,
+                             context_->SEALContext(), relin_keys, tracer,
+                             cancellation);
+      partials[c] = dbm.multiply_rows(
+          absl::MakeConstSpan(dimensions.data(), dimensions.size()),
+          shard_rows.first + c * num_rows / num_chunks,
+          shard_rows.first + (c + 1) * num_rows / num_chunks);
+    });
+    if (cancellation != nullptr) RETURN_IF_ERROR(cancellation->status());
+
+    // Pairwise tree reduction of the partial sums into partials[0].
+    for (size_t step = 1; step < num_chunks; step *= 2) {
+      parallel_for((num_chunks + 2 * step - 1) / (2 * step), caller,
+                   [&](size_t p, const WorkerContext& w) {
+                     const size_t c = p * 2 * step;
+                     if (c + step < num_chunks) {
+                       DatabaseMultiplier::add_partial(
+                           *w.evaluator, partials[c], partials[c + step]);
+                     }
+                   });
+    }
+
+    auto& results = partials[0];
+    if (results.empty()) {
+      results.resize(selection_vectors.size());
+    }
+    vector<Ciphertext*> cts;
+    for (auto& result : results) {
+      for (auto& ct : result) cts.push_back(&ct);
+    }
+    const auto& reply_parms_id = context_->ReplyParmsId();
+    parallel_for(cts.size(), caller, [&](size_t i, const WorkerContext& w) {
+      if (cts[i]->is_ntt_form()) {
+        w.evaluator->transform_from_ntt_inplace(*cts[i]);
+        TraceCount(tracer, Counter::kNTT);
+      }
+      if (cts[i]->parms_id() != reply_parms_id) {
+        w.evaluator->mod_switch_to_inplace(*cts[i], reply_parms_id, w.pool);
+      }
+    });
+    return std::move(results);
+  } catch (std::exception& e) {
+    return InternalError(e.what());
+  }
+}
+
+PIRDatabase::RowMultiplier::RowMultiplier(
+    const PIRDatabase* db, std::shared_ptr<const PlaintextStore> store,
+    std::shared_ptr<const Backend> backend,
+    vector<Ciphertext> selection_vector, const seal::RelinKeys* relin_keys,
+    WorkerContext worker, unique_ptr<CiphertextReencoder> ct_reencoder,
+    Tracer* tracer)
+    : db_(db),
+      store_(std::move(store)),
+      backend_(std::move(backend)),
+      selection_vector_(std::move(selection_vector)),
+      selection_vectors_({&selection_vector_}),
+      relin_keys_({relin_keys}),
+      worker_(std::move(worker)),
+      ct_reencoder_(std::move(ct_reencoder)),
+      tracer_(tracer) {}
+
+PIRDatabase::RowMultiplier::~RowMultiplier() = default;
+
+Status PIRDatabase::RowMultiplier::add_row(size_t row, Ciphertext& selection) {
+  auto& dimensions = db_->context_->Params()->dimensions();
+  if (row >= dimensions[0]) {
+    return InvalidArgumentError("Row " + std::to_string(row) +
+                                " is out of range");
+  }
+  const auto shard_rows = db_->context_->ShardRows();
+  if (row < shard_rows.first || row >= shard_rows.second) {
+    return absl::OkStatus();
+  }
+  ScopedPhase phase(tracer_, Phase::kMultiply);
+  try {
+    if (ct_reencoder_ != nullptr && !selection.is_ntt_form()) {
+      worker_.evaluator->transform_to_ntt_inplace(selection);
+      TraceCount(tracer_, Counter::kNTT);
+    }
+    // The multiplier reads the first dimension from the selection vector, so
+    // the row's ciphertext is lent to it for the duration of the call.
+    std::swap(selection_vector_[row], selection);
+    DatabaseMultiplier dbm(*store_, db_->context_->ShardPlaintexts().first,
+                           selection_vectors_, worker_, ct_reencoder_.get(),
+                           *backend_,
+                           db_->context_->SEALContext(), relin_keys_, tracer_);
+    auto partial = dbm.multiply_rows(
+        absl::MakeConstSpan(dimensions.data(), dimensions.size()), row,
+        row + 1);
+    std::swap(selection_vector_[row], selection);
+    DatabaseMultiplier::add_partial(*worker_.evaluator, result_, partial);
+  } catch (std::exception& e) {
+    return InternalError(e.what());
+  }
+  return absl::OkStatus();
+}
+
+StatusOr<vector<Ciphertext>> PIRDatabase::RowMultiplier::finish() {
+  if (result_.empty()) {
+    return vector<Ciphertext>();
+  }
+  ScopedPhase phase(tracer_, Phase::kMultiply);
+  try {
+    const auto& reply_parms_id = db_->context_->ReplyParmsId();
+    for (auto& ct : result_[0]) {
+      if (ct.is_ntt_form()) {
+        worker_.evaluator->transform_from_ntt_inplace(ct);
+        TraceCount(tracer_, Counter::kNTT);
+      }
+      if (ct.parms_id() != reply_parms_id) {
+        worker_.evaluator->mod_switch_to_inplace(ct, reply_parms_id,
+                                                 worker_.pool);
+      }
+    }
+  } catch (std::exception& e) {
+    return InternalError(e.what());
+  }
+  return std::move(result_[0]);
+}
+
+StatusOr<unique_ptr<PIRDatabase::RowMultiplier>> PIRDatabase::begin_multiply(
+    vector<Ciphertext> selection_vector,
+    const seal::RelinKeys* const relin_keys, const WorkerContext* const worker,
+    Tracer* const tracer) const {
+  auto& dimensions = context_->Params()->dimensions();
+  const size_t dim_sum = context_->DimensionsSum();
   if (selection_vector.size() != dim_sum) {
     return InvalidArgumentError(
         "Selection vector size does not match dimensions");
@@ -302,17 +1001,27 @@ StatusOr<vector<Ciphertext>> PIRDatabase::multiply(
   unique_ptr<CiphertextReencoder> ct_reencoder = nullptr;
   if (!context_->Params()->use_ciphertext_multiplication()) {
     ASSIGN_OR_RETURN(ct_reencoder,
-                     CiphertextReencoder::Create(context_->SEALContext()));
+                     CiphertextReencoder::Create(context_->SEALContext(),
+                                                 context_->ReplyParmsId()));
   }
 
+  const auto w = (worker != nullptr) ? *worker
+                                     : context_->DefaultWorkerContext();
   try {
-    DatabaseMultiplier dbm(db_, selection_vector, context_->Evaluator(),
-                           std::move(ct_reencoder), context_->SEALContext(),
-                           relin_keys, decryptor);
-    return dbm.multiply(dimensions);
+    if (ct_reencoder != nullptr) {
+      for (size_t i = dimensions[0]; i < dim_sum; ++i) {
+        if (!selection_vector[i].is_ntt_form()) {
+          w.evaluator->transform_to_ntt_inplace(selection_vector[i]);
+          TraceCount(tracer, Counter::kNTT);
+        }
+      }
+    }
   } catch (std::exception& e) {
     return InternalError(e.what());
   }
+  return absl::WrapUnique(new RowMultiplier(
+      this, std::atomic_load(&db_), backend(), std::move(selection_vector),
+      relin_keys, w, std::move(ct_reencoder), tracer));
 }
 
 vector<uint32_t> PIRDatabase::calculate_indices(uint32_t index) {
@@ -17,15 +17,27 @@
 #ifndef PIR_DATABASE_H_
 #define PIR_DATABASE_H_
 
+#include <functional>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "absl/status/statusor.h"
+#include "pir/cpp/cancellation.h"
 #include "pir/cpp/context.h"
+#include "pir/cpp/plaintext_store.h"
+#include "pir/cpp/record_source.h"
+#include "pir/cpp/thread_pool.h"
+#include "pir/cpp/tracing.h"
 #include "seal/seal.h"
 
 namespace pir {
 
+class Backend;
+class CiphertextReencoder;
+
 using absl::Status;
 using absl::StatusOr;
 using std::shared_ptr;
@@ -43,9 +55,11 @@ class PIRDatabase {
    * Creates and returns an empty PIR database with the params used to generate
    * a context.
    * @param[in] PIR parameters
+   * @param[in] num_threads Number of threads used to populate and multiply the
+   *    database, including the calling thread. Must be at least 1.
    **/
   static StatusOr<shared_ptr<PIRDatabase>> Create(
-      shared_ptr<PIRParameters> params);
+      shared_ptr<PIRParameters> params, size_t num_threads = 1);
 
   /**
    * Shortcut to create and return a new PIR database instance using a vector of
@@ -53,48 +67,266 @@ class PIRDatabase {
    *really used for testing, not intended for actual PIR use.
    * @param[in] db Vector of integers to encode into database of plaintexts
    * @param[in] PIR parameters
+   * @param[in] num_threads Number of threads used to populate and multiply the
+   *    database.
    **/
   static StatusOr<shared_ptr<PIRDatabase>> Create(
       const vector<std::int64_t>& /*database*/,
-      shared_ptr<PIRParameters> params);
+      shared_ptr<PIRParameters> params, size_t num_threads = 1);
 
   /**
    * Shortcut to create and return a new PIR database instance using the values
    *given. Values are packed into the database as per the parameters given.
    * @param[in] db Database to load
    * @param[in] PIR parameters
+   * @param[in] num_threads Number of threads used to populate and multiply the
+   *    database.
    **/
   static StatusOr<shared_ptr<PIRDatabase>> Create(
-      const vector<string>& /*database*/, shared_ptr<PIRParameters> params);
+      const vector<string>& /*database*/, shared_ptr<PIRParameters> params,
+      size_t num_threads = 1);
+
+  /**
+   * Shortcut to create and return a new PIR database instance populated from a
+   *source of records, such as a mapped file. See populate.
+   * @param[in] source Records to load
+   * @param[in] PIR parameters
+   * @param[in] num_threads Number of threads used to populate and multiply the
+   *    database.
+   **/
+  static StatusOr<shared_ptr<PIRDatabase>> Create(
+      const RecordSource& source, shared_ptr<PIRParameters> params,
+      size_t num_threads = 1);
+
+  /**
+   * How Open reads the plaintexts of a snapshot.
+   */
+  enum class SnapshotAccess {
+    // Mapped read only, for snapshots that fit in memory. See
+    // MappedPlaintextStore.
+    kMapped,
+    // Read from the file a tile at a time, ahead of the multiplication, for
+    // snapshots larger than memory. See StreamedPlaintextStore.
+    kStreamed,
+  };
+
+  /**
+   * Opens a database from a snapshot written by Save. The plaintexts are
+   * mapped or streamed rather than loaded, so opening takes constant time.
+   * Processes mapping the same snapshot share its memory.
+   * @param[in] path Path of the snapshot file.
+   * @param[in] num_threads Number of threads used to multiply the database.
+   * @param[in] access Whether to map or stream the plaintexts.
+   * @returns The database, NotFound if there is no such file, or
+   *    InvalidArgument if the file is not a valid snapshot for its parameters
+   **/
+  static StatusOr<shared_ptr<PIRDatabase>> Open(
+      const std::string& path, size_t num_threads = 1,
+      SnapshotAccess access = SnapshotAccess::kMapped);
+
+  /**
+   * Writes the plaintexts of the database, in the form they are multiplied
+   * in, and its parameters to a snapshot file that Open can map.
+   * Only databases populated with strings can be saved, since snapshots
+   * are updated as those are once opened.
+   * @param[in] path Path of the snapshot file, replaced if it exists.
+   * @returns Internal error if the file can't be written, or
+   *    FailedPrecondition if the database holds no strings
+   **/
+  Status Save(const std::string& path) const;
 
   /**
    * Populate the database plaintexts from a list of integers. Only really used
-   * for testing.
+   * for testing. Plaintexts are encoded on all the threads of the database.
    */
   Status populate(const vector<std::int64_t>& /*database*/);
 
   /**
    * Populate the database plaintexts from a list of strings. Items must match
    * the settings in the context or InvalidArgumentError will be returned.
+   * Plaintexts are encoded on all the threads of the database, each thread
+   * with its own encoder and evaluator.
    */
   Status populate(const vector<string>& /*database*/);
 
+  /**
+   * Populate the database plaintexts from a source of records, read one
+   * plaintext's worth at a time by each thread and encoded straight into the
+   * database, so the records are never all held in memory. Records must match
+   * the settings in the context, as for populate from strings.
+   * @param[in] source Records of the database, num_items of them.
+   * @returns InvalidArgument if the number of records doesn't match the
+   *    parameters, or the error of the source
+   */
+  Status populate(const RecordSource& source);
+
+  /**
+   * Replaces the value of one item, re-encoding only the plaintext that holds
+   * it. See ApplyUpdates.
+   * @param[in] index Index of the item in the database.
+   * @param[in] value New value of the item, bytes_per_item bytes long.
+   */
+  Status Update(size_t index, const string& value);
+
+  /**
+   * Replaces the values of a batch of items. Only the plaintexts holding them
+   * are decoded, re-encoded and transformed, on all the threads of the
+   * database, and they are swapped in together once all of them are ready.
+   * Multiplications already running keep the plaintexts they started with,
+   * so updates neither wait for queries nor block them. Updates are applied
+   * one batch at a time. Only databases of strings can be updated.
+   * @param[in] updates Index and new value of each item, bytes_per_item bytes
+   *    long. When an item appears more than once, the last value wins.
+   * @returns InvalidArgument if an index is out of range or a value has the
+   *    wrong size, or FailedPrecondition if the database holds no strings
+   */
+  Status ApplyUpdates(const vector<std::pair<size_t, string>>& updates);
+
   /**
    * Multiplies the database represented as a multi-dimensional hypercube with
    * a selection vector. Selection vector is split into sub vectors based on
-   * dimensions fetched from PIRParameters in the current context.
+   * dimensions fetched from PIRParameters in the current context. When the
+   * database has more than one thread, the rows of the first dimension are
+   * split between them and the partial results summed. A shard of a sharded
+   * database only multiplies its own rows, so its result is a partial sum.
    * @param[in] selection_vector Selection vector to multiply against
-   * @returns Ciphertext resulting from multiplication, or error
+   * @param[in] relin_keys If not nullptr, relinearization keys applied after
+   *    every ciphertext multiplication.
+   * @param[in] tracer If not nullptr, receives the time of the multiplication
+   *    and the reencoding and the counts of their homomorphic operations.
+   * @param[in] worker If not nullptr, evaluator and memory pool to use on the
+   *    calling thread instead of the ones shared by the database.
+   * @param[in] cancellation If not nullptr, checked before each row of the
+   *    dimensions above the bottom one, stopping the multiplication once the
+   *    request is cancelled or past its deadline.
+   * @returns Ciphertext resulting from multiplication, at
+   *    PIRContext::ReplyParmsId(), or error, Cancelled or DeadlineExceeded
+   *    if the multiplication was stopped
    */
   StatusOr<std::vector<seal::Ciphertext>> multiply(
       std::vector<seal::Ciphertext>& selection_vector,
       const seal::RelinKeys* const relin_keys = nullptr,
-      seal::Decryptor* const decryptor = nullptr) const;
+      Tracer* const tracer = nullptr,
+      const WorkerContext* const worker = nullptr,
+      const Cancellation* const cancellation = nullptr) const;
+
+  /**
+   * Multiplies the database with the selection vectors of a batch of queries
+   * in a single pass over the database: each plaintext is multiplied against
+   * the selection ciphertexts of every query before moving on, so the database
+   * is read from memory once per batch rather than once per query.
+   * @param[in] selection_vectors Selection vector of each query.
+   * @param[in] relin_keys Either empty, or the relinearization keys of each
+   *    query, nullptr where no relinearization should be done.
+   * @param[in] tracer If not nullptr, traces the multiplication as in
+   *    multiply.
+   * @param[in] worker If not nullptr, evaluator and memory pool to use on the
+   *    calling thread instead of the ones shared by the database.
+   * @param[in] cancellation If not nullptr, stops the multiplication for the
+   *    whole batch as in multiply.
+   * @returns Ciphertexts resulting from multiplication for each query, in the
+   *    order of the selection vectors, or error
+   */
+  StatusOr<std::vector<std::vector<seal::Ciphertext>>> multiply_batch(
+      const std::vector<std::vector<seal::Ciphertext>*>& selection_vectors,
+      const std::vector<const seal::RelinKeys*>& relin_keys,
+      Tracer* const tracer = nullptr,
+      const WorkerContext* const worker = nullptr,
+      const Cancellation* const cancellation = nullptr) const;
+
+  /**
+   * Multiplication with a selection vector whose first dimension is supplied
+   * one ciphertext at a time, so that it never has to be held in memory as a
+   * whole. Rows of the first dimension may be added in any order; once all of
+   * them have been added, finish returns the same result as multiply.
+   */
+  class RowMultiplier {
+   public:
+    ~RowMultiplier();
+    RowMultiplier(const RowMultiplier&) = delete;
+    RowMultiplier& operator=(const RowMultiplier&) = delete;
+
+    /**
+     * Multiplies one row of the first dimension with its selection ciphertext
+     * and adds the product to the result. Rows held by other shards of a
+     * sharded database are skipped.
+     * @param[in] row Index of the row in the first dimension.
+     * @param[in] selection Selection ciphertext of the row. May be transformed
+     *    to NTT form in place.
+     * @returns InvalidArgument if the row is out of range, or InternalError
+     *    if a homomorphic operation fails
+     */
+    Status add_row(std::size_t row, seal::Ciphertext& selection);
+
+    /**
+     * Returns the result of the multiplication of all rows added so far.
+     */
+    StatusOr<std::vector<seal::Ciphertext>> finish();
+
+   private:
+    friend class PIRDatabase;
+    RowMultiplier(const PIRDatabase* db,
+                  std::shared_ptr<const PlaintextStore> store,
+                  std::shared_ptr<const Backend> backend,
+                  std::vector<seal::Ciphertext> selection_vector,
+                  const seal::RelinKeys* relin_keys, WorkerContext worker,
+                  std::unique_ptr<CiphertextReencoder> ct_reencoder,
+                  Tracer* tracer);
+
+    const PIRDatabase* const db_;
+    // Plaintexts when the multiplication started, so that every row sees the
+    // same ones whatever updates happen in between.
+    const std::shared_ptr<const PlaintextStore> store_;
+    const std::shared_ptr<const Backend> backend_;
+    std::vector<seal::Ciphertext> selection_vector_;
+    const std::vector<std::vector<seal::Ciphertext>*> selection_vectors_;
+    const std::vector<const seal::RelinKeys*> relin_keys_;
+    const WorkerContext worker_;
+    std::unique_ptr<CiphertextReencoder> ct_reencoder_;
+    Tracer* const tracer_;
+    std::vector<std::vector<seal::Ciphertext>> result_;
+  };
+
+  /**
+   * Starts a multiplication whose first dimension is supplied row by row
+   * through the returned RowMultiplier.
+   * @param[in] selection_vector Selection vector for all dimensions. Entries
+   *    of the first dimension are ignored and may be left empty.
+   * @param[in] relin_keys If not nullptr, relinearization keys applied after
+   *    every ciphertext multiplication.
+   * @param[in] worker If not nullptr, evaluator and memory pool to use instead
+   *    of the ones shared by the database.
+   * @param[in] tracer If not nullptr, traces every row as in multiply. Must
+   *    outlive the multiplier.
+   * @returns The multiplier, or InvalidArgument if the selection vector size
+   *    doesn't match the dimensions
+   */
+  StatusOr<std::unique_ptr<RowMultiplier>> begin_multiply(
+      std::vector<seal::Ciphertext> selection_vector,
+      const seal::RelinKeys* const relin_keys = nullptr,
+      const WorkerContext* const worker = nullptr,
+      Tracer* const tracer = nullptr) const;
+
+  /**
+   * Chooses the backend the database is multiplied with, and that its
+   * servers expand queries with. See CreateBackend. Multiplications already
+   * running finish with the backend they started with.
+   * @param[in] name Name of the backend, or empty for the default one.
+   * @returns InvalidArgument if no backend of that name is built in
+   */
+  Status set_backend(const std::string& name);
+
+  /**
+   * Backend in use, to be held for the duration of an operation.
+   */
+  std::shared_ptr<const Backend> backend() const {
+    return std::atomic_load(&backend_);
+  }
 
   /**
    * Database size.
    **/
-  std::size_t size() const { return db_.size(); }
+  std::size_t size() const { return std::atomic_load(&db_)->size(); }
 
   /**
    * Helper function to calculate indices within the multi-dimensional
@@ -123,12 +355,64 @@ class PIRDatabase {
   static vector<uint32_t> calculate_dimensions(uint32_t db_size,
                                                uint32_t num_dimensions);
 
-  PIRDatabase(std::unique_ptr<PIRContext> context)
-      : context_(std::move(context)) {}
+  PIRDatabase(std::unique_ptr<PIRContext> context, size_t num_threads = 1);
+  ~PIRDatabase();
 
  private:
-  vector<seal::Plaintext> db_;
+  /**
+   * Calls fn(i, worker) for every i in [0, n), on the thread pool if there is
+   * one. worker is the context of the thread making the call, with caller
+   * used for the calling thread.
+   */
+  void parallel_for(
+      size_t n, const WorkerContext& caller,
+      const std::function<void(size_t, const WorkerContext&)>& fn) const;
+
+  // Encodes plaintext i, in coefficient form, into its second argument.
+  using PlaintextEncoder = std::function<Status(size_t, seal::Plaintext&)>;
+
+  /**
+   * Encodes n plaintexts on all the threads of the database and makes them
+   * its contents: packed if the parameters ask for compact storage, or in
+   * the form they are multiplied in.
+   * @param[in] n Number of plaintexts.
+   * @param[in] bits Bits needed for any coefficient of the plaintexts.
+   * @param[in] holds_strings Whether the plaintexts encode strings, which
+   *    can then be updated.
+   * @param[in] make_encoder Called on each thread for the encoder it uses.
+   */
+  Status populate_plaintexts(
+      size_t n, int bits, bool holds_strings,
+      const std::function<PlaintextEncoder()>& make_encoder);
+
+  /**
+   * Splits [0, n) into one contiguous range per thread and calls
+   * fn(begin, end, worker) for each range, on the thread pool if there is one.
+   * @returns The first error returned by fn, or InternalError if it throws
+   */
+  Status parallel_populate(
+      size_t n,
+      const std::function<Status(size_t, size_t, const WorkerContext&)>& fn);
+
+  // Current plaintexts. Readers take a reference with std::atomic_load and
+  // hold it for a whole multiplication, while writers build a new store and
+  // swap it in with std::atomic_store, holding update_mutex_.
+  std::shared_ptr<const PlaintextStore> db_;
+  mutable std::mutex update_mutex_;
+  // Whether db_ was populated from strings, or opened from a snapshot, so
+  // that ApplyUpdates can decode its plaintexts back into items. Guarded by
+  // update_mutex_, and swapped together with db_.
+  bool holds_strings_ = false;
   std::unique_ptr<PIRContext> context_;
+
+  // Arithmetic of the multiplication, and of the expansion of queries by
+  // servers of the database. Swapped like db_.
+  std::shared_ptr<const Backend> backend_;
+
+  // Helper threads for multiply, with one worker context per thread. Null
+  // when the database was created for a single thread.
+  std::unique_ptr<ThreadPool> thread_pool_;
+  vector<WorkerContext> workers_;
 };
 
 }  // namespace pir
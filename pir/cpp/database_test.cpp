@@ -15,7 +15,10 @@
 //
 
 #include <algorithm>
+#include <cstdio>
+#include <fstream>
 #include <iostream>
+#include <sstream>
 #include <vector>
 
 #include "gmock/gmock.h"
@@ -150,31 +153,46 @@ class PIRDatabaseTest : public PIRDatabaseTestBase,
                       plain_mod_bit_size, elem_size,
                       use_ciphertext_multiplication);
   }
-};
 
-TEST_P(PIRDatabaseTest, TestMultiply) {
-  vector<int32_t> v(db_size_);
-  std::generate(v.begin(), v.end(),
-                [n = -db_size_ / 2]() mutable { return n; });
-  ASSERT_THAT(pir_db_->size(), Eq(v.size()));
+  // Multiplies the integer database with a vector of small values of both
+  // signs, and checks the result against the plain dot product.
+  void TestMultiplyInts() {
+    vector<int32_t> v(db_size_);
+    std::generate(v.begin(), v.end(),
+                  [n = -db_size_ / 2]() mutable { return n; });
+    ASSERT_THAT(pir_db_->size(), Eq(v.size()));
+
+    vector<Ciphertext> cts(v.size());
+    int64_t expected = 0;
+    for (size_t i = 0; i < cts.size(); ++i) {
+      Plaintext pt;
+      encoder_->encode(v[i], pt);
+      encryptor_->encrypt(pt, cts[i]);
+      expected += v[i] * int_db_[i];
+    }
+
+    ASSIGN_OR_FAIL(auto result_cts, pir_db_->multiply(cts, nullptr));
+    ASSERT_EQ(result_cts.size(), 1);
 
-  vector<Ciphertext> cts(v.size());
-  int64_t expected = 0;
-  for (size_t i = 0; i < cts.size(); ++i) {
     Plaintext pt;
-    encoder_->encode(v[i], pt);
-    encryptor_->encrypt(pt, cts[i]);
-    expected += v[i] * int_db_[i];
-  }
+    decryptor_->decrypt(result_cts[0], pt);
+    auto result = encoder_->decode_int64(pt);
 
-  ASSIGN_OR_FAIL(auto result_cts, pir_db_->multiply(cts, nullptr));
-  ASSERT_EQ(result_cts.size(), 1);
+    EXPECT_THAT(result, Eq(expected));
+  }
+};
 
-  Plaintext pt;
-  decryptor_->decrypt(result_cts[0], pt);
-  auto result = encoder_->decode_int64(pt);
+TEST_P(PIRDatabaseTest, TestMultiply) { TestMultiplyInts(); }
 
-  EXPECT_THAT(result, Eq(expected));
+TEST_P(PIRDatabaseTest, TestMultiplyCompact) {
+  // Negative values are encoded with coefficients in the upper half of the
+  // plain modulus, which are lifted differently when expanded.
+  for (size_t i = 0; i < int_db_.size(); i += 2) {
+    int_db_[i] = -int_db_[i];
+  }
+  pir_params_->set_compact_storage(true);
+  ASSIGN_OR_FAIL(pir_db_, PIRDatabase::Create(int_db_, pir_params_));
+  TestMultiplyInts();
 }
 
 TEST_P(PIRDatabaseTest, TestMultiplySelectionVectorTooSmall) {
@@ -338,6 +356,211 @@ TEST_P(PIRDatabaseTest, TestCreateValueDoesntMatch) {
   ASSERT_EQ(pir_db_or.status().code(), absl::StatusCode::kInvalidArgument);
 }
 
+TEST_P(PIRDatabaseTest, TestCreateZeroThreads) {
+  auto pir_db_or = PIRDatabase::Create(string_db_, pir_params_, 0);
+  ASSERT_FALSE(pir_db_or.ok());
+  ASSERT_EQ(pir_db_or.status().code(), absl::StatusCode::kInvalidArgument);
+}
+
+// Returns the snapshot file of a database, as a byte for byte summary of its
+// plaintexts.
+string snapshot_contents(const PIRDatabase& db) {
+  const string path = ::testing::TempDir() + "/database_test.contents";
+  auto status = db.Save(path);
+  EXPECT_TRUE(status.ok()) << status;
+  std::ifstream in(path, std::ios::binary);
+  string contents((std::istreambuf_iterator<char>(in)),
+                  std::istreambuf_iterator<char>());
+  std::remove(path.c_str());
+  return contents;
+}
+
+TEST_P(PIRDatabaseTest, TestPopulateMultiThreaded) {
+  ASSIGN_OR_FAIL(auto threaded_db,
+                 PIRDatabase::Create(int_db_, pir_params_, 4));
+  EXPECT_EQ(snapshot_contents(*threaded_db), snapshot_contents(*pir_db_));
+
+  SetUpStringDB(1000, 2, POLY_MODULUS_DEGREE, 16, 128);
+  ASSIGN_OR_FAIL(threaded_db, PIRDatabase::Create(string_db_, pir_params_, 4));
+  EXPECT_EQ(snapshot_contents(*threaded_db), snapshot_contents(*pir_db_));
+}
+
+TEST_P(PIRDatabaseTest, TestPopulateFromRecordSource) {
+  SetUpStringDB(1000, 2, POLY_MODULUS_DEGREE, 16, 128);
+  const auto expected = snapshot_contents(*pir_db_);
+
+  // The same records, back to back in a file.
+  const string path = ::testing::TempDir() + "/database_test.records";
+  {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    for (const auto& item : string_db_) out << item;
+  }
+  ASSIGN_OR_FAIL(auto mapped, MappedRecordSource::Open(path, 128));
+  std::remove(path.c_str());
+  ASSIGN_OR_FAIL(auto from_file,
+                 PIRDatabase::Create(*mapped, pir_params_, 4));
+  EXPECT_EQ(snapshot_contents(*from_file), expected);
+
+  CallbackRecordSource callback(string_db_.size(),
+                                [this](size_t i, string& out) -> Status {
+                                  out.append(string_db_[i]);
+                                  return absl::OkStatus();
+                                });
+  ASSIGN_OR_FAIL(auto from_callback,
+                 PIRDatabase::Create(callback, pir_params_, 4));
+  EXPECT_EQ(snapshot_contents(*from_callback), expected);
+}
+
+TEST_P(PIRDatabaseTest, TestPopulateFromRecordSourceInvalid) {
+  SetUpStringDB(1000, 2, POLY_MODULUS_DEGREE, 16, 128);
+  const string records(999 * 128, 'a');
+  ASSIGN_OR_FAIL(auto too_few, FixedWidthRecordSource::Create(records, 128));
+  EXPECT_THAT(pir_db_->populate(*too_few).code(),
+              Eq(absl::StatusCode::kInvalidArgument));
+
+  CallbackRecordSource failing(string_db_.size(),
+                               [](size_t i, string& out) -> Status {
+                                 if (i == 500) {
+                                   return absl::DataLossError("bad record");
+                                 }
+                                 out.append(128, 'a');
+                                 return absl::OkStatus();
+                               });
+  EXPECT_THAT(pir_db_->populate(failing).code(),
+              Eq(absl::StatusCode::kDataLoss));
+}
+
+TEST_P(PIRDatabaseTest, TestApplyUpdates) {
+  SetUpStringDB(1000, 2, POLY_MODULUS_DEGREE, 16, 128);
+  const string path = ::testing::TempDir() + "/database_test.snapshot";
+  ASSERT_OK(pir_db_->Save(path));
+  ASSIGN_OR_FAIL(auto mapped_db, PIRDatabase::Open(path, 2));
+  std::remove(path.c_str());
+
+  // Both ends of the database, two items of the same plaintext, and an item
+  // updated twice.
+  const vector<std::pair<size_t, string>> updates = {
+      {0, string(128, 'a')},   {1, string(128, 'b')},   {500, string(128, 'c')},
+      {999, string(128, 'd')}, {500, string(128, 'e')},
+  };
+  for (const auto& update : updates) {
+    string_db_[update.first] = update.second;
+  }
+  ASSIGN_OR_FAIL(auto expected_db,
+                 PIRDatabase::Create(string_db_, pir_params_));
+
+  ASSERT_OK(pir_db_->ApplyUpdates(updates));
+  EXPECT_EQ(snapshot_contents(*pir_db_), snapshot_contents(*expected_db));
+  ASSERT_OK(mapped_db->ApplyUpdates(updates));
+  EXPECT_EQ(snapshot_contents(*mapped_db), snapshot_contents(*expected_db));
+
+  // Updates on top of updates.
+  string_db_[1] = string(128, 'f');
+  ASSIGN_OR_FAIL(expected_db, PIRDatabase::Create(string_db_, pir_params_));
+  ASSERT_OK(pir_db_->Update(1, string_db_[1]));
+  EXPECT_EQ(snapshot_contents(*pir_db_), snapshot_contents(*expected_db));
+}
+
+TEST_P(PIRDatabaseTest, TestApplyUpdatesInvalid) {
+  SetUpStringDB(1000, 2, POLY_MODULUS_DEGREE, 16, 128);
+  const auto contents = snapshot_contents(*pir_db_);
+  EXPECT_THAT(pir_db_->Update(1000, string(128, 'a')).code(),
+              Eq(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(pir_db_->Update(0, string(127, 'a')).code(),
+              Eq(absl::StatusCode::kInvalidArgument));
+  // Nothing is applied when any update of the batch is invalid.
+  EXPECT_THAT(pir_db_->ApplyUpdates({{0, string(128, 'a')}, {1, "b"}}).code(),
+              Eq(absl::StatusCode::kInvalidArgument));
+  EXPECT_EQ(snapshot_contents(*pir_db_), contents);
+
+  ASSIGN_OR_FAIL(auto empty_db, PIRDatabase::Create(pir_params_));
+  EXPECT_THAT(empty_db->Update(0, string(128, 'a')).code(),
+              Eq(absl::StatusCode::kFailedPrecondition));
+}
+
+TEST_P(PIRDatabaseTest, TestApplyUpdatesIntegers) {
+  // Integer databases hold one plaintext per item, as many as a database of
+  // strings with the same parameters, but can't be decoded into items.
+  SetUpDB(100);
+  ASSERT_THAT(pir_params_->num_pt(), Eq(int_db_.size()));
+  EXPECT_THAT(
+      pir_db_->Update(0, string(pir_params_->bytes_per_item(), 'a')).code(),
+      Eq(absl::StatusCode::kFailedPrecondition));
+  // Nor saved, as the snapshot would be updated once opened.
+  const string path = ::testing::TempDir() + "/database_test.snapshot";
+  EXPECT_THAT(pir_db_->Save(path).code(),
+              Eq(absl::StatusCode::kFailedPrecondition));
+  EXPECT_THAT(PIRDatabase::Open(path).status().code(),
+              Eq(absl::StatusCode::kNotFound));
+
+  // Strings populated over the integers can be updated.
+  vector<string> strings(int_db_.size(),
+                         string(pir_params_->bytes_per_item(), 'b'));
+  ASSERT_OK(pir_db_->populate(strings));
+  EXPECT_OK(pir_db_->Update(0, string(pir_params_->bytes_per_item(), 'a')));
+  ASSERT_OK(pir_db_->Save(path));
+  ASSIGN_OR_FAIL(auto mapped_db, PIRDatabase::Open(path));
+  std::remove(path.c_str());
+  EXPECT_OK(mapped_db->Update(1, string(pir_params_->bytes_per_item(), 'a')));
+}
+
+TEST_P(PIRDatabaseTest, TestOpenWrongSize) {
+  SetUpStringDB(1000, 2, POLY_MODULUS_DEGREE, 16, 128);
+  ASSERT_THAT(pir_params_->num_pt(), Ne(pir_params_->num_items()));
+  // As many plaintexts as items rather than as the parameters hold.
+  const string path = ::testing::TempDir() + "/database_test.snapshot";
+  ASSERT_OK(MappedPlaintextStore::Write(
+      path, *pir_params_,
+      MemoryPlaintextStore(
+          vector<Plaintext>(pir_params_->num_items(), Plaintext(1)))));
+  EXPECT_THAT(PIRDatabase::Open(path).status().code(),
+              Eq(absl::StatusCode::kInvalidArgument));
+  std::remove(path.c_str());
+}
+
+TEST_P(PIRDatabaseTest, TestOpenMissingSnapshot) {
+  auto pir_db_or =
+      PIRDatabase::Open(::testing::TempDir() + "/missing.snapshot");
+  ASSERT_EQ(pir_db_or.status().code(), absl::StatusCode::kNotFound);
+}
+
+// Cancels a request once the first plaintext product is done.
+class CancellingTracer : public Tracer {
+ public:
+  explicit CancellingTracer(Cancellation* cancellation)
+      : cancellation_(cancellation) {}
+  void RecordPhase(Phase /*phase*/, Clock::duration /*elapsed*/) override {}
+  void Count(Counter counter, uint64_t /*n*/) override {
+    if (counter == Counter::kMultiplyPlain) cancellation_->Cancel();
+  }
+
+ private:
+  Cancellation* const cancellation_;
+};
+
+TEST_P(PIRDatabaseTest, TestMultiplyCancelledPartway) {
+  constexpr size_t d = 3;
+  constexpr size_t db_size = 117;
+  SetUpStringDB(db_size, d, 8192, 20);
+  const auto dims = PIRDatabase::calculate_dimensions(db_size, d);
+  const auto indices = pir_db_->calculate_indices(17);
+  auto relin_keys = keygen_->relin_keys_local();
+  // With several threads, the other rows of the first dimension are stopped
+  // wherever they are when the first product is done, including before the
+  // first row of a lower dimension.
+  for (const size_t num_threads : {1, 4}) {
+    ASSIGN_OR_FAIL(auto db,
+                   PIRDatabase::Create(string_db_, pir_params_, num_threads));
+    auto sv = create_selection_vector(dims, indices, *encryptor_);
+    Cancellation cancellation;
+    CancellingTracer tracer(&cancellation);
+    EXPECT_THAT(db->multiply(sv, &relin_keys, &tracer, nullptr, &cancellation)
+                    .status()
+                    .code(),
+                Eq(absl::StatusCode::kCancelled));
+  }
+}
+
 INSTANTIATE_TEST_SUITE_P(PIRDatabaseTests, PIRDatabaseTest,
                          testing::Values(false, true));
 
@@ -346,7 +569,9 @@ class MultiplyMultiDimTest
       public testing::TestWithParam<
           tuple<uint32_t, uint32_t, uint32_t, uint32_t, uint32_t>> {
  protected:
-  void TestMultiply(bool use_ciphertext_multiplication) {
+  void TestMultiply(bool use_ciphertext_multiplication, size_t num_threads = 1,
+                    bool from_snapshot = false, bool compact = false,
+                    bool trace_noise = false) {
     const auto poly_modulus_degree = get<0>(GetParam());
     const auto plain_mod_bits = get<1>(GetParam());
     const auto dbsize = get<2>(GetParam());
@@ -354,6 +579,19 @@ class MultiplyMultiDimTest
     const auto desired_index = get<4>(GetParam());
     SetUpStringDBImpl(dbsize, d, poly_modulus_degree, plain_mod_bits, 0,
                       use_ciphertext_multiplication);
+    if (num_threads > 1 || compact) {
+      pir_params_->set_compact_storage(compact);
+      ASSIGN_OR_FAIL(pir_db_, PIRDatabase::Create(string_db_, pir_params_,
+                                                  num_threads));
+    }
+    if (from_snapshot) {
+      const string path = ::testing::TempDir() + "/database_test.snapshot";
+      ASSERT_OK(pir_db_->Save(path));
+      ASSIGN_OR_FAIL(pir_db_, PIRDatabase::Open(path, num_threads));
+      // The mapping outlives the file name.
+      std::remove(path.c_str());
+      ASSERT_EQ(pir_db_->size(), pir_params_->num_pt());
+    }
     const size_t elem_size = pir_params_->bytes_per_item();
     const auto dims = PIRDatabase::calculate_dimensions(dbsize, d);
     const auto indices = pir_db_->calculate_indices(desired_index);
@@ -363,7 +601,13 @@ class MultiplyMultiDimTest
     if (use_ciphertext_multiplication) {
       relin_keys = make_unique<RelinKeys>(keygen_->relin_keys_local());
     }
-    ASSIGN_OR_FAIL(auto result_cts, pir_db_->multiply(cts, relin_keys.get()));
+    std::ostringstream noise_budgets;
+    unique_ptr<NoiseBudgetTracer> tracer;
+    if (trace_noise) {
+      tracer = make_unique<NoiseBudgetTracer>(decryptor_.get(), noise_budgets);
+    }
+    ASSIGN_OR_FAIL(auto result_cts,
+                   pir_db_->multiply(cts, relin_keys.get(), tracer.get()));
 
     Plaintext result_pt;
     decode_result(result_cts, result_pt, cts[0].size(), d,
@@ -371,6 +615,101 @@ class MultiplyMultiDimTest
     auto string_encoder = make_unique<StringEncoder>(seal_context_);
     ASSIGN_OR_FAIL(auto result, string_encoder->decode(result_pt, elem_size));
     EXPECT_THAT(result, Eq(string_db_[desired_index]));
+    if (trace_noise) {
+      EXPECT_THAT(noise_budgets.str(), HasSubstr("base noise budget"));
+    }
+  }
+
+  void TestRowMultiplier(bool use_ciphertext_multiplication) {
+    const auto poly_modulus_degree = get<0>(GetParam());
+    const auto plain_mod_bits = get<1>(GetParam());
+    const auto dbsize = get<2>(GetParam());
+    const auto d = get<3>(GetParam());
+    const auto desired_index = get<4>(GetParam());
+    SetUpStringDBImpl(dbsize, d, poly_modulus_degree, plain_mod_bits, 0,
+                      use_ciphertext_multiplication);
+    const size_t elem_size = pir_params_->bytes_per_item();
+    const auto dims = PIRDatabase::calculate_dimensions(dbsize, d);
+    const auto indices = pir_db_->calculate_indices(desired_index);
+    auto cts = create_selection_vector(dims, indices, *encryptor_);
+    const size_t ct_size = cts[0].size();
+
+    // The first dimension is handed over row by row, in reverse order.
+    vector<Ciphertext> rows(cts.begin(), cts.begin() + dims[0]);
+    for (size_t i = 0; i < dims[0]; ++i) cts[i] = Ciphertext();
+
+    auto relin_keys = keygen_->relin_keys_local();
+    ASSIGN_OR_FAIL(auto multiplier,
+                   pir_db_->begin_multiply(
+                       cts, use_ciphertext_multiplication ? &relin_keys
+                                                          : nullptr));
+    for (size_t i = dims[0]; i > 0; --i) {
+      ASSERT_OK(multiplier->add_row(i - 1, rows[i - 1]));
+    }
+    auto bad_row = rows[0];
+    EXPECT_THAT(multiplier->add_row(dims[0], bad_row).code(),
+                Eq(absl::StatusCode::kInvalidArgument));
+    ASSIGN_OR_FAIL(auto result_cts, multiplier->finish());
+
+    Plaintext result_pt;
+    decode_result(result_cts, result_pt, ct_size, d,
+                  use_ciphertext_multiplication);
+    auto string_encoder = make_unique<StringEncoder>(seal_context_);
+    ASSIGN_OR_FAIL(auto result, string_encoder->decode(result_pt, elem_size));
+    EXPECT_THAT(result, Eq(string_db_[desired_index]));
+  }
+
+  void TestMultiplyBatch(bool use_ciphertext_multiplication,
+                         size_t num_threads, bool streamed = false,
+                         const string& backend = "") {
+    const auto poly_modulus_degree = get<0>(GetParam());
+    const auto plain_mod_bits = get<1>(GetParam());
+    const auto dbsize = get<2>(GetParam());
+    const auto d = get<3>(GetParam());
+    const vector<uint32_t> desired_indexes = {get<4>(GetParam()), 0,
+                                              dbsize - 1};
+    SetUpStringDBImpl(dbsize, d, poly_modulus_degree, plain_mod_bits, 0,
+                      use_ciphertext_multiplication);
+    ASSIGN_OR_FAIL(pir_db_,
+                   PIRDatabase::Create(string_db_, pir_params_, num_threads));
+    if (streamed) {
+      const string path = ::testing::TempDir() + "/database_test.snapshot";
+      ASSERT_OK(pir_db_->Save(path));
+      ASSIGN_OR_FAIL(pir_db_,
+                     PIRDatabase::Open(path, num_threads,
+                                       PIRDatabase::SnapshotAccess::kStreamed));
+      // The file stays open after its name is removed.
+      std::remove(path.c_str());
+    }
+    ASSERT_OK(pir_db_->set_backend(backend));
+    const size_t elem_size = pir_params_->bytes_per_item();
+    const auto dims = PIRDatabase::calculate_dimensions(dbsize, d);
+
+    auto relin_keys = keygen_->relin_keys_local();
+    vector<vector<Ciphertext>> cts;
+    for (const auto index : desired_indexes) {
+      cts.push_back(create_selection_vector(
+          dims, pir_db_->calculate_indices(index), *encryptor_));
+    }
+    vector<vector<Ciphertext>*> selection_vectors;
+    vector<const RelinKeys*> batch_relin_keys;
+    for (auto& sv : cts) {
+      selection_vectors.push_back(&sv);
+      batch_relin_keys.push_back(use_ciphertext_multiplication ? &relin_keys
+                                                               : nullptr);
+    }
+    ASSIGN_OR_FAIL(auto results, pir_db_->multiply_batch(selection_vectors,
+                                                         batch_relin_keys));
+    ASSERT_THAT(results, SizeIs(desired_indexes.size()));
+
+    auto string_encoder = make_unique<StringEncoder>(seal_context_);
+    for (size_t q = 0; q < desired_indexes.size(); ++q) {
+      Plaintext result_pt;
+      decode_result(results[q], result_pt, cts[q][0].size(), d,
+                    use_ciphertext_multiplication);
+      ASSIGN_OR_FAIL(auto result, string_encoder->decode(result_pt, elem_size));
+      EXPECT_THAT(result, Eq(string_db_[desired_indexes[q]])) << "q = " << q;
+    }
   }
 };
 
@@ -378,8 +717,75 @@ TEST_P(MultiplyMultiDimTest, CTDecomp) { TestMultiply(false); }
 
 TEST_P(MultiplyMultiDimTest, CTMultiply) { TestMultiply(true); }
 
+TEST_P(MultiplyMultiDimTest, CTDecompMultiThreaded) { TestMultiply(false, 3); }
+
+TEST_P(MultiplyMultiDimTest, CTMultiplyMultiThreaded) {
+  TestMultiply(true, 3);
+}
+
+TEST_P(MultiplyMultiDimTest, CTDecompTraceNoise) {
+  TestMultiply(false, 3, false, false, true);
+}
+
+TEST_P(MultiplyMultiDimTest, CTMultiplyTraceNoise) {
+  TestMultiply(true, 3, false, false, true);
+}
+
+TEST_P(MultiplyMultiDimTest, CTDecompSnapshot) {
+  TestMultiply(false, 1, true);
+}
+
+TEST_P(MultiplyMultiDimTest, CTMultiplySnapshot) {
+  TestMultiply(true, 1, true);
+}
+
+TEST_P(MultiplyMultiDimTest, CTDecompCompact) {
+  TestMultiply(false, 1, false, true);
+}
+
+TEST_P(MultiplyMultiDimTest, CTMultiplyCompact) {
+  TestMultiply(true, 1, false, true);
+}
+
+TEST_P(MultiplyMultiDimTest, CTDecompCompactMultiThreaded) {
+  TestMultiply(false, 3, false, true);
+}
+
+TEST_P(MultiplyMultiDimTest, CTDecompCompactSnapshot) {
+  TestMultiply(false, 1, true, true);
+}
+
+TEST_P(MultiplyMultiDimTest, CTDecompRows) { TestRowMultiplier(false); }
+
+TEST_P(MultiplyMultiDimTest, CTMultiplyRows) { TestRowMultiplier(true); }
+
+TEST_P(MultiplyMultiDimTest, CTDecompBatch) { TestMultiplyBatch(false, 1); }
+
+TEST_P(MultiplyMultiDimTest, CTMultiplyBatch) { TestMultiplyBatch(true, 1); }
+
+TEST_P(MultiplyMultiDimTest, CTDecompBatchMultiThreaded) {
+  TestMultiplyBatch(false, 3);
+}
+
+TEST_P(MultiplyMultiDimTest, CTMultiplyBatchMultiThreaded) {
+  TestMultiplyBatch(true, 3);
+}
+
+TEST_P(MultiplyMultiDimTest, CTDecompBatchStreamed) {
+  TestMultiplyBatch(false, 3, true);
+}
+
+TEST_P(MultiplyMultiDimTest, CTMultiplyBatchStreamed) {
+  TestMultiplyBatch(true, 1, true);
+}
+
+TEST_P(MultiplyMultiDimTest, CTDecompBatchSEALBackend) {
+  TestMultiplyBatch(false, 3, false, "seal");
+}
+
 INSTANTIATE_TEST_SUITE_P(PIRDatabaseMultiplies, MultiplyMultiDimTest,
                          testing::Values(make_tuple(4096, 16, 10, 1, 7),
+                                         make_tuple(4096, 16, 40, 1, 37),
                                          make_tuple(4096, 16, 16, 2, 11),
                                          make_tuple(4096, 16, 16, 2, 0),
                                          make_tuple(4096, 16, 16, 2, 15),
@@ -0,0 +1,240 @@
+//
+// Copyright 2020 the authors listed in CONTRIBUTORS.md
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#include "pir/cpp/dot_product.h"
+
+#include <algorithm>
+#include <limits>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define PIR_DOT_PRODUCT_IFMA 1
+#include <immintrin.h>
+#endif
+
+namespace pir {
+
+namespace {
+
+using uint128_t = unsigned __int128;
+
+// Coefficients of each polynomial handled per pass over the plaintexts, small
+// enough for the accumulators of a few products to stay in L1.
+constexpr std::size_t kBlock = 64;
+
+// Bits per IFMA multiplicand; products are split at this bit.
+constexpr int kIfmaBits = 52;
+
+constexpr uint128_t kUint128Max = ~uint128_t(0);
+
+}  // namespace
+
+DotProduct::DotProduct(const std::vector<std::uint64_t>& moduli,
+                       std::size_t coeff_count, bool allow_simd)
+    : coeff_count_(coeff_count) {
+  bool fits_ifma = coeff_count % 8 == 0;
+  moduli_.reserve(moduli.size());
+  for (const auto q : moduli) {
+    Modulus m;
+    m.value = q;
+    uint128_t ratio = kUint128Max / q;
+    if (kUint128Max % q == q - 1) ++ratio;
+    m.ratio[0] = static_cast<std::uint64_t>(ratio);
+    m.ratio[1] = static_cast<std::uint64_t>(ratio >> 64);
+
+    // A reduced accumulator is at most q - 1, and each product adds at most
+    // (q - 1)^2.
+    const uint128_t max_product = uint128_t(q - 1) * (q - 1);
+    const uint128_t terms = (kUint128Max - (q - 1)) / max_product;
+    m.lazy_terms = static_cast<std::size_t>(std::min<uint128_t>(
+        terms, std::numeric_limits<std::size_t>::max()));
+    // Both halves of an IFMA product are below 2^52, and the low accumulator
+    // starts at up to q - 1.
+    constexpr std::uint64_t max_half = (std::uint64_t(1) << kIfmaBits) - 1;
+    m.lazy_terms_ifma = (std::numeric_limits<std::uint64_t>::max() - (q - 1)) /
+                        max_half;
+    fits_ifma = fits_ifma && q <= max_half;
+    moduli_.push_back(m);
+  }
+#ifdef PIR_DOT_PRODUCT_IFMA
+  use_ifma_ = allow_simd && fits_ifma && __builtin_cpu_supports("avx512f") &&
+              __builtin_cpu_supports("avx512ifma");
+#endif
+}
+
+namespace {
+
+// Barrett reduction of a full 128 bit value. The quotient estimate
+// floor(x * ratio / 2^128) is at most one below the real quotient, so a
+// single conditional subtraction is enough for moduli below 2^63.
+inline std::uint64_t barrett_reduce_128(uint128_t x, std::uint64_t modulus,
+                                        const std::uint64_t* ratio) {
+  const auto x0 = static_cast<std::uint64_t>(x);
+  const auto x1 = static_cast<std::uint64_t>(x >> 64);
+  const uint128_t low = uint128_t(x0) * ratio[0];
+  const uint128_t mid0 = uint128_t(x0) * ratio[1];
+  const uint128_t mid1 = uint128_t(x1) * ratio[0];
+  const uint128_t carry = (low >> 64) + static_cast<std::uint64_t>(mid0) +
+                          static_cast<std::uint64_t>(mid1);
+  const std::uint64_t quotient = x1 * ratio[1] +
+                                 static_cast<std::uint64_t>(mid0 >> 64) +
+                                 static_cast<std::uint64_t>(mid1 >> 64) +
+                                 static_cast<std::uint64_t>(carry >> 64);
+  const std::uint64_t remainder = x0 - quotient * modulus;
+  return remainder >= modulus ? remainder - modulus : remainder;
+}
+
+}  // namespace
+
+void DotProduct::compute(
+    const std::vector<const std::uint64_t*>& plain,
+    const std::vector<std::vector<const std::uint64_t*>>& operands,
+    const std::vector<std::uint64_t*>& results, bool accumulate) const {
+  if (use_ifma_) {
+    compute_ifma(plain, operands, results, accumulate);
+  } else {
+    compute_portable(plain, operands, results, accumulate);
+  }
+}
+
+void DotProduct::compute_portable(
+    const std::vector<const std::uint64_t*>& plain,
+    const std::vector<std::vector<const std::uint64_t*>>& operands,
+    const std::vector<std::uint64_t*>& results, bool accumulate) const {
+  const auto num_products = results.size();
+  std::vector<uint128_t> acc(num_products * kBlock);
+
+  for (std::size_t m = 0; m < moduli_.size(); ++m) {
+    const auto& modulus = moduli_[m];
+    for (std::size_t block = 0; block < coeff_count_; block += kBlock) {
+      const auto offset = m * coeff_count_ + block;
+      const auto len = std::min(kBlock, coeff_count_ - block);
+      // A result being added to counts as a reduced accumulator.
+      for (std::size_t j = 0; j < num_products; ++j) {
+        for (std::size_t c = 0; c < len; ++c) {
+          acc[j * kBlock + c] = accumulate ? results[j][offset + c] : 0;
+        }
+      }
+
+      std::size_t pending = 0;
+      for (std::size_t i = 0; i < plain.size(); ++i) {
+        if (pending == modulus.lazy_terms) {
+          for (auto& a : acc) {
+            a = barrett_reduce_128(a, modulus.value, modulus.ratio);
+          }
+          pending = 0;
+        }
+        const auto* b = plain[i] + offset;
+        for (std::size_t j = 0; j < num_products; ++j) {
+          const auto* a = operands[j][i] + offset;
+          auto* sum = &acc[j * kBlock];
+          for (std::size_t c = 0; c < len; ++c) {
+            sum[c] += uint128_t(a[c]) * b[c];
+          }
+        }
+        ++pending;
+      }
+
+      for (std::size_t j = 0; j < num_products; ++j) {
+        const auto* sum = &acc[j * kBlock];
+        auto* result = results[j] + offset;
+        for (std::size_t c = 0; c < len; ++c) {
+          result[c] = barrett_reduce_128(sum[c], modulus.value, modulus.ratio);
+        }
+      }
+    }
+  }
+}
+
+#ifdef PIR_DOT_PRODUCT_IFMA
+
+// The low and high halves of each 104 bit product are accumulated separately
+// in 64 bit lanes, and only recombined when reducing.
+__attribute__((target("avx512f,avx512ifma"))) void DotProduct::compute_ifma(
+    const std::vector<const std::uint64_t*>& plain,
+    const std::vector<std::vector<const std::uint64_t*>>& operands,
+    const std::vector<std::uint64_t*>& results, bool accumulate) const {
+  const auto num_products = results.size();
+  std::vector<std::uint64_t> acc_lo(num_products * kBlock);
+  std::vector<std::uint64_t> acc_hi(num_products * kBlock);
+  const auto reduce = [](std::uint64_t lo, std::uint64_t hi,
+                         const Modulus& modulus) {
+    return barrett_reduce_128((uint128_t(hi) << kIfmaBits) + lo,
+                              modulus.value, modulus.ratio);
+  };
+
+  for (std::size_t m = 0; m < moduli_.size(); ++m) {
+    const auto& modulus = moduli_[m];
+    for (std::size_t block = 0; block < coeff_count_; block += kBlock) {
+      const auto offset = m * coeff_count_ + block;
+      const auto len = std::min(kBlock, coeff_count_ - block);
+      std::fill(acc_hi.begin(), acc_hi.end(), 0);
+      for (std::size_t j = 0; j < num_products; ++j) {
+        for (std::size_t c = 0; c < len; ++c) {
+          acc_lo[j * kBlock + c] = accumulate ? results[j][offset + c] : 0;
+        }
+      }
+
+      std::size_t pending = 0;
+      for (std::size_t i = 0; i < plain.size(); ++i) {
+        if (pending == modulus.lazy_terms_ifma) {
+          for (std::size_t k = 0; k < acc_lo.size(); ++k) {
+            acc_lo[k] = reduce(acc_lo[k], acc_hi[k], modulus);
+            acc_hi[k] = 0;
+          }
+          pending = 0;
+        }
+        const auto* b = plain[i] + offset;
+        for (std::size_t j = 0; j < num_products; ++j) {
+          const auto* a = operands[j][i] + offset;
+          auto* lo = &acc_lo[j * kBlock];
+          auto* hi = &acc_hi[j * kBlock];
+          for (std::size_t c = 0; c < len; c += 8) {
+            const __m512i va = _mm512_loadu_si512(a + c);
+            const __m512i vb = _mm512_loadu_si512(b + c);
+            _mm512_storeu_si512(
+                lo + c, _mm512_madd52lo_epu64(_mm512_loadu_si512(lo + c), va,
+                                              vb));
+            _mm512_storeu_si512(
+                hi + c, _mm512_madd52hi_epu64(_mm512_loadu_si512(hi + c), va,
+                                              vb));
+          }
+        }
+        ++pending;
+      }
+
+      for (std::size_t j = 0; j < num_products; ++j) {
+        const auto* lo = &acc_lo[j * kBlock];
+        const auto* hi = &acc_hi[j * kBlock];
+        auto* result = results[j] + offset;
+        for (std::size_t c = 0; c < len; ++c) {
+          result[c] = reduce(lo[c], hi[c], modulus);
+        }
+      }
+    }
+  }
+}
+
+#else
+
+void DotProduct::compute_ifma(
+    const std::vector<const std::uint64_t*>& plain,
+    const std::vector<std::vector<const std::uint64_t*>>& operands,
+    const std::vector<std::uint64_t*>& results, bool accumulate) const {
+  compute_portable(plain, operands, results, accumulate);
+}
+
+#endif  // PIR_DOT_PRODUCT_IFMA
+
+}  // namespace pir
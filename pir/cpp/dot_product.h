@@ -0,0 +1,101 @@
+//
+// Copyright 2020 the authors listed in CONTRIBUTORS.md
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef PIR_DOT_PRODUCT_H_
+#define PIR_DOT_PRODUCT_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace pir {
+
+/**
+ * Coefficient-wise inner products of polynomials in NTT form and RNS
+ * representation, as used for the bottom dimension of the database multiply:
+ * result = sum_i operand_i * plain_i, with every polynomial made of one block
+ * of coeff_count coefficients per modulus.
+ *
+ * Products are accumulated without reduction in 128 bit integers, and only
+ * folded back below the modulus when the next product could overflow the
+ * accumulator, so a row of the database costs one reduction per coefficient
+ * rather than one per plaintext. When all the moduli fit in 52 bits and the
+ * CPU supports AVX-512 IFMA, eight coefficients are accumulated at a time with
+ * the 52 bit multiply-add instructions.
+ */
+class DotProduct {
+ public:
+  /**
+   * Creates a kernel for the given moduli.
+   * @param[in] moduli Value of each RNS modulus, between 2 and 2^61.
+   * @param[in] coeff_count Number of coefficients per modulus.
+   * @param[in] allow_simd If false, always use the portable implementation.
+   */
+  DotProduct(const std::vector<std::uint64_t>& moduli,
+             std::size_t coeff_count, bool allow_simd = true);
+
+  /**
+   * Computes the inner products of several operand vectors with the same
+   * plaintext vector in a single pass over the plaintexts:
+   * results[j] = sum_i operands[j][i] * plain[i]. Every polynomial points to
+   * moduli.size() * coeff_count words in NTT form, each below its modulus.
+   * @param[in] plain Plaintext polynomials shared by all the products.
+   * @param[in] operands For each product, one polynomial per plaintext.
+   * @param[out] results For each product, where to write the result. May not
+   *    alias any of the inputs.
+   * @param[in] accumulate If true, the products are added to results, which
+   *    must then already be below their moduli, instead of overwriting them.
+   */
+  void compute(
+      const std::vector<const std::uint64_t*>& plain,
+      const std::vector<std::vector<const std::uint64_t*>>& operands,
+      const std::vector<std::uint64_t*>& results,
+      bool accumulate = false) const;
+
+  /**
+   * Returns true if compute runs the AVX-512 IFMA implementation.
+   */
+  bool uses_simd() const { return use_ifma_; }
+
+ private:
+  struct Modulus {
+    std::uint64_t value;
+    // floor(2^128 / value), low word first, for Barrett reduction.
+    std::uint64_t ratio[2];
+    // Products that may be added to a reduced accumulator before it has to
+    // be reduced again, for the 128 bit and the IFMA accumulators.
+    std::size_t lazy_terms;
+    std::size_t lazy_terms_ifma;
+  };
+
+  void compute_portable(
+      const std::vector<const std::uint64_t*>& plain,
+      const std::vector<std::vector<const std::uint64_t*>>& operands,
+      const std::vector<std::uint64_t*>& results, bool accumulate) const;
+
+  void compute_ifma(
+      const std::vector<const std::uint64_t*>& plain,
+      const std::vector<std::vector<const std::uint64_t*>>& operands,
+      const std::vector<std::uint64_t*>& results, bool accumulate) const;
+
+  std::vector<Modulus> moduli_;
+  const std::size_t coeff_count_;
+  bool use_ifma_ = false;
+};
+
+}  // namespace pir
+
+#endif  // PIR_DOT_PRODUCT_H_
@@ -0,0 +1,159 @@
+//
+// Copyright 2020 the authors listed in CONTRIBUTORS.md
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "pir/cpp/dot_product.h"
+
+#include <random>
+#include <tuple>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace pir {
+namespace {
+
+using std::uint64_t;
+using std::vector;
+using namespace ::testing;
+
+// Not a multiple of the kernel block size, so the last block is partial.
+constexpr size_t COEFF_COUNT = 72;
+
+// Moduli of the given sizes in bits, the second one at the top of the range.
+vector<uint64_t> moduli_for(int bits) {
+  return {(uint64_t(1) << (bits - 1)) + 1, (uint64_t(1) << bits) - 1};
+}
+
+class DotProductTest
+    : public ::testing::TestWithParam<std::tuple<int, bool, size_t>> {
+ protected:
+  void SetUp() {
+    std::tie(bits_, allow_simd_, num_terms_) = GetParam();
+    moduli_ = moduli_for(bits_);
+  }
+
+  // Generates num_terms_ random polynomials, all coefficients below their
+  // modulus. Half of them are set to the largest value to hit the bounds.
+  vector<vector<uint64_t>> random_polys() {
+    vector<vector<uint64_t>> polys(num_terms_);
+    for (size_t i = 0; i < num_terms_; ++i) {
+      polys[i].resize(moduli_.size() * COEFF_COUNT);
+      for (size_t m = 0; m < moduli_.size(); ++m) {
+        std::uniform_int_distribution<uint64_t> dist(0, moduli_[m] - 1);
+        for (size_t c = 0; c < COEFF_COUNT; ++c) {
+          polys[i][m * COEFF_COUNT + c] =
+              c % 2 == 0 ? moduli_[m] - 1 : dist(prng_);
+        }
+      }
+    }
+    return polys;
+  }
+
+  vector<uint64_t> expected(const vector<vector<uint64_t>>& a,
+                            const vector<vector<uint64_t>>& b) {
+    vector<uint64_t> result(moduli_.size() * COEFF_COUNT, 0);
+    for (size_t m = 0; m < moduli_.size(); ++m) {
+      const auto q = moduli_[m];
+      for (size_t c = 0; c < COEFF_COUNT; ++c) {
+        auto& r = result[m * COEFF_COUNT + c];
+        for (size_t i = 0; i < a.size(); ++i) {
+          const auto k = m * COEFF_COUNT + c;
+          r = (r + static_cast<uint64_t>(
+                       (static_cast<unsigned __int128>(a[i][k]) * b[i][k]) %
+                       q)) %
+              q;
+        }
+      }
+    }
+    return result;
+  }
+
+  static vector<const uint64_t*> pointers(const vector<vector<uint64_t>>& v) {
+    vector<const uint64_t*> result;
+    for (const auto& p : v) result.push_back(p.data());
+    return result;
+  }
+
+  int bits_;
+  bool allow_simd_;
+  size_t num_terms_;
+  vector<uint64_t> moduli_;
+  std::mt19937_64 prng_{42};
+};
+
+TEST_P(DotProductTest, MatchesNaive) {
+  DotProduct dot_product(moduli_, COEFF_COUNT, allow_simd_);
+  if (!allow_simd_) {
+    EXPECT_FALSE(dot_product.uses_simd());
+  }
+  auto plain = random_polys();
+  vector<vector<vector<uint64_t>>> operands(3);
+  vector<vector<const uint64_t*>> operand_ptrs;
+  vector<vector<uint64_t>> results(operands.size());
+  vector<uint64_t*> result_ptrs;
+  for (size_t j = 0; j < operands.size(); ++j) {
+    operands[j] = random_polys();
+    operand_ptrs.push_back(pointers(operands[j]));
+    results[j].resize(moduli_.size() * COEFF_COUNT);
+    result_ptrs.push_back(results[j].data());
+  }
+
+  dot_product.compute(pointers(plain), operand_ptrs, result_ptrs);
+  for (size_t j = 0; j < operands.size(); ++j) {
+    EXPECT_THAT(results[j], ElementsAreArray(expected(operands[j], plain)))
+        << "j = " << j;
+  }
+}
+
+TEST_P(DotProductTest, Accumulate) {
+  DotProduct dot_product(moduli_, COEFF_COUNT, allow_simd_);
+  auto plain = random_polys();
+  auto operands = random_polys();
+  // Two halves of the terms, the second added to the result of the first.
+  const size_t half = num_terms_ / 2;
+  const auto plain_ptrs = pointers(plain);
+  const auto operand_ptrs = pointers(operands);
+  vector<uint64_t> result(moduli_.size() * COEFF_COUNT);
+  dot_product.compute({plain_ptrs.begin(), plain_ptrs.begin() + half},
+                      {{operand_ptrs.begin(), operand_ptrs.begin() + half}},
+                      {result.data()});
+  dot_product.compute({plain_ptrs.begin() + half, plain_ptrs.end()},
+                      {{operand_ptrs.begin() + half, operand_ptrs.end()}},
+                      {result.data()}, true);
+  EXPECT_THAT(result, ElementsAreArray(expected(operands, plain)));
+}
+
+TEST_P(DotProductTest, NoTerms) {
+  DotProduct dot_product(moduli_, COEFF_COUNT, allow_simd_);
+  vector<uint64_t> result(moduli_.size() * COEFF_COUNT, 1);
+  dot_product.compute({}, {{}}, {result.data()});
+  EXPECT_THAT(result, Each(0));
+}
+
+// Term counts on both sides of the 256 products a 60 bit accumulator takes,
+// and of the 4096 of the IFMA accumulators, before they have to be reduced.
+INSTANTIATE_TEST_SUITE_P(DotProducts, DotProductTest,
+                         Combine(Values(20, 50, 52, 60), Bool(),
+                                 Values(1, 7, 300, 4200)));
+
+TEST(DotProductSimdTest, NotUsedForWideModuli) {
+  DotProduct dot_product(moduli_for(60), COEFF_COUNT);
+  EXPECT_FALSE(dot_product.uses_simd());
+}
+
+}  // namespace
+}  // namespace pir
@@ -0,0 +1,79 @@
+//
+// Copyright 2020 the authors listed in CONTRIBUTORS.md
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#include "pir/cpp/key_cache.h"
+
+#include <iterator>
+
+namespace pir {
+
+KeyCache::KeyCache(std::size_t max_bytes, std::size_t max_entries)
+    : max_bytes_(max_bytes), max_entries_(max_entries) {}
+
+std::shared_ptr<const ClientKeys> KeyCache::Lookup(const std::string& key_id) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = index_.find(key_id);
+  if (it == index_.end()) {
+    ++metrics_.misses;
+    return nullptr;
+  }
+  ++metrics_.hits;
+  entries_.splice(entries_.begin(), entries_, it->second);
+  return it->second->keys;
+}
+
+void KeyCache::Insert(const std::string& key_id,
+                      std::shared_ptr<const ClientKeys> keys,
+                      std::size_t bytes) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = index_.find(key_id);
+  if (it != index_.end()) {
+    EraseLocked(it->second);
+  }
+  if (bytes > max_bytes_ || max_entries_ == 0) return;
+
+  while (!entries_.empty() && (metrics_.bytes + bytes > max_bytes_ ||
+                               entries_.size() >= max_entries_)) {
+    EraseLocked(std::prev(entries_.end()));
+    ++metrics_.evictions;
+  }
+  entries_.push_front(Entry{key_id, std::move(keys), bytes});
+  index_[key_id] = entries_.begin();
+  metrics_.bytes += bytes;
+  metrics_.entries = entries_.size();
+  ++metrics_.insertions;
+}
+
+void KeyCache::Erase(const std::string& key_id) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = index_.find(key_id);
+  if (it != index_.end()) {
+    EraseLocked(it->second);
+  }
+}
+
+KeyCacheMetrics KeyCache::Metrics() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return metrics_;
+}
+
+void KeyCache::EraseLocked(EntryList::iterator it) {
+  metrics_.bytes -= it->bytes;
+  index_.erase(it->key_id);
+  entries_.erase(it);
+  metrics_.entries = entries_.size();
+}
+
+}  // namespace pir
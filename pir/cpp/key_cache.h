@@ -0,0 +1,129 @@
+//
+// Copyright 2020 the authors listed in CONTRIBUTORS.md
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#ifndef PIR_KEY_CACHE_H_
+#define PIR_KEY_CACHE_H_
+
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include "seal/seal.h"
+
+namespace pir {
+
+/**
+ * Evaluation keys uploaded by a client, deserialized once and shared by every
+ * request that refers to them.
+ */
+struct ClientKeys {
+  seal::GaloisKeys galois_keys;
+  std::optional<seal::RelinKeys> relin_keys;
+};
+
+/**
+ * Counters describing the behaviour of a KeyCache.
+ */
+struct KeyCacheMetrics {
+  // Lookups that found the key ID.
+  std::size_t hits = 0;
+  // Lookups for a key ID that wasn't cached.
+  std::size_t misses = 0;
+  // Entries added, including replacements of an existing key ID.
+  std::size_t insertions = 0;
+  // Entries dropped to make room for newer ones.
+  std::size_t evictions = 0;
+  // Entries and bytes currently held.
+  std::size_t entries = 0;
+  std::size_t bytes = 0;
+};
+
+/**
+ * Thread safe least recently used cache of client keys, indexed by the key ID
+ * sent with each request. The cache is bounded both by the number of entries
+ * and by the total size of the keys it holds; the least recently used entries
+ * are evicted when either limit would be exceeded.
+ */
+class KeyCache {
+ public:
+  /**
+   * Creates an empty cache.
+   * @param[in] max_bytes Upper bound on the total size of the cached keys.
+   *    Zero disables the cache.
+   * @param[in] max_entries Upper bound on the number of cached key IDs.
+   */
+  KeyCache(std::size_t max_bytes, std::size_t max_entries);
+
+  KeyCache(const KeyCache&) = delete;
+  KeyCache& operator=(const KeyCache&) = delete;
+
+  /**
+   * Looks up the keys for a key ID and marks them as most recently used.
+   * @param[in] key_id Key ID to look up.
+   * @returns The keys, or nullptr if they aren't in the cache.
+   */
+  std::shared_ptr<const ClientKeys> Lookup(const std::string& key_id);
+
+  /**
+   * Adds keys to the cache, replacing any previous keys with the same ID, and
+   * evicts the least recently used entries until the limits are met again.
+   * Keys larger than the byte limit on their own aren't cached.
+   * @param[in] key_id Key ID the keys are stored under.
+   * @param[in] keys Keys to cache.
+   * @param[in] bytes Size accounted for the keys.
+   */
+  void Insert(const std::string& key_id, std::shared_ptr<const ClientKeys> keys,
+              std::size_t bytes);
+
+  /**
+   * Removes the keys for a key ID, if present.
+   */
+  void Erase(const std::string& key_id);
+
+  /**
+   * Returns a snapshot of the cache counters.
+   */
+  KeyCacheMetrics Metrics() const;
+
+ private:
+  struct Entry {
+    std::string key_id;
+    std::shared_ptr<const ClientKeys> keys;
+    std::size_t bytes;
+  };
+  using EntryList = std::list<Entry>;
+
+  void EraseLocked(EntryList::iterator it);
+
+  const std::size_t max_bytes_;
+  const std::size_t max_entries_;
+
+  mutable std::mutex mutex_;
+  // Most recently used first.
+  EntryList entries_;
+  std::unordered_map<std::string, EntryList::iterator> index_;
+  KeyCacheMetrics metrics_;
+};
+
+}  // namespace pir
+
+#endif  // PIR_KEY_CACHE_H_
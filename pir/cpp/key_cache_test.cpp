@@ -0,0 +1,115 @@
+//
+// Copyright 2020 the authors listed in CONTRIBUTORS.md
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "pir/cpp/key_cache.h"
+
+#include <memory>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace pir {
+namespace {
+
+using std::make_shared;
+using ::testing::Eq;
+using ::testing::IsNull;
+using ::testing::NotNull;
+
+TEST(KeyCacheTest, LookupAfterInsert) {
+  KeyCache cache(100, 10);
+  auto keys = make_shared<ClientKeys>();
+  cache.Insert("a", keys, 10);
+  EXPECT_THAT(cache.Lookup("a"), Eq(keys));
+  EXPECT_THAT(cache.Lookup("b"), IsNull());
+
+  const auto metrics = cache.Metrics();
+  EXPECT_THAT(metrics.hits, Eq(1));
+  EXPECT_THAT(metrics.misses, Eq(1));
+  EXPECT_THAT(metrics.insertions, Eq(1));
+  EXPECT_THAT(metrics.entries, Eq(1));
+  EXPECT_THAT(metrics.bytes, Eq(10));
+}
+
+TEST(KeyCacheTest, EvictsLeastRecentlyUsedByBytes) {
+  KeyCache cache(100, 10);
+  cache.Insert("a", make_shared<ClientKeys>(), 40);
+  cache.Insert("b", make_shared<ClientKeys>(), 40);
+  ASSERT_THAT(cache.Lookup("a"), NotNull());
+  cache.Insert("c", make_shared<ClientKeys>(), 40);
+
+  EXPECT_THAT(cache.Lookup("a"), NotNull());
+  EXPECT_THAT(cache.Lookup("b"), IsNull());
+  EXPECT_THAT(cache.Lookup("c"), NotNull());
+
+  const auto metrics = cache.Metrics();
+  EXPECT_THAT(metrics.evictions, Eq(1));
+  EXPECT_THAT(metrics.entries, Eq(2));
+  EXPECT_THAT(metrics.bytes, Eq(80));
+}
+
+TEST(KeyCacheTest, EvictsLeastRecentlyUsedByEntries) {
+  KeyCache cache(100, 2);
+  cache.Insert("a", make_shared<ClientKeys>(), 1);
+  cache.Insert("b", make_shared<ClientKeys>(), 1);
+  cache.Insert("c", make_shared<ClientKeys>(), 1);
+
+  EXPECT_THAT(cache.Lookup("a"), IsNull());
+  EXPECT_THAT(cache.Lookup("b"), NotNull());
+  EXPECT_THAT(cache.Lookup("c"), NotNull());
+  EXPECT_THAT(cache.Metrics().evictions, Eq(1));
+}
+
+TEST(KeyCacheTest, ReplaceExistingKeyId) {
+  KeyCache cache(100, 10);
+  cache.Insert("a", make_shared<ClientKeys>(), 30);
+  auto keys = make_shared<ClientKeys>();
+  cache.Insert("a", keys, 50);
+
+  EXPECT_THAT(cache.Lookup("a"), Eq(keys));
+  const auto metrics = cache.Metrics();
+  EXPECT_THAT(metrics.evictions, Eq(0));
+  EXPECT_THAT(metrics.entries, Eq(1));
+  EXPECT_THAT(metrics.bytes, Eq(50));
+}
+
+TEST(KeyCacheTest, OversizedKeysNotCached) {
+  KeyCache cache(100, 10);
+  cache.Insert("a", make_shared<ClientKeys>(), 10);
+  cache.Insert("b", make_shared<ClientKeys>(), 101);
+
+  EXPECT_THAT(cache.Lookup("a"), NotNull());
+  EXPECT_THAT(cache.Lookup("b"), IsNull());
+  EXPECT_THAT(cache.Metrics().evictions, Eq(0));
+}
+
+TEST(KeyCacheTest, DisabledCache) {
+  KeyCache cache(0, 10);
+  cache.Insert("a", make_shared<ClientKeys>(), 1);
+  EXPECT_THAT(cache.Lookup("a"), IsNull());
+  EXPECT_THAT(cache.Metrics().entries, Eq(0));
+}
+
+TEST(KeyCacheTest, Erase) {
+  KeyCache cache(100, 10);
+  cache.Insert("a", make_shared<ClientKeys>(), 10);
+  cache.Erase("a");
+  EXPECT_THAT(cache.Lookup("a"), IsNull());
+  EXPECT_THAT(cache.Metrics().bytes, Eq(0));
+}
+
+}  // namespace
+}  // namespace pir
@@ -0,0 +1,72 @@
+//
+// Copyright 2020 the authors listed in CONTRIBUTORS.md
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#include "pir/cpp/keyword_client.h"
+
+#include "absl/memory/memory.h"
+#include "pir/cpp/status_asserts.h"
+
+namespace pir {
+
+using std::size_t;
+using std::string;
+using std::vector;
+
+KeywordPIRClient::KeywordPIRClient(
+    std::shared_ptr<KeywordPIRParameters> params,
+    std::unique_ptr<PIRClient> client)
+    : params_(std::move(params)), client_(std::move(client)) {}
+
+StatusOr<std::unique_ptr<KeywordPIRClient>> KeywordPIRClient::Create(
+    std::shared_ptr<KeywordPIRParameters> params, size_t num_threads) {
+  // The bucket parameters live as long as the keyword parameters holding
+  // them.
+  std::shared_ptr<PIRParameters> bucket_params(
+      params, params->mutable_bucket_parameters());
+  ASSIGN_OR_RETURN(auto client,
+                   PIRClient::Create(bucket_params, false,
+                                     seal::Serialization::compr_mode_default,
+                                     num_threads));
+  return absl::WrapUnique(
+      new KeywordPIRClient(std::move(params), std::move(client)));
+}
+
+vector<size_t> KeywordPIRClient::buckets(const vector<string>& keys) const {
+  vector<size_t> result;
+  result.reserve(keys.size());
+  for (const auto& key : keys) {
+    result.push_back(KeywordBucket(*params_, key));
+  }
+  return result;
+}
+
+StatusOr<Request> KeywordPIRClient::CreateRequest(const vector<string>& keys,
+                                                  bool include_keys) const {
+  return client_->CreateRequest(buckets(keys), include_keys);
+}
+
+StatusOr<vector<std::optional<string>>> KeywordPIRClient::ProcessResponse(
+    const vector<string>& keys, const Response& response) const {
+  ASSIGN_OR_RETURN(auto items, client_->ProcessResponse(buckets(keys),
+                                                        response));
+  vector<std::optional<string>> result;
+  result.reserve(keys.size());
+  for (size_t i = 0; i < keys.size(); ++i) {
+    result.push_back(FindInKeywordBucket(*params_, items[i], keys[i]));
+  }
+  return result;
+}
+
+}  // namespace pir
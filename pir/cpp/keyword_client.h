@@ -0,0 +1,92 @@
+//
+// Copyright 2020 the authors listed in CONTRIBUTORS.md
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef PIR_KEYWORD_CLIENT_H_
+#define PIR_KEYWORD_CLIENT_H_
+
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "absl/status/statusor.h"
+#include "pir/cpp/client.h"
+#include "pir/cpp/keyword_table.h"
+
+namespace pir {
+
+using absl::StatusOr;
+
+/**
+ * Client of keyword PIR, which looks records up by key. Each key is fetched
+ * as the whole bucket it hashes to, and matched against the keys in the
+ * bucket once decrypted, so the server learns neither the key nor whether it
+ * exists.
+ */
+class KeywordPIRClient {
+ public:
+  /**
+   * Creates and returns a new client instance, from existing parameters.
+   * @param[in] params Keyword PIR parameters
+   * @param[in] num_threads Number of threads used to decrypt the replies of a
+   *    response. With 1, replies are decrypted on the calling thread.
+   * @returns InvalidArgument if the parameters are invalid
+   **/
+  static StatusOr<std::unique_ptr<KeywordPIRClient>> Create(
+      std::shared_ptr<KeywordPIRParameters> params,
+      std::size_t num_threads = 1);
+
+  /**
+   * Creates a new request for the buckets of the given keys.
+   * @param[in] keys Keys to look up.
+   * @param[in] include_keys Whether to send the encryption keys with the
+   *    request, as for PIRClient::CreateRequest.
+   * @returns InvalidArgument if the encryption fails
+   **/
+  StatusOr<Request> CreateRequest(const std::vector<std::string>& keys,
+                                  bool include_keys = true) const;
+
+  /**
+   * Extracts the values of the keys from the response to a request.
+   * @param[in] keys Keys the request was created with, in the same order.
+   * @param[in] response The response from the server.
+   * @returns The value of each key in the order of keys, nullopt for keys
+   *    that aren't in the database, or an error
+   **/
+  StatusOr<std::vector<std::optional<std::string>>> ProcessResponse(
+      const std::vector<std::string>& keys, const Response& response) const;
+
+  /**
+   * Identifier sent with every request so that a server can cache the keys.
+   **/
+  const std::string& KeyId() const { return client_->KeyId(); }
+
+  KeywordPIRClient() = delete;
+
+ private:
+  KeywordPIRClient(std::shared_ptr<KeywordPIRParameters> params,
+                   std::unique_ptr<PIRClient> client);
+
+  std::vector<std::size_t> buckets(const std::vector<std::string>& keys) const;
+
+  std::shared_ptr<KeywordPIRParameters> params_;
+  // Client of the bucket database.
+  std::unique_ptr<PIRClient> client_;
+};
+
+}  // namespace pir
+
+#endif  // PIR_KEYWORD_CLIENT_H_
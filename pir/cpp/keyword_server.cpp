@@ -0,0 +1,56 @@
+//
+// Copyright 2020 the authors listed in CONTRIBUTORS.md
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#include "pir/cpp/keyword_server.h"
+
+#include "absl/memory/memory.h"
+#include "pir/cpp/database.h"
+#include "pir/cpp/record_source.h"
+#include "pir/cpp/status_asserts.h"
+
+namespace pir {
+
+using std::size_t;
+using std::string;
+using std::vector;
+
+StatusOr<std::unique_ptr<KeywordPIRServer>> KeywordPIRServer::Create(
+    const vector<std::pair<string, string>>& records,
+    std::shared_ptr<KeywordPIRParameters> params, size_t num_threads,
+    size_t key_cache_bytes) {
+  std::shared_ptr<PIRParameters> bucket_params(
+      params, params->mutable_bucket_parameters());
+  vector<vector<std::pair<absl::string_view, absl::string_view>>> buckets(
+      bucket_params->num_items());
+  for (const auto& [key, value] : records) {
+    buckets[KeywordBucket(*params, key)].emplace_back(key, value);
+  }
+
+  // Buckets are serialized as the database reads them, so that only the
+  // plaintexts being encoded are ever held as strings.
+  CallbackRecordSource source(
+      buckets.size(), [&](size_t i, string& out) -> Status {
+        return EncodeKeywordBucket(*params, buckets[i], out);
+      });
+  ASSIGN_OR_RETURN(auto db,
+                   PIRDatabase::Create(source, bucket_params, num_threads));
+  ASSIGN_OR_RETURN(auto server,
+                   PIRServer::Create(db, bucket_params, num_threads,
+                                     key_cache_bytes));
+  return absl::WrapUnique(
+      new KeywordPIRServer(std::move(params), std::move(server)));
+}
+
+}  // namespace pir
@@ -0,0 +1,78 @@
+//
+// Copyright 2020 the authors listed in CONTRIBUTORS.md
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef PIR_KEYWORD_SERVER_H_
+#define PIR_KEYWORD_SERVER_H_
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/status/statusor.h"
+#include "pir/cpp/keyword_table.h"
+#include "pir/cpp/server.h"
+
+namespace pir {
+
+using absl::StatusOr;
+
+/**
+ * Server of keyword PIR. Holds the records in a database of buckets, and
+ * answers requests for buckets like an index based server.
+ */
+class KeywordPIRServer {
+ public:
+  /**
+   * Creates and returns a new server instance, hashing the records into the
+   * buckets of the database.
+   * @param[in] records Key and value of every record, with the keys the
+   *    parameters were created for and values of bytes_per_value bytes.
+   * @param[in] params Keyword PIR parameters
+   * @param[in] num_threads Number of threads used to populate the database
+   *    and process the queries of a request, as for PIRServer::Create.
+   * @param[in] key_cache_bytes Size limit of the cache of deserialized client
+   *    keys, as for PIRServer::Create.
+   * @returns InvalidArgument if the records don't fit the parameters or the
+   *    database encoding fails
+   **/
+  static StatusOr<std::unique_ptr<KeywordPIRServer>> Create(
+      const std::vector<std::pair<std::string, std::string>>& records,
+      std::shared_ptr<KeywordPIRParameters> params,
+      std::size_t num_threads = 1, std::size_t key_cache_bytes = 0);
+
+  /**
+   * Handles a client request. See PIRServer::ProcessRequest.
+   **/
+  StatusOr<Response> ProcessRequest(const Request& request) const {
+    return server_->ProcessRequest(request);
+  }
+
+  KeywordPIRServer() = delete;
+
+ private:
+  KeywordPIRServer(std::shared_ptr<KeywordPIRParameters> params,
+                   std::unique_ptr<PIRServer> server)
+      : params_(std::move(params)), server_(std::move(server)) {}
+
+  std::shared_ptr<KeywordPIRParameters> params_;
+  // Server of the bucket database.
+  std::unique_ptr<PIRServer> server_;
+};
+
+}  // namespace pir
+
+#endif  // PIR_KEYWORD_SERVER_H_
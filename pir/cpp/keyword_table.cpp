@@ -0,0 +1,200 @@
+//
+// Copyright 2020 the authors listed in CONTRIBUTORS.md
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#include "pir/cpp/keyword_table.h"
+
+#include <algorithm>
+#include <string_view>
+#include <unordered_set>
+
+#include "pir/cpp/status_asserts.h"
+#include "pir/cpp/string_encoder.h"
+#include "seal/seal.h"
+
+namespace pir {
+
+using absl::InvalidArgumentError;
+using std::size_t;
+using std::string;
+using std::vector;
+
+namespace {
+
+// Largest average number of records per bucket tried when sizing the table.
+constexpr size_t kMaxAverageLoad = 64;
+
+// FNV-1a of the key, so that buckets don't depend on the standard library,
+// finished with SplitMix64 to spread the seed over all bits.
+uint64_t hash_key(uint64_t seed, absl::string_view key) {
+  uint64_t x = 0xcbf29ce484222325ULL;
+  for (const unsigned char c : key) {
+    x ^= c;
+    x *= 0x100000001b3ULL;
+  }
+  x ^= seed;
+  x ^= x >> 30;
+  x *= 0xbf58476d1ce4e5b9ULL;
+  x ^= x >> 27;
+  x *= 0x94d049bb133111ebULL;
+  x ^= x >> 31;
+  return x;
+}
+
+size_t slot_bytes(const KeywordPIRParameters& params) {
+  return 1 + params.max_key_bytes() + params.bytes_per_value();
+}
+
+// Number of records in the fullest bucket of a table of num_buckets.
+size_t max_load(const vector<uint64_t>& hashes, size_t num_buckets) {
+  vector<size_t> loads(num_buckets, 0);
+  size_t result = 0;
+  for (const auto hash : hashes) {
+    result = std::max(result, ++loads[hash % num_buckets]);
+  }
+  return result;
+}
+
+}  // namespace
+
+size_t KeywordBucket(const KeywordPIRParameters& params,
+                     absl::string_view key) {
+  return hash_key(params.hash_seed(), key) %
+         params.bucket_parameters().num_items();
+}
+
+Status EncodeKeywordBucket(
+    const KeywordPIRParameters& params,
+    const vector<std::pair<absl::string_view, absl::string_view>>& records,
+    string& out) {
+  if (records.size() > params.slots_per_bucket()) {
+    return InvalidArgumentError(
+        std::to_string(records.size()) + " records in a bucket of " +
+        std::to_string(params.slots_per_bucket()) + " slots");
+  }
+  const size_t start = out.size();
+  for (const auto& [key, value] : records) {
+    if (key.size() > params.max_key_bytes()) {
+      return InvalidArgumentError("Key of " + std::to_string(key.size()) +
+                                  " bytes is too long");
+    }
+    if (value.size() != params.bytes_per_value()) {
+      return InvalidArgumentError(
+          "Value is " + std::to_string(value.size()) + " bytes, expected " +
+          std::to_string(params.bytes_per_value()));
+    }
+    out.push_back(static_cast<char>(key.size() + 1));
+    out.append(key.data(), key.size());
+    out.append(params.max_key_bytes() - key.size(), 0);
+    out.append(value.data(), value.size());
+  }
+  out.resize(start + params.bucket_parameters().bytes_per_item(), 0);
+  return absl::OkStatus();
+}
+
+std::optional<string> FindInKeywordBucket(const KeywordPIRParameters& params,
+                                          absl::string_view bucket,
+                                          absl::string_view key) {
+  const size_t slot_size = slot_bytes(params);
+  for (size_t offset = 0; offset + slot_size <= bucket.size();
+       offset += slot_size) {
+    const size_t length = static_cast<unsigned char>(bucket[offset]);
+    // Slots are filled in order, so the first empty one ends the bucket.
+    if (length == 0) break;
+    if (bucket.substr(offset + 1, length - 1) == key) {
+      return string(
+          bucket.substr(offset + 1 + params.max_key_bytes(),
+                        params.bytes_per_value()));
+    }
+  }
+  return std::nullopt;
+}
+
+StatusOr<std::shared_ptr<KeywordPIRParameters>> CreateKeywordPIRParameters(
+    const vector<string>& keys, size_t bytes_per_value, size_t dimensions,
+    EncryptionParameters enc_params, bool use_ciphertext_multiplication,
+    size_t bits_per_coeff) {
+  auto params = std::make_shared<KeywordPIRParameters>();
+  params->set_bytes_per_value(bytes_per_value);
+  params->set_hash_seed(DEFAULT_KEYWORD_HASH_SEED);
+
+  std::unordered_set<std::string_view> seen;
+  vector<uint64_t> hashes;
+  hashes.reserve(keys.size());
+  size_t max_key_bytes = 0;
+  for (const auto& key : keys) {
+    if (key.size() > MAX_KEYWORD_BYTES) {
+      return InvalidArgumentError("Key of " + std::to_string(key.size()) +
+                                  " bytes is too long");
+    }
+    if (!seen.insert(key).second) {
+      return InvalidArgumentError("Repeated key " + key);
+    }
+    max_key_bytes = std::max(max_key_bytes, key.size());
+    hashes.push_back(hash_key(params->hash_seed(), key));
+  }
+  params->set_max_key_bytes(max_key_bytes);
+  const size_t slot_size = slot_bytes(*params);
+
+  auto seal_context = seal::SEALContext::Create(enc_params);
+  if (!seal_context->parameters_set()) {
+    return InvalidArgumentError(
+        string("Error setting encryption parameters: ") +
+        seal_context->parameter_error_message());
+  }
+  StringEncoder encoder(seal_context);
+  if (bits_per_coeff > 0) {
+    if (bits_per_coeff > encoder.bits_per_coeff()) {
+      return InvalidArgumentError("Bits per coefficient greater than max");
+    }
+    encoder.set_bits_per_coeff(bits_per_coeff);
+  }
+  const size_t max_slots = encoder.max_bytes_per_plaintext() / slot_size;
+
+  // Number of buckets and slots of the smallest table found so far.
+  size_t best_num_pt = 0, best_buckets = 0, best_slots = 0;
+  for (size_t load = 1; load <= kMaxAverageLoad; load *= 2) {
+    size_t num_buckets = std::max<size_t>((keys.size() + load - 1) / load, 1);
+    size_t slots = std::max<size_t>(max_load(hashes, num_buckets), 1);
+    if (slots > max_slots) continue;
+    // Rounding up to whole plaintexts makes the table emptier, but changes
+    // where every key goes, so the fullest bucket is found again.
+    size_t items_per_pt = encoder.num_items_per_plaintext(slots * slot_size);
+    num_buckets = (num_buckets + items_per_pt - 1) / items_per_pt *
+                  items_per_pt;
+    slots = std::max<size_t>(max_load(hashes, num_buckets), 1);
+    if (slots > max_slots) continue;
+    items_per_pt = encoder.num_items_per_plaintext(slots * slot_size);
+    const size_t num_pt = (num_buckets + items_per_pt - 1) / items_per_pt;
+    if (best_num_pt == 0 || num_pt < best_num_pt) {
+      best_num_pt = num_pt;
+      best_buckets = num_buckets;
+      best_slots = slots;
+    }
+  }
+  if (best_num_pt == 0) {
+    return InvalidArgumentError("Cannot fit a bucket within one plaintext");
+  }
+
+  params->set_slots_per_bucket(best_slots);
+  ASSIGN_OR_RETURN(auto bucket_params,
+                   CreatePIRParameters(best_buckets, best_slots * slot_size,
+                                       dimensions, enc_params,
+                                       use_ciphertext_multiplication,
+                                       bits_per_coeff));
+  *params->mutable_bucket_parameters() = *bucket_params;
+  return params;
+}
+
+}  // namespace pir
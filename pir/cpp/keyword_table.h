@@ -0,0 +1,109 @@
+//
+// Copyright 2020 the authors listed in CONTRIBUTORS.md
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef PIR_KEYWORD_TABLE_H_
+#define PIR_KEYWORD_TABLE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "pir/cpp/parameters.h"
+#include "pir/proto/payload.pb.h"
+
+namespace pir {
+
+using absl::Status;
+using absl::StatusOr;
+
+// Longest key a keyword table can hold. Each slot stores the key length in a
+// single byte, with zero marking an empty slot.
+constexpr std::size_t MAX_KEYWORD_BYTES = 254;
+
+// Seed of the hash function mapping keys to buckets. The table isn't secret,
+// so a fixed seed keeps it the same from run to run.
+constexpr uint64_t DEFAULT_KEYWORD_HASH_SEED = 0x6b6579;
+
+/**
+ * Bucket a key hashes to.
+ * @param[in] params Keyword parameters.
+ * @param[in] key Key to look up.
+ * @returns Index of the bucket in the bucket database
+ */
+std::size_t KeywordBucket(const KeywordPIRParameters& params,
+                          absl::string_view key);
+
+/**
+ * Serializes the records of a bucket into a database item of
+ * bucket_parameters.bytes_per_item bytes. Each slot holds the length of the
+ * key plus one, the key padded to max_key_bytes and the value. Unused slots
+ * are zero.
+ * @param[in] params Keyword parameters.
+ * @param[in] records Key and value of each record hashed to the bucket.
+ * @param[out] out String the item is appended to.
+ * @returns InvalidArgument if there are more records than slots, or a key or
+ *    value doesn't fit its slot
+ */
+Status EncodeKeywordBucket(
+    const KeywordPIRParameters& params,
+    const std::vector<std::pair<absl::string_view, absl::string_view>>&
+        records,
+    std::string& out);
+
+/**
+ * Finds the value of a key in a bucket serialized by EncodeKeywordBucket.
+ * @param[in] params Keyword parameters.
+ * @param[in] bucket The bucket item.
+ * @param[in] key Key to look up.
+ * @returns The value, or nullopt if the bucket doesn't hold the key
+ */
+std::optional<std::string> FindInKeywordBucket(
+    const KeywordPIRParameters& params, absl::string_view bucket,
+    absl::string_view key);
+
+/**
+ * Helper function to create the parameters of keyword PIR for a set of keys.
+ * The number of buckets trades slots for buckets: fewer, fuller buckets
+ * waste fewer slots but the fullest bucket sets the size of all of them. Of
+ * the loads tried, the one needing the fewest database plaintexts is kept,
+ * with the number of buckets rounded up to fill the last plaintext.
+ * @param[in] keys Keys of every record, each at most MAX_KEYWORD_BYTES long.
+ * @param[in] bytes_per_value Size in bytes of every value.
+ * @param[in] dimensions Number of dimensions of the bucket database.
+ * @param[in] enc_params SEAL Encryption Parameters to be used.
+ * @param[in] use_ciphertext_multiplication Multiply selection vectors as
+ *    ciphertexts rather than decomposing them.
+ * @param[in] bits_per_coeff If non-zero, number of bits to encode per
+ *    plaintext coefficient.
+ * @returns InvalidArgument if a key is too long or repeated, or if no bucket
+ *    size fits within one plaintext
+ */
+StatusOr<std::shared_ptr<KeywordPIRParameters>> CreateKeywordPIRParameters(
+    const std::vector<std::string>& keys, std::size_t bytes_per_value,
+    std::size_t dimensions = 1,
+    EncryptionParameters enc_params = GenerateEncryptionParams(),
+    bool use_ciphertext_multiplication = false,
+    std::size_t bits_per_coeff = 0);
+
+}  // namespace pir
+
+#endif  // PIR_KEYWORD_TABLE_H_
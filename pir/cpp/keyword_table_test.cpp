@@ -0,0 +1,123 @@
+//
+// Copyright 2020 the authors listed in CONTRIBUTORS.md
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "pir/cpp/keyword_table.h"
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "pir/cpp/status_asserts.h"
+
+namespace pir {
+namespace {
+
+using std::size_t;
+using std::string;
+using std::vector;
+using ::testing::Eq;
+using ::testing::Le;
+using ::testing::Optional;
+
+KeywordPIRParameters MakeParams(size_t slots, size_t max_key_bytes,
+                                size_t bytes_per_value) {
+  KeywordPIRParameters params;
+  params.set_slots_per_bucket(slots);
+  params.set_max_key_bytes(max_key_bytes);
+  params.set_bytes_per_value(bytes_per_value);
+  params.set_hash_seed(DEFAULT_KEYWORD_HASH_SEED);
+  params.mutable_bucket_parameters()->set_num_items(10);
+  params.mutable_bucket_parameters()->set_bytes_per_item(
+      slots * (1 + max_key_bytes + bytes_per_value));
+  return params;
+}
+
+TEST(KeywordTableTest, EncodeAndFind) {
+  const auto params = MakeParams(3, 5, 4);
+  string bucket;
+  ASSERT_OK(EncodeKeywordBucket(
+      params, {{"alice", "aaaa"}, {"bob", "bbbb"}, {"", "eeee"}}, bucket));
+  EXPECT_THAT(bucket.size(), Eq(params.bucket_parameters().bytes_per_item()));
+
+  EXPECT_THAT(FindInKeywordBucket(params, bucket, "alice"),
+              Optional(Eq("aaaa")));
+  EXPECT_THAT(FindInKeywordBucket(params, bucket, "bob"),
+              Optional(Eq("bbbb")));
+  EXPECT_THAT(FindInKeywordBucket(params, bucket, ""),
+              Optional(Eq("eeee")));
+  EXPECT_THAT(FindInKeywordBucket(params, bucket, "bo"), Eq(std::nullopt));
+  EXPECT_THAT(FindInKeywordBucket(params, bucket, "carol"), Eq(std::nullopt));
+}
+
+TEST(KeywordTableTest, EncodePadsEmptySlots) {
+  const auto params = MakeParams(3, 5, 4);
+  string bucket;
+  ASSERT_OK(EncodeKeywordBucket(params, {}, bucket));
+  EXPECT_THAT(bucket, Eq(string(params.bucket_parameters().bytes_per_item(),
+                                0)));
+  EXPECT_THAT(FindInKeywordBucket(params, bucket, ""), Eq(std::nullopt));
+}
+
+TEST(KeywordTableTest, EncodeInvalid) {
+  const auto params = MakeParams(1, 5, 4);
+  string bucket;
+  EXPECT_THAT(EncodeKeywordBucket(params, {{"a", "aaaa"}, {"b", "bbbb"}},
+                                  bucket)
+                  .code(),
+              Eq(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(
+      EncodeKeywordBucket(params, {{"toolong", "aaaa"}}, bucket).code(),
+      Eq(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(EncodeKeywordBucket(params, {{"a", "aaa"}}, bucket).code(),
+              Eq(absl::StatusCode::kInvalidArgument));
+}
+
+TEST(KeywordTableTest, CreateParamsFitsEveryBucket) {
+  vector<string> keys;
+  for (size_t i = 0; i < 2000; ++i) {
+    keys.push_back("user" + std::to_string(i * 7919));
+  }
+  ASSIGN_OR_FAIL(auto params, CreateKeywordPIRParameters(keys, 8));
+  const auto& bucket_params = params->bucket_parameters();
+  EXPECT_THAT(params->max_key_bytes(), Eq(12));
+  EXPECT_THAT(bucket_params.bytes_per_item(),
+              Eq(params->slots_per_bucket() * (1 + 12 + 8)));
+  // The last plaintext is full.
+  EXPECT_THAT(bucket_params.num_items() % bucket_params.items_per_plaintext(),
+              Eq(0));
+
+  std::map<size_t, size_t> loads;
+  for (const auto& key : keys) {
+    const auto b = KeywordBucket(*params, key);
+    ASSERT_THAT(b, Le(bucket_params.num_items() - 1));
+    EXPECT_THAT(++loads[b], Le(params->slots_per_bucket()));
+  }
+}
+
+TEST(KeywordTableTest, CreateParamsInvalid) {
+  EXPECT_THAT(CreateKeywordPIRParameters({"a", "b", "a"}, 8).status().code(),
+              Eq(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(CreateKeywordPIRParameters({string(MAX_KEYWORD_BYTES + 1, 'k')},
+                                         8)
+                  .status()
+                  .code(),
+              Eq(absl::StatusCode::kInvalidArgument));
+}
+
+}  // namespace
+}  // namespace pir
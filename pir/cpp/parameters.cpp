@@ -15,6 +15,8 @@
 //
 #include "pir/cpp/parameters.h"
 
+#include <algorithm>
+
 #include "pir/cpp/database.h"
 #include "pir/cpp/serialization.h"
 #include "pir/cpp/status_asserts.h"
@@ -56,7 +58,7 @@ EncryptionParameters GenerateEncryptionParams(
 StatusOr<shared_ptr<PIRParameters>> CreatePIRParameters(
     size_t dbsize, size_t bytes_per_item, size_t dimensions,
     EncryptionParameters seal_params, bool use_ciphertext_multiplication,
-    size_t bits_per_coeff) {
+    size_t bits_per_coeff, size_t num_shards) {
   // Make sure SEAL Parameter are valid
   auto seal_context = seal::SEALContext::Create(seal_params);
   if (!seal_context->parameters_set()) {
@@ -103,6 +105,26 @@ StatusOr<shared_ptr<PIRParameters>> CreatePIRParameters(
        PIRDatabase::calculate_dimensions(parameters->num_pt(), dimensions))
     parameters->add_dimensions(dim);
 
+  if (num_shards == 0 ||
+      (num_shards > 1 && num_shards > parameters->dimensions(0))) {
+    return InvalidArgumentError(
+        "Number of shards must be between 1 and the " +
+        std::to_string(parameters->dimensions(0)) +
+        " rows of the first dimension");
+  }
+  if (num_shards > 1) parameters->set_num_shards(num_shards);
+
+  return parameters;
+}
+
+StatusOr<shared_ptr<PIRParameters>> ShardParameters(
+    const PIRParameters& params, size_t shard_index) {
+  if (shard_index >= std::max<size_t>(params.num_shards(), 1)) {
+    return InvalidArgumentError("Shard index " + std::to_string(shard_index) +
+                                " is out of range");
+  }
+  auto parameters = make_shared<PIRParameters>(params);
+  parameters->set_shard_index(shard_index);
   return parameters;
 }
 
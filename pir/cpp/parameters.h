@@ -64,12 +64,29 @@ EncryptionParameters GenerateEncryptionParams(uint32_t poly_mod_degree,
  * @param[in] enc_params SEAL Encryption Parameters to be used.
  * @param[in] bits_per_coeff If non-zero, number of bits to encode per plaintext
  *    plaintext coefficient in the database.
- * @returns InvalidArgument if EncryptionParameters serialization fails.
+ * @param[in] num_shards Number of servers the rows of the first dimension are
+ *    split between. See ShardParameters.
+ * @returns InvalidArgument if EncryptionParameters serialization fails, or if
+ *    there are more shards than rows in the first dimension.
  */
 StatusOr<std::shared_ptr<PIRParameters>> CreatePIRParameters(
     size_t dbsize, size_t bytes_per_item, size_t dimensions = 1,
     EncryptionParameters enc_params = GenerateEncryptionParams(),
-    bool use_ciphertext_multiplication = false, size_t bits_per_coeff = 0);
+    bool use_ciphertext_multiplication = false, size_t bits_per_coeff = 0,
+    size_t num_shards = 1);
+
+/**
+ * Returns the parameters of one shard of a sharded database, for its
+ * database and server. Each shard holds a contiguous range of rows of the
+ * first dimension, and replies with its part of the sum over those rows, so
+ * the replies of all shards add up to the reply of a single server. Clients
+ * use the parameters of the whole database.
+ * @param[in] params Parameters of the whole database.
+ * @param[in] shard_index Index of the shard.
+ * @returns InvalidArgument if the shard index is out of range
+ */
+StatusOr<std::shared_ptr<PIRParameters>> ShardParameters(
+    const PIRParameters& params, size_t shard_index);
 }  // namespace pir
 
 #endif  // PIR_PARAMETERS_H_
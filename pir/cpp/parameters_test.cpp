@@ -97,6 +97,34 @@ TEST(PIRParametersTest, CreateAllParams) {
       << context->parameter_error_message();
 }
 
+TEST(PIRParametersTest, CreateSharded) {
+  ASSIGN_OR_FAIL(auto pir_params,
+                 CreatePIRParameters(19011, 500, 3, GenerateEncryptionParams(),
+                                     false, 0, 4));
+  EXPECT_THAT(pir_params->num_shards(), Eq(4));
+  EXPECT_THAT(pir_params->shard_index(), Eq(0));
+
+  ASSIGN_OR_FAIL(auto shard_params, ShardParameters(*pir_params, 3));
+  EXPECT_THAT(shard_params->shard_index(), Eq(3));
+  EXPECT_THAT(shard_params->num_shards(), Eq(4));
+  EXPECT_THAT(shard_params->dimensions(), ElementsAre(11, 10, 10));
+  EXPECT_THAT(ShardParameters(*pir_params, 4).status().code(),
+              Eq(absl::StatusCode::kInvalidArgument));
+}
+
+TEST(PIRParametersTest, CreateTooManyShards) {
+  EXPECT_THAT(CreatePIRParameters(19011, 500, 3, GenerateEncryptionParams(),
+                                  false, 0, 12)
+                  .status()
+                  .code(),
+              Eq(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(CreatePIRParameters(19011, 500, 3, GenerateEncryptionParams(),
+                                  false, 0, 0)
+                  .status()
+                  .code(),
+              Eq(absl::StatusCode::kInvalidArgument));
+}
+
 TEST(PIRParametersTest, EncryptionParamsSerialization) {
   // use something other than defaults
   auto params = GenerateEncryptionParams(8192);
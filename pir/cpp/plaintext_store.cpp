@@ -0,0 +1,625 @@
+//
+// Copyright 2020 the authors listed in CONTRIBUTORS.md
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#include "pir/cpp/plaintext_store.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <stdexcept>
+
+#include "absl/memory/memory.h"
+#include "pir/cpp/status_asserts.h"
+#include "pir/cpp/utils.h"
+#include "seal/util/ntt.h"
+
+namespace pir {
+
+using absl::InternalError;
+using absl::InvalidArgumentError;
+using std::uint64_t;
+
+namespace {
+
+constexpr char kMagic[8] = {'P', 'I', 'R', 'S', 'N', 'A', 'P', '\0'};
+constexpr std::uint32_t kVersion = 1;
+constexpr std::uint32_t kByteOrder = 0x01020304;
+
+// Alignment of the sections of a snapshot. Plaintexts start at a page
+// boundary, and each one on a cache line.
+constexpr uint64_t kLineSize = 64;
+constexpr uint64_t kPageSize = 4096;
+
+struct SnapshotHeader {
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t byte_order;
+  uint64_t params_offset;
+  uint64_t params_size;
+  uint64_t coeff_counts_offset;
+  uint64_t num_plaintexts;
+  uint64_t data_offset;
+  // Words between the start of consecutive plaintexts.
+  uint64_t slot_words;
+  uint64_t parms_id[4];
+};
+
+static_assert(sizeof(seal::parms_id_type) == sizeof(SnapshotHeader::parms_id),
+              "parms_id size mismatch");
+
+uint64_t align_up(uint64_t value, uint64_t alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+// Returns true if [offset, offset + length) is within a file of the given
+// size, without overflowing.
+bool in_file(uint64_t offset, uint64_t length, uint64_t file_size) {
+  return offset <= file_size && length <= file_size - offset;
+}
+
+// Opens a file for reading and returns its descriptor, along with its size.
+StatusOr<int> open_snapshot(const std::string& path, uint64_t& file_size) {
+  const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    const std::string error = path + ": " + std::strerror(errno);
+    return errno == ENOENT ? absl::NotFoundError(error) : InternalError(error);
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    const std::string error = path + ": " + std::strerror(errno);
+    close(fd);
+    return InternalError(error);
+  }
+  file_size = st.st_size;
+  if (file_size < sizeof(SnapshotHeader)) {
+    close(fd);
+    return InvalidArgumentError(path + " is too small to be a snapshot");
+  }
+  return fd;
+}
+
+// Everything in a snapshot but the plaintexts.
+struct SnapshotInfo {
+  SnapshotHeader header;
+  PIRParameters params;
+  std::vector<uint64_t> coeff_counts;
+};
+
+// Reads and checks the header, parameters and coefficient counts of a
+// snapshot of file_size bytes. read copies size bytes of the file from
+// offset to dest, and is only called for ranges within the file.
+Status read_snapshot_info(
+    const std::string& path, uint64_t file_size,
+    const std::function<Status(uint64_t offset, uint64_t size, void* dest)>&
+        read,
+    SnapshotInfo& info) {
+  auto& header = info.header;
+  RETURN_IF_ERROR(read(0, sizeof(header), &header));
+  if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0) {
+    return InvalidArgumentError(path + " is not a PIR database snapshot");
+  }
+  if (header.byte_order != kByteOrder) {
+    return InvalidArgumentError(path + " was written with another byte order");
+  }
+  if (header.version != kVersion) {
+    return InvalidArgumentError(path + " has unsupported snapshot version " +
+                                std::to_string(header.version));
+  }
+
+  const uint64_t slot_bytes = header.slot_words * sizeof(uint64_t);
+  if (!in_file(header.params_offset, header.params_size, file_size) ||
+      header.num_plaintexts > file_size / sizeof(uint64_t) ||
+      !in_file(header.coeff_counts_offset,
+               header.num_plaintexts * sizeof(uint64_t), file_size) ||
+      header.data_offset % kLineSize != 0 ||
+      header.slot_words > file_size / sizeof(uint64_t) ||
+      !in_file(header.data_offset, 0, file_size) ||
+      (slot_bytes > 0 &&
+       header.num_plaintexts > (file_size - header.data_offset) / slot_bytes)) {
+    return InvalidArgumentError(path + " is truncated or corrupt");
+  }
+  std::string serialized_params(header.params_size, '\0');
+  RETURN_IF_ERROR(
+      read(header.params_offset, header.params_size, &serialized_params[0]));
+  if (!info.params.ParseFromString(serialized_params)) {
+    return InvalidArgumentError(path + " has invalid PIR parameters");
+  }
+
+  info.coeff_counts.resize(header.num_plaintexts);
+  RETURN_IF_ERROR(read(header.coeff_counts_offset,
+                       header.num_plaintexts * sizeof(uint64_t),
+                       info.coeff_counts.data()));
+  for (const auto coeff_count : info.coeff_counts) {
+    if (coeff_count > header.slot_words) {
+      return InvalidArgumentError(path + " is truncated or corrupt");
+    }
+  }
+  return absl::OkStatus();
+}
+
+// Reads size bytes of fd from offset to dest.
+Status pread_fully(int fd, const std::string& path, uint64_t offset,
+                   uint64_t size, void* dest) {
+  auto* bytes = static_cast<char*>(dest);
+  while (size > 0) {
+    const ssize_t n = pread(fd, bytes, size, offset);
+    if (n < 0 && errno == EINTR) continue;
+    if (n < 0) {
+      return InternalError("Unable to read " + path + ": " +
+                           std::strerror(errno));
+    }
+    if (n == 0) {
+      return InternalError("Unable to read " + path + ": file was truncated");
+    }
+    bytes += n;
+    offset += n;
+    size -= n;
+  }
+  return absl::OkStatus();
+}
+
+// Scan reading each plaintext from the store when asked for it.
+class DirectScan : public PlaintextStore::Scan {
+ public:
+  explicit DirectScan(const PlaintextStore& store) : store_(store) {}
+
+  const uint64_t* data(std::size_t i, uint64_t* scratch) override {
+    return store_.data(i, scratch);
+  }
+  const seal::Plaintext& plaintext(std::size_t i,
+                                   seal::Plaintext& scratch) override {
+    return store_.plaintext(i, scratch);
+  }
+
+ private:
+  const PlaintextStore& store_;
+};
+
+}  // namespace
+
+std::unique_ptr<PlaintextStore::Scan> PlaintextStore::scan(
+    std::size_t, std::size_t) const {
+  return absl::make_unique<DirectScan>(*this);
+}
+
+// Reads patched plaintexts from the patches, and the others through a scan
+// of the base store.
+class PatchedPlaintextStore::PatchedScan : public PlaintextStore::Scan {
+ public:
+  PatchedScan(const PatchedPlaintextStore& store, std::size_t begin,
+              std::size_t end)
+      : patches_(store.patches_), base_(store.base_->scan(begin, end)) {}
+
+  const uint64_t* data(std::size_t i, uint64_t* scratch) override {
+    return patches_[i] ? patches_[i]->data() : base_->data(i, scratch);
+  }
+  const seal::Plaintext& plaintext(std::size_t i,
+                                   seal::Plaintext& scratch) override {
+    return patches_[i] ? *patches_[i] : base_->plaintext(i, scratch);
+  }
+
+ private:
+  const std::vector<std::shared_ptr<const seal::Plaintext>>& patches_;
+  const std::unique_ptr<PlaintextStore::Scan> base_;
+};
+
+std::shared_ptr<const PlaintextStore> PatchedPlaintextStore::Create(
+    std::shared_ptr<const PlaintextStore> base,
+    const std::vector<Patch>& patches) {
+  std::vector<std::shared_ptr<const seal::Plaintext>> replaced;
+  if (const auto* patched =
+          dynamic_cast<const PatchedPlaintextStore*>(base.get())) {
+    replaced = patched->patches_;
+    base = patched->base_;
+  } else {
+    replaced.resize(base->size());
+  }
+  for (const auto& patch : patches) {
+    replaced[patch.first] = patch.second;
+  }
+  return std::shared_ptr<const PlaintextStore>(
+      new PatchedPlaintextStore(std::move(base), std::move(replaced)));
+}
+
+std::unique_ptr<PlaintextStore::Scan> PatchedPlaintextStore::scan(
+    std::size_t begin, std::size_t end) const {
+  return absl::make_unique<PatchedScan>(*this, begin, end);
+}
+
+PackedPlaintextStore::PackedPlaintextStore(
+    std::shared_ptr<seal::SEALContext> context, std::size_t size, int bits,
+    bool ntt)
+    : context_data_(context->first_context_data()),
+      poly_modulus_degree_(context_data_->parms().poly_modulus_degree()),
+      coeff_modulus_(context_data_->parms().coeff_modulus()),
+      plain_modulus_(context_data_->parms().plain_modulus().value()),
+      bits_(bits),
+      ntt_(ntt),
+      parms_id_(ntt ? context->first_parms_id() : seal::parms_id_zero),
+      slot_words_((poly_modulus_degree_ * bits + 63) / 64),
+      words_(size * slot_words_),
+      coeff_counts_(size) {}
+
+Status PackedPlaintextStore::set(std::size_t i, const seal::Plaintext& pt) {
+  if (pt.is_ntt_form()) {
+    return InvalidArgumentError(
+        "Packed plaintexts must be in coefficient form");
+  }
+  if (pt.coeff_count() > poly_modulus_degree_) {
+    return InvalidArgumentError("Plaintext has too many coefficients");
+  }
+  uint64_t* slot = &words_[i * slot_words_];
+  std::fill_n(slot, slot_words_, 0);
+  for (std::size_t c = 0, bit = 0; c < pt.coeff_count(); ++c, bit += bits_) {
+    const uint64_t value = pt[c];
+    if (value >> bits_ != 0) {
+      return InvalidArgumentError("Coefficient " + std::to_string(value) +
+                                  " does not fit in " + std::to_string(bits_) +
+                                  " bits");
+    }
+    const std::size_t shift = bit % 64;
+    slot[bit / 64] |= value << shift;
+    if (shift + bits_ > 64) {
+      slot[bit / 64 + 1] |= value >> (64 - shift);
+    }
+  }
+  coeff_counts_[i] = pt.coeff_count();
+  return absl::OkStatus();
+}
+
+void PackedPlaintextStore::expand(std::size_t i, uint64_t* dest) const {
+  const uint64_t* slot = &words_[i * slot_words_];
+  const uint64_t mask = (uint64_t(1) << bits_) - 1;
+  const std::size_t count = coeff_counts_[i];
+  for (std::size_t c = 0, bit = 0; c < count; ++c, bit += bits_) {
+    const std::size_t shift = bit % 64;
+    uint64_t value = slot[bit / 64] >> shift;
+    if (shift + bits_ > 64) {
+      value |= slot[bit / 64 + 1] << (64 - shift);
+    }
+    dest[c] = value & mask;
+  }
+  if (!ntt_) return;
+
+  // Lift to every coefficient modulus the way Evaluator::transform_to_ntt
+  // does, from the highest one down so the coefficients in the first limb
+  // are read before being replaced.
+  std::fill(dest + count, dest + poly_modulus_degree_, 0);
+  const uint64_t threshold = (plain_modulus_ + 1) / 2;
+  const auto* ntt_tables = context_data_->small_ntt_tables();
+  for (std::size_t m = coeff_modulus_.size(); m-- > 0;) {
+    const uint64_t increment = coeff_modulus_[m].value() - plain_modulus_;
+    uint64_t* limb = dest + m * poly_modulus_degree_;
+    for (std::size_t c = 0; c < poly_modulus_degree_; ++c) {
+      limb[c] = dest[c] >= threshold ? dest[c] + increment : dest[c];
+    }
+    seal::util::ntt_negacyclic_harvey(limb, ntt_tables[m]);
+  }
+}
+
+const uint64_t* PackedPlaintextStore::data(std::size_t i,
+                                           uint64_t* scratch) const {
+  expand(i, scratch);
+  return scratch;
+}
+
+const seal::Plaintext& PackedPlaintextStore::plaintext(
+    std::size_t i, seal::Plaintext& scratch) const {
+  // SEAL doesn't resize plaintexts in NTT form.
+  scratch.parms_id() = seal::parms_id_zero;
+  scratch.resize(coeff_count(i));
+  expand(i, scratch.data());
+  scratch.parms_id() = parms_id_;
+  return scratch;
+}
+
+MappedPlaintextStore::~MappedPlaintextStore() {
+  munmap(mapping_, mapping_size_);
+}
+
+Status MappedPlaintextStore::Write(const std::string& path,
+                                   const PIRParameters& params,
+                                   const PlaintextStore& store) {
+  std::string serialized_params;
+  if (!params.SerializeToString(&serialized_params)) {
+    return InternalError("Unable to serialize PIR parameters");
+  }
+
+  const auto parms_id =
+      store.size() > 0 ? store.parms_id(0) : seal::parms_id_zero;
+  uint64_t max_coeff_count = 0;
+  std::vector<uint64_t> coeff_counts(store.size());
+  for (size_t i = 0; i < store.size(); ++i) {
+    if (store.parms_id(i) != parms_id) {
+      return InvalidArgumentError(
+          "All plaintexts in a snapshot must have the same parms_id");
+    }
+    coeff_counts[i] = store.coeff_count(i);
+    max_coeff_count = std::max(max_coeff_count, coeff_counts[i]);
+  }
+
+  SnapshotHeader header = {};
+  std::memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kVersion;
+  header.byte_order = kByteOrder;
+  header.params_offset = align_up(sizeof(SnapshotHeader), kLineSize);
+  header.params_size = serialized_params.size();
+  header.coeff_counts_offset =
+      align_up(header.params_offset + header.params_size, kLineSize);
+  header.num_plaintexts = store.size();
+  header.data_offset = align_up(
+      header.coeff_counts_offset + coeff_counts.size() * sizeof(uint64_t),
+      kPageSize);
+  header.slot_words = align_up(max_coeff_count, kLineSize / sizeof(uint64_t));
+  std::memcpy(header.parms_id, parms_id.data(), sizeof(header.parms_id));
+
+  const std::string temp_path = path + ".tmp";
+  std::ofstream out(temp_path,
+                    std::ios::out | std::ios::binary | std::ios::trunc);
+  if (!out) {
+    return InternalError("Unable to create " + temp_path);
+  }
+  uint64_t written = 0;
+  const auto write = [&out, &written](const void* data, uint64_t size) {
+    out.write(static_cast<const char*>(data), size);
+    written += size;
+  };
+  const auto pad_to = [&write, &written](uint64_t offset) {
+    static const char zeros[kPageSize] = {};
+    while (written < offset) {
+      write(zeros, std::min(offset - written, kPageSize));
+    }
+  };
+
+  write(&header, sizeof(header));
+  pad_to(header.params_offset);
+  write(serialized_params.data(), serialized_params.size());
+  pad_to(header.coeff_counts_offset);
+  write(coeff_counts.data(), coeff_counts.size() * sizeof(uint64_t));
+  pad_to(header.data_offset);
+  std::vector<uint64_t> scratch(store.expands() ? max_coeff_count : 0);
+  for (size_t i = 0; i < store.size(); ++i) {
+    write(store.data(i, scratch.data()), coeff_counts[i] * sizeof(uint64_t));
+    pad_to(header.data_offset + (i + 1) * header.slot_words * sizeof(uint64_t));
+  }
+  out.close();
+  if (!out) {
+    std::remove(temp_path.c_str());
+    return InternalError("Unable to write " + temp_path);
+  }
+  if (std::rename(temp_path.c_str(), path.c_str()) != 0) {
+    const std::string error = std::strerror(errno);
+    std::remove(temp_path.c_str());
+    return InternalError("Unable to rename " + temp_path + ": " + error);
+  }
+  return absl::OkStatus();
+}
+
+StatusOr<std::unique_ptr<MappedPlaintextStore>> MappedPlaintextStore::Open(
+    const std::string& path) {
+  uint64_t file_size;
+  ASSIGN_OR_RETURN(const int fd, open_snapshot(path, file_size));
+  void* mapping = mmap(nullptr, file_size, PROT_READ, MAP_SHARED, fd, 0);
+  const int mmap_errno = errno;
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    return InternalError("Unable to map " + path + ": " +
+                         std::strerror(mmap_errno));
+  }
+  auto store = absl::WrapUnique(new MappedPlaintextStore(mapping, file_size));
+  const auto* bytes = static_cast<const char*>(mapping);
+
+  SnapshotInfo info;
+  RETURN_IF_ERROR(read_snapshot_info(
+      path, file_size,
+      [bytes](uint64_t offset, uint64_t size, void* dest) {
+        std::memcpy(dest, bytes + offset, size);
+        return absl::OkStatus();
+      },
+      info));
+  store->params_ = std::move(info.params);
+  store->coeff_counts_ = std::move(info.coeff_counts);
+  std::memcpy(store->parms_id_.data(), info.header.parms_id,
+              sizeof(info.header.parms_id));
+  store->data_ =
+      reinterpret_cast<const uint64_t*>(bytes + info.header.data_offset);
+  store->slot_words_ = info.header.slot_words;
+  return std::move(store);
+}
+
+const seal::Plaintext& MappedPlaintextStore::plaintext(
+    std::size_t i, seal::Plaintext& scratch) const {
+  // SEAL doesn't resize plaintexts in NTT form.
+  scratch.parms_id() = seal::parms_id_zero;
+  scratch.resize(coeff_counts_[i]);
+  std::copy_n(data(i, nullptr), coeff_counts_[i], scratch.data());
+  scratch.parms_id() = parms_id_;
+  return scratch;
+}
+
+/**
+ * Scan of a StreamedPlaintextStore. The range is split in tiles of
+ * tile_plaintexts, and the tile after the one being read is always being
+ * read by a prefetch thread into a second buffer. Moving on to the next tile
+ * waits for that read, swaps the buffers and starts reading the tile after.
+ */
+class StreamedPlaintextStore::TileScan : public PlaintextStore::Scan {
+ public:
+  TileScan(const StreamedPlaintextStore& store, std::size_t begin,
+           std::size_t end)
+      : store_(store),
+        begin_(begin),
+        end_(std::max(begin, std::min(end, store.size()))),
+        tile_size_(std::max<std::size_t>(
+            1, std::min(store.tile_plaintexts_, end_ - begin_))),
+        current_(new uint64_t[tile_size_ * store.slot_words_]),
+        next_(new uint64_t[tile_size_ * store.slot_words_]) {
+    if (begin_ < end_) prefetch(0);
+  }
+
+  ~TileScan() override {
+    if (pending_.valid()) pending_.wait();
+  }
+
+  const uint64_t* data(std::size_t i, uint64_t* scratch) override {
+    const uint64_t* slot = find(i);
+    if (slot == nullptr) return store_.data(i, scratch);
+    std::copy_n(slot, store_.coeff_counts_[i], scratch);
+    return scratch;
+  }
+
+  const seal::Plaintext& plaintext(std::size_t i,
+                                   seal::Plaintext& scratch) override {
+    const uint64_t* slot = find(i);
+    if (slot == nullptr) return store_.plaintext(i, scratch);
+    // SEAL doesn't resize plaintexts in NTT form.
+    scratch.parms_id() = seal::parms_id_zero;
+    scratch.resize(store_.coeff_counts_[i]);
+    std::copy_n(slot, store_.coeff_counts_[i], scratch.data());
+    scratch.parms_id() = store_.parms_id_;
+    return scratch;
+  }
+
+ private:
+  static constexpr std::size_t kNoTile = ~std::size_t(0);
+
+  std::size_t tile_begin(std::size_t tile) const {
+    return begin_ + tile * tile_size_;
+  }
+
+  std::size_t tile_end(std::size_t tile) const {
+    return std::min(end_, tile_begin(tile + 1));
+  }
+
+  // Starts reading a tile into next_.
+  void prefetch(std::size_t tile) {
+    pending_tile_ = tile;
+    pending_ = std::async(std::launch::async, [this, tile] {
+      store_.read(tile_begin(tile), tile_end(tile), next_.get());
+    });
+  }
+
+  // Returns the slot of plaintext i, moving on to its tile first, or nullptr
+  // if i is outside the range or before the current tile.
+  const uint64_t* find(std::size_t i) {
+    if (i < begin_ || i >= end_) return nullptr;
+    const std::size_t tile = (i - begin_) / tile_size_;
+    if (tile != current_tile_) {
+      if (current_tile_ != kNoTile && tile < current_tile_) return nullptr;
+      bool prefetched = false;
+      if (pending_.valid()) {
+        // Rethrows the errors of the read.
+        pending_.get();
+        prefetched = pending_tile_ == tile;
+      }
+      if (prefetched) {
+        std::swap(current_, next_);
+      } else {
+        store_.read(tile_begin(tile), tile_end(tile), current_.get());
+      }
+      current_tile_ = tile;
+      if (tile_begin(tile + 1) < end_) prefetch(tile + 1);
+    }
+    return &current_[(i - tile_begin(tile)) * store_.slot_words_];
+  }
+
+  const StreamedPlaintextStore& store_;
+  const std::size_t begin_;
+  const std::size_t end_;
+  // Plaintexts per tile.
+  const std::size_t tile_size_;
+  // Slots of the tile being read by the caller, and of the one after.
+  std::unique_ptr<uint64_t[]> current_;
+  std::unique_ptr<uint64_t[]> next_;
+  std::size_t current_tile_ = kNoTile;
+  // Read of the tile pending_tile_ into next_, if valid.
+  std::future<void> pending_;
+  std::size_t pending_tile_ = kNoTile;
+};
+
+StreamedPlaintextStore::~StreamedPlaintextStore() { close(fd_); }
+
+StatusOr<std::unique_ptr<StreamedPlaintextStore>> StreamedPlaintextStore::Open(
+    const std::string& path, const std::size_t tile_bytes) {
+  uint64_t file_size;
+  ASSIGN_OR_RETURN(const int fd, open_snapshot(path, file_size));
+  auto store = absl::WrapUnique(new StreamedPlaintextStore(fd, path));
+
+  SnapshotInfo info;
+  RETURN_IF_ERROR(read_snapshot_info(
+      path, file_size,
+      [fd, &path](uint64_t offset, uint64_t size, void* dest) {
+        return pread_fully(fd, path, offset, size, dest);
+      },
+      info));
+#ifdef POSIX_FADV_SEQUENTIAL
+  // Scans read the plaintexts in order, so the kernel may read further
+  // ahead than it otherwise would.
+  posix_fadvise(fd, info.header.data_offset, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+  store->params_ = std::move(info.params);
+  store->coeff_counts_ = std::move(info.coeff_counts);
+  std::memcpy(store->parms_id_.data(), info.header.parms_id,
+              sizeof(info.header.parms_id));
+  store->data_offset_ = info.header.data_offset;
+  store->slot_words_ = info.header.slot_words;
+  store->tile_plaintexts_ = std::max<std::size_t>(
+      1, tile_bytes / std::max<std::size_t>(
+                          1, store->slot_words_ * sizeof(uint64_t)));
+  return std::move(store);
+}
+
+void StreamedPlaintextStore::read(std::size_t begin, std::size_t end,
+                                  uint64_t* dest) const {
+  const uint64_t slot_bytes = slot_words_ * sizeof(uint64_t);
+  const auto status = pread_fully(fd_, path_, data_offset_ + begin * slot_bytes,
+                                  (end - begin) * slot_bytes, dest);
+  if (!status.ok()) throw std::runtime_error(std::string(status.message()));
+}
+
+const uint64_t* StreamedPlaintextStore::data(std::size_t i,
+                                             uint64_t* scratch) const {
+  const auto status =
+      pread_fully(fd_, path_, data_offset_ + i * slot_words_ * sizeof(uint64_t),
+                  coeff_counts_[i] * sizeof(uint64_t), scratch);
+  if (!status.ok()) throw std::runtime_error(std::string(status.message()));
+  return scratch;
+}
+
+const seal::Plaintext& StreamedPlaintextStore::plaintext(
+    std::size_t i, seal::Plaintext& scratch) const {
+  // SEAL doesn't resize plaintexts in NTT form.
+  scratch.parms_id() = seal::parms_id_zero;
+  scratch.resize(coeff_counts_[i]);
+  data(i, scratch.data());
+  scratch.parms_id() = parms_id_;
+  return scratch;
+}
+
+std::unique_ptr<PlaintextStore::Scan> StreamedPlaintextStore::scan(
+    std::size_t begin, std::size_t end) const {
+  return absl::make_unique<TileScan>(*this, begin, end);
+}
+
+}  // namespace pir
@@ -0,0 +1,412 @@
+//
+// Copyright 2020 the authors listed in CONTRIBUTORS.md
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef PIR_PLAINTEXT_STORE_H_
+#define PIR_PLAINTEXT_STORE_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/status/statusor.h"
+#include "pir/proto/payload.pb.h"
+#include "seal/seal.h"
+
+namespace pir {
+
+using absl::Status;
+using absl::StatusOr;
+
+/**
+ * Read only access to the plaintexts of a database, wherever they are kept.
+ * Plaintexts are exposed both as raw coefficients, for kernels working on the
+ * RNS limbs directly, and as SEAL plaintexts for the evaluator.
+ */
+class PlaintextStore {
+ public:
+  virtual ~PlaintextStore() = default;
+
+  /**
+   * Number of plaintexts in the store.
+   */
+  virtual std::size_t size() const = 0;
+
+  /**
+   * Returns the coefficients of plaintext i, coeff_count(i) words. Stores that
+   * expand plaintexts write them to scratch and return scratch; the others
+   * ignore it, and it may be nullptr for them.
+   */
+  virtual const std::uint64_t* data(std::size_t i,
+                                    std::uint64_t* scratch) const = 0;
+
+  /**
+   * Returns the number of coefficients of plaintext i.
+   */
+  virtual std::size_t coeff_count(std::size_t i) const = 0;
+
+  /**
+   * Returns the parms_id of plaintext i, parms_id_zero if it is not in NTT
+   * form.
+   */
+  virtual const seal::parms_id_type& parms_id(std::size_t i) const = 0;
+
+  /**
+   * Returns plaintext i as a SEAL plaintext. Stores that don't hold SEAL
+   * plaintexts copy it into scratch and return scratch, so the result is only
+   * valid until scratch is reused.
+   */
+  virtual const seal::Plaintext& plaintext(std::size_t i,
+                                           seal::Plaintext& scratch) const = 0;
+
+  /**
+   * Whether the store expands plaintexts every time they are read, rather
+   * than holding them in the form they are returned in.
+   */
+  virtual bool expands() const { return false; }
+
+  /**
+   * Reads the plaintexts of a range of a store in increasing order, so that
+   * stores reading them from disk can read ahead of the caller.
+   */
+  class Scan {
+   public:
+    virtual ~Scan() = default;
+
+    /**
+     * As PlaintextStore::data and PlaintextStore::plaintext. Plaintexts may
+     * be skipped, but reading one before the last one read, or outside the
+     * range of the scan, goes back to the store and may be slow.
+     */
+    virtual const std::uint64_t* data(std::size_t i,
+                                      std::uint64_t* scratch) = 0;
+    virtual const seal::Plaintext& plaintext(std::size_t i,
+                                             seal::Plaintext& scratch) = 0;
+  };
+
+  /**
+   * Starts a scan of the plaintexts [begin, end). The default scan reads
+   * each plaintext from the store when asked for it. The store must outlive
+   * the scan, and scans of the same store may run concurrently.
+   */
+  virtual std::unique_ptr<Scan> scan(std::size_t begin, std::size_t end) const;
+
+  bool is_ntt_form(std::size_t i) const {
+    return parms_id(i) != seal::parms_id_zero;
+  }
+};
+
+/**
+ * Plaintexts held in memory, as produced by PIRDatabase::populate.
+ */
+class MemoryPlaintextStore : public PlaintextStore {
+ public:
+  explicit MemoryPlaintextStore(std::vector<seal::Plaintext> plaintexts = {})
+      : plaintexts_(std::move(plaintexts)) {}
+
+  std::size_t size() const override { return plaintexts_.size(); }
+  const std::uint64_t* data(std::size_t i,
+                            std::uint64_t*) const override {
+    return plaintexts_[i].data();
+  }
+  std::size_t coeff_count(std::size_t i) const override {
+    return plaintexts_[i].coeff_count();
+  }
+  const seal::parms_id_type& parms_id(std::size_t i) const override {
+    return plaintexts_[i].parms_id();
+  }
+  const seal::Plaintext& plaintext(std::size_t i,
+                                   seal::Plaintext&) const override {
+    return plaintexts_[i];
+  }
+
+ private:
+  std::vector<seal::Plaintext> plaintexts_;
+};
+
+/**
+ * A store with some of the plaintexts of another one replaced, so that
+ * updating a database only encodes and copies the plaintexts that change. The
+ * base store is shared, and never modified.
+ */
+class PatchedPlaintextStore : public PlaintextStore {
+ public:
+  using Patch = std::pair<std::size_t, std::shared_ptr<const seal::Plaintext>>;
+
+  /**
+   * Creates a store with the given plaintexts of base replaced. When base is
+   * itself a PatchedPlaintextStore, the new store patches its base with both
+   * sets of patches, so that lookups never go through more than one level.
+   * @param[in] base Store to patch.
+   * @param[in] patches Index and replacement of each plaintext to replace.
+   *    Later patches of the same index win.
+   */
+  static std::shared_ptr<const PlaintextStore> Create(
+      std::shared_ptr<const PlaintextStore> base,
+      const std::vector<Patch>& patches);
+
+  std::size_t size() const override { return base_->size(); }
+  const std::uint64_t* data(std::size_t i,
+                            std::uint64_t* scratch) const override {
+    return patches_[i] ? patches_[i]->data() : base_->data(i, scratch);
+  }
+  std::size_t coeff_count(std::size_t i) const override {
+    return patches_[i] ? patches_[i]->coeff_count() : base_->coeff_count(i);
+  }
+  const seal::parms_id_type& parms_id(std::size_t i) const override {
+    return patches_[i] ? patches_[i]->parms_id() : base_->parms_id(i);
+  }
+  const seal::Plaintext& plaintext(std::size_t i,
+                                   seal::Plaintext& scratch) const override {
+    return patches_[i] ? *patches_[i] : base_->plaintext(i, scratch);
+  }
+  bool expands() const override { return base_->expands(); }
+  std::unique_ptr<Scan> scan(std::size_t begin,
+                             std::size_t end) const override;
+
+ private:
+  class PatchedScan;
+
+  PatchedPlaintextStore(
+      std::shared_ptr<const PlaintextStore> base,
+      std::vector<std::shared_ptr<const seal::Plaintext>> patches)
+      : base_(std::move(base)), patches_(std::move(patches)) {}
+
+  const std::shared_ptr<const PlaintextStore> base_;
+  // Replacement of each plaintext, nullptr where the base one is used.
+  const std::vector<std::shared_ptr<const seal::Plaintext>> patches_;
+};
+
+/**
+ * Plaintexts kept in coefficient form, each coefficient packed in a fixed
+ * number of bits rather than in a 64 bit word per coefficient modulus. Reads
+ * expand a plaintext and, when the database multiplies in NTT form, lift and
+ * transform it, trading that work for several times less memory.
+ */
+class PackedPlaintextStore : public PlaintextStore {
+ public:
+  /**
+   * Creates a store of zero plaintexts.
+   * @param[in] context SEAL context of the database. Plaintexts are expanded
+   *    at its first parameters.
+   * @param[in] size Number of plaintexts.
+   * @param[in] bits Bits kept per coefficient, at most 62.
+   * @param[in] ntt Whether plaintexts are read in NTT form.
+   */
+  PackedPlaintextStore(std::shared_ptr<seal::SEALContext> context,
+                       std::size_t size, int bits, bool ntt);
+
+  /**
+   * Packs plaintext i. Different plaintexts may be set concurrently.
+   * @param[in] i Index of the plaintext.
+   * @param[in] pt Plaintext in coefficient form.
+   * @returns InvalidArgument if pt is in NTT form, has more coefficients than
+   *    the polynomial modulus degree, or a coefficient that doesn't fit
+   */
+  Status set(std::size_t i, const seal::Plaintext& pt);
+
+  /**
+   * Bytes taken by the packed plaintexts.
+   */
+  std::size_t packed_bytes() const {
+    return words_.size() * sizeof(std::uint64_t);
+  }
+
+  std::size_t size() const override { return coeff_counts_.size(); }
+  const std::uint64_t* data(std::size_t i,
+                            std::uint64_t* scratch) const override;
+  std::size_t coeff_count(std::size_t i) const override {
+    return ntt_ ? poly_modulus_degree_ * coeff_modulus_.size()
+                : coeff_counts_[i];
+  }
+  const seal::parms_id_type& parms_id(std::size_t) const override {
+    return parms_id_;
+  }
+  const seal::Plaintext& plaintext(std::size_t i,
+                                   seal::Plaintext& scratch) const override;
+  bool expands() const override { return true; }
+
+ private:
+  // Writes plaintext i to dest, coeff_count(i) words.
+  void expand(std::size_t i, std::uint64_t* dest) const;
+
+  const std::shared_ptr<const seal::SEALContext::ContextData> context_data_;
+  const std::size_t poly_modulus_degree_;
+  const std::vector<seal::Modulus> coeff_modulus_;
+  const std::uint64_t plain_modulus_;
+  const int bits_;
+  const bool ntt_;
+  const seal::parms_id_type parms_id_;
+  // Words per plaintext, enough for poly_modulus_degree_ coefficients.
+  const std::size_t slot_words_;
+  std::vector<std::uint64_t> words_;
+  std::vector<std::size_t> coeff_counts_;
+};
+
+/**
+ * Plaintexts mapped read only from a snapshot file, so that opening a
+ * database doesn't have to encode it again and processes serving the same
+ * snapshot share its pages.
+ *
+ * The snapshot starts with a fixed header and the serialized PIRParameters,
+ * followed by the coefficient count of each plaintext. The plaintexts come
+ * next, from a page aligned offset, each in a slot of the same size so that
+ * every plaintext starts on a cache line. All integers are in host byte
+ * order; the header records it so files from another architecture are
+ * rejected rather than misread.
+ */
+class MappedPlaintextStore : public PlaintextStore {
+ public:
+  ~MappedPlaintextStore() override;
+  MappedPlaintextStore(const MappedPlaintextStore&) = delete;
+  MappedPlaintextStore& operator=(const MappedPlaintextStore&) = delete;
+
+  /**
+   * Writes a snapshot of the store and the parameters it was built with. The
+   * file is written next to path and renamed into place once complete.
+   * Plaintexts are written in the form they are read in, so the snapshot of
+   * a store that expands them holds them expanded.
+   * @param[in] path Path of the snapshot file.
+   * @param[in] params Parameters of the database.
+   * @param[in] store Plaintexts of the database. All of them must have the
+   *    same parms_id.
+   * @returns InvalidArgument if the plaintexts don't share a parms_id, or
+   *    Internal if the file can't be written
+   */
+  static Status Write(const std::string& path, const PIRParameters& params,
+                      const PlaintextStore& store);
+
+  /**
+   * Maps a snapshot written by Write.
+   * @param[in] path Path of the snapshot file.
+   * @returns The store, NotFound if there is no such file, or
+   *    InvalidArgument if the file is not a valid snapshot
+   */
+  static StatusOr<std::unique_ptr<MappedPlaintextStore>> Open(
+      const std::string& path);
+
+  /**
+   * Parameters the snapshot was written with.
+   */
+  const PIRParameters& params() const { return params_; }
+
+  std::size_t size() const override { return coeff_counts_.size(); }
+  const std::uint64_t* data(std::size_t i,
+                            std::uint64_t*) const override {
+    return data_ + i * slot_words_;
+  }
+  std::size_t coeff_count(std::size_t i) const override {
+    return coeff_counts_[i];
+  }
+  const seal::parms_id_type& parms_id(std::size_t) const override {
+    return parms_id_;
+  }
+  const seal::Plaintext& plaintext(std::size_t i,
+                                   seal::Plaintext& scratch) const override;
+
+ private:
+  MappedPlaintextStore(void* mapping, std::size_t mapping_size)
+      : mapping_(mapping), mapping_size_(mapping_size) {}
+
+  void* const mapping_;
+  const std::size_t mapping_size_;
+  PIRParameters params_;
+  std::vector<std::uint64_t> coeff_counts_;
+  seal::parms_id_type parms_id_;
+  const std::uint64_t* data_ = nullptr;
+  std::size_t slot_words_ = 0;
+};
+
+/**
+ * Plaintexts of a snapshot written by MappedPlaintextStore::Write, read from
+ * the file as they are needed rather than mapped, for databases larger than
+ * memory. Mapping those blocks the multiplication on a page fault at every
+ * page it hasn't read yet; a scan of this store instead reads a tile of
+ * plaintexts with a single call, while a prefetch thread reads the next tile
+ * in the background. Only the two tiles of each scan are held in memory, so
+ * every multiplication reads the whole snapshot again, once for all the
+ * queries of its batch.
+ */
+class StreamedPlaintextStore : public PlaintextStore {
+ public:
+  // Default size of the tiles read by scans.
+  static constexpr std::size_t kDefaultTileBytes = 8 << 20;
+
+  ~StreamedPlaintextStore() override;
+  StreamedPlaintextStore(const StreamedPlaintextStore&) = delete;
+  StreamedPlaintextStore& operator=(const StreamedPlaintextStore&) = delete;
+
+  /**
+   * Opens a snapshot written by MappedPlaintextStore::Write.
+   * @param[in] path Path of the snapshot file.
+   * @param[in] tile_bytes Bytes read at once by scans, rounded down to whole
+   *    plaintexts but at least one plaintext.
+   * @returns The store, NotFound if there is no such file, or
+   *    InvalidArgument if the file is not a valid snapshot
+   */
+  static StatusOr<std::unique_ptr<StreamedPlaintextStore>> Open(
+      const std::string& path, std::size_t tile_bytes = kDefaultTileBytes);
+
+  /**
+   * Parameters the snapshot was written with.
+   */
+  const PIRParameters& params() const { return params_; }
+
+  /**
+   * Number of plaintexts in the tiles read by scans.
+   */
+  std::size_t tile_plaintexts() const { return tile_plaintexts_; }
+
+  std::size_t size() const override { return coeff_counts_.size(); }
+  // Reads throw std::runtime_error if the file can't be read.
+  const std::uint64_t* data(std::size_t i,
+                            std::uint64_t* scratch) const override;
+  std::size_t coeff_count(std::size_t i) const override {
+    return coeff_counts_[i];
+  }
+  const seal::parms_id_type& parms_id(std::size_t) const override {
+    return parms_id_;
+  }
+  const seal::Plaintext& plaintext(std::size_t i,
+                                   seal::Plaintext& scratch) const override;
+  bool expands() const override { return true; }
+  std::unique_ptr<Scan> scan(std::size_t begin,
+                             std::size_t end) const override;
+
+ private:
+  class TileScan;
+
+  StreamedPlaintextStore(int fd, std::string path)
+      : fd_(fd), path_(std::move(path)) {}
+
+  // Reads the slots of the plaintexts [begin, end) into dest, slot_words_
+  // words apart.
+  void read(std::size_t begin, std::size_t end, std::uint64_t* dest) const;
+
+  const int fd_;
+  const std::string path_;
+  PIRParameters params_;
+  std::vector<std::uint64_t> coeff_counts_;
+  seal::parms_id_type parms_id_;
+  std::uint64_t data_offset_ = 0;
+  std::size_t slot_words_ = 0;
+  std::size_t tile_plaintexts_ = 1;
+};
+
+}  // namespace pir
+
+#endif  // PIR_PLAINTEXT_STORE_H_
@@ -0,0 +1,342 @@
+//
+// Copyright 2020 the authors listed in CONTRIBUTORS.md
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "pir/cpp/plaintext_store.h"
+
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "pir/cpp/parameters.h"
+#include "pir/cpp/status_asserts.h"
+
+namespace pir {
+namespace {
+
+using seal::Plaintext;
+using std::string;
+using std::vector;
+using namespace ::testing;
+
+class PlaintextStoreTest : public ::testing::Test {
+ protected:
+  void SetUp() {
+    path_ = ::testing::TempDir() + "/plaintext_store_test.snapshot";
+    params_.set_num_items(3);
+    params_.set_num_pt(3);
+    params_.add_dimensions(3);
+    params_.set_bytes_per_item(17);
+
+    // Different sizes, so some slots are padded.
+    for (size_t size : {8, 3, 20}) {
+      Plaintext pt(size);
+      for (size_t c = 0; c < size; ++c) {
+        pt[c] = size * 1000 + c;
+      }
+      plaintexts_.push_back(pt);
+    }
+  }
+
+  void TearDown() { std::remove(path_.c_str()); }
+
+  void WriteFile(const string& contents) {
+    std::ofstream out(path_, std::ios::binary | std::ios::trunc);
+    out << contents;
+  }
+
+  string ReadFile() {
+    std::ifstream in(path_, std::ios::binary);
+    return string(std::istreambuf_iterator<char>(in),
+                  std::istreambuf_iterator<char>());
+  }
+
+  string path_;
+  PIRParameters params_;
+  vector<Plaintext> plaintexts_;
+};
+
+TEST_F(PlaintextStoreTest, TestWriteOpen) {
+  MemoryPlaintextStore store(plaintexts_);
+  ASSERT_OK(MappedPlaintextStore::Write(path_, params_, store));
+
+  ASSIGN_OR_FAIL(auto mapped, MappedPlaintextStore::Open(path_));
+  EXPECT_EQ(mapped->params().SerializeAsString(), params_.SerializeAsString());
+  ASSERT_EQ(mapped->size(), plaintexts_.size());
+  for (size_t i = 0; i < plaintexts_.size(); ++i) {
+    const auto* data = mapped->data(i, nullptr);
+    EXPECT_EQ(reinterpret_cast<std::uintptr_t>(data) % 64, 0) << "i = " << i;
+    ASSERT_EQ(mapped->coeff_count(i), plaintexts_[i].coeff_count());
+    EXPECT_FALSE(mapped->is_ntt_form(i));
+    EXPECT_THAT(vector<uint64_t>(data, data + mapped->coeff_count(i)),
+                ElementsAreArray(plaintexts_[i].data(),
+                                 plaintexts_[i].coeff_count()))
+        << "i = " << i;
+    Plaintext scratch;
+    EXPECT_EQ(mapped->plaintext(i, scratch), plaintexts_[i]) << "i = " << i;
+  }
+}
+
+TEST_F(PlaintextStoreTest, TestWriteOpenEmpty) {
+  ASSERT_OK(
+      MappedPlaintextStore::Write(path_, params_, MemoryPlaintextStore()));
+  ASSIGN_OR_FAIL(auto mapped, MappedPlaintextStore::Open(path_));
+  EXPECT_EQ(mapped->size(), 0);
+}
+
+TEST_F(PlaintextStoreTest, TestPatched) {
+  std::shared_ptr<const PlaintextStore> base =
+      std::make_shared<MemoryPlaintextStore>(plaintexts_);
+  auto replacement = std::make_shared<Plaintext>(5);
+  (*replacement)[4] = 42;
+  auto patched = PatchedPlaintextStore::Create(base, {{1, replacement}});
+  ASSERT_EQ(patched->size(), base->size());
+  Plaintext scratch;
+  EXPECT_EQ(patched->data(0, nullptr), base->data(0, nullptr));
+  EXPECT_EQ(&patched->plaintext(1, scratch), replacement.get());
+  EXPECT_EQ(patched->coeff_count(1), 5);
+  EXPECT_EQ(patched->data(2, nullptr), base->data(2, nullptr));
+
+  // Patching a patched store keeps the earlier patches, and leaves both the
+  // base and the earlier store as they were.
+  auto twice = PatchedPlaintextStore::Create(
+      patched, {{2, std::make_shared<Plaintext>(7)}});
+  EXPECT_EQ(&twice->plaintext(1, scratch), replacement.get());
+  EXPECT_EQ(twice->coeff_count(2), 7);
+  EXPECT_EQ(twice->data(0, nullptr), base->data(0, nullptr));
+  EXPECT_EQ(patched->coeff_count(2), plaintexts_[2].coeff_count());
+  EXPECT_EQ(base->coeff_count(1), plaintexts_[1].coeff_count());
+
+  ASSERT_OK(MappedPlaintextStore::Write(path_, params_, *twice));
+  ASSIGN_OR_FAIL(auto mapped, MappedPlaintextStore::Open(path_));
+  EXPECT_EQ(mapped->plaintext(1, scratch), *replacement);
+}
+
+TEST_F(PlaintextStoreTest, TestWriteMixedParmsIds) {
+  plaintexts_[1].parms_id() = {1, 2, 3, 4};
+  MemoryPlaintextStore store(plaintexts_);
+  EXPECT_THAT(MappedPlaintextStore::Write(path_, params_, store).code(),
+              Eq(absl::StatusCode::kInvalidArgument));
+}
+
+TEST_F(PlaintextStoreTest, TestOpenMissingFile) {
+  EXPECT_THAT(MappedPlaintextStore::Open(path_ + ".missing").status().code(),
+              Eq(absl::StatusCode::kNotFound));
+}
+
+TEST_F(PlaintextStoreTest, TestOpenNotSnapshot) {
+  WriteFile(string(4096, 'x'));
+  EXPECT_THAT(MappedPlaintextStore::Open(path_).status().code(),
+              Eq(absl::StatusCode::kInvalidArgument));
+}
+
+TEST_F(PlaintextStoreTest, TestOpenTruncated) {
+  MemoryPlaintextStore store(plaintexts_);
+  ASSERT_OK(MappedPlaintextStore::Write(path_, params_, store));
+  const auto contents = ReadFile();
+  for (size_t size : {size_t(0), size_t(16), contents.size() - 8}) {
+    WriteFile(contents.substr(0, size));
+    EXPECT_THAT(MappedPlaintextStore::Open(path_).status().code(),
+                Eq(absl::StatusCode::kInvalidArgument))
+        << "size = " << size;
+  }
+}
+
+TEST_F(PlaintextStoreTest, TestStreamed) {
+  MemoryPlaintextStore store(plaintexts_);
+  ASSERT_OK(MappedPlaintextStore::Write(path_, params_, store));
+
+  ASSIGN_OR_FAIL(auto streamed, StreamedPlaintextStore::Open(path_));
+  EXPECT_EQ(streamed->params().SerializeAsString(),
+            params_.SerializeAsString());
+  EXPECT_TRUE(streamed->expands());
+  ASSERT_EQ(streamed->size(), plaintexts_.size());
+  // Out of order, reading the file for each plaintext.
+  for (size_t i = plaintexts_.size(); i-- > 0;) {
+    ASSERT_EQ(streamed->coeff_count(i), plaintexts_[i].coeff_count());
+    EXPECT_FALSE(streamed->is_ntt_form(i));
+    vector<uint64_t> scratch(streamed->coeff_count(i));
+    EXPECT_EQ(streamed->data(i, scratch.data()), scratch.data());
+    EXPECT_THAT(scratch, ElementsAreArray(plaintexts_[i].data(),
+                                          plaintexts_[i].coeff_count()))
+        << "i = " << i;
+    Plaintext pt;
+    EXPECT_EQ(streamed->plaintext(i, pt), plaintexts_[i]) << "i = " << i;
+  }
+}
+
+TEST_F(PlaintextStoreTest, TestStreamedScan) {
+  vector<Plaintext> plaintexts;
+  for (size_t i = 0; i < 11; ++i) {
+    plaintexts.push_back(plaintexts_[i % plaintexts_.size()]);
+    plaintexts.back()[0] = i;
+  }
+  MemoryPlaintextStore store(plaintexts);
+  ASSERT_OK(MappedPlaintextStore::Write(path_, params_, store));
+  // Slots of 24 words, so tiles of 3 plaintexts.
+  ASSIGN_OR_FAIL(auto streamed,
+                 StreamedPlaintextStore::Open(path_, 4 * 24 * 8 - 1));
+  ASSERT_EQ(streamed->tile_plaintexts(), 3);
+
+  const auto expect_scan = [&](size_t begin, size_t end,
+                               const vector<size_t>& reads) {
+    auto scan = streamed->scan(begin, end);
+    vector<uint64_t> scratch(24);
+    Plaintext pt;
+    for (size_t i : reads) {
+      EXPECT_EQ(scan->data(i, scratch.data()), scratch.data());
+      const size_t coeff_count = plaintexts[i].coeff_count();
+      EXPECT_THAT(
+          vector<uint64_t>(scratch.begin(), scratch.begin() + coeff_count),
+          ElementsAreArray(plaintexts[i].data(), coeff_count))
+          << "begin = " << begin << ", i = " << i;
+      EXPECT_EQ(scan->plaintext(i, pt), plaintexts[i])
+          << "begin = " << begin << ", i = " << i;
+    }
+  };
+  // Whole store, in order.
+  expect_scan(0, 11, {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10});
+  // Tiles skipped, and a partial last tile.
+  expect_scan(2, 10, {2, 3, 9});
+  // Plaintexts out of order or outside the range are still read.
+  expect_scan(4, 8, {5, 4, 7, 6, 0, 10});
+  // An end past the store, and an empty scan.
+  expect_scan(9, 20, {9, 10});
+  expect_scan(5, 5, {});
+}
+
+TEST_F(PlaintextStoreTest, TestPatchedStreamedScan) {
+  MemoryPlaintextStore store(plaintexts_);
+  ASSERT_OK(MappedPlaintextStore::Write(path_, params_, store));
+  ASSIGN_OR_FAIL(auto streamed, StreamedPlaintextStore::Open(path_, 1));
+  auto replacement = std::make_shared<Plaintext>(5);
+  (*replacement)[4] = 42;
+  auto patched = PatchedPlaintextStore::Create(std::move(streamed),
+                                               {{1, replacement}});
+  EXPECT_TRUE(patched->expands());
+
+  auto scan = patched->scan(0, 3);
+  Plaintext scratch;
+  EXPECT_EQ(scan->plaintext(0, scratch), plaintexts_[0]);
+  EXPECT_EQ(&scan->plaintext(1, scratch), replacement.get());
+  EXPECT_EQ(scan->plaintext(2, scratch), plaintexts_[2]);
+}
+
+TEST_F(PlaintextStoreTest, TestMemoryScan) {
+  MemoryPlaintextStore store(plaintexts_);
+  auto scan = store.scan(0, store.size());
+  Plaintext scratch;
+  for (size_t i = 0; i < store.size(); ++i) {
+    EXPECT_EQ(scan->data(i, nullptr), store.data(i, nullptr));
+    EXPECT_EQ(&scan->plaintext(i, scratch), &store.plaintext(i, scratch));
+  }
+}
+
+TEST_F(PlaintextStoreTest, TestStreamedOpenInvalid) {
+  EXPECT_THAT(
+      StreamedPlaintextStore::Open(path_ + ".missing").status().code(),
+      Eq(absl::StatusCode::kNotFound));
+  WriteFile(string(4096, 'x'));
+  EXPECT_THAT(StreamedPlaintextStore::Open(path_).status().code(),
+              Eq(absl::StatusCode::kInvalidArgument));
+
+  MemoryPlaintextStore store(plaintexts_);
+  ASSERT_OK(MappedPlaintextStore::Write(path_, params_, store));
+  const auto contents = ReadFile();
+  WriteFile(contents.substr(0, contents.size() - 8));
+  EXPECT_THAT(StreamedPlaintextStore::Open(path_).status().code(),
+              Eq(absl::StatusCode::kInvalidArgument));
+}
+
+class PackedPlaintextStoreTest : public ::testing::TestWithParam<int> {
+ protected:
+  void SetUp() {
+    context_ = seal::SEALContext::Create(GenerateEncryptionParams(4096, 20));
+    evaluator_ = std::make_unique<seal::Evaluator>(context_);
+    bits_ = GetParam();
+
+    // Random coefficients, including the largest that fit, of plaintexts
+    // with as many coefficients as the polynomial and with fewer.
+    std::mt19937_64 prng(42);
+    std::uniform_int_distribution<uint64_t> dist(0, (1 << bits_) - 1);
+    for (size_t size : {4096, 1000, 1}) {
+      Plaintext pt(size);
+      for (size_t c = 0; c < size; ++c) {
+        pt[c] = c % 5 == 0 ? (1 << bits_) - 1 : dist(prng);
+      }
+      plaintexts_.push_back(pt);
+    }
+  }
+
+  std::shared_ptr<seal::SEALContext> context_;
+  std::unique_ptr<seal::Evaluator> evaluator_;
+  int bits_;
+  vector<Plaintext> plaintexts_;
+};
+
+TEST_P(PackedPlaintextStoreTest, TestCoefficientForm) {
+  PackedPlaintextStore store(context_, plaintexts_.size(), bits_, false);
+  for (size_t i = 0; i < plaintexts_.size(); ++i) {
+    ASSERT_OK(store.set(i, plaintexts_[i]));
+  }
+  EXPECT_LT(store.packed_bytes(), plaintexts_.size() * 4096 * sizeof(uint64_t));
+  Plaintext scratch;
+  for (size_t i = 0; i < plaintexts_.size(); ++i) {
+    EXPECT_FALSE(store.is_ntt_form(i));
+    EXPECT_EQ(store.plaintext(i, scratch), plaintexts_[i]) << "i = " << i;
+  }
+}
+
+TEST_P(PackedPlaintextStoreTest, TestNTTForm) {
+  PackedPlaintextStore store(context_, plaintexts_.size(), bits_, true);
+  for (size_t i = 0; i < plaintexts_.size(); ++i) {
+    ASSERT_OK(store.set(i, plaintexts_[i]));
+  }
+  Plaintext scratch;
+  for (size_t i = 0; i < plaintexts_.size(); ++i) {
+    Plaintext expected = plaintexts_[i];
+    evaluator_->transform_to_ntt_inplace(expected, context_->first_parms_id());
+    ASSERT_EQ(store.coeff_count(i), expected.coeff_count());
+    EXPECT_EQ(store.parms_id(i), expected.parms_id());
+    EXPECT_EQ(store.plaintext(i, scratch), expected) << "i = " << i;
+    vector<uint64_t> data(store.coeff_count(i));
+    EXPECT_THAT(vector<uint64_t>(store.data(i, data.data()),
+                                 store.data(i, data.data()) + data.size()),
+                ElementsAreArray(expected.data(), expected.coeff_count()))
+        << "i = " << i;
+  }
+}
+
+TEST_P(PackedPlaintextStoreTest, TestSetInvalid) {
+  PackedPlaintextStore store(context_, 1, bits_, true);
+  Plaintext too_big(1);
+  too_big[0] = 1 << bits_;
+  EXPECT_THAT(store.set(0, too_big).code(),
+              Eq(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(store.set(0, Plaintext(4097)).code(),
+              Eq(absl::StatusCode::kInvalidArgument));
+}
+
+// Widths dividing 64 and not, up to the widest below the plain modulus.
+INSTANTIATE_TEST_SUITE_P(PackedPlaintextStores, PackedPlaintextStoreTest,
+                         Values(1, 16, 19));
+
+}  // namespace
+}  // namespace pir
@@ -0,0 +1,115 @@
+//
+// Copyright 2020 the authors listed in CONTRIBUTORS.md
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#include "pir/cpp/record_source.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+
+#include "absl/memory/memory.h"
+#include "pir/cpp/status_asserts.h"
+#include "pir/cpp/utils.h"
+
+namespace pir {
+
+using absl::InternalError;
+using absl::InvalidArgumentError;
+
+StatusOr<absl::string_view> VectorRecordSource::Read(
+    std::size_t begin, std::size_t end, std::string& scratch) const {
+  scratch.clear();
+  for (std::size_t i = begin; i < end; ++i) {
+    scratch.append(records_[i]);
+  }
+  return absl::string_view(scratch);
+}
+
+StatusOr<std::unique_ptr<FixedWidthRecordSource>>
+FixedWidthRecordSource::Create(absl::string_view data,
+                               std::size_t record_size) {
+  if (record_size == 0 || data.size() % record_size != 0) {
+    return InvalidArgumentError(
+        "Data size " + std::to_string(data.size()) +
+        " is not a multiple of record size " + std::to_string(record_size));
+  }
+  return absl::WrapUnique(new FixedWidthRecordSource(data, record_size));
+}
+
+MappedRecordSource::MappedRecordSource(void* mapping,
+                                       std::size_t mapping_size,
+                                       std::size_t record_size)
+    : FixedWidthRecordSource(
+          absl::string_view(static_cast<const char*>(mapping), mapping_size),
+          record_size),
+      mapping_(mapping),
+      mapping_size_(mapping_size) {}
+
+MappedRecordSource::~MappedRecordSource() {
+  if (mapping_ != nullptr) munmap(mapping_, mapping_size_);
+}
+
+StatusOr<std::unique_ptr<MappedRecordSource>> MappedRecordSource::Open(
+    const std::string& path, std::size_t record_size) {
+  const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    const std::string error = path + ": " + std::strerror(errno);
+    return errno == ENOENT ? absl::NotFoundError(error) : InternalError(error);
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    const std::string error = path + ": " + std::strerror(errno);
+    close(fd);
+    return InternalError(error);
+  }
+  const std::size_t file_size = st.st_size;
+  if (record_size == 0 || file_size % record_size != 0) {
+    close(fd);
+    return InvalidArgumentError(
+        path + ": size " + std::to_string(file_size) +
+        " is not a multiple of record size " + std::to_string(record_size));
+  }
+  // Empty files can't be mapped, and have no records to read anyway.
+  void* mapping = nullptr;
+  if (file_size > 0) {
+    mapping = mmap(nullptr, file_size, PROT_READ, MAP_SHARED, fd, 0);
+    const int mmap_errno = errno;
+    if (mapping == MAP_FAILED) {
+      close(fd);
+      return InternalError("Unable to map " + path + ": " +
+                           std::strerror(mmap_errno));
+    }
+    // Records are read once, front to back.
+    madvise(mapping, file_size, MADV_SEQUENTIAL);
+  }
+  close(fd);
+  return absl::WrapUnique(
+      new MappedRecordSource(mapping, file_size, record_size));
+}
+
+StatusOr<absl::string_view> CallbackRecordSource::Read(
+    std::size_t begin, std::size_t end, std::string& scratch) const {
+  scratch.clear();
+  for (std::size_t i = begin; i < end; ++i) {
+    RETURN_IF_ERROR(callback_(i, scratch));
+  }
+  return absl::string_view(scratch);
+}
+
+}  // namespace pir
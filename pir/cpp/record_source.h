@@ -0,0 +1,161 @@
+//
+// Copyright 2020 the authors listed in CONTRIBUTORS.md
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef PIR_RECORD_SOURCE_H_
+#define PIR_RECORD_SOURCE_H_
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+
+namespace pir {
+
+using absl::Status;
+using absl::StatusOr;
+
+/**
+ * Records to populate a database from, read a plaintext's worth at a time so
+ * that the records never have to be held in memory alongside the database.
+ */
+class RecordSource {
+ public:
+  virtual ~RecordSource() = default;
+
+  /**
+   * Number of records.
+   */
+  virtual std::size_t size() const = 0;
+
+  /**
+   * Returns the records [begin, end), one after the other. Sources that hold
+   * them contiguously return a view of their own memory; the others copy them
+   * into scratch and return a view of it. May be called concurrently, each
+   * caller with its own scratch.
+   * @param[in] begin Index of the first record.
+   * @param[in] end One past the index of the last record, at most size().
+   * @param[in] scratch Buffer the records may be copied to.
+   * @returns The records, or the error of the underlying source
+   */
+  virtual StatusOr<absl::string_view> Read(std::size_t begin, std::size_t end,
+                                           std::string& scratch) const = 0;
+};
+
+/**
+ * Records held in a vector of strings, which must outlive the source.
+ */
+class VectorRecordSource : public RecordSource {
+ public:
+  explicit VectorRecordSource(const std::vector<std::string>& records)
+      : records_(records) {}
+
+  std::size_t size() const override { return records_.size(); }
+  StatusOr<absl::string_view> Read(std::size_t begin, std::size_t end,
+                                   std::string& scratch) const override;
+
+ private:
+  const std::vector<std::string>& records_;
+};
+
+/**
+ * Records of a fixed size stored back to back in memory the caller owns, such
+ * as a mapped file. Reads return views of that memory without copying.
+ */
+class FixedWidthRecordSource : public RecordSource {
+ public:
+  /**
+   * Creates a source over data, which must outlive it.
+   * @param[in] data Records, one after the other.
+   * @param[in] record_size Size of each record in bytes.
+   * @returns InvalidArgument if record_size is zero or doesn't divide the
+   *    size of data
+   */
+  static StatusOr<std::unique_ptr<FixedWidthRecordSource>> Create(
+      absl::string_view data, std::size_t record_size);
+
+  std::size_t size() const override { return data_.size() / record_size_; }
+  StatusOr<absl::string_view> Read(std::size_t begin, std::size_t end,
+                                   std::string&) const override {
+    return data_.substr(begin * record_size_, (end - begin) * record_size_);
+  }
+
+ protected:
+  FixedWidthRecordSource(absl::string_view data, std::size_t record_size)
+      : data_(data), record_size_(record_size) {}
+
+  absl::string_view data_;
+  const std::size_t record_size_;
+};
+
+/**
+ * Records of a fixed size read from a file that is mapped read only, so that
+ * they take page cache the kernel can reclaim rather than memory of the
+ * process.
+ */
+class MappedRecordSource : public FixedWidthRecordSource {
+ public:
+  ~MappedRecordSource() override;
+  MappedRecordSource(const MappedRecordSource&) = delete;
+  MappedRecordSource& operator=(const MappedRecordSource&) = delete;
+
+  /**
+   * Maps a file of records stored back to back.
+   * @param[in] path Path of the file.
+   * @param[in] record_size Size of each record in bytes.
+   * @returns The source, NotFound if there is no such file, or
+   *    InvalidArgument if record_size is zero or doesn't divide the file size
+   */
+  static StatusOr<std::unique_ptr<MappedRecordSource>> Open(
+      const std::string& path, std::size_t record_size);
+
+ private:
+  MappedRecordSource(void* mapping, std::size_t mapping_size,
+                     std::size_t record_size);
+
+  void* const mapping_;
+  const std::size_t mapping_size_;
+};
+
+/**
+ * Records pulled one at a time from a callback, for sources such as a
+ * database cursor or a decompressor that produce them on demand.
+ */
+class CallbackRecordSource : public RecordSource {
+ public:
+  // Appends record i to its second argument. Called concurrently for
+  // different records when the database populates on several threads.
+  using Callback = std::function<Status(std::size_t, std::string&)>;
+
+  CallbackRecordSource(std::size_t size, Callback callback)
+      : size_(size), callback_(std::move(callback)) {}
+
+  std::size_t size() const override { return size_; }
+  StatusOr<absl::string_view> Read(std::size_t begin, std::size_t end,
+                                   std::string& scratch) const override;
+
+ private:
+  const std::size_t size_;
+  const Callback callback_;
+};
+
+}  // namespace pir
+
+#endif  // PIR_RECORD_SOURCE_H_
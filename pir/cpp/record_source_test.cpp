@@ -0,0 +1,121 @@
+//
+// Copyright 2020 the authors listed in CONTRIBUTORS.md
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "pir/cpp/record_source.h"
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "pir/cpp/status_asserts.h"
+
+namespace pir {
+namespace {
+
+using std::string;
+using std::vector;
+using namespace ::testing;
+
+class RecordSourceTest : public ::testing::Test {
+ protected:
+  void SetUp() { path_ = ::testing::TempDir() + "/record_source_test.records"; }
+
+  void TearDown() { std::remove(path_.c_str()); }
+
+  void WriteFile(const string& contents) {
+    std::ofstream out(path_, std::ios::binary | std::ios::trunc);
+    out << contents;
+  }
+
+  string path_;
+};
+
+TEST_F(RecordSourceTest, TestVector) {
+  const vector<string> records = {"abc", "", "de", "fghi"};
+  VectorRecordSource source(records);
+  ASSERT_EQ(source.size(), 4);
+  string scratch;
+  ASSIGN_OR_FAIL(auto all, source.Read(0, 4, scratch));
+  EXPECT_EQ(all, "abcdefghi");
+  ASSIGN_OR_FAIL(auto some, source.Read(1, 3, scratch));
+  EXPECT_EQ(some, "de");
+  ASSIGN_OR_FAIL(auto none, source.Read(2, 2, scratch));
+  EXPECT_EQ(none, "");
+}
+
+TEST_F(RecordSourceTest, TestFixedWidth) {
+  const string data = "aaabbbcccddd";
+  ASSIGN_OR_FAIL(auto source, FixedWidthRecordSource::Create(data, 3));
+  ASSERT_EQ(source->size(), 4);
+  string scratch;
+  ASSIGN_OR_FAIL(auto records, source->Read(1, 3, scratch));
+  EXPECT_EQ(records, "bbbccc");
+  // A view of the data rather than a copy.
+  EXPECT_EQ(records.data(), data.data() + 3);
+  EXPECT_THAT(scratch, IsEmpty());
+}
+
+TEST_F(RecordSourceTest, TestFixedWidthInvalid) {
+  EXPECT_THAT(FixedWidthRecordSource::Create("aaab", 3).status().code(),
+              Eq(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(FixedWidthRecordSource::Create("aaa", 0).status().code(),
+              Eq(absl::StatusCode::kInvalidArgument));
+}
+
+TEST_F(RecordSourceTest, TestMapped) {
+  WriteFile("aaabbbcccddd");
+  ASSIGN_OR_FAIL(auto source, MappedRecordSource::Open(path_, 3));
+  // The mapping outlives the file name.
+  std::remove(path_.c_str());
+  ASSERT_EQ(source->size(), 4);
+  string scratch;
+  ASSIGN_OR_FAIL(auto records, source->Read(2, 4, scratch));
+  EXPECT_EQ(records, "cccddd");
+}
+
+TEST_F(RecordSourceTest, TestMappedEmpty) {
+  WriteFile("");
+  ASSIGN_OR_FAIL(auto source, MappedRecordSource::Open(path_, 3));
+  EXPECT_EQ(source->size(), 0);
+}
+
+TEST_F(RecordSourceTest, TestMappedInvalid) {
+  EXPECT_THAT(MappedRecordSource::Open(path_ + ".missing", 3).status().code(),
+              Eq(absl::StatusCode::kNotFound));
+  WriteFile("aaab");
+  EXPECT_THAT(MappedRecordSource::Open(path_, 3).status().code(),
+              Eq(absl::StatusCode::kInvalidArgument));
+}
+
+TEST_F(RecordSourceTest, TestCallback) {
+  CallbackRecordSource source(3, [](size_t i, string& out) -> Status {
+    if (i == 2) return absl::DataLossError("bad record");
+    out.append(2, 'a' + i);
+    return absl::OkStatus();
+  });
+  ASSERT_EQ(source.size(), 3);
+  string scratch;
+  ASSIGN_OR_FAIL(auto records, source.Read(0, 2, scratch));
+  EXPECT_EQ(records, "aabb");
+  EXPECT_THAT(source.Read(1, 3, scratch).status().code(),
+              Eq(absl::StatusCode::kDataLoss));
+}
+
+}  // namespace
+}  // namespace pir
@@ -31,25 +31,29 @@ using std::vector;
 
 StatusOr<vector<Ciphertext>> LoadCiphertexts(
     const std::shared_ptr<seal::SEALContext>& sealctx,
-    const Ciphertexts& input) {
+    const Ciphertexts& input, Tracer* const tracer) {
+  ScopedPhase phase(tracer, Phase::kDeserialize);
   vector<Ciphertext> output(input.ct_size());
   for (int idx = 0; idx < input.ct_size(); ++idx) {
     ASSIGN_OR_RETURN(output[idx],
                      SEALDeserialize<Ciphertext>(sealctx, input.ct(idx)));
+    TraceCount(tracer, Counter::kBytesIn, input.ct(idx).size());
   }
 
   return output;
 }
 
 Status SaveCiphertexts(const vector<Ciphertext>& ciphertexts,
-                       Ciphertexts* output) {
+                       Ciphertexts* output, Tracer* const tracer) {
   if (output == nullptr) {
     return InvalidArgumentError("output nullptr");
   }
 
+  ScopedPhase phase(tracer, Phase::kSerialize);
   for (size_t idx = 0; idx < ciphertexts.size(); ++idx) {
-    RETURN_IF_ERROR(
-        SEALSerialize<Ciphertext>(ciphertexts[idx], output->add_ct()));
+    auto* ct = output->add_ct();
+    RETURN_IF_ERROR(SEALSerialize<Ciphertext>(ciphertexts[idx], ct));
+    TraceCount(tracer, Counter::kBytesOut, ct->size());
   }
   return absl::OkStatus();
 }
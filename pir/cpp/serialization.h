@@ -20,6 +20,7 @@
 #include <string>
 
 #include "absl/status/statusor.h"
+#include "pir/cpp/tracing.h"
 #include "pir/proto/payload.pb.h"
 #include "seal/seal.h"
 
@@ -39,16 +40,22 @@ using std::vector;
  * Decodes and loads a PIR Ciphertext.
  * @param[in] The SEAL context, for buffer allocations.
  * @param[in] The encoded ciphertext.
+ * @param[in] tracer If not nullptr, receives the time of the decoding and the
+ *    number of bytes read.
  * @returns InvalidArgument if the decoding fails.
  **/
 StatusOr<vector<Ciphertext>> LoadCiphertexts(const shared_ptr<SEALContext>& ctx,
-                                             const Ciphertexts& encoded);
+                                             const Ciphertexts& encoded,
+                                             Tracer* const tracer = nullptr);
 
 /**
  * Saves the Ciphertexts to a protobuffer.
+ * @param[in] tracer If not nullptr, receives the time of the encoding and the
+ *    number of bytes written.
  * @returns InvalidArgument if the encoding fails
  **/
-Status SaveCiphertexts(const vector<Ciphertext>& buff, Ciphertexts* output);
+Status SaveCiphertexts(const vector<Ciphertext>& buff, Ciphertexts* output,
+                       Tracer* const tracer = nullptr);
 
 /**
  * Shortcut to save response data to a protocol buffer based on a list of
@@ -75,18 +82,22 @@ Status SaveRequest(const vector<vector<Ciphertext>>& cts,
 /**
  * Saves a SEAL object to a string.
  * Compatible SEAL types: Ciphertext, Plaintext, SecretKey, PublicKey,
- *GaloisKeys, RelinKeys.
+ *GaloisKeys, RelinKeys, and Serializable wrappers of them, such as the seeded
+ *ciphertexts returned by Encryptor::encrypt_symmetric.
+ * @param[in] compr_mode Compression applied to the serialized object.
  * @returns InternalError if the encoding fails.
  **/
 template <class T>
-Status SEALSerialize(const T& sealobj, string* output) {
+Status SEALSerialize(const T& sealobj, string* output,
+                     seal::compr_mode_type compr_mode =
+                         seal::Serialization::compr_mode_default) {
   if (output == nullptr) {
     return InvalidArgumentError("output nullptr");
   }
   std::stringstream stream;
 
   try {
-    sealobj.save(stream);
+    sealobj.save(stream, compr_mode);
   } catch (const std::exception& e) {
     return InternalError(e.what());
   }
@@ -15,10 +15,14 @@
 //
 #include "pir/cpp/server.h"
 
+#include <algorithm>
+#include <limits>
+#include <string>
+
+#include "pir/cpp/backend.h"
 #include "pir/cpp/status_asserts.h"
 #include "pir/cpp/utils.h"
 #include "seal/seal.h"
-#include "seal/util/polyarithsmallmod.h"
 
 namespace pir {
 
@@ -28,47 +32,294 @@ using ::seal::GaloisKeys;
 using ::seal::RelinKeys;
 using ::std::shared_ptr;
 
+PIRServer::ExpansionScratch::ExpansionScratch(
+    const seal::MemoryPoolHandle& pool, size_t levels)
+    : substituted(pool), difference(pool) {
+  siblings.reserve(levels);
+  for (size_t i = 0; i < levels; ++i) {
+    siblings.emplace_back(pool);
+  }
+}
+
 PIRServer::PIRServer(std::unique_ptr<PIRContext> context,
-                     std::shared_ptr<PIRDatabase> db)
-    : context_(std::move(context)), db_(db) {}
+                     std::shared_ptr<PIRDatabase> db, size_t num_threads,
+                     size_t key_cache_bytes)
+    : context_(std::move(context)),
+      db_(db),
+      key_cache_(std::make_unique<KeyCache>(
+          key_cache_bytes, std::numeric_limits<size_t>::max())),
+      galois_elts_(generate_galois_elts(
+          context_->EncryptionParams().poly_modulus_degree(),
+          context_->DimensionsSum())) {
+  if (num_threads > 1) {
+    // The calling thread takes part in the work, so it counts as one.
+    thread_pool_ = std::make_unique<ThreadPool>(num_threads - 1);
+    for (size_t i = 0; i < thread_pool_->size(); ++i) {
+      workers_.push_back(context_->CreateWorkerContext());
+    }
+  }
+  workers_.push_back(context_->DefaultWorkerContext());
+}
 
 StatusOr<std::unique_ptr<PIRServer>> PIRServer::Create(
-    std::shared_ptr<PIRDatabase> db, shared_ptr<PIRParameters> params) {
-  if (params->num_pt() != db->size()) {
-    return absl::InvalidArgumentError("database size mismatch");
+    std::shared_ptr<PIRDatabase> db, shared_ptr<PIRParameters> params,
+    size_t num_threads, size_t key_cache_bytes) {
+  if (num_threads == 0) {
+    return absl::InvalidArgumentError("number of threads must be positive");
   }
   ASSIGN_OR_RETURN(auto context, PIRContext::Create(params));
-  return absl::WrapUnique(new PIRServer(std::move(context), db));
+  const auto shard = context->ShardPlaintexts();
+  if (shard.second - shard.first != db->size()) {
+    return absl::InvalidArgumentError("database size mismatch");
+  }
+  return absl::WrapUnique(
+      new PIRServer(std::move(context), db, num_threads, key_cache_bytes));
 }
 
-StatusOr<Response> PIRServer::ProcessRequest(const Request& request) const {
-  Response response;
-  ASSIGN_OR_RETURN(auto galois_keys,
-                   SEALDeserialize<GaloisKeys>(context_->SEALContext(),
-                                               request.galois_keys()));
+StatusOr<std::shared_ptr<const ClientKeys>> PIRServer::GetKeys(
+    const Request& request) const {
+  ScopedPhase phase(tracer_.get(), Phase::kKeys);
+  if (request.galois_keys().empty() && !request.key_id().empty()) {
+    auto keys = key_cache_->Lookup(request.key_id());
+    if (keys == nullptr) {
+      return absl::NotFoundError("No keys cached for key ID " +
+                                 request.key_id());
+    }
+    return keys;
+  }
 
-  const auto dimensions = context_->Params()->dimensions();
-  const size_t dim_sum = context_->DimensionsSum();
+  // Checking the key set the client listed first avoids deserializing keys
+  // that can't expand the queries.
+  if (request.galois_elts_size() > 0) {
+    for (const auto elt : galois_elts_) {
+      if (std::find(request.galois_elts().begin(), request.galois_elts().end(),
+                    elt) == request.galois_elts().end()) {
+        return absl::InvalidArgumentError(
+            "Galois key set lacks element " + std::to_string(elt) +
+            " needed for expansion");
+      }
+    }
+  }
 
-  optional<RelinKeys> relin_keys;
+  auto keys = std::make_shared<ClientKeys>();
+  ASSIGN_OR_RETURN(keys->galois_keys,
+                   SEALDeserialize<GaloisKeys>(context_->SEALContext(),
+                                               request.galois_keys()));
+  try {
+    for (const auto elt : galois_elts_) {
+      if (!keys->galois_keys.has_key(elt)) {
+        return absl::InvalidArgumentError("Galois keys lack element " +
+                                          std::to_string(elt) +
+                                          " needed for expansion");
+      }
+    }
+  } catch (const std::exception& e) {
+    return absl::InvalidArgumentError(e.what());
+  }
   if (!request.relin_keys().empty()) {
-    ASSIGN_OR_RETURN(relin_keys,
+    ASSIGN_OR_RETURN(keys->relin_keys,
                      SEALDeserialize<RelinKeys>(context_->SEALContext(),
                                                 request.relin_keys()));
   }
+  TraceCount(tracer_.get(), Counter::kBytesIn,
+             request.galois_keys().size() + request.relin_keys().size());
+  if (!request.key_id().empty()) {
+    key_cache_->Insert(
+        request.key_id(), keys,
+        request.galois_keys().size() + request.relin_keys().size());
+  }
+  return keys;
+}
+
+StatusOr<Response> PIRServer::ProcessRequest(
+    const Request& request, const Cancellation* const cancellation) const {
+  Response response;
+  ASSIGN_OR_RETURN(auto keys, GetKeys(request));
+  const auto& galois_keys = keys->galois_keys;
+  const auto& relin_keys = keys->relin_keys;
+
+  const size_t dim_sum = context_->DimensionsSum();
+
+  // Replies are added up front so that each query writes to its own slot and
+  // the order of the replies matches the order of the queries.
+  const size_t num_queries = request.query_size();
+  vector<Ciphertexts*> replies(num_queries);
+  for (auto& reply : replies) {
+    reply = response.add_reply();
+  }
 
-  for (const auto& query : request.query()) {
-    RETURN_IF_ERROR(processQuery(query, galois_keys, relin_keys, dim_sum,
-                                 response.add_reply()));
+  if (thread_pool_ == nullptr || num_queries <= 1) {
+    for (size_t i = 0; i < num_queries; ++i) {
+      RETURN_IF_ERROR(processQuery(request.query(i), galois_keys, relin_keys,
+                                   dim_sum, replies[i], workers_.back(),
+                                   cancellation));
+    }
+    return response;
+  }
+
+  vector<Status> statuses(num_queries);
+  thread_pool_->ParallelFor(num_queries, [&](size_t i, size_t worker) {
+    statuses[i] = processQuery(request.query(i), galois_keys, relin_keys,
+                               dim_sum, replies[i], workers_[worker],
+                               cancellation);
+  });
+  for (const auto& status : statuses) {
+    RETURN_IF_ERROR(status);
   }
   return response;
 }
 
+Status PIRServer::ProcessRequestStreaming(
+    const Request& request, const ResponseSink& sink,
+    const Cancellation* const cancellation) const {
+  ASSIGN_OR_RETURN(auto keys, GetKeys(request));
+  const size_t dim_sum = context_->DimensionsSum();
+  for (size_t q = 0; q < request.query_size(); ++q) {
+    ASSIGN_OR_RETURN(auto results,
+                     multiplyQuery(request.query(q), keys->galois_keys,
+                                   keys->relin_keys, dim_sum, workers_.back(),
+                                   cancellation));
+    // Each ciphertext is let go of as soon as it has been written, so the
+    // reply is never held serialized as a whole.
+    for (auto& ct : results) {
+      string serialized;
+      {
+        ScopedPhase phase(tracer_.get(), Phase::kSerialize);
+        RETURN_IF_ERROR(SEALSerialize<>(ct, &serialized));
+      }
+      ct.release();
+      TraceCount(tracer_.get(), Counter::kBytesOut, serialized.size());
+      RETURN_IF_ERROR(sink(q, results.size(), std::move(serialized)));
+    }
+  }
+  return absl::OkStatus();
+}
+
+Status PIRServer::ProcessQuery(const Ciphertexts& query,
+                               const ClientKeys& keys,
+                               Ciphertexts* reply) const {
+  return ProcessQuery(query, keys, reply, workers_.back());
+}
+
+Status PIRServer::ProcessQuery(const Ciphertexts& query,
+                               const ClientKeys& keys, Ciphertexts* reply,
+                               const WorkerContext& worker) const {
+  return processQuery(query, keys.galois_keys, keys.relin_keys,
+                      context_->DimensionsSum(), reply, worker);
+}
+
+std::vector<StatusOr<Response>> PIRServer::ProcessBatch(
+    absl::Span<const Request> requests) const {
+  const size_t dim_sum = context_->DimensionsSum();
+  vector<Status> statuses(requests.size());
+  vector<std::shared_ptr<const ClientKeys>> keys(requests.size());
+  vector<Response> responses(requests.size());
+
+  // Every query of every request, with the reply it will be written to.
+  struct PendingQuery {
+    size_t request;
+    const Ciphertexts* query;
+    Ciphertexts* reply;
+    vector<seal::Ciphertext> selection_vector;
+    Status status;
+  };
+  vector<PendingQuery> pending;
+  for (size_t r = 0; r < requests.size(); ++r) {
+    auto keys_or = GetKeys(requests[r]);
+    if (!keys_or.ok()) {
+      statuses[r] = keys_or.status();
+      continue;
+    }
+    keys[r] = *std::move(keys_or);
+    for (const auto& query : requests[r].query()) {
+      pending.push_back({r, &query, responses[r].add_reply(), {}, {}});
+    }
+  }
+
+  parallel_for(pending.size(), [&](size_t i, const WorkerContext& worker) {
+    auto& p = pending[i];
+    auto query_or =
+        LoadCiphertexts(context_->SEALContext(), *p.query, tracer_.get());
+    if (!query_or.ok()) {
+      p.status = query_or.status();
+      return;
+    }
+    ScopedPhase phase(tracer_.get(), Phase::kExpansion);
+    auto selection_vector_or = oblivious_expansion(
+        *query_or, dim_sum, keys[p.request]->galois_keys, worker);
+    if (!selection_vector_or.ok()) {
+      p.status = selection_vector_or.status();
+      return;
+    }
+    p.selection_vector = *std::move(selection_vector_or);
+  });
+  for (const auto& p : pending) {
+    if (!p.status.ok() && statuses[p.request].ok()) {
+      statuses[p.request] = p.status;
+    }
+  }
+
+  vector<PendingQuery*> batch;
+  vector<vector<seal::Ciphertext>*> selection_vectors;
+  vector<const RelinKeys*> relin_keys;
+  for (auto& p : pending) {
+    if (!statuses[p.request].ok()) continue;
+    batch.push_back(&p);
+    selection_vectors.push_back(&p.selection_vector);
+    const auto& request_relin_keys = keys[p.request]->relin_keys;
+    relin_keys.push_back(request_relin_keys ? &request_relin_keys.value()
+                                            : nullptr);
+  }
+
+  auto results_or = db_->multiply_batch(selection_vectors, relin_keys,
+                                        tracer_.get(), &workers_.back());
+  if (results_or.ok()) {
+    auto& results = *results_or;
+    parallel_for(batch.size(), [&](size_t i, const WorkerContext&) {
+      batch[i]->status =
+          SaveCiphertexts(results[i], batch[i]->reply, tracer_.get());
+    });
+  }
+  for (auto* p : batch) {
+    if (!statuses[p->request].ok()) continue;
+    statuses[p->request] = results_or.ok() ? p->status : results_or.status();
+  }
+
+  std::vector<StatusOr<Response>> output;
+  output.reserve(requests.size());
+  for (size_t r = 0; r < requests.size(); ++r) {
+    if (statuses[r].ok()) {
+      output.emplace_back(std::move(responses[r]));
+    } else {
+      output.emplace_back(statuses[r]);
+    }
+  }
+  return output;
+}
+
+void PIRServer::parallel_for(
+    size_t n,
+    const std::function<void(size_t, const WorkerContext&)>& fn) const {
+  if (thread_pool_ == nullptr) {
+    for (size_t i = 0; i < n; ++i) fn(i, workers_.back());
+    return;
+  }
+  thread_pool_->ParallelFor(
+      n, [&](size_t i, size_t worker) { fn(i, workers_[worker]); });
+}
+
 Status PIRServer::substitute_power_x_inplace(
     seal::Ciphertext& ct, uint32_t power,
     const seal::GaloisKeys& gal_keys) const {
+  return substitute_power_x_inplace(ct, power, gal_keys, workers_.back());
+}
+
+Status PIRServer::substitute_power_x_inplace(
+    seal::Ciphertext& ct, uint32_t power, const seal::GaloisKeys& gal_keys,
+    const WorkerContext& worker) const {
   try {
-    context_->Evaluator()->apply_galois_inplace(ct, power, gal_keys);
+    db_->backend()->apply_galois_inplace(*worker.evaluator, ct, power, gal_keys,
+                                         worker.pool);
   } catch (const std::exception& e) {
     return absl::InternalError(e.what());
   }
@@ -78,33 +329,18 @@ Status PIRServer::substitute_power_x_inplace(
 void PIRServer::multiply_inverse_power_of_x(
     const seal::Ciphertext& encrypted, uint32_t k,
     seal::Ciphertext& destination) const {
-  // This has to get the actual params from the SEALContext. Using just the
-  // params from PIR doesn't work.
-  const auto& params = context_->SEALContext()->first_context_data()->parms();
-  const auto poly_modulus_degree = params.poly_modulus_degree();
-  const auto coeff_mod_count = params.coeff_modulus().size();
-
-  uint32_t index =
-      ((poly_modulus_degree << 1) - k) % (poly_modulus_degree << 1);
-
-  // have to make a copy here
-  destination = encrypted;
-
-  // Loop over polynomials in ciphertext
-  for (size_t i = 0; i < encrypted.size(); i++) {
-    // loop over each coefficient in polynomial
-    for (size_t j = 0; j < coeff_mod_count; j++) {
-      seal::util::negacyclic_shift_poly_coeffmod(
-          encrypted.data(i) + (j * poly_modulus_degree), poly_modulus_degree,
-          index, params.coeff_modulus()[j],
-          destination.data(i) + (j * poly_modulus_degree));
-    }
-  }
+  db_->backend()->multiply_inverse_power_of_x(encrypted, k, destination);
 }
 
 StatusOr<std::vector<seal::Ciphertext>> PIRServer::oblivious_expansion(
     const seal::Ciphertext& ct, const size_t num_items,
     const seal::GaloisKeys& gal_keys) const {
+  return oblivious_expansion(ct, num_items, gal_keys, workers_.back());
+}
+
+StatusOr<std::vector<seal::Ciphertext>> PIRServer::oblivious_expansion(
+    const seal::Ciphertext& ct, const size_t num_items,
+    const seal::GaloisKeys& gal_keys, const WorkerContext& worker) const {
   const auto poly_modulus_degree =
       context_->EncryptionParams().poly_modulus_degree();
 
@@ -113,41 +349,76 @@ StatusOr<std::vector<seal::Ciphertext>> PIRServer::oblivious_expansion(
         "Cannot expand more items from a CT than poly modulus degree");
   }
 
-  size_t logm = ceil_log2(num_items);
-  std::vector<seal::Ciphertext> results(next_power_two(num_items));
+  const size_t logm = ceil_log2(num_items);
+  std::vector<seal::Ciphertext> results;
+  results.reserve(num_items);
+  while (results.size() < num_items) {
+    results.emplace_back(worker.pool);
+  }
+  if (num_items == 0) {
+    return results;
+  }
   results[0] = ct;
 
-  for (size_t j = 0; j < logm; ++j) {
-    const size_t two_power_j = (1 << j);
-    for (size_t k = 0; k < two_power_j; ++k) {
-      auto c0 = results[k];
-
-      RETURN_IF_ERROR(substitute_power_x_inplace(
-          c0, (poly_modulus_degree >> j) + 1, gal_keys));
+  ExpansionScratch scratch(worker.pool, 0);
+  try {
+    for (size_t j = 0; j < logm; ++j) {
+      const size_t two_power_j = (1 << j);
+      // Items past num_items are never needed, so neither are the nodes that
+      // only lead to them.
+      for (size_t k = 0; k < std::min(two_power_j, num_items); ++k) {
+        auto* sibling = (k + two_power_j < num_items)
+                            ? &results[k + two_power_j]
+                            : nullptr;
+        RETURN_IF_ERROR(
+            expansion_step(results[k], sibling, j, gal_keys, worker, scratch));
+      }
+    }
+  } catch (const std::exception& e) {
+    return absl::InternalError(e.what());
+  }
+  return results;
+}
 
-      // This essentially produces what the paper calls c1
-      multiply_inverse_power_of_x(results[k], two_power_j,
-                                  results[k + two_power_j]);
+Status PIRServer::expansion_step(seal::Ciphertext& ct,
+                                 seal::Ciphertext* sibling, size_t level,
+                                 const seal::GaloisKeys& gal_keys,
+                                 const WorkerContext& worker,
+                                 ExpansionScratch& scratch) const {
+  const size_t poly_modulus_degree =
+      context_->EncryptionParams().poly_modulus_degree();
+  const size_t two_power_j = (1 << level);
 
-      // Do the multiply by power of x after substitution operator to avoid
-      // having to do the substitution operator a second time, since it's about
-      // 20x slower. Except that now instead of multiplying by x^(-2^j) we have
-      // to do the substitution first ourselves, producing
-      // (x^(N/2^j + 1))^(-2^j) = 1/x^(2^j * (N/2^j + 1)) = 1/x^(N + 2^j)
-      seal::Ciphertext c1;
-      multiply_inverse_power_of_x(c0, poly_modulus_degree + two_power_j, c1);
+  auto& c0 = scratch.substituted;
+  c0 = ct;
+  RETURN_IF_ERROR(substitute_power_x_inplace(
+      c0, (poly_modulus_degree >> level) + 1, gal_keys, worker));
 
-      context_->Evaluator()->add_inplace(results[k], c0);
-      context_->Evaluator()->add_inplace(results[k + two_power_j], c1);
-    }
+  if (sibling != nullptr) {
+    // The sibling is ct / x^(2^j) + c0 / x^(N + 2^j). Doing the multiply by
+    // power of x after the substitution operator avoids having to do the
+    // substitution a second time, since it's about 20x slower: instead of
+    // multiplying by x^(-2^j) before substituting, we multiply by
+    // (x^(N/2^j + 1))^(-2^j) = 1/x^(2^j * (N/2^j + 1)) = 1/x^(N + 2^j) after.
+    // As x^N = -1 that is -1/x^(2^j), so both terms share a single shift of
+    // ct - c0.
+    worker.evaluator->sub(ct, c0, scratch.difference);
+    multiply_inverse_power_of_x(scratch.difference, two_power_j, *sibling);
   }
-  results.resize(num_items);
-  return results;
+  worker.evaluator->add_inplace(ct, c0);
+  TraceCount(tracer_.get(), Counter::kGalois);
+  return absl::OkStatus();
 }
 
 StatusOr<std::vector<seal::Ciphertext>> PIRServer::oblivious_expansion(
     const std::vector<seal::Ciphertext>& cts, size_t total_items,
     const seal::GaloisKeys& gal_keys) const {
+  return oblivious_expansion(cts, total_items, gal_keys, workers_.back());
+}
+
+StatusOr<std::vector<seal::Ciphertext>> PIRServer::oblivious_expansion(
+    const std::vector<seal::Ciphertext>& cts, size_t total_items,
+    const seal::GaloisKeys& gal_keys, const WorkerContext& worker) const {
   size_t poly_modulus_degree =
       context_->EncryptionParams().poly_modulus_degree();
 
@@ -161,8 +432,9 @@ StatusOr<std::vector<seal::Ciphertext>> PIRServer::oblivious_expansion(
   results.reserve(total_items);
   for (const auto& ct : cts) {
     ASSIGN_OR_RETURN(
-        auto v, oblivious_expansion(
-                    ct, std::min(poly_modulus_degree, total_items), gal_keys));
+        auto v,
+        oblivious_expansion(ct, std::min(poly_modulus_degree, total_items),
+                            gal_keys, worker));
     results.insert(results.end(), std::make_move_iterator(v.begin()),
                    std::make_move_iterator(v.end()));
     total_items -= poly_modulus_degree;
@@ -170,28 +442,190 @@ StatusOr<std::vector<seal::Ciphertext>> PIRServer::oblivious_expansion(
   return results;
 }
 
-Status PIRServer::processQuery(const Ciphertexts& query_proto,
-                               const GaloisKeys& galois_keys,
-                               const optional<RelinKeys>& relin_keys,
-                               const size_t& dim_sum,
-                               Ciphertexts* output) const {
-  ASSIGN_OR_RETURN(auto query,
-                   LoadCiphertexts(context_->SEALContext(), query_proto));
+Status PIRServer::oblivious_expansion_streaming(
+    const seal::Ciphertext& ct, const size_t num_items,
+    const seal::GaloisKeys& gal_keys,
+    const std::function<Status(size_t, seal::Ciphertext&)>& visitor) const {
+  return oblivious_expansion_streaming(ct, num_items, gal_keys, workers_.back(),
+                                       visitor);
+}
 
-  ASSIGN_OR_RETURN(auto selection_vector,
-                   oblivious_expansion(query, dim_sum, galois_keys));
+Status PIRServer::oblivious_expansion_streaming(
+    const seal::Ciphertext& ct, const size_t num_items,
+    const seal::GaloisKeys& gal_keys, const WorkerContext& worker,
+    const std::function<Status(size_t, seal::Ciphertext&)>& visitor) const {
+  const auto poly_modulus_degree =
+      context_->EncryptionParams().poly_modulus_degree();
 
-  vector<seal::Ciphertext> results;
-  if (relin_keys) {
-    ASSIGN_OR_RETURN(results,
-                     db_->multiply(selection_vector, &relin_keys.value()));
-  } else {
-    ASSIGN_OR_RETURN(results, db_->multiply(selection_vector));
+  if (num_items > poly_modulus_degree) {
+    return absl::InvalidArgumentError(
+        "Cannot expand more items from a CT than poly modulus degree");
+  }
+  if (num_items == 0) {
+    return absl::OkStatus();
   }
 
-  RETURN_IF_ERROR(SaveCiphertexts(results, output));
+  try {
+    const size_t logm = ceil_log2(num_items);
+    ExpansionScratch scratch(worker.pool, logm);
+    seal::Ciphertext root(ct, worker.pool);
+    return expand_subtree(root, 0, 0, logm, num_items, gal_keys, worker,
+                          scratch, visitor);
+  } catch (const std::exception& e) {
+    return absl::InternalError(e.what());
+  }
+}
 
+Status PIRServer::expand_subtree(
+    seal::Ciphertext& ct, size_t index, size_t level, size_t logm,
+    size_t num_items, const seal::GaloisKeys& gal_keys,
+    const WorkerContext& worker, ExpansionScratch& scratch,
+    const std::function<Status(size_t, seal::Ciphertext&)>& visitor) const {
+  if (level == logm) {
+    return visitor(index, ct);
+  }
+
+  // All items of the subtree at index + 2^j are at least index + 2^j. Only
+  // one sibling per level is alive at a time, so each level has one buffer.
+  const size_t two_power_j = (1 << level);
+  const bool expand_sibling = index + two_power_j < num_items;
+  auto& sibling = scratch.siblings[level];
+  // The visitor may have taken the buffer at a leaf of an earlier subtree,
+  // leaving it without memory to write the next sibling into.
+  if (expand_sibling && !sibling.pool()) {
+    sibling = seal::Ciphertext(worker.pool);
+  }
+  RETURN_IF_ERROR(expansion_step(ct, expand_sibling ? &sibling : nullptr,
+                                 level, gal_keys, worker, scratch));
+
+  RETURN_IF_ERROR(expand_subtree(ct, index, level + 1, logm, num_items,
+                                 gal_keys, worker, scratch, visitor));
+  if (expand_sibling) {
+    return expand_subtree(sibling, index + two_power_j, level + 1, logm,
+                          num_items, gal_keys, worker, scratch, visitor);
+  }
   return absl::OkStatus();
 }
 
+StatusOr<vector<seal::Ciphertext>> PIRServer::multiplyQueryStreaming(
+    const vector<seal::Ciphertext>& query, const GaloisKeys& galois_keys,
+    const optional<RelinKeys>& relin_keys, const size_t& dim_sum,
+    const WorkerContext& worker, const Cancellation* cancellation) const {
+  const size_t poly_modulus_degree =
+      context_->EncryptionParams().poly_modulus_degree();
+  if (query.size() != dim_sum / poly_modulus_degree + 1) {
+    return absl::InvalidArgumentError(
+        "Number of ciphertexts doesn't match number of items for oblivious "
+        "expansion.");
+  }
+
+  // Every row of the first dimension is multiplied with the whole selection
+  // vector of the lower dimensions, so the query ciphertexts holding any of
+  // those are expanded up front. Only the query ciphertexts before them, which
+  // hold nothing but rows of the first dimension, are streamed.
+  const size_t first_dimension = context_->Params()->dimensions(0);
+  const size_t num_streamed = first_dimension < dim_sum
+                                  ? first_dimension / poly_modulus_degree
+                                  : query.size();
+  vector<seal::Ciphertext> selection_vector(dim_sum);
+  vector<size_t> held_rows;
+  {
+    // The expansion of the streamed rows is interleaved with their
+    // multiplication, so only this part is traced as a phase of its own.
+    ScopedPhase phase(tracer_.get(), Phase::kExpansion);
+    for (size_t c = num_streamed; c < query.size(); ++c) {
+      const size_t offset = c * poly_modulus_degree;
+      RETURN_IF_ERROR(oblivious_expansion_streaming(
+          query[c], std::min(poly_modulus_degree, dim_sum - offset),
+          galois_keys, worker, [&](size_t i, seal::Ciphertext& ct) {
+            selection_vector[offset + i] = std::move(ct);
+            if (offset + i < first_dimension) held_rows.push_back(offset + i);
+            return absl::OkStatus();
+          }));
+    }
+  }
+  vector<seal::Ciphertext> held(held_rows.size());
+  for (size_t i = 0; i < held_rows.size(); ++i) {
+    held[i] = std::move(selection_vector[held_rows[i]]);
+  }
+
+  ASSIGN_OR_RETURN(
+      auto multiplier,
+      db_->begin_multiply(std::move(selection_vector),
+                          relin_keys ? &relin_keys.value() : nullptr, &worker,
+                          tracer_.get()));
+  // Rows are multiplied one at a time, so the request is checked before each.
+  auto add_row = [&](size_t row, seal::Ciphertext& ct) -> Status {
+    if (cancellation != nullptr) RETURN_IF_ERROR(cancellation->status());
+    return multiplier->add_row(row, ct);
+  };
+  for (size_t i = 0; i < held_rows.size(); ++i) {
+    RETURN_IF_ERROR(add_row(held_rows[i], held[i]));
+  }
+  for (size_t c = 0; c < num_streamed; ++c) {
+    const size_t offset = c * poly_modulus_degree;
+    RETURN_IF_ERROR(oblivious_expansion_streaming(
+        query[c], std::min(poly_modulus_degree, dim_sum - offset), galois_keys,
+        worker, [&](size_t i, seal::Ciphertext& ct) {
+          return add_row(offset + i, ct);
+        }));
+  }
+  return multiplier->finish();
+}
+
+StatusOr<vector<seal::Ciphertext>> PIRServer::multiplyQuery(
+    const Ciphertexts& query_proto, const GaloisKeys& galois_keys,
+    const optional<RelinKeys>& relin_keys, const size_t& dim_sum,
+    const WorkerContext& worker, const Cancellation* cancellation) const {
+  if (cancellation != nullptr) RETURN_IF_ERROR(cancellation->status());
+  Tracer* const tracer = tracer_.get();
+  // The pool only grows, so the difference is what this query allocated,
+  // along with anyone else sharing the pool in the meantime.
+  const size_t allocated = tracer != nullptr ? worker.pool.alloc_byte_count()
+                                             : 0;
+  auto results = expandAndMultiply(query_proto, galois_keys, relin_keys,
+                                   dim_sum, worker, cancellation);
+  if (tracer != nullptr) {
+    tracer->Count(Counter::kAllocatedBytes,
+                  worker.pool.alloc_byte_count() - allocated);
+  }
+  return results;
+}
+
+StatusOr<vector<seal::Ciphertext>> PIRServer::expandAndMultiply(
+    const Ciphertexts& query_proto, const GaloisKeys& galois_keys,
+    const optional<RelinKeys>& relin_keys, const size_t& dim_sum,
+    const WorkerContext& worker, const Cancellation* cancellation) const {
+  ASSIGN_OR_RETURN(auto query, LoadCiphertexts(context_->SEALContext(),
+                                               query_proto, tracer_.get()));
+  if (streaming_expansion_) {
+    return multiplyQueryStreaming(query, galois_keys, relin_keys, dim_sum,
+                                  worker, cancellation);
+  }
+
+  vector<seal::Ciphertext> selection_vector;
+  {
+    ScopedPhase phase(tracer_.get(), Phase::kExpansion);
+    ASSIGN_OR_RETURN(selection_vector,
+                     oblivious_expansion(query, dim_sum, galois_keys, worker));
+  }
+  if (cancellation != nullptr) RETURN_IF_ERROR(cancellation->status());
+
+  return db_->multiply(selection_vector,
+                       relin_keys ? &relin_keys.value() : nullptr,
+                       tracer_.get(), &worker, cancellation);
+}
+
+Status PIRServer::processQuery(const Ciphertexts& query_proto,
+                               const GaloisKeys& galois_keys,
+                               const optional<RelinKeys>& relin_keys,
+                               const size_t& dim_sum, Ciphertexts* output,
+                               const WorkerContext& worker,
+                               const Cancellation* cancellation) const {
+  ASSIGN_OR_RETURN(auto results,
+                   multiplyQuery(query_proto, galois_keys, relin_keys, dim_sum,
+                                 worker, cancellation));
+  return SaveCiphertexts(results, output, tracer_.get());
+}
+
 }  // namespace pir
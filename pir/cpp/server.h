@@ -17,12 +17,19 @@
 #ifndef PIR_SERVER_H_
 #define PIR_SERVER_H_
 
+#include <functional>
+#include <string>
 #include <vector>
 
 #include "absl/status/statusor.h"
+#include "absl/types/span.h"
+#include "pir/cpp/cancellation.h"
 #include "pir/cpp/context.h"
 #include "pir/cpp/database.h"
+#include "pir/cpp/key_cache.h"
 #include "pir/cpp/serialization.h"
+#include "pir/cpp/thread_pool.h"
+#include "pir/cpp/tracing.h"
 #include "seal/seal.h"
 
 namespace pir {
@@ -38,18 +45,118 @@ class PIRServer {
    * Creates and returns a new server instance, holding a database.
    * @param[in] db PIRDatabase to load
    * @param[in] params PIR Paramerters
+   * @param[in] num_threads Number of threads used to process the queries of a
+   *    request in parallel. Each thread gets its own evaluator and memory
+   *    pool. With 1, queries are processed one at a time on the calling
+   *    thread.
+   * @param[in] key_cache_bytes Size limit of the cache of deserialized client
+   *    keys, measured by the serialized size of the keys. With 0, keys are
+   *    never cached and every request must include them.
    * @returns InvalidArgument if the database encoding fails
    **/
   static StatusOr<std::unique_ptr<PIRServer>> Create(
-      std::shared_ptr<PIRDatabase> database, shared_ptr<PIRParameters> params);
+      std::shared_ptr<PIRDatabase> database, shared_ptr<PIRParameters> params,
+      size_t num_threads = 1, size_t key_cache_bytes = 0);
 
   /**
-   * Handles a client request.
+   * Handles a client request. Replies are in the same order as the queries
+   * in the request, regardless of the number of threads used. If the request
+   * has a key ID and keys, the keys are cached under the ID; if it has a key ID
+   * and no keys, the cached keys are used.
    * @param[in] request The PIR Payload
+   * @param[in] cancellation If not nullptr, checked between the queries of the
+   *    request, after their expansion and between the rows of the higher
+   *    dimensions of the database, so that a cancelled request or one past
+   *    its deadline stops early.
    * @returns InvalidArgument if the deserialization or encrypted operations
-   *fail
+   *fail, NotFound if the request refers to keys that aren't cached, and
+   *Cancelled or DeadlineExceeded if the request was stopped
    **/
-  StatusOr<Response> ProcessRequest(const Request& request) const;
+  StatusOr<Response> ProcessRequest(
+      const Request& request,
+      const Cancellation* const cancellation = nullptr) const;
+
+  /**
+   * Receives the ciphertexts of the replies of a request one at a time, as
+   * they are serialized. Called with the index of the query in the request,
+   * the number of ciphertexts in its reply, and the next ciphertext of the
+   * reply, in order. An error stops the processing of the request.
+   */
+  using ResponseSink = std::function<Status(
+      std::size_t query, std::size_t num_ciphertexts, std::string ciphertext)>;
+
+  /**
+   * Handles a client request like ProcessRequest, writing each ciphertext of
+   * the replies to a sink as soon as it is serialized instead of building a
+   * whole Response, so that the server can start sending a reply before the
+   * rest is written and never holds it serialized in full. Queries are
+   * processed one after the other on the calling thread, so that replies
+   * reach the sink in the order of the queries; the database's threads
+   * still split each multiplication. See PIRClient::BeginReply for the
+   * client side.
+   * @param[in] request The PIR Payload
+   * @param[in] sink Receives the ciphertexts of the replies.
+   * @param[in] cancellation If not nullptr, stops the request early as in
+   *    ProcessRequest.
+   * @returns The errors of ProcessRequest, or the first error of the sink
+   **/
+  Status ProcessRequestStreaming(
+      const Request& request, const ResponseSink& sink,
+      const Cancellation* const cancellation = nullptr) const;
+
+  /**
+   * Handles the requests of many clients together. The queries of all of the
+   * requests are expanded first, and then multiplied with the database in a
+   * single pass, so each database plaintext is read once for the whole batch
+   * instead of once per query.
+   * @param[in] requests Requests to process, possibly from different clients.
+   * @returns The response to each request, in the same order as the requests.
+   *    A request that fails doesn't affect the others in the batch.
+   **/
+  std::vector<StatusOr<Response>> ProcessBatch(
+      absl::Span<const Request> requests) const;
+
+  /**
+   * Finds the keys to use for a request, deserializing them from the request
+   * or fetching them from the key cache. Keys from the request are checked to
+   * hold every Galois element expansion needs before they are cached.
+   * @returns InvalidArgument if the Galois keys can't expand the queries,
+   *    NotFound if the request refers to keys that aren't cached
+   */
+  StatusOr<std::shared_ptr<const ClientKeys>> GetKeys(
+      const Request& request) const;
+
+  /**
+   * Handles a single query on the calling thread, with keys from GetKeys of
+   * this or any other server with the same encryption parameters. Lets a
+   * caller holding several servers share one set of keys between them.
+   * @param[in] query The query ciphertexts
+   * @param[in] keys Keys of the client that sent the query
+   * @param[out] reply Reply to the query
+   * @returns InvalidArgument if the encrypted operations fail
+   */
+  Status ProcessQuery(const Ciphertexts& query, const ClientKeys& keys,
+                      Ciphertexts* reply) const;
+
+  /**
+   * Handles a single query as above, with the evaluator and memory pool of
+   * the calling thread instead of the ones shared by the server. Lets a
+   * caller running queries of several servers on its own threads give each
+   * thread its own.
+   * @param[in] query The query ciphertexts
+   * @param[in] keys Keys of the client that sent the query
+   * @param[out] reply Reply to the query
+   * @param[in] worker Worker context of the calling thread, created from a
+   *    context with the same encryption parameters as this server.
+   * @returns InvalidArgument if the encrypted operations fail
+   */
+  Status ProcessQuery(const Ciphertexts& query, const ClientKeys& keys,
+                      Ciphertexts* reply, const WorkerContext& worker) const;
+
+  /**
+   * Returns the counters of the client key cache.
+   **/
+  KeyCacheMetrics GetKeyCacheMetrics() const { return key_cache_->Metrics(); }
 
   PIRServer() = delete;
 
@@ -127,19 +234,163 @@ class PIRServer {
       const std::vector<seal::Ciphertext>& cts, const size_t total_items,
       const seal::GaloisKeys& gal_keys) const;
 
+  /**
+   * Streaming version of oblivious_expansion. Instead of returning all of the
+   * expanded ciphertexts at once, calls visitor(i, ct) with the expansion of
+   * item i as soon as it has been computed. The expansion tree is walked depth
+   * first, so only O(log num_items) ciphertexts are alive at any time, and
+   * branches that only lead to items past num_items are never computed. Items
+   * are visited in bit-reversed order of their index.
+   *
+   * @param[in] ct The input ciphertext to expand.
+   * @param[in] num_items The number of items to extract.
+   * @param[in] gal_keys Galois keys supplied by the client.
+   * @param[in] visitor Called with each item index and its ciphertext, which
+   *    the visitor may take. Expansion stops at the first error it returns.
+   * @returns The first error from the expansion or the visitor.
+   */
+  Status oblivious_expansion_streaming(
+      const seal::Ciphertext& ct, const size_t num_items,
+      const seal::GaloisKeys& gal_keys,
+      const std::function<Status(size_t, seal::Ciphertext&)>& visitor) const;
+
+  /**
+   * Sets whether ProcessRequest expands the first dimension of each query
+   * lazily. When enabled, the selection ciphertexts of the first dimension are
+   * multiplied with the database as they come out of the expansion instead of
+   * being materialized first, so that peak memory per query no longer grows
+   * with the size of the first dimension. Only the ciphertexts of the other
+   * dimensions, plus those of the first dimension that share a query
+   * ciphertext with them, are held in memory. The rows of a query are then
+   * multiplied on a single thread. ProcessBatch always materializes the
+   * selection vectors.
+   */
+  void set_streaming_expansion(bool streaming) {
+    streaming_expansion_ = streaming;
+  }
+
+  /**
+   * Sets the tracer that receives the time of each phase of every request,
+   * such as key lookup, expansion and the multiplication with the database,
+   * and the counts of homomorphic operations, bytes and allocations. With
+   * nullptr, the default, nothing is measured. Must not be called while
+   * requests are processed.
+   */
+  void set_tracer(std::shared_ptr<Tracer> tracer) {
+    tracer_ = std::move(tracer);
+  }
+
   // Just for testing: get the context
   PIRContext* Context() { return context_.get(); }
 
  private:
   PIRServer(std::unique_ptr<PIRContext> /*sealctx*/,
-            std::shared_ptr<PIRDatabase> /*db*/);
+            std::shared_ptr<PIRDatabase> /*db*/, size_t /*num_threads*/,
+            size_t /*key_cache_bytes*/);
+
+  /**
+   * Calls fn(i, worker) for every i in [0, n), on the thread pool if there is
+   * one, with the worker context of the thread making each call.
+   */
+  void parallel_for(
+      size_t n,
+      const std::function<void(size_t, const WorkerContext&)>& fn) const;
+
+  Status substitute_power_x_inplace(seal::Ciphertext& ct, std::uint32_t power,
+                                    const seal::GaloisKeys& gal_keys,
+                                    const WorkerContext& worker) const;
+
+  StatusOr<std::vector<seal::Ciphertext>> oblivious_expansion(
+      const seal::Ciphertext& ct, const size_t num_items,
+      const seal::GaloisKeys& gal_keys, const WorkerContext& worker) const;
+
+  StatusOr<std::vector<seal::Ciphertext>> oblivious_expansion(
+      const std::vector<seal::Ciphertext>& cts, size_t total_items,
+      const seal::GaloisKeys& gal_keys, const WorkerContext& worker) const;
+
+  Status oblivious_expansion_streaming(
+      const seal::Ciphertext& ct, const size_t num_items,
+      const seal::GaloisKeys& gal_keys, const WorkerContext& worker,
+      const std::function<Status(size_t, seal::Ciphertext&)>& visitor) const;
+
+  /**
+   * Buffers reused by every step of one expansion, allocated from the
+   * worker's memory pool.
+   */
+  struct ExpansionScratch {
+    ExpansionScratch(const seal::MemoryPoolHandle& pool, size_t levels);
+
+    // Substituted copy of the node being expanded.
+    seal::Ciphertext substituted;
+    // Difference of the node and its substitution.
+    seal::Ciphertext difference;
+    // One sibling per level of a depth first expansion.
+    std::vector<seal::Ciphertext> siblings;
+  };
+
+  /**
+   * One step of the expansion at the given level: turns ct into its child
+   * holding the same index and, unless sibling is nullptr, writes the child
+   * at index + 2^level to sibling.
+   */
+  Status expansion_step(seal::Ciphertext& ct, seal::Ciphertext* sibling,
+                        size_t level, const seal::GaloisKeys& gal_keys,
+                        const WorkerContext& worker,
+                        ExpansionScratch& scratch) const;
+
+  /**
+   * Expands the subtree of the expansion tree rooted at ct, which holds the
+   * items congruent to index modulo 2^level.
+   */
+  Status expand_subtree(
+      seal::Ciphertext& ct, size_t index, size_t level, size_t logm,
+      size_t num_items, const seal::GaloisKeys& gal_keys,
+      const WorkerContext& worker, ExpansionScratch& scratch,
+      const std::function<Status(size_t, seal::Ciphertext&)>& visitor) const;
 
   Status processQuery(const Ciphertexts& query, const GaloisKeys& galois_keys,
                       const optional<RelinKeys>& relin_keys,
-                      const size_t& dim_sum, Ciphertexts* output) const;
+                      const size_t& dim_sum, Ciphertexts* output,
+                      const WorkerContext& worker,
+                      const Cancellation* cancellation = nullptr) const;
+
+  // Expands a query and multiplies it with the database.
+  StatusOr<vector<seal::Ciphertext>> multiplyQuery(
+      const Ciphertexts& query, const GaloisKeys& galois_keys,
+      const optional<RelinKeys>& relin_keys, const size_t& dim_sum,
+      const WorkerContext& worker, const Cancellation* cancellation) const;
+
+  // multiplyQuery without the cancellation check and allocation count.
+  StatusOr<vector<seal::Ciphertext>> expandAndMultiply(
+      const Ciphertexts& query, const GaloisKeys& galois_keys,
+      const optional<RelinKeys>& relin_keys, const size_t& dim_sum,
+      const WorkerContext& worker, const Cancellation* cancellation) const;
+
+  StatusOr<vector<seal::Ciphertext>> multiplyQueryStreaming(
+      const vector<seal::Ciphertext>& query, const GaloisKeys& galois_keys,
+      const optional<RelinKeys>& relin_keys, const size_t& dim_sum,
+      const WorkerContext& worker, const Cancellation* cancellation) const;
 
   std::unique_ptr<PIRContext> context_;
   std::shared_ptr<PIRDatabase> db_;
+
+  // Null when queries are processed on the calling thread.
+  std::unique_ptr<ThreadPool> thread_pool_;
+
+  // One entry per thread pool worker, followed by one for threads outside of
+  // the pool.
+  std::vector<WorkerContext> workers_;
+
+  // Deserialized client keys by key ID.
+  std::unique_ptr<KeyCache> key_cache_;
+
+  bool streaming_expansion_ = false;
+
+  // Null when requests aren't traced.
+  std::shared_ptr<Tracer> tracer_;
+
+  // Galois elements needed to obliviously expand a query.
+  const std::vector<uint32_t> galois_elts_;
 };
 
 }  // namespace pir
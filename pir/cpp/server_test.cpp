@@ -93,6 +93,59 @@ class PIRServerTest : public ::testing::TestWithParam<bool>,
                size_t elem_size = ELEM_SIZE, uint32_t plain_mod_bit_size = 20) {
     SetUpDBImpl(dbsize, dimensions, elem_size, plain_mod_bit_size, GetParam());
   }
+
+  void TestProcessRequest2Dim() {
+    const size_t desired_index = 42;
+
+    uint64_t m_inv;
+    ASSERT_TRUE(seal::util::try_invert_uint_mod(
+        next_power_two(server_->Context()->DimensionsSum()),
+        server_->Context()->EncryptionParams().plain_modulus().value(), m_inv));
+
+    Plaintext pt(POLY_MODULUS_DEGREE);
+    pt.set_zero();
+    // select 4th row
+    pt[4] = m_inv;
+    // select 6th column (after 10-item selection vector for rows)
+    pt[16] = m_inv;
+
+    vector<Ciphertext> query(1);
+    encryptor_->encrypt(pt, query[0]);
+
+    Request request_proto;
+    SaveRequest({query}, gal_keys_, relin_keys_, &request_proto);
+
+    ASSIGN_OR_FAIL(auto response, server_->ProcessRequest(request_proto));
+    ASSERT_EQ(response.reply_size(), 1);
+    ASSIGN_OR_FAIL(auto reply,
+                   LoadCiphertexts(server_->Context()->SEALContext(),
+                                   response.reply(0)));
+
+    Plaintext result_pt;
+    if (GetParam()) {
+      // CT Multiplication
+      ASSERT_THAT(reply, SizeIs(1));
+      EXPECT_THAT(reply[0].size(), Eq(2))
+          << "Ciphertext larger than expected. Were relin keys used?";
+      decryptor_->decrypt(reply[0], result_pt);
+
+    } else {
+      ASSIGN_OR_FAIL(auto ct_reencoder, CiphertextReencoder::Create(
+                                            server_->Context()->SEALContext()));
+      ASSERT_THAT(reply,
+                  SizeIs(ct_reencoder->ExpansionRatio() * query[0].size()));
+      vector<Plaintext> reply_pts(reply.size());
+      for (size_t i = 0; i < reply_pts.size(); ++i) {
+        decryptor_->decrypt(reply[i], reply_pts[i]);
+      }
+      auto result_ct = ct_reencoder->Decode(reply_pts);
+      EXPECT_EQ(result_ct.size(), query[0].size());
+      decryptor_->decrypt(result_ct, result_pt);
+    }
+
+    auto encoder = server_->Context()->Encoder();
+    ASSERT_THAT(encoder->decode_int64(result_pt), Eq(int_db_[desired_index]));
+  }
 };
 
 TEST_P(PIRServerTest, TestProcessRequest_SingleCT) {
@@ -150,6 +203,35 @@ TEST_P(PIRServerTest, TestProcessRequest_MultiCT) {
                  next_power_two(db_size_ - POLY_MODULUS_DEGREE)));
 }
 
+TEST_P(PIRServerTest, TestProcessRequestStreaming_MultiCT) {
+  SetUpDB(5000);
+  server_->set_streaming_expansion(true);
+  const size_t desired_index = 4200;
+  Plaintext pt(POLY_MODULUS_DEGREE);
+  pt.set_zero();
+
+  vector<Ciphertext> query(2);
+  encryptor_->encrypt(pt, query[0]);
+  pt[desired_index - POLY_MODULUS_DEGREE] = 1;
+  encryptor_->encrypt(pt, query[1]);
+
+  Request request_proto;
+  SaveRequest({query}, gal_keys_, relin_keys_, &request_proto);
+
+  ASSIGN_OR_FAIL(auto result_raw, server_->ProcessRequest(request_proto));
+  ASSERT_EQ(result_raw.reply_size(), 1);
+  ASSIGN_OR_FAIL(auto result, LoadCiphertexts(server_->Context()->SEALContext(),
+                                              result_raw.reply(0)));
+  ASSERT_THAT(result, SizeIs(1));
+
+  Plaintext result_pt;
+  decryptor_->decrypt(result[0], result_pt);
+  auto encoder = server_->Context()->Encoder();
+  ASSERT_THAT(encoder->decode_int64(result_pt),
+              Eq(int_db_[desired_index] *
+                 next_power_two(db_size_ - POLY_MODULUS_DEGREE)));
+}
+
 TEST_P(PIRServerTest, TestProcessBatchRequest) {
   const vector<size_t> indexes = {3, 4, 5};
   vector<vector<Ciphertext>> queries(indexes.size());
@@ -182,45 +264,176 @@ TEST_P(PIRServerTest, TestProcessBatchRequest) {
   }
 }
 
-// Make sure that if we get a weird request from client nothing explodes.
-TEST_P(PIRServerTest, TestProcessRequestZeroInput) {
+TEST_P(PIRServerTest, TestProcessBatchRequestMultiThreaded) {
+  ASSIGN_OR_FAIL(server_, PIRServer::Create(pir_db_, pir_params_, 4));
+  const vector<size_t> indexes = {9, 3, 4, 5, 0, 1, 8};
+  vector<vector<Ciphertext>> queries(indexes.size());
+
+  for (size_t idx = 0; idx < indexes.size(); ++idx) {
+    Plaintext pt(POLY_MODULUS_DEGREE);
+    pt.set_zero();
+    pt[indexes[idx]] = 1;
+
+    vector<Ciphertext> query(1);
+    encryptor_->encrypt(pt, query[0]);
+    queries[idx] = query;
+  }
+
+  Request request_proto;
+  SaveRequest(queries, gal_keys_, relin_keys_, &request_proto);
+
+  ASSIGN_OR_FAIL(auto response, server_->ProcessRequest(request_proto));
+  ASSERT_EQ(response.reply_size(), indexes.size());
+  for (size_t idx = 0; idx < indexes.size(); ++idx) {
+    ASSIGN_OR_FAIL(auto result,
+                   LoadCiphertexts(server_->Context()->SEALContext(),
+                                   response.reply(idx)));
+    ASSERT_THAT(result, SizeIs(1));
+
+    Plaintext result_pt;
+    decryptor_->decrypt(result[0], result_pt);
+    auto encoder = server_->Context()->Encoder();
+    ASSERT_THAT(encoder->decode_int64(result_pt),
+                Eq(int_db_[indexes[idx]] * next_power_two(db_size_)))
+        << "idx = " << idx;
+  }
+}
+
+TEST_P(PIRServerTest, TestProcessBatch) {
+  const vector<vector<size_t>> indexes = {{3}, {9, 0}, {1}, {5}};
+  vector<Request> requests(indexes.size());
+  for (size_t r = 0; r < indexes.size(); ++r) {
+    vector<vector<Ciphertext>> queries(indexes[r].size());
+    for (size_t idx = 0; idx < indexes[r].size(); ++idx) {
+      Plaintext pt(POLY_MODULUS_DEGREE);
+      pt.set_zero();
+      pt[indexes[r][idx]] = 1;
+      queries[idx].resize(1);
+      encryptor_->encrypt(pt, queries[idx][0]);
+    }
+    SaveRequest(queries, gal_keys_, relin_keys_, &requests[r]);
+  }
+  // A request that can't be processed must not affect the others.
+  requests[2].set_galois_keys("invalid");
+
+  auto responses = server_->ProcessBatch(requests);
+  ASSERT_THAT(responses, SizeIs(requests.size()));
+  EXPECT_THAT(responses[2].status().code(),
+              Eq(absl::StatusCode::kInvalidArgument));
+  auto encoder = server_->Context()->Encoder();
+  for (size_t r : {0, 1, 3}) {
+    ASSERT_OK(responses[r].status());
+    ASSERT_EQ(responses[r]->reply_size(), indexes[r].size());
+    for (size_t idx = 0; idx < indexes[r].size(); ++idx) {
+      ASSIGN_OR_FAIL(auto result,
+                     LoadCiphertexts(server_->Context()->SEALContext(),
+                                     responses[r]->reply(idx)));
+      ASSERT_THAT(result, SizeIs(1));
+
+      Plaintext result_pt;
+      decryptor_->decrypt(result[0], result_pt);
+      ASSERT_THAT(encoder->decode_int64(result_pt),
+                  Eq(int_db_[indexes[r][idx]] * next_power_two(db_size_)))
+          << "r = " << r << ", idx = " << idx;
+    }
+  }
+}
+
+TEST_P(PIRServerTest, TestCreateZeroThreads) {
+  auto server_or = PIRServer::Create(pir_db_, pir_params_, 0);
+  ASSERT_THAT(server_or.status().code(),
+              Eq(absl::StatusCode::kInvalidArgument));
+}
+
+TEST_P(PIRServerTest, TestProcessRequestCachedKeys) {
+  ASSIGN_OR_FAIL(server_, PIRServer::Create(pir_db_, pir_params_, 1, 1 << 30));
+  const size_t desired_index = 7;
   Plaintext pt(POLY_MODULUS_DEGREE);
   pt.set_zero();
+  pt[desired_index] = 1;
 
   vector<Ciphertext> query(1);
   encryptor_->encrypt(pt, query[0]);
 
-  Request request_proto;
-  SaveRequest({query}, gal_keys_, relin_keys_, &request_proto);
+  Request with_keys;
+  SaveRequest({query}, gal_keys_, relin_keys_, &with_keys);
+  with_keys.set_key_id("client");
+  ASSERT_OK(server_->ProcessRequest(with_keys).status());
 
-  ASSIGN_OR_FAIL(auto result_raw, server_->ProcessRequest(request_proto));
+  Request without_keys;
+  SaveRequest({query}, &without_keys);
+  without_keys.set_key_id("client");
+  ASSIGN_OR_FAIL(auto result_raw, server_->ProcessRequest(without_keys));
   ASSERT_EQ(result_raw.reply_size(), 1);
   ASSIGN_OR_FAIL(auto result, LoadCiphertexts(server_->Context()->SEALContext(),
                                               result_raw.reply(0)));
-
   ASSERT_THAT(result, SizeIs(1));
 
   Plaintext result_pt;
   decryptor_->decrypt(result[0], result_pt);
   auto encoder = server_->Context()->Encoder();
-  ASSERT_THAT(encoder->decode_int64(result_pt), 0);
+  ASSERT_THAT(encoder->decode_int64(result_pt),
+              Eq(int_db_[desired_index] * next_power_two(db_size_)));
+
+  const auto metrics = server_->GetKeyCacheMetrics();
+  EXPECT_THAT(metrics.insertions, Eq(1));
+  EXPECT_THAT(metrics.hits, Eq(1));
+  EXPECT_THAT(metrics.entries, Eq(1));
+  EXPECT_THAT(metrics.bytes, Eq(with_keys.galois_keys().size() +
+                                with_keys.relin_keys().size()));
 }
 
-TEST_P(PIRServerTest, TestProcessRequest_2Dim) {
-  SetUpDB(82, 2);
-  const size_t desired_index = 42;
+TEST_P(PIRServerTest, TestProcessRequestMissingGaloisKeys) {
+  ASSIGN_OR_FAIL(server_, PIRServer::Create(pir_db_, pir_params_, 1, 1 << 30));
+  Plaintext pt(POLY_MODULUS_DEGREE);
+  pt.set_zero();
+
+  vector<Ciphertext> query(1);
+  encryptor_->encrypt(pt, query[0]);
+
+  // 10 items take 4 levels; keys for only 3 of them can't expand the query.
+  vector<uint32_t> galois_elts = generate_galois_elts(POLY_MODULUS_DEGREE, 10);
+  ASSERT_THAT(galois_elts, SizeIs(4));
+  galois_elts.pop_back();
+
+  Request request_proto;
+  SaveRequest({query}, keygen_->galois_keys_local(galois_elts), relin_keys_,
+              &request_proto);
+  request_proto.set_key_id("client");
+  auto result_or = server_->ProcessRequest(request_proto);
+  EXPECT_THAT(result_or.status().code(),
+              Eq(absl::StatusCode::kInvalidArgument));
+
+  // Rejected before the keys are deserialized when the key set says so.
+  for (const auto elt : galois_elts) {
+    request_proto.add_galois_elts(elt);
+  }
+  result_or = server_->ProcessRequest(request_proto);
+  EXPECT_THAT(result_or.status().code(),
+              Eq(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(server_->GetKeyCacheMetrics().insertions, Eq(0));
+}
+
+TEST_P(PIRServerTest, TestProcessRequestUnknownKeyId) {
+  ASSIGN_OR_FAIL(server_, PIRServer::Create(pir_db_, pir_params_, 1, 1 << 30));
+  Plaintext pt(POLY_MODULUS_DEGREE);
+  pt.set_zero();
 
-  uint64_t m_inv;
-  ASSERT_TRUE(seal::util::try_invert_uint_mod(
-      next_power_two(server_->Context()->DimensionsSum()),
-      server_->Context()->EncryptionParams().plain_modulus().value(), m_inv));
+  vector<Ciphertext> query(1);
+  encryptor_->encrypt(pt, query[0]);
 
+  Request request_proto;
+  SaveRequest({query}, &request_proto);
+  request_proto.set_key_id("unknown");
+  auto result_or = server_->ProcessRequest(request_proto);
+  ASSERT_THAT(result_or.status().code(), Eq(absl::StatusCode::kNotFound));
+  EXPECT_THAT(server_->GetKeyCacheMetrics().misses, Eq(1));
+}
+
+// Make sure that if we get a weird request from client nothing explodes.
+TEST_P(PIRServerTest, TestProcessRequestZeroInput) {
   Plaintext pt(POLY_MODULUS_DEGREE);
   pt.set_zero();
-  // select 4th row
-  pt[4] = m_inv;
-  // select 6th column (after 10-item selection vector for rows)
-  pt[16] = m_inv;
 
   vector<Ciphertext> query(1);
   encryptor_->encrypt(pt, query[0]);
@@ -228,35 +441,82 @@ TEST_P(PIRServerTest, TestProcessRequest_2Dim) {
   Request request_proto;
   SaveRequest({query}, gal_keys_, relin_keys_, &request_proto);
 
-  ASSIGN_OR_FAIL(auto response, server_->ProcessRequest(request_proto));
-  ASSERT_EQ(response.reply_size(), 1);
-  ASSIGN_OR_FAIL(auto reply, LoadCiphertexts(server_->Context()->SEALContext(),
-                                             response.reply(0)));
+  ASSIGN_OR_FAIL(auto result_raw, server_->ProcessRequest(request_proto));
+  ASSERT_EQ(result_raw.reply_size(), 1);
+  ASSIGN_OR_FAIL(auto result, LoadCiphertexts(server_->Context()->SEALContext(),
+                                              result_raw.reply(0)));
+
+  ASSERT_THAT(result, SizeIs(1));
 
   Plaintext result_pt;
-  if (GetParam()) {
-    // CT Multiplication
-    ASSERT_THAT(reply, SizeIs(1));
-    EXPECT_THAT(reply[0].size(), Eq(2))
-        << "Ciphertext larger than expected. Were relin keys used?";
-    decryptor_->decrypt(reply[0], result_pt);
+  decryptor_->decrypt(result[0], result_pt);
+  auto encoder = server_->Context()->Encoder();
+  ASSERT_THAT(encoder->decode_int64(result_pt), 0);
+}
+
+TEST_P(PIRServerTest, TestProcessRequest_2Dim) {
+  SetUpDB(82, 2);
+  TestProcessRequest2Dim();
+}
 
+TEST_P(PIRServerTest, TestProcessRequestStreaming_2Dim) {
+  SetUpDB(82, 2);
+  server_->set_streaming_expansion(true);
+  TestProcessRequest2Dim();
+}
+
+TEST_P(PIRServerTest, TestProcessRequestSEALBackend_2Dim) {
+  SetUpDB(82, 2);
+  ASSERT_OK(pir_db_->set_backend("seal"));
+  TestProcessRequest2Dim();
+}
+
+TEST_P(PIRServerTest, TestProcessRequestTraced_2Dim) {
+  SetUpDB(82, 2);
+  auto tracer = std::make_shared<MetricsTracer>();
+  server_->set_tracer(tracer);
+  TestProcessRequest2Dim();
+
+  for (const auto phase : {Phase::kKeys, Phase::kDeserialize,
+                           Phase::kExpansion, Phase::kMultiply,
+                           Phase::kSerialize}) {
+    EXPECT_THAT(tracer->phase_calls(phase), Eq(1)) << PhaseName(phase);
+  }
+  // One product per plaintext of the database, and per row of the top
+  // dimension either a ciphertext product or one per digit of the
+  // decomposition.
+  const auto dims = PIRDatabase::calculate_dimensions(82, 2);
+  if (GetParam()) {
+    EXPECT_THAT(tracer->count(Counter::kMultiplyPlain), Eq(82));
+    EXPECT_THAT(tracer->count(Counter::kMultiply), Eq(dims[0]));
+    EXPECT_THAT(tracer->phase_calls(Phase::kReencode), Eq(0));
   } else {
-    ASSIGN_OR_FAIL(auto ct_reencoder, CiphertextReencoder::Create(
-                                          server_->Context()->SEALContext()));
-    ASSERT_THAT(reply,
-                SizeIs(ct_reencoder->ExpansionRatio() * query[0].size()));
-    vector<Plaintext> reply_pts(reply.size());
-    for (size_t i = 0; i < reply_pts.size(); ++i) {
-      decryptor_->decrypt(reply[i], reply_pts[i]);
-    }
-    auto result_ct = ct_reencoder->Decode(reply_pts);
-    EXPECT_EQ(result_ct.size(), query[0].size());
-    decryptor_->decrypt(result_ct, result_pt);
+    EXPECT_THAT(tracer->count(Counter::kMultiplyPlain), Gt(82 + dims[0]));
+    EXPECT_THAT(tracer->count(Counter::kMultiply), Eq(0));
+    EXPECT_THAT(tracer->phase_calls(Phase::kReencode), Eq(dims[0]));
+    EXPECT_THAT(tracer->count(Counter::kNTT), Gt(0));
   }
+  EXPECT_THAT(tracer->count(Counter::kGalois), Gt(0));
+  EXPECT_THAT(tracer->count(Counter::kBytesIn), Gt(0));
+  EXPECT_THAT(tracer->count(Counter::kBytesOut), Gt(0));
+
+  tracer->Reset();
+  EXPECT_THAT(tracer->phase_calls(Phase::kMultiply), Eq(0));
+  EXPECT_THAT(tracer->phase_time(Phase::kMultiply).count(), Eq(0));
+  EXPECT_THAT(tracer->count(Counter::kBytesIn), Eq(0));
+}
 
-  auto encoder = server_->Context()->Encoder();
-  ASSERT_THAT(encoder->decode_int64(result_pt), Eq(int_db_[desired_index]));
+TEST_P(PIRServerTest, TestStreamingExpansionStopsOnVisitorError) {
+  Ciphertext ct;
+  encryptor_->encrypt_zero(ct);
+  size_t visits = 0;
+  auto status = server_->oblivious_expansion_streaming(
+      ct, 8, gal_keys_, [&](size_t, Ciphertext&) {
+        ++visits;
+        return absl::CancelledError("stop");
+      });
+  EXPECT_THAT(status.code(), Eq(absl::StatusCode::kCancelled));
+  EXPECT_THAT(visits, Eq(1));
 }
 
 INSTANTIATE_TEST_SUITE_P(PIRServerTests, PIRServerTest,
@@ -373,6 +633,56 @@ TEST_P(ObliviousExpansionTest, ObliviousExpansionExamples) {
   ASSERT_THAT(results_pt, ContainerEq(expected_pt));
 }
 
+TEST_P(ObliviousExpansionTest, StreamingExamples) {
+  Plaintext input_pt(get<0>(GetParam()));
+  Ciphertext ct;
+  encryptor_->encrypt(input_pt, ct);
+
+  auto expected = get<1>(GetParam());
+  vector<Plaintext> results_pt(expected.size());
+  vector<int> visits(expected.size(), 0);
+  ASSERT_OK(server_->oblivious_expansion_streaming(
+      ct, expected.size(),
+      keygen_->galois_keys_local(generate_galois_elts(POLY_MODULUS_DEGREE)),
+      [&](size_t i, Ciphertext& result) {
+        EXPECT_THAT(i, Lt(expected.size()));
+        ++visits[i];
+        decryptor_->decrypt(result, results_pt[i]);
+        return absl::OkStatus();
+      }));
+
+  vector<Plaintext> expected_pt(expected.size());
+  for (size_t i = 0; i < expected_pt.size(); ++i) {
+    expected_pt[i] = Plaintext(expected[i]);
+  }
+  EXPECT_THAT(visits, Each(Eq(1)));
+  ASSERT_THAT(results_pt, ContainerEq(expected_pt));
+}
+
+TEST_P(ObliviousExpansionTest, StreamingVisitorTakesResults) {
+  Plaintext input_pt(get<0>(GetParam()));
+  Ciphertext ct;
+  encryptor_->encrypt(input_pt, ct);
+
+  // Taking every leaf moves the per-level buffers out from under the
+  // expansion, which must give the next subtrees fresh ones.
+  auto expected = get<1>(GetParam());
+  vector<Ciphertext> results(expected.size());
+  ASSERT_OK(server_->oblivious_expansion_streaming(
+      ct, expected.size(),
+      keygen_->galois_keys_local(generate_galois_elts(POLY_MODULUS_DEGREE)),
+      [&](size_t i, Ciphertext& result) {
+        results[i] = std::move(result);
+        return absl::OkStatus();
+      }));
+
+  for (size_t i = 0; i < expected.size(); ++i) {
+    Plaintext result_pt;
+    decryptor_->decrypt(results[i], result_pt);
+    EXPECT_THAT(result_pt, Eq(Plaintext(expected[i]))) << "i = " << i;
+  }
+}
+
 INSTANTIATE_TEST_SUITE_P(
     ObliviousExpansion, ObliviousExpansionTest,
     testing::Values(make_tuple("1", vector<string>({"2", "0"})),
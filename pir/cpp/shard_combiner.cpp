@@ -0,0 +1,77 @@
+//
+// Copyright 2020 the authors listed in CONTRIBUTORS.md
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#include "pir/cpp/shard_combiner.h"
+
+#include <algorithm>
+#include <string>
+
+#include "absl/memory/memory.h"
+#include "pir/cpp/serialization.h"
+#include "pir/cpp/status_asserts.h"
+#include "pir/cpp/utils.h"
+
+namespace pir {
+
+using absl::InvalidArgumentError;
+using std::size_t;
+
+StatusOr<std::unique_ptr<ShardCombiner>> ShardCombiner::Create(
+    std::shared_ptr<PIRParameters> params) {
+  ASSIGN_OR_RETURN(auto context, PIRContext::Create(params));
+  return absl::WrapUnique(new ShardCombiner(std::move(context)));
+}
+
+StatusOr<Response> ShardCombiner::Combine(
+    absl::Span<const Response> responses) const {
+  const size_t num_shards =
+      std::max<size_t>(context_->Params()->num_shards(), 1);
+  if (responses.size() != num_shards) {
+    return InvalidArgumentError(
+        std::to_string(responses.size()) + " responses for " +
+        std::to_string(num_shards) + " shards");
+  }
+  for (const auto& response : responses) {
+    if (response.reply_size() != responses[0].reply_size()) {
+      return InvalidArgumentError("Shard responses have different replies");
+    }
+  }
+
+  Response result;
+  auto& evaluator = *context_->Evaluator();
+  for (int r = 0; r < responses[0].reply_size(); ++r) {
+    ASSIGN_OR_RETURN(auto sum, LoadCiphertexts(context_->SEALContext(),
+                                               responses[0].reply(r)));
+    for (size_t s = 1; s < responses.size(); ++s) {
+      ASSIGN_OR_RETURN(auto cts, LoadCiphertexts(context_->SEALContext(),
+                                                 responses[s].reply(r)));
+      if (cts.size() != sum.size()) {
+        return InvalidArgumentError(
+            "Shard replies have different numbers of ciphertexts");
+      }
+      try {
+        for (size_t i = 0; i < sum.size(); ++i) {
+          evaluator.add_inplace(sum[i], cts[i]);
+        }
+      } catch (const std::exception& e) {
+        return InvalidArgumentError(e.what());
+      }
+    }
+    RETURN_IF_ERROR(SaveCiphertexts(sum, result.add_reply()));
+  }
+  return result;
+}
+
+}  // namespace pir
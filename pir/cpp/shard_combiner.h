@@ -0,0 +1,67 @@
+//
+// Copyright 2020 the authors listed in CONTRIBUTORS.md
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef PIR_SHARD_COMBINER_H_
+#define PIR_SHARD_COMBINER_H_
+
+#include <memory>
+
+#include "absl/status/statusor.h"
+#include "absl/types/span.h"
+#include "pir/cpp/context.h"
+#include "pir/proto/payload.pb.h"
+
+namespace pir {
+
+using absl::StatusOr;
+
+/**
+ * Adds up the partial responses of the shards of a sharded database into the
+ * response a single server would have sent. Runs at a coordinator in front
+ * of the shard servers, or on the client when the shards reply to it
+ * directly. Needs no keys: the partial replies are only added.
+ */
+class ShardCombiner {
+ public:
+  /**
+   * Creates a combiner for a sharded database.
+   * @param[in] params Parameters of the whole database.
+   * @returns InvalidArgument if the SEAL parameter deserialization fails
+   **/
+  static StatusOr<std::unique_ptr<ShardCombiner>> Create(
+      std::shared_ptr<PIRParameters> params);
+
+  /**
+   * Adds up the responses of every shard to the same request.
+   * @param[in] responses Response of each shard, in any order.
+   * @returns The combined response, or InvalidArgument if there isn't one
+   *    response per shard, the responses don't have the same shape or the
+   *    ciphertexts can't be deserialized
+   **/
+  StatusOr<Response> Combine(absl::Span<const Response> responses) const;
+
+  ShardCombiner() = delete;
+
+ private:
+  explicit ShardCombiner(std::unique_ptr<PIRContext> context)
+      : context_(std::move(context)) {}
+
+  std::unique_ptr<PIRContext> context_;
+};
+
+}  // namespace pir
+
+#endif  // PIR_SHARD_COMBINER_H_
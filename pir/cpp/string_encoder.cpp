@@ -16,68 +16,136 @@
 
 #include "pir/cpp/string_encoder.h"
 
+#include <cstring>
+
 #include "pir/cpp/status_asserts.h"
 
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define PIR_STRING_ENCODER_AVX2 1
+#include <immintrin.h>
+#endif
+
 namespace pir {
 
 using absl::InvalidArgumentError;
 
-size_t StringEncoder::num_items_per_plaintext(size_t item_size) {
-  return poly_modulus_degree_ * bits_per_coeff_ / item_size / 8;
+namespace {
+
+using uint128_t = unsigned __int128;
+
+// Zero bytes after the packed bytes, so that every load of a coefficient's
+// bytes, scalar or vector, stays within the buffer.
+constexpr size_t kPadding = 32;
+
+inline uint64_t load_be64(const uint8_t* p) {
+  uint64_t value;
+  std::memcpy(&value, p, sizeof(value));
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  value = __builtin_bswap64(value);
+#endif
+  return value;
 }
 
-size_t StringEncoder::max_bytes_per_plaintext() {
-  return poly_modulus_degree_ * bits_per_coeff_ / 8;
+inline void store_be64(uint64_t value, uint8_t* p) {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  value = __builtin_bswap64(value);
+#endif
+  std::memcpy(p, &value, sizeof(value));
 }
 
-/**
- * Helper class for encoding strings to PT coefficients and keeping track of
- * where we are.
- */
-class StringEncoderImpl {
- public:
-  StringEncoderImpl(Plaintext& destination, size_t bits_per_coeff)
-      : destination_(destination),
-        bits_per_coeff_(bits_per_coeff),
-        coeff_bits_(bits_per_coeff) {}
-
-  StringEncoderImpl() = delete;
-
-  void encode(const string& value);
-  void terminate();
-
- private:
-  Plaintext& destination_;
-  size_t bits_per_coeff_;
-
-  // temporary variables for encoding
-  size_t coeff_index_ = 0;
-  size_t coeff_bits_;
-};
-
-void StringEncoderImpl::encode(const string& value) {
-  for (uint8_t c : value) {
-    size_t remain_bits = 8;
-    while (remain_bits > 0) {
-      size_t n = std::min(coeff_bits_, remain_bits);
-      destination_[coeff_index_] <<= n;
-      destination_[coeff_index_] |= (c >> (8 - n));
-      c <<= n;
-      coeff_bits_ -= n;
-      remain_bits -= n;
-      if (coeff_bits_ <= 0) {
-        ++coeff_index_;
-        coeff_bits_ = bits_per_coeff_;
-      }
+// The strings form one bit stream, most significant bit of each byte first,
+// and every coefficient holds the next bits_per_coeff bits of it, first bit
+// highest. Coefficient k is read from a 72 bit window starting at the byte
+// holding its first bit, which covers it for any width up to 64 bits.
+void unpack_portable(const uint8_t* bytes, size_t begin, size_t end,
+                     size_t bits_per_coeff, uint64_t* coeffs) {
+  const uint64_t mask = bits_per_coeff == 64
+                            ? ~uint64_t(0)
+                            : (uint64_t(1) << bits_per_coeff) - 1;
+  for (size_t k = begin; k < end; ++k) {
+    const size_t bit = k * bits_per_coeff;
+    const uint8_t* p = bytes + bit / 8;
+    const uint128_t window = (uint128_t(load_be64(p)) << 8) | p[8];
+    coeffs[k] =
+        static_cast<uint64_t>(window >> (72 - bit % 8 - bits_per_coeff)) &
+        mask;
+  }
+}
+
+#ifdef PIR_STRING_ENCODER_AVX2
+
+// Even widths of up to 32 bits pack four coefficients in a whole number of
+// bytes, at most 16, so each group of four is one load and one byte shuffle
+// into 64 bit lanes, then a variable shift and a mask.
+bool fits_avx2(size_t bits_per_coeff) {
+  static const bool has_avx2 = __builtin_cpu_supports("avx2");
+  return bits_per_coeff % 2 == 0 && bits_per_coeff <= 32 && has_avx2;
+}
+
+__attribute__((target("avx2"))) size_t unpack_avx2(const uint8_t* bytes,
+                                                   size_t num_coeff,
+                                                   size_t bits_per_coeff,
+                                                   uint64_t* coeffs) {
+  alignas(32) uint8_t shuffle[32];
+  alignas(32) uint64_t shifts[4];
+  for (size_t c = 0; c < 4; ++c) {
+    const size_t bit = c * bits_per_coeff;
+    const size_t first = bit / 8;
+    const size_t last = (bit + bits_per_coeff - 1) / 8;
+    const size_t n = last - first + 1;
+    // Lane c / 2 holds the same 16 bytes as the other, so indices are from
+    // the start of the group. The bytes go in big endian, so the first one
+    // ends up highest.
+    for (size_t j = 0; j < 8; ++j) {
+      shuffle[c * 8 + j] = j < n ? first + n - 1 - j : 0x80;
     }
+    shifts[c] = n * 8 - bit % 8 - bits_per_coeff;
   }
+  const __m256i shuffle_v =
+      _mm256_load_si256(reinterpret_cast<const __m256i*>(shuffle));
+  const __m256i shifts_v =
+      _mm256_load_si256(reinterpret_cast<const __m256i*>(shifts));
+  const __m256i mask_v =
+      _mm256_set1_epi64x((uint64_t(1) << bits_per_coeff) - 1);
+  const size_t group_bytes = bits_per_coeff / 2;
+
+  size_t k = 0;
+  for (const uint8_t* p = bytes; k + 4 <= num_coeff; k += 4, p += group_bytes) {
+    const __m256i group = _mm256_broadcastsi128_si256(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+    const __m256i values = _mm256_and_si256(
+        _mm256_srlv_epi64(_mm256_shuffle_epi8(group, shuffle_v), shifts_v),
+        mask_v);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(coeffs + k), values);
+  }
+  return k;
 }
 
-void StringEncoderImpl::terminate() {
-  if (coeff_bits_ < bits_per_coeff_ && coeff_bits_ > 0) {
-    destination_[coeff_index_] <<= coeff_bits_;
+#endif  // PIR_STRING_ENCODER_AVX2
+
+// Writes num_coeff coefficients packed from the bytes, which must be followed
+// by kPadding zero bytes.
+void unpack(const uint8_t* bytes, size_t num_coeff, size_t bits_per_coeff,
+            uint64_t* coeffs) {
+  size_t done = 0;
+#ifdef PIR_STRING_ENCODER_AVX2
+  if (fits_avx2(bits_per_coeff)) {
+    done = unpack_avx2(bytes, num_coeff, bits_per_coeff, coeffs);
   }
+#endif
+  unpack_portable(bytes, done, num_coeff, bits_per_coeff, coeffs);
 }
+
+}  // namespace
+
+size_t StringEncoder::num_items_per_plaintext(size_t item_size) {
+  return poly_modulus_degree_ * bits_per_coeff_ / item_size / 8;
+}
+
+size_t StringEncoder::max_bytes_per_plaintext() {
+  return poly_modulus_degree_ * bits_per_coeff_ / 8;
+}
+
 StringEncoder::StringEncoder(shared_ptr<seal::SEALContext> context)
     : context_(context) {
   const auto params = context_->first_context_data()->parms();
@@ -94,15 +162,11 @@ StatusOr<size_t> StringEncoder::calc_num_coeff(size_t num_bytes) const {
   return num_coeff;
 }
 
-Status StringEncoder::encode(const string& value,
+Status StringEncoder::encode(absl::string_view value,
                              Plaintext& destination) const {
-  ASSIGN_OR_RETURN(const auto num_coeff, calc_num_coeff(value.size()));
-  destination.resize(num_coeff);
-  destination.set_zero();
-  StringEncoderImpl impl(destination, bits_per_coeff_);
-  impl.encode(value);
-  impl.terminate();
-  return absl::OkStatus();
+  std::vector<uint8_t> bytes(value.size() + kPadding, 0);
+  std::memcpy(bytes.data(), value.data(), value.size());
+  return encode_bytes(bytes, value.size(), destination);
 }
 
 Status StringEncoder::encode(vector<string>::const_iterator v,
@@ -110,14 +174,20 @@ Status StringEncoder::encode(vector<string>::const_iterator v,
                              Plaintext& destination) const {
   size_t total_size = std::accumulate(
       v, end, 0, [](int a, const string& b) { return a + b.size(); });
-  ASSIGN_OR_RETURN(auto num_coeff, calc_num_coeff(total_size));
-  destination.resize(num_coeff);
-  destination.set_zero();
-  StringEncoderImpl impl(destination, bits_per_coeff_);
-  while (v != end) {
-    impl.encode(*(v++));
+  // The values are copied into one buffer, which is cheaper than following
+  // the bit stream across strings.
+  std::vector<uint8_t> bytes(total_size + kPadding, 0);
+  for (auto* p = bytes.data(); v != end; p += (v++)->size()) {
+    std::memcpy(p, v->data(), v->size());
   }
-  impl.terminate();
+  return encode_bytes(bytes, total_size, destination);
+}
+
+Status StringEncoder::encode_bytes(const std::vector<uint8_t>& bytes,
+                                   size_t size, Plaintext& destination) const {
+  ASSIGN_OR_RETURN(auto num_coeff, calc_num_coeff(size));
+  destination.resize(num_coeff);
+  unpack(bytes.data(), num_coeff, bits_per_coeff_, destination.data());
   return absl::OkStatus();
 }
 
@@ -127,34 +197,45 @@ StatusOr<string> StringEncoder::decode(const Plaintext& pt, size_t length,
     return InvalidArgumentError(
         "Requested decode beyond end of data in polynomial");
   }
-  size_t start_coeff_index = byte_offset * 8 / bits_per_coeff_;
-  size_t coeff_bits =
-      ((start_coeff_index + 1) * bits_per_coeff_) - (byte_offset * 8);
-  if (coeff_bits <= 0) {
-    coeff_bits = bits_per_coeff_;
-  }
   if (length <= 0) {
     length = pt.significant_coeff_count() * bits_per_coeff_ / 8;
   }
-  string result(length, 0);
-  size_t result_index = 0;
-  size_t remain_bits = 8;
-  for (size_t i = start_coeff_index; i < pt.coeff_count(); ++i) {
-    while (coeff_bits > 0) {
-      size_t n = std::min(coeff_bits, remain_bits);
-      result[result_index] <<= n;
-      result[result_index] |= (pt[i] >> (coeff_bits - n));
-
-      coeff_bits -= n;
-      remain_bits -= n;
-      if (remain_bits <= 0) {
-        if (++result_index >= length) return result;
-        remain_bits = 8;
-      }
+
+  // Bits of the coefficients are appended to an accumulator and written out
+  // 64 at a time. The bits of the first coefficient before the offset are
+  // dropped.
+  const uint64_t mask = bits_per_coeff_ == 64
+                            ? ~uint64_t(0)
+                            : (uint64_t(1) << bits_per_coeff_) - 1;
+  const size_t first_coeff = byte_offset * 8 / bits_per_coeff_;
+  size_t skip = byte_offset * 8 - first_coeff * bits_per_coeff_;
+  std::vector<uint8_t> bytes(length + sizeof(uint64_t), 0);
+  uint8_t* out = bytes.data();
+  uint8_t* const out_end = bytes.data() + length;
+  uint128_t acc = 0;
+  size_t acc_bits = 0;
+  for (size_t i = first_coeff; i < pt.coeff_count() && out < out_end; ++i) {
+    const size_t bits = bits_per_coeff_ - skip;
+    const uint64_t value = (pt[i] & mask) & (~uint64_t(0) >> (64 - bits));
+    acc = (acc << bits) | value;
+    acc_bits += bits;
+    skip = 0;
+    if (acc_bits >= 64) {
+      acc_bits -= 64;
+      store_be64(static_cast<uint64_t>(acc >> acc_bits), out);
+      out += sizeof(uint64_t);
     }
-    coeff_bits = bits_per_coeff_;
   }
-  return result;
+  // When the coefficients run out first, the whole bytes left are written
+  // and the bits of a last partial byte are kept in its low bits.
+  for (; acc_bits >= 8 && out < out_end; out++) {
+    acc_bits -= 8;
+    *out = static_cast<uint8_t>(acc >> acc_bits);
+  }
+  if (acc_bits > 0 && out < out_end) {
+    *out = static_cast<uint8_t>(acc) & ((1 << acc_bits) - 1);
+  }
+  return string(bytes.begin(), bytes.begin() + length);
 }
 
 }  // namespace pir
@@ -18,8 +18,10 @@
 #define PIR_STRING_ENCODER_H_
 
 #include <string>
+#include <vector>
 
 #include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
 #include "seal/seal.h"
 
 namespace pir {
@@ -50,12 +52,13 @@ class StringEncoder {
 
   /**
    * Encode a string of binary value into the destination using a
-   * minimal amount of coefficients.
+   * minimal amount of coefficients. Several values can be encoded together by
+   * passing a view of them one after the other.
    * @param[in] value String to encode
    * @param[out] destination Plaintext to populate with encoded value
    * @returns Invalid argument if string is too big for plaintext polynomial
    */
-  Status encode(const string& value, Plaintext& destination) const;
+  Status encode(absl::string_view value, Plaintext& destination) const;
 
   /**
    * Encodes several strings into a plaintext using the
@@ -104,6 +107,11 @@ class StringEncoder {
   // bytes of input in the current context, or InvalidArgumentError if the input
   // is too long.
   StatusOr<size_t> calc_num_coeff(size_t num_bytes) const;
+
+  // Encodes the first size bytes, which must be followed by at least 32 zero
+  // bytes so that coefficients can be read a word at a time.
+  Status encode_bytes(const std::vector<uint8_t>& bytes, size_t size,
+                      Plaintext& destination) const;
 };
 
 }  // namespace pir
@@ -18,6 +18,7 @@
 
 #include <iostream>
 #include <memory>
+#include <random>
 
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
@@ -181,6 +182,115 @@ TEST_F(StringEncoderTest, TestEncOp) {
   EXPECT_THAT(result.substr(v.size()), Each(0));
 }
 
+// The encoder before it packed a word at a time, a bit at a time, for output
+// the fast paths must match byte for byte.
+void ReferenceEncode(const vector<string>& values, size_t bits_per_coeff,
+                     size_t num_coeff, Plaintext& destination) {
+  destination.resize(num_coeff);
+  destination.set_zero();
+  size_t coeff_index = 0;
+  size_t coeff_bits = bits_per_coeff;
+  for (const auto& value : values) {
+    for (uint8_t c : value) {
+      for (size_t byte_bits = 8; byte_bits > 0;) {
+        const size_t n = std::min(coeff_bits, byte_bits);
+        destination[coeff_index] <<= n;
+        destination[coeff_index] |= (c >> (8 - n));
+        c <<= n;
+        coeff_bits -= n;
+        byte_bits -= n;
+        if (coeff_bits == 0) {
+          ++coeff_index;
+          coeff_bits = bits_per_coeff;
+        }
+      }
+    }
+  }
+  if (coeff_bits < bits_per_coeff) {
+    destination[coeff_index] <<= coeff_bits;
+  }
+}
+
+string ReferenceDecode(const Plaintext& pt, size_t bits_per_coeff,
+                       size_t length, size_t byte_offset) {
+  const size_t first_coeff = byte_offset * 8 / bits_per_coeff;
+  size_t coeff_bits = (first_coeff + 1) * bits_per_coeff - byte_offset * 8;
+  if (length == 0) {
+    length = pt.significant_coeff_count() * bits_per_coeff / 8;
+  }
+  vector<uint8_t> result(length, 0);
+  size_t result_index = 0;
+  size_t result_bits = 8;
+  for (size_t i = first_coeff; i < pt.coeff_count(); ++i) {
+    while (coeff_bits > 0) {
+      const size_t n = std::min(coeff_bits, result_bits);
+      result[result_index] <<= n;
+      result[result_index] |= (pt[i] >> (coeff_bits - n));
+      coeff_bits -= n;
+      result_bits -= n;
+      if (result_bits == 0) {
+        if (++result_index >= length) {
+          return string(result.begin(), result.end());
+        }
+        result_bits = 8;
+      }
+    }
+    coeff_bits = bits_per_coeff;
+  }
+  return string(result.begin(), result.end());
+}
+
+class StringEncoderReferenceTest : public StringEncoderTest,
+                                   public WithParamInterface<size_t> {};
+
+TEST_P(StringEncoderReferenceTest, TestMatchesReference) {
+  const size_t bits_per_coeff = GetParam();
+  encoder_->set_bits_per_coeff(bits_per_coeff);
+  std::mt19937_64 prng(bits_per_coeff);
+  for (int trial = 0; trial < 20; ++trial) {
+    // Strings of different lengths, including empty ones, so values start
+    // at every bit position of a coefficient.
+    vector<string> values(prng() % 5 + 1);
+    size_t total_size = 0;
+    for (auto& value : values) {
+      value.resize(prng() % 100);
+      for (auto& c : value) {
+        c = prng();
+      }
+      total_size += value.size();
+    }
+    const size_t num_coeff =
+        (total_size * 8 + bits_per_coeff - 1) / bits_per_coeff;
+    Plaintext expected;
+    ReferenceEncode(values, bits_per_coeff, num_coeff, expected);
+
+    Plaintext pt;
+    ASSERT_OK(encoder_->encode(values.begin(), values.end(), pt));
+    ASSERT_EQ(pt, expected) << "trial = " << trial;
+    if (values.size() == 1) {
+      Plaintext single;
+      ASSERT_OK(encoder_->encode(values[0], single));
+      ASSERT_EQ(single, expected) << "trial = " << trial;
+    }
+
+    ASSIGN_OR_FAIL(auto all, encoder_->decode(pt));
+    EXPECT_EQ(all, ReferenceDecode(pt, bits_per_coeff, 0, 0))
+        << "trial = " << trial;
+    for (int i = 0; i < 20 && total_size > 0; ++i) {
+      const size_t offset = prng() % total_size;
+      const size_t length = prng() % (total_size - offset) + 1;
+      ASSIGN_OR_FAIL(auto result, encoder_->decode(pt, length, offset));
+      EXPECT_EQ(result, ReferenceDecode(pt, bits_per_coeff, length, offset))
+          << "trial = " << trial << ", offset = " << offset
+          << ", length = " << length;
+    }
+  }
+}
+
+// Every width below the plain modulus, including those with vector paths.
+INSTANTIATE_TEST_SUITE_P(StringEncoderReference, StringEncoderReferenceTest,
+                         Range(size_t(1), size_t(60)));
+
 class StringEncoderMaxBytesPerPlaintextTest
     : public testing::TestWithParam<tuple<uint32_t, uint32_t, uint32_t>> {
  protected:
@@ -0,0 +1,92 @@
+//
+// Copyright 2020 the authors listed in CONTRIBUTORS.md
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef PIR_THREAD_POOL_H_
+#define PIR_THREAD_POOL_H_
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace pir {
+
+/**
+ * Fixed size pool of worker threads. Every task is told the index of the
+ * worker running it, so callers can keep per-worker state (evaluators, memory
+ * pools, scratch buffers) that never needs locking.
+ */
+class ThreadPool {
+ public:
+  /**
+   * Starts a pool with the given number of worker threads.
+   * @param[in] num_threads Number of workers. May be zero, in which case all
+   *    work submitted through ParallelFor runs on the calling thread.
+   */
+  explicit ThreadPool(std::size_t num_threads);
+
+  /**
+   * Waits for all queued tasks to finish and joins the workers.
+   */
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  /**
+   * Number of worker threads in the pool.
+   */
+  std::size_t size() const { return workers_.size(); }
+
+  /**
+   * Queues a task to run on one of the workers. The task receives the index
+   * of the worker running it, in the range [0, size()).
+   */
+  void Schedule(std::function<void(std::size_t)> task);
+
+  /**
+   * Calls fn(i, worker) for every i in [0, n) and blocks until all of the
+   * calls have returned. The calling thread takes part in the work, so it is
+   * safe to call ParallelFor from inside a task running on the same pool.
+   * The worker index passed to fn is in [0, size()], where size() denotes the
+   * calling thread when it isn't one of this pool's workers. If any call
+   * throws, the first exception is rethrown once all calls have finished.
+   */
+  void ParallelFor(std::size_t n,
+                   const std::function<void(std::size_t, std::size_t)>& fn);
+
+  /**
+   * Index of the current thread within this pool, or size() if the current
+   * thread isn't one of its workers.
+   */
+  std::size_t CurrentWorker() const;
+
+ private:
+  void WorkerLoop(std::size_t worker);
+
+  std::vector<std::thread> workers_;
+  std::deque<std::function<void(std::size_t)>> tasks_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  bool stopping_ = false;
+};
+
+}  // namespace pir
+
+#endif  // PIR_THREAD_POOL_H_
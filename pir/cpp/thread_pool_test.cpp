@@ -0,0 +1,92 @@
+//
+// Copyright 2020 the authors listed in CONTRIBUTORS.md
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "pir/cpp/thread_pool.h"
+
+#include <atomic>
+#include <stdexcept>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace pir {
+namespace {
+
+using std::vector;
+using namespace ::testing;
+
+class ThreadPoolTest : public ::testing::TestWithParam<size_t> {};
+
+TEST_P(ThreadPoolTest, ParallelForVisitsEveryIndexOnce) {
+  ThreadPool pool(GetParam());
+  vector<std::atomic<int>> visits(1000);
+  pool.ParallelFor(visits.size(), [&visits, &pool](size_t i, size_t worker) {
+    EXPECT_LE(worker, pool.size());
+    ++visits[i];
+  });
+  for (size_t i = 0; i < visits.size(); ++i) {
+    EXPECT_EQ(visits[i], 1) << "i = " << i;
+  }
+}
+
+TEST_P(ThreadPoolTest, NestedParallelFor) {
+  ThreadPool pool(GetParam());
+  std::atomic<int> count(0);
+  pool.ParallelFor(8, [&count, &pool](size_t, size_t) {
+    pool.ParallelFor(8, [&count](size_t, size_t) { ++count; });
+  });
+  EXPECT_EQ(count, 64);
+}
+
+TEST_P(ThreadPoolTest, ParallelForRethrows) {
+  ThreadPool pool(GetParam());
+  std::atomic<int> count(0);
+  EXPECT_THROW(pool.ParallelFor(100,
+                                [&count](size_t i, size_t) {
+                                  ++count;
+                                  if (i == 42) throw std::runtime_error("42");
+                                }),
+               std::runtime_error);
+  EXPECT_EQ(count, 100);
+}
+
+TEST_P(ThreadPoolTest, Schedule) {
+  std::atomic<int> count(0);
+  {
+    ThreadPool pool(GetParam());
+    if (pool.size() == 0) return;
+    for (int i = 0; i < 100; ++i) {
+      pool.Schedule([&count, &pool](size_t worker) {
+        EXPECT_LT(worker, pool.size());
+        EXPECT_EQ(pool.CurrentWorker(), worker);
+        ++count;
+      });
+    }
+  }
+  EXPECT_EQ(count, 100);
+}
+
+TEST(ThreadPoolCurrentWorkerTest, OutsideOfPool) {
+  ThreadPool pool(2);
+  EXPECT_EQ(pool.CurrentWorker(), pool.size());
+}
+
+INSTANTIATE_TEST_SUITE_P(ThreadPoolTests, ThreadPoolTest,
+                         testing::Values(0, 1, 4));
+
+}  // namespace
+}  // namespace pir
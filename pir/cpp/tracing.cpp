@@ -0,0 +1,101 @@
+//
+// Copyright 2020 the authors listed in CONTRIBUTORS.md
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#include "pir/cpp/tracing.h"
+
+namespace pir {
+
+const char* PhaseName(const Phase phase) {
+  switch (phase) {
+    case Phase::kKeys:
+      return "keys";
+    case Phase::kDeserialize:
+      return "deserialize";
+    case Phase::kExpansion:
+      return "expansion";
+    case Phase::kMultiply:
+      return "multiply";
+    case Phase::kReencode:
+      return "reencode";
+    case Phase::kSerialize:
+      return "serialize";
+  }
+  return "unknown";
+}
+
+const char* CounterName(const Counter counter) {
+  switch (counter) {
+    case Counter::kMultiplyPlain:
+      return "multiply_plain";
+    case Counter::kMultiply:
+      return "multiply";
+    case Counter::kNTT:
+      return "ntt";
+    case Counter::kGalois:
+      return "galois";
+    case Counter::kBytesIn:
+      return "bytes_in";
+    case Counter::kBytesOut:
+      return "bytes_out";
+    case Counter::kAllocatedBytes:
+      return "allocated_bytes";
+  }
+  return "unknown";
+}
+
+void MetricsTracer::RecordPhase(const Phase phase,
+                                const Clock::duration elapsed) {
+  const auto p = static_cast<std::size_t>(phase);
+  phase_ticks_[p].fetch_add(elapsed.count(), std::memory_order_relaxed);
+  phase_calls_[p].fetch_add(1, std::memory_order_relaxed);
+}
+
+void MetricsTracer::Count(const Counter counter, const uint64_t n) {
+  counts_[static_cast<std::size_t>(counter)].fetch_add(
+      n, std::memory_order_relaxed);
+}
+
+Tracer::Clock::duration MetricsTracer::phase_time(const Phase phase) const {
+  return Clock::duration(phase_ticks_[static_cast<std::size_t>(phase)].load(
+      std::memory_order_relaxed));
+}
+
+uint64_t MetricsTracer::phase_calls(const Phase phase) const {
+  return phase_calls_[static_cast<std::size_t>(phase)].load(
+      std::memory_order_relaxed);
+}
+
+uint64_t MetricsTracer::count(const Counter counter) const {
+  return counts_[static_cast<std::size_t>(counter)].load(
+      std::memory_order_relaxed);
+}
+
+void MetricsTracer::Reset() {
+  for (auto& t : phase_ticks_) t.store(0, std::memory_order_relaxed);
+  for (auto& c : phase_calls_) c.store(0, std::memory_order_relaxed);
+  for (auto& c : counts_) c.store(0, std::memory_order_relaxed);
+}
+
+void NoiseBudgetTracer::ObserveCiphertext(const std::size_t depth,
+                                          const std::string& step,
+                                          const std::size_t row,
+                                          const seal::Ciphertext& ct) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const int budget = decryptor_->invariant_noise_budget(ct);
+  out_ << std::string(depth, ' ') << "i = " << row << " " << step
+       << " noise budget " << budget << std::endl;
+}
+
+}  // namespace pir
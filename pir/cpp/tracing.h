@@ -0,0 +1,226 @@
+//
+// Copyright 2020 the authors listed in CONTRIBUTORS.md
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef PIR_TRACING_H_
+#define PIR_TRACING_H_
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <string>
+
+#include "seal/seal.h"
+
+namespace pir {
+
+/**
+ * Phases of the work on a request. Phases may nest: reencoding happens
+ * within the multiplication with the database.
+ */
+enum class Phase {
+  // Deserializing client keys or fetching them from the key cache.
+  kKeys,
+  // Deserializing query ciphertexts.
+  kDeserialize,
+  // Oblivious expansion of queries into selection vectors.
+  kExpansion,
+  // Multiplication of selection vectors with the database.
+  kMultiply,
+  // Decomposition of ciphertexts into plaintexts between dimensions.
+  kReencode,
+  // Serializing reply ciphertexts.
+  kSerialize,
+};
+
+constexpr std::size_t kNumPhases = 6;
+
+/**
+ * Events counted while processing requests.
+ */
+enum class Counter {
+  // Products of a ciphertext with a plaintext, including those done by the
+  // dot product kernel.
+  kMultiplyPlain,
+  // Products of two ciphertexts.
+  kMultiply,
+  // Forward and inverse NTT transforms of ciphertexts and plaintexts.
+  kNTT,
+  // Galois automorphisms applied during expansion.
+  kGalois,
+  // Serialized bytes of the keys and query ciphertexts read.
+  kBytesIn,
+  // Serialized bytes of the reply ciphertexts written.
+  kBytesOut,
+  // Bytes newly allocated by the memory pools of the workers processing the
+  // queries. The default worker uses the global pool, which other threads
+  // may allocate from at the same time.
+  kAllocatedBytes,
+};
+
+constexpr std::size_t kNumCounters = 7;
+
+/**
+ * Name of a phase or counter, such as "expansion" or "multiply_plain".
+ */
+const char* PhaseName(Phase phase);
+const char* CounterName(Counter counter);
+
+/**
+ * Receives the timings and counts of the work done by the server. Methods
+ * may be called from any of the threads processing requests at the same
+ * time, so implementations must be thread safe. Components take a Tracer
+ * pointer that is nullptr by default, in which case nothing is measured.
+ */
+class Tracer {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  virtual ~Tracer() = default;
+
+  /**
+   * Called once each time a phase ends, with the wall time it took.
+   */
+  virtual void RecordPhase(Phase phase, Clock::duration elapsed) = 0;
+
+  /**
+   * Adds n to a counter.
+   */
+  virtual void Count(Counter counter, uint64_t n) = 0;
+
+  /**
+   * Returns true if ObserveCiphertext should be called. Observing makes the
+   * database multiply with a single thread and without the dot product
+   * kernel, so that every intermediate ciphertext exists, and is meant for
+   * debugging only.
+   */
+  virtual bool ObservesCiphertexts() const { return false; }
+
+  /**
+   * Called with the ciphertext resulting from each homomorphic operation of
+   * the multiplication with the database.
+   * @param[in] depth Dimension of the database the operation belongs to.
+   * @param[in] step Name of the operation, such as "mult" or "relin".
+   * @param[in] row Row of the dimension being multiplied.
+   * @param[in] ct Result of the operation.
+   */
+  virtual void ObserveCiphertext(std::size_t depth, const std::string& step,
+                                 std::size_t row, const seal::Ciphertext& ct) {}
+};
+
+/**
+ * Adds n to a counter of tracer, if not nullptr.
+ */
+inline void TraceCount(Tracer* const tracer, const Counter counter,
+                       const uint64_t n = 1) {
+  if (tracer != nullptr) tracer->Count(counter, n);
+}
+
+/**
+ * Records the wall time from its construction to its destruction as a phase
+ * of tracer. Does nothing, not even read the clock, if tracer is nullptr.
+ */
+class ScopedPhase {
+ public:
+  ScopedPhase(Tracer* const tracer, const Phase phase)
+      : tracer_(tracer), phase_(phase) {
+    if (tracer_ != nullptr) start_ = Tracer::Clock::now();
+  }
+
+  ~ScopedPhase() {
+    if (tracer_ != nullptr) {
+      tracer_->RecordPhase(phase_, Tracer::Clock::now() - start_);
+    }
+  }
+
+  ScopedPhase(const ScopedPhase&) = delete;
+  ScopedPhase& operator=(const ScopedPhase&) = delete;
+
+ private:
+  Tracer* const tracer_;
+  const Phase phase_;
+  Tracer::Clock::time_point start_;
+};
+
+/**
+ * Tracer summing the time and number of calls of each phase and the value
+ * of each counter over every request, with atomic counters so that threads
+ * never wait on each other.
+ */
+class MetricsTracer : public Tracer {
+ public:
+  void RecordPhase(Phase phase, Clock::duration elapsed) override;
+  void Count(Counter counter, uint64_t n) override;
+
+  /**
+   * Total wall time spent in a phase. Phases run by several threads at once
+   * count once per thread.
+   */
+  Clock::duration phase_time(Phase phase) const;
+
+  /**
+   * Number of times a phase ended.
+   */
+  uint64_t phase_calls(Phase phase) const;
+
+  uint64_t count(Counter counter) const;
+
+  /**
+   * Sets every time and count back to zero.
+   */
+  void Reset();
+
+ private:
+  std::array<std::atomic<Clock::rep>, kNumPhases> phase_ticks_{};
+  std::array<std::atomic<uint64_t>, kNumPhases> phase_calls_{};
+  std::array<std::atomic<uint64_t>, kNumCounters> counts_{};
+};
+
+/**
+ * Tracer writing the noise budget left after every homomorphic operation of
+ * the multiplication with the database, using the client's secret key. Only
+ * for debugging the choice of parameters: it needs the secret key and slows
+ * the multiplication down a lot.
+ */
+class NoiseBudgetTracer : public Tracer {
+ public:
+  /**
+   * @param[in] decryptor Decryptor holding the secret key of the queries,
+   *    which must outlive the tracer.
+   * @param[in] out Stream the noise budgets are written to.
+   */
+  NoiseBudgetTracer(seal::Decryptor* const decryptor, std::ostream& out)
+      : decryptor_(decryptor), out_(out) {}
+
+  void RecordPhase(Phase phase, Clock::duration elapsed) override {}
+  void Count(Counter counter, uint64_t n) override {}
+  bool ObservesCiphertexts() const override { return true; }
+  void ObserveCiphertext(std::size_t depth, const std::string& step,
+                         std::size_t row, const seal::Ciphertext& ct) override;
+
+ private:
+  seal::Decryptor* const decryptor_;
+  std::ostream& out_;
+  // Keeps the lines of queries processed at the same time whole.
+  std::mutex mutex_;
+};
+
+}  // namespace pir
+
+#endif  // PIR_TRACING_H_
@@ -1,13 +1,21 @@
 #include "pir/cpp/utils.h"
 
+#include <algorithm>
+
 namespace pir {
 
 using std::vector;
 
 vector<uint32_t> generate_galois_elts(uint64_t N) {
-  const size_t logN = ceil_log2(N);
-  vector<uint32_t> galois_elts(logN);
-  for (size_t i = 0; i < logN; ++i) {
+  return generate_galois_elts(N, N);
+}
+
+vector<uint32_t> generate_galois_elts(uint64_t N, uint64_t num_items) {
+  // Expanding m items takes ceil(log2(m)) levels, level i substituting with
+  // element N/2^i + 1, and no ciphertext holds more than N items.
+  const size_t levels = ceil_log2(std::min(N, num_items));
+  vector<uint32_t> galois_elts(levels);
+  for (size_t i = 0; i < levels; ++i) {
     galois_elts[i] = (N >> i) + 1;
   }
   return galois_elts;
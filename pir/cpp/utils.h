@@ -25,6 +25,10 @@ namespace pir {
 // Utility function to generate Galois elements needed for Oblivious Expansion.
 std::vector<uint32_t> generate_galois_elts(uint64_t N);
 
+// Utility function to generate only the Galois elements needed to obliviously
+// expand num_items items, at most N of which share a ciphertext.
+std::vector<uint32_t> generate_galois_elts(uint64_t N, uint64_t num_items);
+
 // Utility function to find the next highest power of 2 of a given number.
 template <typename t>
 t next_power_two(t n) {
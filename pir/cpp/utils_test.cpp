@@ -62,5 +62,16 @@ TEST(Log2Test, Log2) {
   EXPECT_EQ(log2(1UL << 31), 31);
 }
 
+TEST(GenerateGaloisEltsTest, GenerateGaloisElts) {
+  using Elts = std::vector<uint32_t>;
+  EXPECT_EQ(generate_galois_elts(16), Elts({17, 9, 5, 3}));
+  EXPECT_EQ(generate_galois_elts(16, 16), generate_galois_elts(16));
+  EXPECT_EQ(generate_galois_elts(16, 100), generate_galois_elts(16));
+  EXPECT_EQ(generate_galois_elts(16, 5), Elts({17, 9, 5}));
+  EXPECT_EQ(generate_galois_elts(16, 4), Elts({17, 9}));
+  EXPECT_EQ(generate_galois_elts(16, 2), Elts({17}));
+  EXPECT_EQ(generate_galois_elts(16, 1), Elts());
+}
+
 }  // namespace
 }  // namespace pir